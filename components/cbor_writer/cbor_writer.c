@@ -0,0 +1,106 @@
+#include <string.h>
+
+#include "cbor_writer.h"
+
+/* Major types */
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_SIMPLE 7
+
+/* Simple values */
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_NULL 22
+
+static void cw_put(cw_t *w, uint8_t b) {
+    if (w->buf != NULL && w->len < w->size) {
+        w->buf[w->len] = b;
+    }
+    w->len++;
+}
+
+/**
+ * Write an initial byte and its argument in the shortest form
+ */
+static void cw_head(cw_t *w, uint8_t major, uint64_t value) {
+    int bytes;
+    uint8_t info;
+
+    if (value < 24) {
+        cw_put(w, (major << 5) | (uint8_t)value);
+        return;
+    }
+    if (value <= UINT8_MAX) {
+        info = 24;
+        bytes = 1;
+    }
+    else if (value <= UINT16_MAX) {
+        info = 25;
+        bytes = 2;
+    }
+    else if (value <= UINT32_MAX) {
+        info = 26;
+        bytes = 4;
+    }
+    else {
+        info = 27;
+        bytes = 8;
+    }
+    cw_put(w, (major << 5) | info);
+    while (bytes-- > 0) {
+        cw_put(w, (uint8_t)(value >> (8 * bytes)));
+    }
+}
+
+void cw_init(cw_t *w, uint8_t *buf, size_t size) {
+    w->buf = buf;
+    w->size = (buf != NULL) ? size : 0;
+    w->len = 0;
+}
+
+void cw_map(cw_t *w, size_t pairs) {
+    cw_head(w, CBOR_MAP, pairs);
+}
+
+void cw_array(cw_t *w, size_t items) {
+    cw_head(w, CBOR_ARRAY, items);
+}
+
+void cw_uint(cw_t *w, uint64_t value) {
+    cw_head(w, CBOR_UINT, value);
+}
+
+void cw_int(cw_t *w, int64_t value) {
+    if (value < 0) {
+        // -1 - value, without overflowing on INT64_MIN
+        cw_head(w, CBOR_NEGINT, ~(uint64_t)value);
+    }
+    else {
+        cw_head(w, CBOR_UINT, (uint64_t)value);
+    }
+}
+
+void cw_text(cw_t *w, const char *value) {
+    size_t n = strlen(value);
+    cw_head(w, CBOR_TEXT, n);
+    if (w->buf != NULL && w->len < w->size) {
+        size_t room = w->size - w->len;
+        memcpy(w->buf + w->len, value, (n < room) ? n : room);
+    }
+    w->len += n;
+}
+
+void cw_bool(cw_t *w, bool value) {
+    cw_put(w, (CBOR_SIMPLE << 5) | (value ? CBOR_TRUE : CBOR_FALSE));
+}
+
+void cw_null(cw_t *w) {
+    cw_put(w, (CBOR_SIMPLE << 5) | CBOR_NULL);
+}
+
+bool cw_ok(const cw_t *w) {
+    return w->buf == NULL || w->len <= w->size;
+}
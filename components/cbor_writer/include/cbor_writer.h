@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Content-Type of CBOR payloads (RFC 8949) */
+#define CBOR_CONTENT_TYPE "application/cbor"
+
+/**
+ * Streaming CBOR writer.
+ * The counterpart of the JSON writer for compact binary payloads: it writes straight into a caller
+ * supplied buffer without allocating, and initialised with a NULL buffer it only counts.
+ * Maps and arrays use definite lengths, so the caller gives the number of entries up front and
+ * then writes exactly that many items (a key and a value for each map entry).
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    // Length of the whole item, even past the end of the buffer
+    size_t len;
+} cw_t;
+
+/**
+ * \brief Start an item. A NULL buffer only measures the item.
+ */
+void cw_init(cw_t *w, uint8_t *buf, size_t size);
+
+/**
+ * \brief Start a map of \p pairs key/value pairs
+ */
+void cw_map(cw_t *w, size_t pairs);
+
+/**
+ * \brief Start an array of \p items items
+ */
+void cw_array(cw_t *w, size_t items);
+
+void cw_uint(cw_t *w, uint64_t value);
+void cw_int(cw_t *w, int64_t value);
+
+/**
+ * \brief Write a UTF-8 text string
+ */
+void cw_text(cw_t *w, const char *value);
+void cw_bool(cw_t *w, bool value);
+void cw_null(cw_t *w);
+
+/**
+ * \brief Length of the item written so far, including anything that did not fit
+ */
+static inline size_t cw_length(const cw_t *w) {
+    return w->len;
+}
+
+/**
+ * \brief Whether everything written fits the buffer
+ */
+bool cw_ok(const cw_t *w);
+
+#ifdef __cplusplus
+}
+#endif
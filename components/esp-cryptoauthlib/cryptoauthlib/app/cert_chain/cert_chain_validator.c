@@ -0,0 +1,484 @@
+/**
+ * \file
+ * \brief  Host side engine validating device -> signer -> root certificate
+ *         chains with a cache of verified signers
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+
+#include <unistd.h>
+#include "cert_chain_validator.h"
+#include "atcacert/atcacert_host_sw.h"
+#include "crypto/atca_crypto_sw_sha2.h"
+
+#define CERT_CHAIN_SIGNER_EMPTY         (0)
+#define CERT_CHAIN_SIGNER_PENDING       (1)
+#define CERT_CHAIN_SIGNER_DONE          (2)
+
+/** \brief Work shared by the threads of one cert_chain_validate_batch() call */
+typedef struct cert_chain_job
+{
+    cert_chain_validator_t*     validator;
+    const cert_chain_request_t* requests;
+    int*                        results;
+    size_t                      count;
+    pthread_mutex_t             lock;
+    size_t                      next;       //!< First request not yet claimed by a worker
+} cert_chain_job_t;
+
+static double cert_chain_elapsed(const struct timespec* start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** \brief Initialize a chain validator. Roots are added with
+ *         cert_chain_validator_add_root() before the first validation.
+ *
+ * \param[out] validator  Validator to initialize
+ * \param[in]  workers    Number of threads used by cert_chain_validate_batch(),
+ *                        0 for one per online processor
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS cert_chain_validator_init(cert_chain_validator_t* validator, size_t workers)
+{
+    if (validator == NULL)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memset(validator, 0, sizeof(*validator));
+
+    if (workers == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (online > 0) ? (size_t)online : 1;
+    }
+    validator->worker_count = (workers > CERT_CHAIN_MAX_WORKERS) ? CERT_CHAIN_MAX_WORKERS : workers;
+
+    if (0 != pthread_mutex_init(&validator->lock, NULL))
+    {
+        return ATCA_GEN_FAIL;
+    }
+    if (0 != pthread_cond_init(&validator->signer_done, NULL))
+    {
+        (void)pthread_mutex_destroy(&validator->lock);
+        return ATCA_GEN_FAIL;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &validator->start);
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Free the resources of a validator. No validation may be running. */
+void cert_chain_validator_release(cert_chain_validator_t* validator)
+{
+    if (validator)
+    {
+        (void)pthread_cond_destroy(&validator->signer_done);
+        (void)pthread_mutex_destroy(&validator->lock);
+        memset(validator, 0, sizeof(*validator));
+    }
+}
+
+/** \brief Add a trusted root public key signer certificates are verified against */
+ATCA_STATUS cert_chain_validator_add_root(cert_chain_validator_t* validator, const uint8_t root_public_key[64])
+{
+    ATCA_STATUS status = ATCA_BAD_PARAM;
+
+    if (validator && root_public_key)
+    {
+        pthread_mutex_lock(&validator->lock);
+        if (validator->root_count >= CERT_CHAIN_MAX_ROOTS)
+        {
+            status = ATCA_INVALID_SIZE;
+        }
+        else if (ATCACERT_E_SUCCESS == atcacert_get_key_id(root_public_key, validator->root_key_id[validator->root_count]))
+        {
+            memcpy(validator->root_public_key[validator->root_count], root_public_key, 64);
+            validator->root_count++;
+            status = ATCA_SUCCESS;
+        }
+        else
+        {
+            status = ATCA_GEN_FAIL;
+        }
+        pthread_mutex_unlock(&validator->lock);
+    }
+    return status;
+}
+
+/* Verify a signer certificate against the roots, without holding the lock */
+static int cert_chain_verify_signer(cert_chain_validator_t* validator, const cert_chain_request_t* request,
+                                    const uint8_t key_id[20], uint8_t public_key[64])
+{
+    int ret;
+    uint8_t signer_key_id[20];
+    uint8_t root_key_id[20];
+    bool has_root_key_id;
+    size_t i;
+
+    ret = atcacert_get_subj_public_key(request->signer_def, request->signer_cert, request->signer_cert_size, public_key);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+
+    // The signer must hold the key the device certificate refers to
+    ret = atcacert_get_key_id(public_key, signer_key_id);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (memcmp(signer_key_id, key_id, sizeof(signer_key_id)))
+    {
+        return ATCACERT_E_VERIFY_FAILED;
+    }
+
+    has_root_key_id = (request->signer_def->std_cert_elements[STDCERT_AUTH_KEY_ID].count == sizeof(root_key_id))
+                      && (ATCACERT_E_SUCCESS == atcacert_get_auth_key_id(request->signer_def, request->signer_cert,
+                                                                         request->signer_cert_size, root_key_id));
+
+    ret = ATCACERT_E_VERIFY_FAILED;
+    for (i = 0; i < validator->root_count && ret != ATCACERT_E_SUCCESS; i++)
+    {
+        if (!has_root_key_id || !memcmp(validator->root_key_id[i], root_key_id, sizeof(root_key_id)))
+        {
+            ret = atcacert_verify_cert_sw(request->signer_def, request->signer_cert, request->signer_cert_size,
+                                          validator->root_public_key[i]);
+        }
+    }
+
+    return (ret == ATCACERT_E_SUCCESS) ? ATCACERT_E_SUCCESS : ATCACERT_E_VERIFY_FAILED;
+}
+
+static cert_chain_signer_t* cert_chain_find_signer(cert_chain_validator_t* validator, const uint8_t key_id[20])
+{
+    size_t i;
+
+    for (i = 0; i < CERT_CHAIN_SIGNER_CACHE_SIZE; i++)
+    {
+        if (validator->signers[i].state != CERT_CHAIN_SIGNER_EMPTY && !memcmp(validator->signers[i].key_id, key_id, 20))
+        {
+            return &validator->signers[i];
+        }
+    }
+    return NULL;
+}
+
+/* Least recently used entry that isn't being verified, NULL when all are */
+static cert_chain_signer_t* cert_chain_victim_signer(cert_chain_validator_t* validator)
+{
+    cert_chain_signer_t* victim = NULL;
+    size_t i;
+
+    for (i = 0; i < CERT_CHAIN_SIGNER_CACHE_SIZE; i++)
+    {
+        cert_chain_signer_t* entry = &validator->signers[i];
+        if (entry->state == CERT_CHAIN_SIGNER_EMPTY)
+        {
+            return entry;
+        }
+        if (entry->state == CERT_CHAIN_SIGNER_DONE && (victim == NULL || entry->last_used < victim->last_used))
+        {
+            victim = entry;
+        }
+    }
+    return victim;
+}
+
+/* Get the public key of the verified signer of a request. The signer
+ * certificate is verified once per key ID and certificate; concurrent
+ * requests for a signer being verified wait for that result. Only verified
+ * signers are cached, so a bad certificate claiming the key of a cached
+ * signer fails on its own without affecting the entry. */
+static int cert_chain_get_signer(cert_chain_validator_t* validator, const cert_chain_request_t* request,
+                                 const uint8_t key_id[20], uint8_t public_key[64])
+{
+    int ret = ATCACERT_E_VERIFY_FAILED;
+    uint8_t digest[32];
+    cert_chain_signer_t* entry;
+    bool waited = false;
+    bool claimed = false;
+
+    if (request->signer_cert)
+    {
+        if (0 != atcac_sw_sha2_256(request->signer_cert, request->signer_cert_size, digest))
+        {
+            return ATCACERT_E_ERROR;
+        }
+    }
+
+    pthread_mutex_lock(&validator->lock);
+    for (;;)
+    {
+        entry = cert_chain_find_signer(validator, key_id);
+
+        if (entry && entry->state == CERT_CHAIN_SIGNER_PENDING)
+        {
+            if (!waited)
+            {
+                validator->stats.signer_waits++;
+                waited = true;
+            }
+            pthread_cond_wait(&validator->signer_done, &validator->lock);
+            continue;
+        }
+
+        if (entry && (request->signer_cert == NULL || !memcmp(entry->cert_digest, digest, sizeof(digest))))
+        {
+            validator->stats.signer_cache_hits++;
+            entry->last_used = ++validator->use_counter;
+            memcpy(public_key, entry->public_key, 64);
+            ret = ATCACERT_E_SUCCESS;
+            break;
+        }
+
+        if (request->signer_cert == NULL)
+        {
+            // Unknown signer and none provided
+            break;
+        }
+
+        /* Verify the signer. A certificate claiming the key of a cached signer is checked on
+           its own: only a valid one may replace the cached entry */
+        if (entry == NULL)
+        {
+            entry = cert_chain_victim_signer(validator);
+            if (entry)
+            {
+                memcpy(entry->key_id, key_id, sizeof(entry->key_id));
+                entry->state = CERT_CHAIN_SIGNER_PENDING;
+                claimed = true;
+            }
+        }
+        validator->stats.signer_verifications++;
+        pthread_mutex_unlock(&validator->lock);
+
+        ret = cert_chain_verify_signer(validator, request, key_id, public_key);
+
+        pthread_mutex_lock(&validator->lock);
+        if (claimed)
+        {
+            if (ret == ATCACERT_E_SUCCESS)
+            {
+                memcpy(entry->cert_digest, digest, sizeof(entry->cert_digest));
+                memcpy(entry->public_key, public_key, sizeof(entry->public_key));
+                entry->last_used = ++validator->use_counter;
+                entry->state = CERT_CHAIN_SIGNER_DONE;
+            }
+            else
+            {
+                // Failures aren't cached, waiting requests verify their own certificate
+                entry->state = CERT_CHAIN_SIGNER_EMPTY;
+            }
+            pthread_cond_broadcast(&validator->signer_done);
+        }
+        else if (entry && ret == ATCACERT_E_SUCCESS && entry->state == CERT_CHAIN_SIGNER_DONE
+                 && !memcmp(entry->key_id, key_id, sizeof(entry->key_id)))
+        {
+            // A reissued certificate for the cached key
+            memcpy(entry->cert_digest, digest, sizeof(entry->cert_digest));
+            entry->last_used = ++validator->use_counter;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&validator->lock);
+
+    return ret;
+}
+
+/** \brief Validate one device certificate chain: the device certificate must
+ *         be signed by the signer, which must be signed by one of the roots.
+ *         Thread safe.
+ *
+ * The signer is looked up by the authority key ID of the device certificate
+ * (or the key ID of the signer public key when the device certificate has
+ * none). A signer certificate verified before is not verified again, so the
+ * signer certificate can be omitted from the request once it is cached.
+ *
+ * \param[in] validator  Validator with the trusted roots
+ * \param[in] request    Chain to validate
+ *
+ * \return ATCACERT_E_SUCCESS when the chain is valid, otherwise an error code.
+ */
+int cert_chain_validate(cert_chain_validator_t* validator, const cert_chain_request_t* request)
+{
+    int ret;
+    uint8_t key_id[20];
+    uint8_t signer_public_key[64];
+
+    if (validator == NULL || request == NULL || request->device_def == NULL || request->device_cert == NULL
+        || request->signer_def == NULL || (request->signer_cert == NULL && request->signer_cert_size > 0))
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+
+    if (request->device_def->std_cert_elements[STDCERT_AUTH_KEY_ID].count == sizeof(key_id))
+    {
+        ret = atcacert_get_auth_key_id(request->device_def, request->device_cert, request->device_cert_size, key_id);
+    }
+    else if (request->signer_cert)
+    {
+        ret = atcacert_get_subj_public_key(request->signer_def, request->signer_cert, request->signer_cert_size, signer_public_key);
+        if (ret == ATCACERT_E_SUCCESS)
+        {
+            ret = atcacert_get_key_id(signer_public_key, key_id);
+        }
+    }
+    else
+    {
+        ret = ATCACERT_E_BAD_PARAMS;
+    }
+
+    if (ret == ATCACERT_E_SUCCESS)
+    {
+        ret = cert_chain_get_signer(validator, request, key_id, signer_public_key);
+    }
+
+    if (ret == ATCACERT_E_SUCCESS)
+    {
+        ret = atcacert_verify_cert_sw(request->device_def, request->device_cert, request->device_cert_size, signer_public_key);
+        ret = (ret == ATCACERT_E_SUCCESS) ? ATCACERT_E_SUCCESS : ATCACERT_E_VERIFY_FAILED;
+    }
+
+    pthread_mutex_lock(&validator->lock);
+    validator->stats.validations++;
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        validator->stats.failures++;
+    }
+    pthread_mutex_unlock(&validator->lock);
+
+    return ret;
+}
+
+static void* cert_chain_worker(void* arg)
+{
+    cert_chain_job_t* job = (cert_chain_job_t*)arg;
+    size_t first;
+    size_t last;
+    size_t i;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&job->lock);
+        first = job->next;
+        last = (job->count - first > CERT_CHAIN_CHUNK) ? first + CERT_CHAIN_CHUNK : job->count;
+        job->next = last;
+        pthread_mutex_unlock(&job->lock);
+
+        if (first >= last)
+        {
+            break;
+        }
+
+        for (i = first; i < last; i++)
+        {
+            job->results[i] = cert_chain_validate(job->validator, &job->requests[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/** \brief Validate a batch of chains over the validator workers. Requests for
+ *         the same signer share a single signer verification.
+ *
+ * \param[in]  validator  Validator with the trusted roots
+ * \param[in]  requests   Chains to validate
+ * \param[in]  count      Number of requests
+ * \param[out] results    Result of cert_chain_validate() for every request
+ *
+ * \return ATCA_SUCCESS when the batch was processed, otherwise an error code.
+ */
+ATCA_STATUS cert_chain_validate_batch(cert_chain_validator_t* validator, const cert_chain_request_t* requests, size_t count, int* results)
+{
+    cert_chain_job_t job;
+    pthread_t threads[CERT_CHAIN_MAX_WORKERS];
+    size_t started = 0;
+    size_t i;
+
+    if (validator == NULL || ((requests == NULL || results == NULL) && count > 0))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.validator = validator;
+    job.requests = requests;
+    job.results = results;
+    job.count = count;
+    if (0 != pthread_mutex_init(&job.lock, NULL))
+    {
+        return ATCA_GEN_FAIL;
+    }
+
+    // The calling thread is one of the workers
+    for (i = 1; i < validator->worker_count && i * CERT_CHAIN_CHUNK < count; i++)
+    {
+        if (0 != pthread_create(&threads[i], NULL, cert_chain_worker, &job))
+        {
+            break;
+        }
+        started = i;
+    }
+
+    (void)cert_chain_worker(&job);
+
+    for (i = 1; i <= started; i++)
+    {
+        (void)pthread_join(threads[i], NULL);
+    }
+    (void)pthread_mutex_destroy(&job.lock);
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Get the counters of a validator, including the validation rate
+ *
+ * \param[in]  validator  Validator
+ * \param[out] stats      Counters since initialization or the last reset
+ * \param[in]  reset      Restart the counters and the rate measurement
+ */
+void cert_chain_validator_stats(cert_chain_validator_t* validator, cert_chain_stats_t* stats, bool reset)
+{
+    if (validator && stats)
+    {
+        pthread_mutex_lock(&validator->lock);
+        *stats = validator->stats;
+        stats->seconds = cert_chain_elapsed(&validator->start);
+        stats->validations_per_sec = (stats->seconds > 0) ? (double)stats->validations / stats->seconds : 0.0;
+        if (reset)
+        {
+            memset(&validator->stats, 0, sizeof(validator->stats));
+            clock_gettime(CLOCK_MONOTONIC, &validator->start);
+        }
+        pthread_mutex_unlock(&validator->lock);
+    }
+}
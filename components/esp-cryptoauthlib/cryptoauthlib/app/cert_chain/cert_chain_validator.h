@@ -0,0 +1,125 @@
+/**
+ * \file
+ * \brief  Host side engine validating device -> signer -> root certificate
+ *         chains with a cache of verified signers
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+
+#ifndef CERT_CHAIN_VALIDATOR_H_
+#define CERT_CHAIN_VALIDATOR_H_
+
+#include <pthread.h>
+#include <time.h>
+#include "cryptoauthlib.h"
+#include "atcacert/atcacert_def.h"
+
+/** \brief Number of verified signer certificates remembered. Signers are
+ *         replaced least recently used first once it is full.
+ */
+#ifndef CERT_CHAIN_SIGNER_CACHE_SIZE
+#define CERT_CHAIN_SIGNER_CACHE_SIZE    (64)
+#endif
+
+/** \brief Maximum number of trusted root public keys */
+#ifndef CERT_CHAIN_MAX_ROOTS
+#define CERT_CHAIN_MAX_ROOTS            (8)
+#endif
+
+/** \brief Maximum number of worker threads used by cert_chain_validate_batch() */
+#ifndef CERT_CHAIN_MAX_WORKERS
+#define CERT_CHAIN_MAX_WORKERS          (64)
+#endif
+
+/** \brief Number of requests a worker claims from a batch at a time */
+#ifndef CERT_CHAIN_CHUNK
+#define CERT_CHAIN_CHUNK                (16)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief One device certificate chain to validate */
+typedef struct cert_chain_request
+{
+    const atcacert_def_t* device_def;                       //!< Definition of the device certificate
+    const uint8_t*        device_cert;                      //!< Device certificate
+    size_t                device_cert_size;                 //!< Size of device_cert in bytes
+    const atcacert_def_t* signer_def;                       //!< Definition of the signer certificate
+    const uint8_t*        signer_cert;                      //!< Signer certificate. May be NULL when the signer is already cached.
+    size_t                signer_cert_size;                 //!< Size of signer_cert in bytes
+} cert_chain_request_t;
+
+/** \brief Counters of a validator, see cert_chain_validator_stats() */
+typedef struct cert_chain_stats
+{
+    uint64_t validations;                                   //!< Chains validated
+    uint64_t failures;                                      //!< Chains rejected
+    uint64_t signer_verifications;                          //!< Signer certificates verified against a root
+    uint64_t signer_cache_hits;                             //!< Chains whose signer was found in the cache
+    uint64_t signer_waits;                                  //!< Chains that waited for another thread verifying the same signer
+    double   seconds;                                       //!< Time since the validator was initialized or the counters reset
+    double   validations_per_sec;                           //!< validations / seconds
+} cert_chain_stats_t;
+
+/** \brief Verified (or rejected) signer certificate */
+typedef struct cert_chain_signer
+{
+    uint8_t  key_id[20];                                    //!< Key ID of the signer public key
+    uint8_t  state;                                         //!< CERT_CHAIN_SIGNER_EMPTY, _PENDING or _DONE
+    uint8_t  cert_digest[32];                               //!< SHA256 of the verified signer certificate
+    uint8_t  public_key[64];                                //!< Signer public key
+    uint64_t last_used;                                     //!< Value of the use counter when last used
+} cert_chain_signer_t;
+
+/** \brief Validator state, shared by every thread using it */
+typedef struct cert_chain_validator
+{
+    pthread_mutex_t     lock;
+    pthread_cond_t      signer_done;                        //!< Signalled when a pending signer is verified
+    size_t              worker_count;                       //!< Number of threads used by cert_chain_validate_batch()
+    size_t              root_count;
+    uint8_t             root_public_key[CERT_CHAIN_MAX_ROOTS][64];
+    uint8_t             root_key_id[CERT_CHAIN_MAX_ROOTS][20];
+    uint64_t            use_counter;
+    cert_chain_signer_t signers[CERT_CHAIN_SIGNER_CACHE_SIZE];
+    cert_chain_stats_t  stats;
+    struct timespec     start;
+} cert_chain_validator_t;
+
+ATCA_STATUS cert_chain_validator_init(cert_chain_validator_t* validator, size_t workers);
+void cert_chain_validator_release(cert_chain_validator_t* validator);
+ATCA_STATUS cert_chain_validator_add_root(cert_chain_validator_t* validator, const uint8_t root_public_key[64]);
+int cert_chain_validate(cert_chain_validator_t* validator, const cert_chain_request_t* request);
+ATCA_STATUS cert_chain_validate_batch(cert_chain_validator_t* validator, const cert_chain_request_t* requests, size_t count, int* results);
+void cert_chain_validator_stats(cert_chain_validator_t* validator, cert_chain_stats_t* stats, bool reset);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* CERT_CHAIN_VALIDATOR_H_ */
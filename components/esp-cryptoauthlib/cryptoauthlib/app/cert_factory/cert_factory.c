@@ -0,0 +1,546 @@
+/**
+ * \file
+ * \brief  Host side bulk generator of compressed device certificates for
+ *         manufacturing provisioning
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+
+#include <pthread.h>
+#include <unistd.h>
+#include "cert_factory.h"
+#include "atcacert/atcacert_date.h"
+
+/* Location of the device serial number in the configuration zone: SN[0:3], RevNum, SN[4:8] */
+static const atcacert_device_loc_t cert_factory_sn_loc =
+{
+    .zone      = DEVZONE_CONFIG,
+    .slot      = 0,
+    .is_genkey = FALSE,
+    .offset    = 0,
+    .count     = 13
+};
+
+/** \brief Work shared by the threads of one cert_factory_run() call */
+typedef struct cert_factory_job
+{
+    cert_factory_t*             factory;
+    const cert_factory_input_t* inputs;
+    size_t                      count;
+    uint8_t*                    records;
+    pthread_mutex_t             lock;
+    size_t                      next;       //!< First input not yet claimed by a worker
+    size_t                      failed;     //!< Number of records that could not be built
+} cert_factory_job_t;
+
+typedef struct cert_factory_worker
+{
+    cert_factory_job_t* job;
+    size_t              id;                 //!< Index of the signing key context used by the worker
+} cert_factory_worker_t;
+
+static void cert_factory_put_u16(uint8_t* buf, size_t value)
+{
+    buf[0] = (uint8_t)(value & 0xFF);
+    buf[1] = (uint8_t)((value >> 8) & 0xFF);
+}
+
+static void cert_factory_put_u32(uint8_t* buf, size_t value)
+{
+    cert_factory_put_u16(buf, value & 0xFFFF);
+    cert_factory_put_u16(&buf[2], (value >> 16) & 0xFFFF);
+}
+
+/** \brief Initialize a certificate factory
+ *
+ * \param[out] factory          Factory to initialize
+ * \param[in]  cert_def         Definition of the certificates to generate
+ * \param[in]  ca_key_pem       PEM encoded private key of the signer
+ * \param[in]  ca_key_pem_size  Size of ca_key_pem in bytes
+ * \param[in]  issue_date       Issue date of the certificates. Only the
+ *                              precision of the compressed certificate (the
+ *                              hour) is kept so the devices rebuild the exact
+ *                              certificates that were signed.
+ * \param[in]  workers          Number of threads used by cert_factory_run(),
+ *                              0 for one per online processor
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS cert_factory_init(cert_factory_t* factory, const atcacert_def_t* cert_def, const uint8_t* ca_key_pem, size_t ca_key_pem_size,
+                              const atcacert_tm_utc_t* issue_date, size_t workers)
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+    uint8_t enc_dates[3];
+    size_t public_key_size = sizeof(factory->ca_public_key);
+
+    if (factory == NULL || cert_def == NULL || ca_key_pem == NULL || issue_date == NULL)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memset(factory, 0, sizeof(*factory));
+    factory->cert_def = cert_def;
+
+    if (workers == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (online > 0) ? (size_t)online : 1;
+    }
+    factory->worker_count = (workers > CERT_FACTORY_MAX_WORKERS) ? CERT_FACTORY_MAX_WORKERS : workers;
+
+    if (ATCACERT_E_SUCCESS != atcacert_max_cert_size(cert_def, &factory->max_cert_size)
+        || factory->max_cert_size > 0xFFFF)
+    {
+        return ATCA_BAD_PARAM;
+    }
+    factory->record_size = (CERT_FACTORY_REC_CERT + factory->max_cert_size + 7) & ~(size_t)7;
+
+    /* Dates go through the compressed certificate encoding, as they do when the device rebuilds the certificate */
+    if (ATCACERT_E_SUCCESS != atcacert_date_enc_compcert(issue_date, cert_def->expire_years, enc_dates)
+        || ATCACERT_E_SUCCESS != atcacert_date_dec_compcert(enc_dates, cert_def->expire_date_format, &factory->issue_date,
+                                                            &factory->expire_date))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    /* Each worker signs with its own key context, the backends don't guarantee a context is thread safe */
+    while (factory->key_count < factory->worker_count)
+    {
+        if (ATCA_SUCCESS != (status = atcac_pk_init_pem(&factory->ca_key[factory->key_count], ca_key_pem, ca_key_pem_size, false)))
+        {
+            break;
+        }
+        factory->key_count++;
+    }
+
+    if (ATCA_SUCCESS == status)
+    {
+        status = atcac_pk_public(&factory->ca_key[0], factory->ca_public_key, &public_key_size);
+    }
+
+    if (ATCA_SUCCESS != status)
+    {
+        cert_factory_release(factory);
+    }
+    return status;
+}
+
+/** \brief Free the signing key contexts of a factory */
+void cert_factory_release(cert_factory_t* factory)
+{
+    size_t i;
+
+    if (factory)
+    {
+        for (i = 0; i < factory->key_count; i++)
+        {
+            (void)atcac_pk_free(&factory->ca_key[i]);
+        }
+        memset(factory, 0, sizeof(*factory));
+    }
+}
+
+/** \brief Set the signer ID written to the certificates. Without it the
+ *         signer ID of the certificate template is kept.
+ */
+void cert_factory_set_signer_id(cert_factory_t* factory, const uint8_t signer_id[2])
+{
+    if (factory && signer_id)
+    {
+        memcpy(factory->signer_id, signer_id, sizeof(factory->signer_id));
+        factory->has_signer_id = true;
+    }
+}
+
+/** \brief Size in bytes of the output of cert_factory_run() for count inputs */
+size_t cert_factory_output_size(const cert_factory_t* factory, size_t count)
+{
+    return (factory) ? CERT_FACTORY_HEADER_SIZE + count * factory->record_size : 0;
+}
+
+/** \brief Generate, sign and compress the certificate of one device into an
+ *         output record. Can be called from several threads at once as long as
+ *         each uses a different worker index.
+ *
+ * \param[in]  factory  Initialized factory
+ * \param[in]  worker   Index of the signing key context to use, below
+ *                      factory->worker_count
+ * \param[in]  input    Device serial number and public key
+ * \param[out] record   Output record, factory->record_size bytes
+ *
+ * \return ATCACERT_E_SUCCESS on success, otherwise an error code. The code is
+ *         also stored in the record status, ATCACERT_E_DECODING_ERROR when
+ *         the public key is not a point on P-256.
+ */
+int cert_factory_build(cert_factory_t* factory, size_t worker, const cert_factory_input_t* input, uint8_t* record)
+{
+    int ret;
+    atcacert_build_state_t build_state;
+    uint8_t* cert;
+    size_t cert_size;
+    uint8_t config_sn[13];
+    uint8_t tbs_digest[32];
+    uint8_t signature[64];
+    size_t signature_size = sizeof(signature);
+    atcac_pk_ctx device_key;
+
+    if (factory == NULL || worker >= factory->worker_count || input == NULL || record == NULL)
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+
+    memset(record, 0, factory->record_size);
+    memcpy(&record[CERT_FACTORY_REC_SN], input->device_sn, sizeof(input->device_sn));
+    cert = &record[CERT_FACTORY_REC_CERT];
+    cert_size = factory->max_cert_size;
+
+    memset(config_sn, 0, sizeof(config_sn));
+    memcpy(&config_sn[0], &input->device_sn[0], 4);
+    memcpy(&config_sn[8], &input->device_sn[4], 5);
+
+    do
+    {
+        /* Never sign a key the device cannot hold, e.g. from a corrupted line of the device list */
+        if (ATCA_SUCCESS != atcac_pk_init(&device_key, input->public_key, sizeof(input->public_key), 0, true))
+        {
+            ret = ATCACERT_E_DECODING_ERROR;
+            break;
+        }
+        (void)atcac_pk_free(&device_key);
+
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_cert_build_start(&build_state, factory->cert_def, cert, &cert_size, factory->ca_public_key)))
+        {
+            break;
+        }
+
+        /* Fills any certificate element taken from the serial number and the SN used by SNSRC_DEVICE_SN */
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_cert_build_process(&build_state, &cert_factory_sn_loc, config_sn)))
+        {
+            break;
+        }
+
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_set_subj_public_key(factory->cert_def, cert, cert_size, input->public_key)))
+        {
+            break;
+        }
+
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_set_issue_date(factory->cert_def, cert, cert_size, &factory->issue_date)))
+        {
+            break;
+        }
+
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_set_expire_date(factory->cert_def, cert, cert_size, &factory->expire_date)))
+        {
+            break;
+        }
+
+        if (factory->has_signer_id)
+        {
+            if (ATCACERT_E_SUCCESS != (ret = atcacert_set_signer_id(factory->cert_def, cert, cert_size, factory->signer_id)))
+            {
+                break;
+            }
+        }
+
+        /* Generates the certificate serial number, which may hash the public key and dates set above */
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_cert_build_finish(&build_state)))
+        {
+            break;
+        }
+
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_get_tbs_digest(factory->cert_def, cert, cert_size, tbs_digest)))
+        {
+            break;
+        }
+
+        if (ATCA_SUCCESS != atcac_pk_sign(&factory->ca_key[worker], tbs_digest, sizeof(tbs_digest), signature, &signature_size)
+            || signature_size != sizeof(signature))
+        {
+            ret = ATCACERT_E_ERROR;
+            break;
+        }
+
+        if (ATCACERT_E_SUCCESS != (ret = atcacert_set_signature(factory->cert_def, cert, &cert_size, factory->max_cert_size, signature)))
+        {
+            break;
+        }
+
+        ret = atcacert_get_comp_cert(factory->cert_def, cert, cert_size, &record[CERT_FACTORY_REC_COMP_CERT]);
+    }
+    while (0);
+
+    if (ATCACERT_E_SUCCESS == ret)
+    {
+        cert_factory_put_u16(&record[CERT_FACTORY_REC_CERT_SIZE], cert_size);
+    }
+    else
+    {
+        /* Don't leave a partial certificate behind */
+        memset(&record[CERT_FACTORY_REC_COMP_CERT], 0, factory->record_size - CERT_FACTORY_REC_COMP_CERT);
+    }
+    record[CERT_FACTORY_REC_STATUS] = (uint8_t)ret;
+
+    return ret;
+}
+
+static void* cert_factory_worker(void* arg)
+{
+    cert_factory_worker_t* worker = (cert_factory_worker_t*)arg;
+    cert_factory_job_t* job = worker->job;
+    size_t failed = 0;
+    size_t first;
+    size_t last;
+    size_t i;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&job->lock);
+        first = job->next;
+        last = (job->count - first > CERT_FACTORY_CHUNK) ? first + CERT_FACTORY_CHUNK : job->count;
+        job->next = last;
+        pthread_mutex_unlock(&job->lock);
+
+        if (first >= last)
+        {
+            break;
+        }
+
+        for (i = first; i < last; i++)
+        {
+            if (ATCACERT_E_SUCCESS != cert_factory_build(job->factory, worker->id, &job->inputs[i],
+                                                         &job->records[i * job->factory->record_size]))
+            {
+                failed++;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->failed += failed;
+    pthread_mutex_unlock(&job->lock);
+
+    return NULL;
+}
+
+/** \brief Generate the certificates of a list of devices into an output
+ *         buffer, normally a mapped file, spreading the work over the factory
+ *         workers. Records are written in input order.
+ *
+ * \param[in]  factory      Initialized factory
+ * \param[in]  inputs       Device serial numbers and public keys
+ * \param[in]  count        Number of inputs
+ * \param[out] output       Output buffer, see the layout in cert_factory.h
+ * \param[in]  output_size  Size of output, at least cert_factory_output_size()
+ * \param[out] failed       Number of records with an error status. Optional.
+ *
+ * \return ATCA_SUCCESS when the output was written (individual records may
+ *         still have failed), otherwise an error code.
+ */
+ATCA_STATUS cert_factory_run(cert_factory_t* factory, const cert_factory_input_t* inputs, size_t count, uint8_t* output, size_t output_size,
+                             size_t* failed)
+{
+    cert_factory_job_t job;
+    cert_factory_worker_t workers[CERT_FACTORY_MAX_WORKERS];
+    pthread_t threads[CERT_FACTORY_MAX_WORKERS];
+    size_t started = 0;
+    size_t i;
+
+    if (factory == NULL || factory->cert_def == NULL || (inputs == NULL && count > 0) || output == NULL
+        || count > 0xFFFFFFFF || output_size < cert_factory_output_size(factory, count))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memset(output, 0, CERT_FACTORY_HEADER_SIZE);
+    memcpy(output, CERT_FACTORY_MAGIC, 4);
+    cert_factory_put_u16(&output[4], CERT_FACTORY_VERSION);
+    cert_factory_put_u16(&output[6], CERT_FACTORY_HEADER_SIZE);
+    cert_factory_put_u32(&output[8], factory->record_size);
+    cert_factory_put_u32(&output[12], count);
+    cert_factory_put_u32(&output[16], factory->max_cert_size);
+
+    memset(&job, 0, sizeof(job));
+    job.factory = factory;
+    job.inputs = inputs;
+    job.count = count;
+    job.records = &output[CERT_FACTORY_HEADER_SIZE];
+    if (0 != pthread_mutex_init(&job.lock, NULL))
+    {
+        return ATCA_GEN_FAIL;
+    }
+
+    for (i = 0; i < factory->worker_count; i++)
+    {
+        workers[i].job = &job;
+        workers[i].id = i;
+    }
+
+    /* The calling thread is worker 0 */
+    for (i = 1; i < factory->worker_count && i * CERT_FACTORY_CHUNK < count; i++)
+    {
+        if (0 != pthread_create(&threads[i], NULL, cert_factory_worker, &workers[i]))
+        {
+            break;
+        }
+        started = i;
+    }
+
+    (void)cert_factory_worker(&workers[0]);
+
+    for (i = 1; i <= started; i++)
+    {
+        (void)pthread_join(threads[i], NULL);
+    }
+    (void)pthread_mutex_destroy(&job.lock);
+
+    if (failed)
+    {
+        *failed = job.failed;
+    }
+    return ATCA_SUCCESS;
+}
+
+static int cert_factory_hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Decode exactly size bytes of hex from [*pos, end), stopping at the field end */
+static bool cert_factory_hex_field(const char** pos, const char* end, uint8_t* data, size_t size)
+{
+    const char* p = *pos;
+    size_t i;
+    int hi;
+    int lo;
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    for (i = 0; i < size; i++)
+    {
+        if (end - p < 2 || (hi = cert_factory_hex_nibble(p[0])) < 0 || (lo = cert_factory_hex_nibble(p[1])) < 0)
+        {
+            return false;
+        }
+        data[i] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+    }
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+        p++;
+    }
+    *pos = p;
+    return true;
+}
+
+/** \brief Parse the device list given to the factory. Each line holds the
+ *         device serial number and public key as hex, separated by a comma:
+ *
+ *             0123xxxxxxxxxxxxEE,<128 hex digits of X and Y>
+ *
+ *         Empty lines and lines starting with '#' are skipped.
+ *
+ * \param[in]  text       CSV text, not necessarily null terminated
+ * \param[in]  text_size  Size of text in bytes
+ * \param[out] inputs     Parsed devices. NULL to only count them.
+ * \param[in]  max_count  Size of inputs in records
+ * \param[out] count      Number of devices found
+ * \param[out] line       Line number of a malformed line. Optional.
+ *
+ * \return ATCA_SUCCESS on success, ATCA_PARSE_ERROR for a malformed line or
+ *         ATCA_SMALL_BUFFER when inputs is too small.
+ */
+ATCA_STATUS cert_factory_parse_csv(const char* text, size_t text_size, cert_factory_input_t* inputs, size_t max_count, size_t* count,
+                                   size_t* line)
+{
+    const char* pos = text;
+    const char* end = text + text_size;
+    const char* eol;
+    size_t line_no = 0;
+    size_t found = 0;
+    cert_factory_input_t input;
+
+    if ((text == NULL && text_size > 0) || count == NULL)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    for (; pos < end; pos = eol + 1)
+    {
+        line_no++;
+        eol = memchr(pos, '\n', (size_t)(end - pos));
+        if (eol == NULL)
+        {
+            eol = end;
+        }
+
+        while (pos < eol && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+        {
+            pos++;
+        }
+        if (pos == eol || *pos == '#')
+        {
+            continue;
+        }
+
+        if (!cert_factory_hex_field(&pos, eol, input.device_sn, sizeof(input.device_sn))
+            || pos == eol || *pos++ != ','
+            || !cert_factory_hex_field(&pos, eol, input.public_key, sizeof(input.public_key))
+            || pos != eol)
+        {
+            if (line)
+            {
+                *line = line_no;
+            }
+            return ATCA_PARSE_ERROR;
+        }
+
+        if (inputs)
+        {
+            if (found >= max_count)
+            {
+                return ATCA_SMALL_BUFFER;
+            }
+            inputs[found] = input;
+        }
+        found++;
+    }
+
+    *count = found;
+    return ATCA_SUCCESS;
+}
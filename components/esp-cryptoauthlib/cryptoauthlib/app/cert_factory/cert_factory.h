@@ -0,0 +1,123 @@
+/**
+ * \file
+ * \brief  Host side bulk generator of compressed device certificates for
+ *         manufacturing provisioning
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+
+#ifndef CERT_FACTORY_H_
+#define CERT_FACTORY_H_
+
+#include "cryptoauthlib.h"
+#include "atcacert/atcacert_def.h"
+#include "crypto/atca_crypto_sw.h"
+
+/** \brief Maximum number of worker threads signing certificates */
+#ifndef CERT_FACTORY_MAX_WORKERS
+#define CERT_FACTORY_MAX_WORKERS        (64)
+#endif
+
+/** \brief Number of records a worker claims from the input at a time */
+#ifndef CERT_FACTORY_CHUNK
+#define CERT_FACTORY_CHUNK              (64)
+#endif
+
+/** \name Output file layout
+ *
+ * The output is a header followed by fixed size records so it can be mapped
+ * and indexed directly by the line tooling. All integers are little endian.
+ *
+ *   Header (CERT_FACTORY_HEADER_SIZE bytes)
+ *     0   magic "ACFB"
+ *     4   u16 format version (CERT_FACTORY_VERSION)
+ *     6   u16 header size
+ *     8   u32 record size
+ *     12  u32 record count
+ *     16  u32 maximum certificate size
+ *     20  reserved, zero
+ *
+ *   Record (record size bytes, input order)
+ *     0   device serial number (9 bytes)
+ *     9   u8 status, ATCACERT_E_SUCCESS when the record is valid
+ *     10  u16 certificate size
+ *     12  reserved, zero
+ *     16  compressed certificate (72 bytes)
+ *     88  DER certificate, zero padded to the record size
+ * @{ */
+#define CERT_FACTORY_MAGIC              "ACFB"
+#define CERT_FACTORY_VERSION            (1)
+#define CERT_FACTORY_HEADER_SIZE        (32)
+#define CERT_FACTORY_REC_SN             (0)
+#define CERT_FACTORY_REC_STATUS         (9)
+#define CERT_FACTORY_REC_CERT_SIZE      (10)
+#define CERT_FACTORY_REC_COMP_CERT      (16)
+#define CERT_FACTORY_REC_CERT           (88)
+/** @} */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Device data a certificate is generated from */
+typedef struct cert_factory_input
+{
+    uint8_t device_sn[9];                                   //!< Device serial number
+    uint8_t public_key[64];                                 //!< Device public key, X and Y
+} cert_factory_input_t;
+
+/** \brief Factory state for one certificate definition and signing key */
+typedef struct cert_factory
+{
+    const atcacert_def_t* cert_def;                         //!< Definition of the generated certificates
+    atcacert_tm_utc_t     issue_date;                       //!< Issue date of every certificate, as stored in the compressed certificate
+    atcacert_tm_utc_t     expire_date;                      //!< Expire date the device rebuilds from the compressed certificate
+    uint8_t               signer_id[2];                     //!< Signer ID written to every certificate
+    bool                  has_signer_id;                    //!< Signer ID is set in the certificates
+    uint8_t               ca_public_key[64];                //!< Public key of the signing key, for the authority key ID
+    size_t                max_cert_size;                    //!< Largest certificate the definition can produce
+    size_t                record_size;                      //!< Size of an output record
+    size_t                worker_count;                     //!< Number of threads used by cert_factory_run()
+    size_t                key_count;                        //!< Number of initialized ca_key contexts
+    atcac_pk_ctx          ca_key[CERT_FACTORY_MAX_WORKERS]; //!< Signing key, one context per worker
+} cert_factory_t;
+
+ATCA_STATUS cert_factory_init(cert_factory_t* factory, const atcacert_def_t* cert_def, const uint8_t* ca_key_pem, size_t ca_key_pem_size,
+                              const atcacert_tm_utc_t* issue_date, size_t workers);
+void cert_factory_release(cert_factory_t* factory);
+void cert_factory_set_signer_id(cert_factory_t* factory, const uint8_t signer_id[2]);
+size_t cert_factory_output_size(const cert_factory_t* factory, size_t count);
+int cert_factory_build(cert_factory_t* factory, size_t worker, const cert_factory_input_t* input, uint8_t* record);
+ATCA_STATUS cert_factory_run(cert_factory_t* factory, const cert_factory_input_t* inputs, size_t count, uint8_t* output, size_t output_size,
+                             size_t* failed);
+ATCA_STATUS cert_factory_parse_csv(const char* text, size_t text_size, cert_factory_input_t* inputs, size_t max_count, size_t* count,
+                                   size_t* line);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* CERT_FACTORY_H_ */
@@ -0,0 +1,229 @@
+/**
+ * \file
+ * \brief  Command line front end of the certificate factory: reads a device list
+ *         and writes the mapped certificate file used by the production line
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cert_factory.h"
+
+/** \brief Device certificate definition the tool is built with, as printed by
+ *         cert2certdef.py --device-cert
+ */
+#ifndef CERT_FACTORY_CERT_DEF
+#define CERT_FACTORY_CERT_DEF           g_cert_def_2_device
+#endif
+
+extern const atcacert_def_t CERT_FACTORY_CERT_DEF;
+
+static void* cert_factory_tool_map(const char* path, size_t* size)
+{
+    void* data = NULL;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd >= 0)
+    {
+        if (0 == fstat(fd, &st) && st.st_size > 0)
+        {
+            data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            *size = (size_t)st.st_size;
+            if (MAP_FAILED == data)
+            {
+                data = NULL;
+            }
+        }
+        close(fd);
+    }
+    return data;
+}
+
+/* Keys are read null terminated, which the mbedTLS PEM parser requires */
+static char* cert_factory_tool_read_key(const char* path, size_t* size)
+{
+    char* pem = NULL;
+    size_t map_size = 0;
+    void* data = cert_factory_tool_map(path, &map_size);
+
+    if (data)
+    {
+        if (NULL != (pem = malloc(map_size + 1)))
+        {
+            memcpy(pem, data, map_size);
+            pem[map_size] = '\0';
+            *size = map_size + 1;
+        }
+        munmap(data, map_size);
+    }
+    return pem;
+}
+
+int main(int argc, char* argv[])
+{
+    int ret = EXIT_FAILURE;
+    ATCA_STATUS status;
+    cert_factory_t* factory = NULL;
+    cert_factory_input_t* inputs = NULL;
+    atcacert_tm_utc_t issue_date;
+    uint8_t signer_id[2];
+    char* key_pem = NULL;
+    size_t key_pem_size = 0;
+    char* csv = NULL;
+    size_t csv_size = 0;
+    size_t count = 0;
+    size_t line = 0;
+    size_t failed = 0;
+    size_t output_size;
+    uint8_t* output = MAP_FAILED;
+    int fd = -1;
+    struct timespec start;
+    struct timespec stop;
+    time_t now;
+    struct tm utc;
+    double seconds;
+
+    if (argc < 4 || argc > 6)
+    {
+        fprintf(stderr, "usage: %s <signer_key.pem> <devices.csv> <output> [workers] [signer_id]\n", argv[0]);
+        fprintf(stderr, "  devices.csv holds one '<device_sn_hex>,<public_key_hex>' line per device\n");
+        return EXIT_FAILURE;
+    }
+
+    do
+    {
+        if (NULL == (key_pem = cert_factory_tool_read_key(argv[1], &key_pem_size)))
+        {
+            fprintf(stderr, "Unable to read %s\n", argv[1]);
+            break;
+        }
+        if (NULL == (csv = cert_factory_tool_map(argv[2], &csv_size)))
+        {
+            fprintf(stderr, "Unable to read %s\n", argv[2]);
+            break;
+        }
+
+        if (ATCA_SUCCESS != cert_factory_parse_csv(csv, csv_size, NULL, 0, &count, &line))
+        {
+            fprintf(stderr, "%s:%u: expected <device_sn_hex>,<public_key_hex>\n", argv[2], (unsigned)line);
+            break;
+        }
+        if (NULL == (inputs = malloc((count ? count : 1) * sizeof(*inputs)))
+            || ATCA_SUCCESS != cert_factory_parse_csv(csv, csv_size, inputs, count, &count, &line))
+        {
+            break;
+        }
+
+        /* Same validity start as cert_sign.py: the current UTC hour */
+        now = time(NULL);
+        if (NULL == gmtime_r(&now, &utc))
+        {
+            break;
+        }
+        memset(&issue_date, 0, sizeof(issue_date));
+        issue_date.tm_hour = utc.tm_hour;
+        issue_date.tm_mday = utc.tm_mday;
+        issue_date.tm_mon = utc.tm_mon;
+        issue_date.tm_year = utc.tm_year;
+
+        if (NULL == (factory = malloc(sizeof(*factory))))
+        {
+            break;
+        }
+        status = cert_factory_init(factory, &CERT_FACTORY_CERT_DEF, (const uint8_t*)key_pem, key_pem_size, &issue_date,
+                                   (argc > 4) ? (size_t)strtoul(argv[4], NULL, 10) : 0);
+        if (ATCA_SUCCESS != status)
+        {
+            fprintf(stderr, "Unable to set up the factory with %s: %02X\n", argv[1], status);
+            free(factory);
+            factory = NULL;
+            break;
+        }
+        if (argc > 5)
+        {
+            unsigned long id = strtoul(argv[5], NULL, 16);
+            signer_id[0] = (uint8_t)(id >> 8);
+            signer_id[1] = (uint8_t)id;
+            cert_factory_set_signer_id(factory, signer_id);
+        }
+
+        /* The records are written straight into the mapped output file */
+        output_size = cert_factory_output_size(factory, count);
+        if (0 > (fd = open(argv[3], O_RDWR | O_CREAT | O_TRUNC, 0644)) || 0 != ftruncate(fd, (off_t)output_size)
+            || MAP_FAILED == (output = mmap(NULL, output_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)))
+        {
+            fprintf(stderr, "Unable to create %s\n", argv[3]);
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        status = cert_factory_run(factory, inputs, count, output, output_size, &failed);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        if (ATCA_SUCCESS != status)
+        {
+            fprintf(stderr, "Certificate generation failed: %02X\n", status);
+            break;
+        }
+        if (0 != msync(output, output_size, MS_SYNC))
+        {
+            fprintf(stderr, "Unable to write %s\n", argv[3]);
+            break;
+        }
+
+        seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%u certificates, %u failed, %u workers, %.3f s (%.0f/s)\n", (unsigned)count, (unsigned)failed,
+               (unsigned)factory->worker_count, seconds, (seconds > 0) ? (double)count / seconds : 0.0);
+        ret = (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    while (0);
+
+    if (MAP_FAILED != output)
+    {
+        munmap(output, output_size);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (factory)
+    {
+        cert_factory_release(factory);
+        free(factory);
+    }
+    free(inputs);
+    if (csv)
+    {
+        munmap(csv, csv_size);
+    }
+    free(key_pem);
+    return ret;
+}
@@ -134,3 +134,41 @@ ATCA_STATUS symmetric_authenticate(uint8_t slot, const uint8_t *master_key, cons
 
     return status;
 }
+
+
+/** \brief Collect the device side of the symmetric authentication so it can be
+ *         checked by a host that holds the master key (for example a backend
+ *         using symmetric_verifier_verify_batch()).
+ *  \param[in]  slot                The slot number used for the symmetric authentication.
+ *  \param[in]  rand_number         The 20 byte rand_number from the host.
+ *  \param[out] response            Serial number, nonce and MAC of the device.
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS symmetric_authenticate_response(uint8_t slot, const uint8_t *rand_number, symmetric_auth_response_t *response)
+{
+    ATCA_STATUS status;
+
+    if (!rand_number || !response)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    do
+    {
+        if ((status = atcab_read_serial_number(response->sn)) != ATCA_SUCCESS)
+        {
+            break;
+        }
+
+        memcpy(response->num_in, rand_number, NONCE_NUMIN_SIZE);
+        if ((status = atcab_nonce_rand(response->num_in, response->rand_out)) != ATCA_SUCCESS)
+        {
+            break;
+        }
+
+        status = atcab_mac(MAC_MODE_BLOCK2_TEMPKEY | MAC_MODE_INCLUDE_SN, slot, NULL, response->mac);
+    }
+    while (0);
+
+    return status;
+}
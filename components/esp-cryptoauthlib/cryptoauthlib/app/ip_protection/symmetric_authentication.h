@@ -35,7 +35,19 @@
 extern "C" {
 #endif
 
+/** \brief Device response collected for verification by a remote host (see
+ *         symmetric_authentication_verifier.h)
+ */
+typedef struct symmetric_auth_response
+{
+    uint8_t sn[ATCA_SERIAL_NUM_SIZE];   //!< Device serial number
+    uint8_t num_in[NONCE_NUMIN_SIZE];   //!< Host challenge sent with the Nonce command
+    uint8_t rand_out[RANDOM_NUM_SIZE];  //!< RandOut returned by the Nonce command
+    uint8_t mac[MAC_SIZE];              //!< Response of the MAC command
+} symmetric_auth_response_t;
+
 ATCA_STATUS symmetric_authenticate(uint8_t slot, const uint8_t *master_key, const uint8_t *rand_number);
+ATCA_STATUS symmetric_authenticate_response(uint8_t slot, const uint8_t *rand_number, symmetric_auth_response_t *response);
 
 
 
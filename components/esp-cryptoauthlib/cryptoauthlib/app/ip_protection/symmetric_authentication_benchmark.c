@@ -0,0 +1,212 @@
+/**
+ * \file
+ * \brief  Throughput benchmark of the symmetric authentication verifier against
+ *         the atcah_* reference, with the device responses simulated on the host
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "host/atca_host.h"
+#include "symmetric_authentication_verifier.h"
+
+#define SV_BENCH_SLOT           (5)
+
+static uint32_t sv_bench_seed = 1;
+
+/* Deterministic test data, so runs can be compared */
+static void sv_bench_fill(uint8_t* data, size_t size)
+{
+    while (size--)
+    {
+        sv_bench_seed = sv_bench_seed * 1103515245 + 12345;
+        *data++ = (uint8_t)(sv_bench_seed >> 16);
+    }
+}
+
+static double sv_bench_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* Calculate the response of a device provisioned from master_key, as
+   symmetric_authenticate_response() collects it */
+static void sv_bench_respond(const uint8_t* master_key, symmetric_auth_response_t* response)
+{
+    uint8_t key[ATCA_KEY_SIZE];
+    atca_temp_key_t temp_key, temp_key_derive;
+    atca_nonce_in_out_t nonce_params;
+    struct atca_derive_key_in_out derivekey_params;
+    atca_mac_in_out_t mac_params;
+
+    memset(&temp_key, 0, sizeof(temp_key));
+    memset(&nonce_params, 0, sizeof(nonce_params));
+    nonce_params.mode = NONCE_MODE_SEED_UPDATE;
+    nonce_params.num_in = response->num_in;
+    nonce_params.rand_out = response->rand_out;
+    nonce_params.temp_key = &temp_key;
+    (void)atcah_nonce(&nonce_params);
+
+    memset(&temp_key_derive, 0, sizeof(temp_key_derive));
+    temp_key_derive.valid = 1;
+    memcpy(temp_key_derive.value, response->sn, ATCA_SERIAL_NUM_SIZE);
+    memset(&derivekey_params, 0, sizeof(derivekey_params));
+    derivekey_params.target_key_id = SV_BENCH_SLOT;
+    derivekey_params.parent_key = master_key;
+    derivekey_params.sn = response->sn;
+    derivekey_params.target_key = key;
+    derivekey_params.temp_key = &temp_key_derive;
+    (void)atcah_derive_key(&derivekey_params);
+
+    memset(&mac_params, 0, sizeof(mac_params));
+    mac_params.mode = MAC_MODE_BLOCK2_TEMPKEY | MAC_MODE_INCLUDE_SN;
+    mac_params.key_id = SV_BENCH_SLOT;
+    mac_params.key = key;
+    mac_params.sn = response->sn;
+    mac_params.response = response->mac;
+    mac_params.temp_key = &temp_key;
+    (void)atcah_mac(&mac_params);
+}
+
+/* Register the challenges of responses[0..count) and verify them in one batch */
+static size_t sv_bench_round(symmetric_verifier_t* verifier, const symmetric_auth_response_t* responses, size_t count,
+                             ATCA_STATUS* results)
+{
+    size_t accepted = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        (void)symmetric_verifier_add_challenge(verifier, responses[i].num_in);
+    }
+    (void)symmetric_verifier_verify_batch(verifier, responses, count, results);
+    for (i = 0; i < count; i++)
+    {
+        accepted += (ATCA_SUCCESS == results[i]);
+    }
+    return accepted;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : 20000;
+    size_t workers = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : 0;
+    static symmetric_verifier_t verifier;
+    symmetric_auth_response_t* responses;
+    ATCA_STATUS* results;
+    uint8_t master_key[ATCA_KEY_SIZE];
+    size_t expected = 0;
+    size_t reference = 0;
+    size_t accepted = 0;
+    size_t replayed = 0;
+    size_t mismatches = 0;
+    size_t i;
+    double start, reference_time, verifier_time;
+
+    responses = calloc(count ? count : 1, sizeof(*responses));
+    results = calloc(count ? count : 1, sizeof(*results));
+    if (!responses || !results)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    /* Devices with the default serial number prefix, one in 97 with an other
+       prefix (verified through the reference path) and one in 50 answering
+       with a wrong MAC */
+    sv_bench_fill(master_key, sizeof(master_key));
+    for (i = 0; i < count; i++)
+    {
+        sv_bench_fill(responses[i].sn, sizeof(responses[i].sn));
+        responses[i].sn[0] = ATCA_SN_0_DEF;
+        responses[i].sn[1] = ATCA_SN_1_DEF;
+        responses[i].sn[8] = (i % 97 == 3) ? 0x10 : ATCA_SN_8_DEF;
+        sv_bench_fill(responses[i].num_in, sizeof(responses[i].num_in));
+        sv_bench_fill(responses[i].rand_out, sizeof(responses[i].rand_out));
+        sv_bench_respond(master_key, &responses[i]);
+        if (i % 50 == 7)
+        {
+            responses[i].mac[5] ^= 1;
+        }
+        else
+        {
+            expected++;
+        }
+    }
+
+    start = sv_bench_now();
+    for (i = 0; i < count; i++)
+    {
+        reference += (ATCA_SUCCESS == symmetric_verifier_reference(SV_BENCH_SLOT, master_key, &responses[i]));
+    }
+    reference_time = sv_bench_now() - start;
+
+    if (ATCA_SUCCESS != symmetric_verifier_init(&verifier, SV_BENCH_SLOT, master_key, workers))
+    {
+        fprintf(stderr, "Verifier initialization failed\n");
+        return 1;
+    }
+
+    /* Rounds of at most SYMMETRIC_VERIFIER_MAX_CHALLENGES, as a server
+       collecting the answers to the challenges it has outstanding */
+    start = sv_bench_now();
+    for (i = 0; i < count; i += SYMMETRIC_VERIFIER_MAX_CHALLENGES)
+    {
+        size_t n = (count - i < SYMMETRIC_VERIFIER_MAX_CHALLENGES) ? count - i : SYMMETRIC_VERIFIER_MAX_CHALLENGES;
+        accepted += sv_bench_round(&verifier, &responses[i], n, &results[i]);
+    }
+    verifier_time = sv_bench_now() - start;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((ATCA_SUCCESS == results[i]) != (ATCA_SUCCESS == symmetric_verifier_reference(SV_BENCH_SLOT, master_key, &responses[i])))
+        {
+            mismatches++;
+        }
+    }
+
+    /* Presenting the accepted responses again: their challenges are used up */
+    (void)symmetric_verifier_verify_batch(&verifier, responses, count, results);
+    for (i = 0; i < count; i++)
+    {
+        replayed += (ATCA_SUCCESS == results[i]);
+    }
+    symmetric_verifier_release(&verifier);
+
+    printf("%zu responses, %zu valid, %zu worker thread(s), %d lanes\n", count, expected, workers, SYMMETRIC_VERIFIER_LANES);
+    printf("atcah_* reference: %zu accepted, %.0f responses/s\n", reference, count / reference_time);
+    printf("verifier:          %zu accepted, %.0f responses/s (x%.2f), %zu mismatch(es)\n", accepted,
+           count / verifier_time, reference_time / verifier_time, mismatches);
+    printf("replayed:          %zu accepted\n", replayed);
+
+    free(results);
+    free(responses);
+
+    return (mismatches || replayed || accepted != expected) ? 1 : 0;
+}
@@ -0,0 +1,699 @@
+/**
+ * \file
+ * \brief  Host side engine verifying symmetric authentication responses from
+ *         many devices sharing a master key.
+ *
+ * Every response costs five SHA256 blocks with the atcah_* helpers: one for
+ * the nonce, two for the diversified key and two for the MAC. The first
+ * DeriveKey block only holds the master key, the slot and the fixed serial
+ * number bytes, so its state is calculated once per master key and reused.
+ * The remaining four blocks are hashed for SYMMETRIC_VERIFIER_LANES responses
+ * at a time with the rounds written over lane arrays, and batches can be
+ * shared with a pool of worker threads. A response is only accepted for a
+ * challenge (NumIn) the server issued with symmetric_verifier_add_challenge(),
+ * and each challenge is consumed by the first response accepted for it, so a
+ * recorded response can not be presented again.
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+#include "cryptoauthlib.h"
+#include "host/atca_host.h"
+#include "symmetric_authentication_verifier.h"
+
+#define SV_LANES                        SYMMETRIC_VERIFIER_LANES
+#define SV_CHALLENGE_SLOTS              (SYMMETRIC_VERIFIER_MAX_CHALLENGES * 2)
+#define SV_ROTR(x, n)                   (((x) >> (n)) | ((x) << (32 - (n))))
+
+/* The round arguments never alias, which lets the compiler vectorize over the lanes */
+#if defined(_MSC_VER)
+#define SV_RESTRICT                     __restrict
+#else
+#define SV_RESTRICT                     restrict
+#endif
+
+/* MAC mode used by symmetric_authenticate(): block 1 is the key, block 2 is TempKey */
+#define SV_MAC_MODE                     (MAC_MODE_BLOCK2_TEMPKEY | MAC_MODE_INCLUDE_SN)
+
+static const uint32_t symmetric_verifier_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t symmetric_verifier_iv[8] =
+{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/** \brief One SHA256 round for every lane. a..h are the working variables of
+ *         this round; the new a is written over h and the new e over d so the
+ *         caller only rotates the pointers.
+ */
+static void symmetric_verifier_round(const uint32_t* SV_RESTRICT a, const uint32_t* SV_RESTRICT b, const uint32_t* SV_RESTRICT c,
+                                     uint32_t* SV_RESTRICT d, const uint32_t* SV_RESTRICT e, const uint32_t* SV_RESTRICT f,
+                                     const uint32_t* SV_RESTRICT g, uint32_t* SV_RESTRICT h, const uint32_t* SV_RESTRICT w, uint32_t k)
+{
+    size_t l;
+
+    for (l = 0; l < SV_LANES; l++)
+    {
+        uint32_t t1 = h[l] + (SV_ROTR(e[l], 6) ^ SV_ROTR(e[l], 11) ^ SV_ROTR(e[l], 25))
+                      + ((e[l] & f[l]) ^ (~e[l] & g[l])) + k + w[l];
+        uint32_t t2 = (SV_ROTR(a[l], 2) ^ SV_ROTR(a[l], 13) ^ SV_ROTR(a[l], 22))
+                      + ((a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]));
+
+        d[l] += t1;
+        h[l] = t1 + t2;
+    }
+}
+
+/** \brief SHA256 compression of one block per lane.
+ *
+ *  \param[in,out] state  Hash state of every lane
+ *  \param[in,out] w      Message block in w[0..15] (big endian words), the
+ *                        rest is used for the message schedule
+ */
+static void symmetric_verifier_compress(uint32_t state[8][SV_LANES], uint32_t w[64][SV_LANES])
+{
+    uint32_t v[8][SV_LANES];
+    size_t t, l;
+
+    for (t = 16; t < 64; t++)
+    {
+        for (l = 0; l < SV_LANES; l++)
+        {
+            uint32_t w15 = w[t - 15][l];
+            uint32_t w2 = w[t - 2][l];
+
+            w[t][l] = w[t - 16][l] + (SV_ROTR(w15, 7) ^ SV_ROTR(w15, 18) ^ (w15 >> 3))
+                      + w[t - 7][l] + (SV_ROTR(w2, 17) ^ SV_ROTR(w2, 19) ^ (w2 >> 10));
+        }
+    }
+
+    memcpy(v, state, sizeof(v));
+    for (t = 0; t < 64; t++)
+    {
+        size_t i = 64 - t;
+
+        symmetric_verifier_round(v[i & 7], v[(i + 1) & 7], v[(i + 2) & 7], v[(i + 3) & 7],
+                                 v[(i + 4) & 7], v[(i + 5) & 7], v[(i + 6) & 7], v[(i + 7) & 7],
+                                 w[t], symmetric_verifier_k[t]);
+    }
+
+    for (t = 0; t < 8; t++)
+    {
+        for (l = 0; l < SV_LANES; l++)
+        {
+            state[t][l] += v[t][l];
+        }
+    }
+}
+
+/** \brief Set every lane of the state to the same eight words */
+static void symmetric_verifier_set_state(uint32_t state[8][SV_LANES], const uint32_t* words)
+{
+    size_t t, l;
+
+    for (t = 0; t < 8; t++)
+    {
+        for (l = 0; l < SV_LANES; l++)
+        {
+            state[t][l] = words[t];
+        }
+    }
+}
+
+/** \brief Load a padded 64 byte message block into one lane */
+static void symmetric_verifier_load(uint32_t w[64][SV_LANES], size_t lane, const uint8_t block[64])
+{
+    size_t t;
+
+    for (t = 0; t < 16; t++)
+    {
+        w[t][lane] = ((uint32_t)block[4 * t] << 24) | ((uint32_t)block[4 * t + 1] << 16)
+                     | ((uint32_t)block[4 * t + 2] << 8) | (uint32_t)block[4 * t + 3];
+    }
+}
+
+/** \brief Add SHA256 padding to the last block of a message that ends at
+ *         used bytes into the block.
+ */
+static void symmetric_verifier_pad(uint8_t block[64], size_t used, uint32_t msg_size)
+{
+    block[used] = 0x80;
+    memset(&block[used + 1], 0, 64 - used - 1);
+    block[60] = (uint8_t)(msg_size >> 21);
+    block[61] = (uint8_t)(msg_size >> 13);
+    block[62] = (uint8_t)(msg_size >> 5);
+    block[63] = (uint8_t)(msg_size << 3);
+}
+
+/** \brief Check if the midstate calculated for the default serial number
+ *         prefix applies to a response.
+ */
+static bool symmetric_verifier_default_sn(const symmetric_auth_response_t* response)
+{
+    return (ATCA_SN_0_DEF == response->sn[0]) && (ATCA_SN_1_DEF == response->sn[1]) && (ATCA_SN_8_DEF == response->sn[8]);
+}
+
+/** \brief Verify up to SYMMETRIC_VERIFIER_LANES responses. Does not touch the
+ *         challenge table, so groups of a batch can be hashed concurrently.
+ */
+static void symmetric_verifier_hash_group(const symmetric_verifier_t* verifier, const symmetric_auth_response_t* responses,
+                                          size_t count, ATCA_STATUS* results)
+{
+    uint32_t w[64][SV_LANES];
+    uint32_t temp_key[8][SV_LANES];
+    uint32_t state[8][SV_LANES];
+    uint8_t block[64];
+    size_t l, t;
+
+    memset(w, 0, sizeof(w));
+
+    // TempKey = SHA256(RandOut || NumIn || Opcode || Mode || 0x00)
+    for (l = 0; l < count; l++)
+    {
+        memcpy(block, responses[l].rand_out, RANDOM_NUM_SIZE);
+        memcpy(&block[RANDOM_NUM_SIZE], responses[l].num_in, NONCE_NUMIN_SIZE);
+        block[52] = ATCA_NONCE;
+        block[53] = NONCE_MODE_SEED_UPDATE;
+        block[54] = 0x00;
+        symmetric_verifier_pad(block, ATCA_MSG_SIZE_NONCE, ATCA_MSG_SIZE_NONCE);
+        symmetric_verifier_load(w, l, block);
+    }
+    symmetric_verifier_set_state(temp_key, symmetric_verifier_iv);
+    symmetric_verifier_compress(temp_key, w);
+
+    // Diversified key: second DeriveKey block holds SN[0:8] padded to 32 bytes
+    for (l = 0; l < count; l++)
+    {
+        memset(block, 0, ATCA_KEY_SIZE);
+        memcpy(block, responses[l].sn, ATCA_SERIAL_NUM_SIZE);
+        symmetric_verifier_pad(block, ATCA_KEY_SIZE, ATCA_MSG_SIZE_DERIVE_KEY);
+        symmetric_verifier_load(w, l, block);
+    }
+    symmetric_verifier_set_state(state, verifier->derive_midstate);
+    symmetric_verifier_compress(state, w);
+
+    // MAC first block: diversified key || TempKey, already in word form
+    for (t = 0; t < 8; t++)
+    {
+        memcpy(w[t], state[t], sizeof(w[t]));
+        memcpy(w[t + 8], temp_key[t], sizeof(w[t + 8]));
+    }
+    symmetric_verifier_set_state(state, symmetric_verifier_iv);
+    symmetric_verifier_compress(state, w);
+
+    // MAC second block: Opcode, Mode, KeyID, 11 zeros and the serial number
+    for (l = 0; l < count; l++)
+    {
+        const uint8_t* sn = responses[l].sn;
+
+        memset(block, 0, 16);
+        block[0] = ATCA_MAC;
+        block[1] = SV_MAC_MODE;
+        block[2] = verifier->slot;
+        block[15] = sn[8];
+        memcpy(&block[16], &sn[4], 4);
+        memcpy(&block[20], &sn[0], 4);
+        symmetric_verifier_pad(block, ATCA_MSG_SIZE_MAC - 64, ATCA_MSG_SIZE_MAC);
+        symmetric_verifier_load(w, l, block);
+    }
+    symmetric_verifier_compress(state, w);
+
+    for (l = 0; l < count; l++)
+    {
+        uint32_t diff = 0;
+
+        if (!symmetric_verifier_default_sn(&responses[l]))
+        {
+            results[l] = symmetric_verifier_reference(verifier->slot, verifier->master_key, &responses[l]);
+            continue;
+        }
+
+        for (t = 0; t < 8; t++)
+        {
+            const uint8_t* mac = &responses[l].mac[4 * t];
+            diff |= state[t][l] ^ (((uint32_t)mac[0] << 24) | ((uint32_t)mac[1] << 16) | ((uint32_t)mac[2] << 8) | (uint32_t)mac[3]);
+        }
+        results[l] = diff ? ATCA_CHECKMAC_VERIFY_FAILED : ATCA_SUCCESS;
+    }
+}
+
+/** \brief Hash a NumIn value into the challenge table (FNV-1a) */
+static size_t symmetric_verifier_challenge_hash(const uint8_t* num_in)
+{
+    uint32_t hash = 0x811c9dc5;
+    size_t i;
+
+    for (i = 0; i < NONCE_NUMIN_SIZE; i++)
+    {
+        hash = (hash ^ num_in[i]) * 0x01000193;
+    }
+    return hash % SV_CHALLENGE_SLOTS;
+}
+
+/** \brief Find the challenge table slot holding num_in, or the empty slot
+ *         where it would be added.
+ */
+static size_t symmetric_verifier_challenge_find(const symmetric_verifier_t* verifier, const uint8_t* num_in)
+{
+    size_t i = symmetric_verifier_challenge_hash(num_in);
+
+    while (verifier->challenge_index[i]
+           && memcmp(verifier->challenge_ring[verifier->challenge_index[i] - 1], num_in, NONCE_NUMIN_SIZE))
+    {
+        i = (i + 1) % SV_CHALLENGE_SLOTS;
+    }
+    return i;
+}
+
+/** \brief Remove the challenge at table slot i, shifting back the entries
+ *         that probed past it.
+ */
+static void symmetric_verifier_challenge_remove(symmetric_verifier_t* verifier, size_t i)
+{
+    size_t j = i;
+
+    verifier->challenge_live[verifier->challenge_index[i] - 1] = 0;
+    verifier->challenge_index[i] = 0;
+    for (;;)
+    {
+        size_t k;
+
+        j = (j + 1) % SV_CHALLENGE_SLOTS;
+        if (!verifier->challenge_index[j])
+        {
+            break;
+        }
+        k = symmetric_verifier_challenge_hash(verifier->challenge_ring[verifier->challenge_index[j] - 1]);
+        // Entry j can fill the hole at i only if its home slot is not in (i, j]
+        if ((i < j) ? ((k <= i) || (k > j)) : ((k <= i) && (k > j)))
+        {
+            verifier->challenge_index[i] = verifier->challenge_index[j];
+            verifier->challenge_index[j] = 0;
+            i = j;
+        }
+    }
+}
+
+/** \brief Consume the challenge num_in if it is outstanding.
+ *  \return ATCA_SUCCESS if num_in was issued and not used yet, otherwise
+ *          ATCA_FUNC_FAIL.
+ */
+static ATCA_STATUS symmetric_verifier_challenge_use(symmetric_verifier_t* verifier, const uint8_t* num_in)
+{
+    size_t i = symmetric_verifier_challenge_find(verifier, num_in);
+
+    if (!verifier->challenge_index[i])
+    {
+        return ATCA_FUNC_FAIL;
+    }
+    symmetric_verifier_challenge_remove(verifier, i);
+
+    return ATCA_SUCCESS;
+}
+
+#if SYMMETRIC_VERIFIER_THREADS
+/** \brief Hash the groups of the current batch until none are left. Called
+ *         with the verifier lock held, which is released while hashing.
+ */
+static void symmetric_verifier_run_job(symmetric_verifier_t* verifier)
+{
+    while (verifier->job_next < verifier->job_groups)
+    {
+        size_t offset = verifier->job_next++ * SV_LANES;
+        size_t count = verifier->job_count - offset;
+
+        pthread_mutex_unlock(&verifier->lock);
+        symmetric_verifier_hash_group(verifier, &verifier->job_responses[offset], (count < SV_LANES) ? count : SV_LANES,
+                                      &verifier->job_results[offset]);
+        pthread_mutex_lock(&verifier->lock);
+
+        if (++verifier->job_finished == verifier->job_groups)
+        {
+            pthread_cond_broadcast(&verifier->job_done);
+        }
+    }
+}
+
+static void* symmetric_verifier_worker(void* arg)
+{
+    symmetric_verifier_t* verifier = (symmetric_verifier_t*)arg;
+    unsigned job_id = 0;
+
+    pthread_mutex_lock(&verifier->lock);
+    for (;;)
+    {
+        while (!verifier->stopping && (job_id == verifier->job_id))
+        {
+            pthread_cond_wait(&verifier->job_ready, &verifier->lock);
+        }
+        if (verifier->stopping)
+        {
+            break;
+        }
+        job_id = verifier->job_id;
+        symmetric_verifier_run_job(verifier);
+    }
+    pthread_mutex_unlock(&verifier->lock);
+
+    return NULL;
+}
+#endif
+
+/** \brief Verify a symmetric authentication response with the atcah_*
+ *         helpers, exactly as symmetric_authenticate() does. Used for devices
+ *         with a non default serial number prefix and as a reference.
+ *  \param[in]  slot        The slot number used for the symmetric authentication.
+ *  \param[in]  master_key  The master key used for the calculating the symmetric key.
+ *  \param[in]  response    Response collected from the device.
+ *  \return ATCA_SUCCESS if the MAC matches, otherwise an error code.
+ */
+ATCA_STATUS symmetric_verifier_reference(uint8_t slot, const uint8_t* master_key, const symmetric_auth_response_t* response)
+{
+    ATCA_STATUS status;
+    uint8_t symmetric_key[ATCA_KEY_SIZE];
+    uint8_t host_mac[MAC_SIZE];
+    atca_temp_key_t temp_key, temp_key_derive;
+    atca_nonce_in_out_t nonce_params;
+    atca_mac_in_out_t mac_params;
+    struct atca_derive_key_in_out derivekey_params;
+
+    do
+    {
+        memset(&temp_key, 0, sizeof(temp_key));
+        memset(&nonce_params, 0, sizeof(nonce_params));
+        nonce_params.mode = NONCE_MODE_SEED_UPDATE;
+        nonce_params.num_in = response->num_in;
+        nonce_params.rand_out = response->rand_out;
+        nonce_params.temp_key = &temp_key;
+        if ((status = atcah_nonce(&nonce_params)) != ATCA_SUCCESS)
+        {
+            break;
+        }
+
+        memset(&temp_key_derive, 0, sizeof(temp_key_derive));
+        temp_key_derive.valid = 1;
+        memcpy(temp_key_derive.value, response->sn, ATCA_SERIAL_NUM_SIZE);
+
+        derivekey_params.mode = 0;
+        derivekey_params.target_key_id = slot;
+        derivekey_params.parent_key = master_key;
+        derivekey_params.sn = response->sn;
+        derivekey_params.target_key = symmetric_key;
+        derivekey_params.temp_key = &temp_key_derive;
+        if ((status = atcah_derive_key(&derivekey_params)) != ATCA_SUCCESS)
+        {
+            break;
+        }
+
+        memset(&mac_params, 0, sizeof(mac_params));
+        mac_params.mode = SV_MAC_MODE;
+        mac_params.key_id = slot;
+        mac_params.key = symmetric_key;
+        mac_params.sn = response->sn;
+        mac_params.response = host_mac;
+        mac_params.temp_key = &temp_key;
+        if ((status = atcah_mac(&mac_params)) != ATCA_SUCCESS)
+        {
+            break;
+        }
+
+        if (memcmp(response->mac, host_mac, MAC_SIZE) != 0)
+        {
+            status = ATCA_CHECKMAC_VERIFY_FAILED;
+        }
+    }
+    while (0);
+
+    memset(symmetric_key, 0, sizeof(symmetric_key));
+
+    return status;
+}
+
+/** \brief Initialize a verifier for the devices provisioned from a master key.
+ *  \param[out] verifier    Verifier context to initialize.
+ *  \param[in]  slot        The slot number used for the symmetric authentication.
+ *  \param[in]  master_key  The master key used for the calculating the symmetric key.
+ *  \param[in]  workers     Number of worker threads hashing batches next to
+ *                          the calling thread. Ignored when
+ *                          SYMMETRIC_VERIFIER_THREADS is not set.
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS symmetric_verifier_init(symmetric_verifier_t* verifier, uint8_t slot, const uint8_t* master_key, size_t workers)
+{
+    uint32_t w[64][SV_LANES];
+    uint32_t state[8][SV_LANES];
+    uint8_t block[64];
+    size_t t;
+
+    if (!verifier || !master_key || (workers > SYMMETRIC_VERIFIER_MAX_WORKERS))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memset(verifier, 0, sizeof(*verifier));
+    verifier->slot = slot;
+    memcpy(verifier->master_key, master_key, ATCA_KEY_SIZE);
+
+    // First DeriveKey block: parent key, Opcode, Mode, KeyID, SN[8], SN[0:1] and 25 zeros
+    memset(block, 0, sizeof(block));
+    memcpy(block, master_key, ATCA_KEY_SIZE);
+    block[32] = ATCA_DERIVE_KEY;
+    block[34] = slot;
+    block[36] = ATCA_SN_8_DEF;
+    block[37] = ATCA_SN_0_DEF;
+    block[38] = ATCA_SN_1_DEF;
+    memset(w, 0, sizeof(w));
+    symmetric_verifier_load(w, 0, block);
+    symmetric_verifier_set_state(state, symmetric_verifier_iv);
+    symmetric_verifier_compress(state, w);
+    for (t = 0; t < 8; t++)
+    {
+        verifier->derive_midstate[t] = state[t][0];
+    }
+    memset(block, 0, sizeof(block));
+    memset(w, 0, sizeof(w));
+
+#if SYMMETRIC_VERIFIER_THREADS
+    pthread_mutex_init(&verifier->call_lock, NULL);
+    pthread_mutex_init(&verifier->lock, NULL);
+    pthread_cond_init(&verifier->job_ready, NULL);
+    pthread_cond_init(&verifier->job_done, NULL);
+    for (; verifier->worker_count < workers; verifier->worker_count++)
+    {
+        if (pthread_create(&verifier->workers[verifier->worker_count], NULL, symmetric_verifier_worker, verifier))
+        {
+            symmetric_verifier_release(verifier);
+            return ATCA_GEN_FAIL;
+        }
+    }
+#else
+    (void)workers;
+#endif
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Stop the worker threads and clear the key material of a verifier.
+ *  \param[in]  verifier    Verifier context.
+ */
+void symmetric_verifier_release(symmetric_verifier_t* verifier)
+{
+    if (!verifier)
+    {
+        return;
+    }
+
+#if SYMMETRIC_VERIFIER_THREADS
+    pthread_mutex_lock(&verifier->lock);
+    verifier->stopping = true;
+    pthread_cond_broadcast(&verifier->job_ready);
+    pthread_mutex_unlock(&verifier->lock);
+    while (verifier->worker_count)
+    {
+        pthread_join(verifier->workers[--verifier->worker_count], NULL);
+    }
+    pthread_cond_destroy(&verifier->job_done);
+    pthread_cond_destroy(&verifier->job_ready);
+    pthread_mutex_destroy(&verifier->lock);
+    pthread_mutex_destroy(&verifier->call_lock);
+#endif
+
+    memset(verifier->master_key, 0, sizeof(verifier->master_key));
+    memset(verifier->derive_midstate, 0, sizeof(verifier->derive_midstate));
+}
+
+/** \brief Register a challenge sent to a device. Its response is only
+ *         accepted once, and only while the challenge is among the last
+ *         SYMMETRIC_VERIFIER_MAX_CHALLENGES issued.
+ *  \param[in]  verifier    Verifier context.
+ *  \param[in]  num_in      NumIn sent to the device, 20 bytes. Must come from a
+ *                          good random source (e.g. atcac_sw_random()).
+ *  \return ATCA_SUCCESS on success, ATCA_BAD_PARAM if the challenge is
+ *          already outstanding.
+ */
+ATCA_STATUS symmetric_verifier_add_challenge(symmetric_verifier_t* verifier, const uint8_t* num_in)
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+    size_t i;
+
+    if (!verifier || !num_in)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+#if SYMMETRIC_VERIFIER_THREADS
+    pthread_mutex_lock(&verifier->call_lock);
+#endif
+    do
+    {
+        i = symmetric_verifier_challenge_find(verifier, num_in);
+        if (verifier->challenge_index[i])
+        {
+            status = ATCA_BAD_PARAM;
+            break;
+        }
+
+        // Drop the oldest challenge when it is still outstanding
+        if (verifier->challenge_live[verifier->challenge_next])
+        {
+            symmetric_verifier_challenge_remove(verifier,
+                                                symmetric_verifier_challenge_find(verifier, verifier->challenge_ring[verifier->challenge_next]));
+            i = symmetric_verifier_challenge_find(verifier, num_in);
+        }
+
+        memcpy(verifier->challenge_ring[verifier->challenge_next], num_in, NONCE_NUMIN_SIZE);
+        verifier->challenge_live[verifier->challenge_next] = 1;
+        verifier->challenge_index[i] = (uint16_t)(verifier->challenge_next + 1);
+        verifier->challenge_next = (uint16_t)((verifier->challenge_next + 1) % SYMMETRIC_VERIFIER_MAX_CHALLENGES);
+    }
+    while (0);
+#if SYMMETRIC_VERIFIER_THREADS
+    pthread_mutex_unlock(&verifier->call_lock);
+#endif
+
+    return status;
+}
+
+/** \brief Verify a batch of responses collected with
+ *         symmetric_authenticate_response().
+ *
+ * Responses are hashed SYMMETRIC_VERIFIER_LANES at a time, by the worker
+ * threads as well when there are any. The challenges of the responses with a
+ * valid MAC are then consumed in batch order, so the first of two responses
+ * to the same challenge wins. With SYMMETRIC_VERIFIER_THREADS calls from
+ * several threads are serialized; otherwise the verifier must only be used
+ * by one thread at a time.
+ *
+ *  \param[in]  verifier    Verifier context.
+ *  \param[in]  responses   Responses to be verified.
+ *  \param[in]  count       Number of responses.
+ *  \param[out] results     Per response result: ATCA_SUCCESS,
+ *                          ATCA_CHECKMAC_VERIFY_FAILED for a wrong MAC or
+ *                          ATCA_FUNC_FAIL for a NumIn that is not an
+ *                          outstanding challenge (never issued, dropped or
+ *                          already used).
+ *  \return ATCA_SUCCESS if the batch was processed, otherwise an error code.
+ */
+ATCA_STATUS symmetric_verifier_verify_batch(symmetric_verifier_t* verifier, const symmetric_auth_response_t* responses,
+                                            size_t count, ATCA_STATUS* results)
+{
+    size_t i;
+
+    if (!verifier || (count && (!responses || !results)))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+#if SYMMETRIC_VERIFIER_THREADS
+    pthread_mutex_lock(&verifier->call_lock);
+    if (verifier->worker_count && (count > SV_LANES))
+    {
+        pthread_mutex_lock(&verifier->lock);
+        verifier->job_responses = responses;
+        verifier->job_results = results;
+        verifier->job_count = count;
+        verifier->job_groups = (count + SV_LANES - 1) / SV_LANES;
+        verifier->job_next = 0;
+        verifier->job_finished = 0;
+        verifier->job_id++;
+        pthread_cond_broadcast(&verifier->job_ready);
+
+        symmetric_verifier_run_job(verifier);
+        while (verifier->job_finished < verifier->job_groups)
+        {
+            pthread_cond_wait(&verifier->job_done, &verifier->lock);
+        }
+        pthread_mutex_unlock(&verifier->lock);
+    }
+    else
+#endif
+    {
+        for (i = 0; i < count; i += SV_LANES)
+        {
+            symmetric_verifier_hash_group(verifier, &responses[i], (count - i < SV_LANES) ? count - i : SV_LANES, &results[i]);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (ATCA_SUCCESS == results[i])
+        {
+            results[i] = symmetric_verifier_challenge_use(verifier, responses[i].num_in);
+        }
+    }
+#if SYMMETRIC_VERIFIER_THREADS
+    pthread_mutex_unlock(&verifier->call_lock);
+#endif
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Verify a single response collected with
+ *         symmetric_authenticate_response().
+ *  \param[in]  verifier    Verifier context.
+ *  \param[in]  response    Response to be verified.
+ *  \return ATCA_SUCCESS on successful authentication, otherwise an error code
+ *          (see symmetric_verifier_verify_batch()).
+ */
+ATCA_STATUS symmetric_verifier_verify(symmetric_verifier_t* verifier, const symmetric_auth_response_t* response)
+{
+    ATCA_STATUS result = ATCA_BAD_PARAM;
+    ATCA_STATUS status;
+
+    if ((status = symmetric_verifier_verify_batch(verifier, response, response ? 1 : 0, &result)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+    return result;
+}
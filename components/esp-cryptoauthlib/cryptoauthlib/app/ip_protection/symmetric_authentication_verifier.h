@@ -0,0 +1,113 @@
+/**
+ * \file
+ * \brief  Host side engine verifying symmetric authentication responses from
+ *         many devices sharing a master key
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+#ifndef SYMMETRIC_AUTHENTICATION_VERIFIER_H_
+#define SYMMETRIC_AUTHENTICATION_VERIFIER_H_
+
+#include "cryptoauthlib.h"
+#include "symmetric_authentication.h"
+
+/** \brief Number of responses hashed side by side. The SHA256 rounds are
+ *         written over arrays of this length so the compiler can map them onto
+ *         SIMD registers (8 fills an AVX2 register, 4 a SSE/NEON one).
+ */
+#ifndef SYMMETRIC_VERIFIER_LANES
+#define SYMMETRIC_VERIFIER_LANES            (8)
+#endif
+
+/** \brief Number of outstanding challenges (NumIn values issued to devices
+ *         and not answered yet). When more are issued the oldest is dropped
+ *         and its response rejected. Must not exceed 32768.
+ */
+#ifndef SYMMETRIC_VERIFIER_MAX_CHALLENGES
+#define SYMMETRIC_VERIFIER_MAX_CHALLENGES   (4096)
+#endif
+
+/** \brief Build the POSIX thread worker pool used by
+ *         symmetric_verifier_verify_batch(). When disabled batches are hashed
+ *         on the calling thread only.
+ */
+#ifndef SYMMETRIC_VERIFIER_THREADS
+#define SYMMETRIC_VERIFIER_THREADS          (0)
+#endif
+
+/** \brief Maximum number of worker threads in addition to the calling thread */
+#ifndef SYMMETRIC_VERIFIER_MAX_WORKERS
+#define SYMMETRIC_VERIFIER_MAX_WORKERS      (16)
+#endif
+
+#if SYMMETRIC_VERIFIER_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Verifier state for one master key and slot */
+typedef struct symmetric_verifier
+{
+    uint8_t  slot;                                          //!< Slot holding the diversified key on the devices
+    uint8_t  master_key[ATCA_KEY_SIZE];                     //!< Master key the device keys are derived from
+    uint32_t derive_midstate[8];                            //!< SHA256 state after the first (per master key) DeriveKey block
+    uint16_t challenge_next;                                //!< Oldest challenge_ring entry, replaced next
+    uint16_t challenge_index[SYMMETRIC_VERIFIER_MAX_CHALLENGES * 2];                //!< Open addressing table of outstanding challenge_ring entries + 1
+    uint8_t  challenge_ring[SYMMETRIC_VERIFIER_MAX_CHALLENGES][NONCE_NUMIN_SIZE];   //!< Issued challenges, oldest first
+    uint8_t  challenge_live[SYMMETRIC_VERIFIER_MAX_CHALLENGES];                     //!< Set while the challenge_ring entry is outstanding
+#if SYMMETRIC_VERIFIER_THREADS
+    pthread_mutex_t                  call_lock;             //!< Serializes the API calls sharing the job fields and challenges
+    size_t                           worker_count;          //!< Number of running worker threads
+    pthread_t                        workers[SYMMETRIC_VERIFIER_MAX_WORKERS];
+    pthread_mutex_t                  lock;
+    pthread_cond_t                   job_ready;
+    pthread_cond_t                   job_done;
+    unsigned                         job_id;                //!< Incremented for every batch handed to the workers
+    bool                             stopping;
+    const symmetric_auth_response_t* job_responses;
+    ATCA_STATUS*                     job_results;
+    size_t                           job_groups;            //!< Number of SYMMETRIC_VERIFIER_LANES groups in the batch
+    size_t                           job_count;
+    size_t                           job_next;              //!< Next group to be taken
+    size_t                           job_finished;          //!< Number of groups completed
+#endif
+} symmetric_verifier_t;
+
+ATCA_STATUS symmetric_verifier_init(symmetric_verifier_t* verifier, uint8_t slot, const uint8_t* master_key, size_t workers);
+void symmetric_verifier_release(symmetric_verifier_t* verifier);
+ATCA_STATUS symmetric_verifier_add_challenge(symmetric_verifier_t* verifier, const uint8_t* num_in);
+ATCA_STATUS symmetric_verifier_verify(symmetric_verifier_t* verifier, const symmetric_auth_response_t* response);
+ATCA_STATUS symmetric_verifier_verify_batch(symmetric_verifier_t* verifier, const symmetric_auth_response_t* responses, size_t count, ATCA_STATUS* results);
+ATCA_STATUS symmetric_verifier_reference(uint8_t slot, const uint8_t* master_key, const symmetric_auth_response_t* response);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* SYMMETRIC_AUTHENTICATION_VERIFIER_H_ */
@@ -35,7 +35,34 @@
 static ATCA_STATUS secure_boot_init(secure_boot_parameters* secure_boot_params);
 
 /*Secure boot process routines */
+/* The application is read by secure_boot_process unless segments are only
+   checked on first access */
+#define SECURE_BOOT_STREAM_APPLICATION          (!SECURE_BOOT_SEGMENTED || !SECURE_BOOT_SEGMENT_LAZY)
+
+#if SECURE_BOOT_STREAM_APPLICATION
+typedef ATCA_STATUS (*secure_boot_chunk_handler)(void* context, const uint8_t* data, uint32_t length);
+static ATCA_STATUS secure_boot_stream_memory(uint32_t memory_size, secure_boot_chunk_handler handler, void* context);
+#endif
+#if SECURE_BOOT_SEGMENTED
+static ATCA_STATUS secure_boot_calc_segment_root(secure_boot_parameters* secure_boot_params);
+#if !SECURE_BOOT_SEGMENT_LAZY
+static ATCA_STATUS secure_boot_verify_all_segments(secure_boot_parameters* secure_boot_params);
+#endif
+#else
 static ATCA_STATUS secure_boot_calc_app_digest(secure_boot_parameters* secure_boot_params);
+#endif
+
+#if SECURE_BOOT_SEGMENTED
+#define SECURE_BOOT_SEGMENT_UNCHECKED           0
+#define SECURE_BOOT_SEGMENT_VERIFIED            1
+
+/* Segment digests are only trusted once the ATECC608 has verified their root.
+   Per segment state is a byte so segments can be verified from several cores */
+static uint8_t secure_boot_segment_table[SECURE_BOOT_MAX_SEGMENTS][ATCA_SHA_DIGEST_SIZE];
+static volatile uint8_t secure_boot_segment_state[SECURE_BOOT_MAX_SEGMENTS];
+static uint32_t secure_boot_segments;
+static bool secure_boot_segments_trusted;
+#endif
 
 /** \brief Handles secure boot functionality through initialization, execution,
  *         and de-initialization.
@@ -57,7 +84,11 @@ ATCA_STATUS secure_boot_process(void)
     do
     {
         /* Calculate application digest */
+        #if SECURE_BOOT_SEGMENTED
+        if ((status = secure_boot_calc_segment_root(&secure_boot_params)) != ATCA_SUCCESS)
+        #else
         if ((status = secure_boot_calc_app_digest(&secure_boot_params)) != ATCA_SUCCESS)
+        #endif
         {
             break;
         }
@@ -117,6 +148,19 @@ ATCA_STATUS secure_boot_process(void)
             break;
         }
 
+        #if SECURE_BOOT_SEGMENTED
+        /*Segment table is authentic from here on*/
+        secure_boot_segments_trusted = true;
+
+        #if !SECURE_BOOT_SEGMENT_LAZY
+        if ((status = secure_boot_verify_all_segments(&secure_boot_params)) != ATCA_SUCCESS)
+        {
+            secure_boot_segments_trusted = false;
+            break;
+        }
+        #endif
+        #endif
+
         /*Mark to indicate full copy is executed */
         if ((SECUREBOOT_MODE_FULL_COPY == secure_boot_mode) && ((status = secure_boot_mark_full_copy_completion()) != ATCA_SUCCESS))
         {
@@ -166,49 +210,303 @@ static ATCA_STATUS secure_boot_init(secure_boot_parameters* secure_boot_params)
 
     return ATCA_SUCCESS;
 }
-/** \brief Calculates the application digest using software SHA256
- *         implementation.
- *  \param[in,out] secure_boot_params  Secure boot parameters
+#if SECURE_BOOT_STREAM_APPLICATION
+#if SECURE_BOOT_ASYNC_READ
+#define SECURE_BOOT_DIGEST_BUFFERS              2
+#else
+#define SECURE_BOOT_DIGEST_BUFFERS              1
+#endif
+
+/* Kept out of the stack - boot loaders tend to run on a small one */
+static uint8_t secure_boot_digest_buf[SECURE_BOOT_DIGEST_BUFFERS][SECURE_BOOT_DIGEST_CHUNK_SIZE];
+
+/** \brief Size of the next chunk to read.
+ *  \param[in] total_data_count  Bytes of the application read so far
+ *  \param[in] memory_size       Size of the application
+ */
+static uint32_t secure_boot_next_chunk(uint32_t total_data_count, uint32_t memory_size)
+{
+    uint32_t remaining = memory_size - total_data_count;
+
+    return (remaining < SECURE_BOOT_DIGEST_CHUNK_SIZE) ? remaining : SECURE_BOOT_DIGEST_CHUNK_SIZE;
+}
+
+/** \brief Reads the whole application and hands it to handler chunk by
+ *         chunk.
+ *
+ *  Memory is read in SECURE_BOOT_DIGEST_CHUNK_SIZE chunks. With
+ *  SECURE_BOOT_ASYNC_READ the read of the next chunk is started into the
+ *  other buffer before handler runs on the current one, so hashing overlaps
+ *  the flash transfer.
+ *  \param[in] memory_size  Size of the application
+ *  \param[in] handler      Called for every chunk in order
+ *  \param[in] context      Passed to handler
  *  \return ATCA_SUCCESS on success, otherwise an error code.
  */
-static ATCA_STATUS secure_boot_calc_app_digest(secure_boot_parameters* secure_boot_params)
+static ATCA_STATUS secure_boot_stream_memory(uint32_t memory_size, secure_boot_chunk_handler handler, void* context)
 {
     ATCA_STATUS status;
-    uint8_t sha_data[ATCA_SHA256_BLOCK_SIZE];
     uint32_t total_data_count = 0;
     uint32_t current_data_count;
+    uint8_t* sha_data = secure_boot_digest_buf[0];
 
-    /*Initialize SHA engine*/
-    if ((status = atcac_sw_sha2_256_init(&secure_boot_params->s_sha_context)) != ATCA_SUCCESS)
+    #if SECURE_BOOT_ASYNC_READ
+    uint32_t requested = 0;
+    uint8_t current = 0;
+
+    /*Prime the first buffer*/
+    if (memory_size > 0)
     {
-        return status;
+        requested = secure_boot_next_chunk(0, memory_size);
+        if ((status = secure_boot_read_memory_start(secure_boot_digest_buf[current], requested)) != ATCA_SUCCESS)
+        {
+            return status;
+        }
     }
+    #endif
 
-    /*Loop through SHA calculation for given memory*/
-    while (total_data_count < secure_boot_params->memory_params.memory_size)
+    /*Loop through the given memory*/
+    while (total_data_count < memory_size)
     {
-        /*Default set to data size*/
-        current_data_count = sizeof(sha_data);
+        #if SECURE_BOOT_ASYNC_READ
+        /*Wait for the read in flight and start the next one into the other buffer*/
+        if ((status = secure_boot_read_memory_wait(&current_data_count)) != ATCA_SUCCESS)
+        {
+            return status;
+        }
+        if ((current_data_count == 0) || (current_data_count > requested))
+        {
+            return ATCA_GEN_FAIL;
+        }
+        sha_data = secure_boot_digest_buf[current];
+        total_data_count += current_data_count;
 
-        /*Check if data exceeds available memory*/
-        if ((total_data_count + current_data_count) > secure_boot_params->memory_params.memory_size)
+        if (total_data_count < memory_size)
         {
-            /*Restrict to upper limit of memory*/
-            current_data_count = secure_boot_params->memory_params.memory_size - total_data_count;
+            current ^= 1;
+            requested = secure_boot_next_chunk(total_data_count, memory_size);
+            if ((status = secure_boot_read_memory_start(secure_boot_digest_buf[current], requested)) != ATCA_SUCCESS)
+            {
+                return status;
+            }
         }
+        #else
+        current_data_count = secure_boot_next_chunk(total_data_count, memory_size);
 
         /*Read data from memory*/
         if ((status = secure_boot_read_memory(sha_data, &current_data_count)) != ATCA_SUCCESS)
         {
             return status;
         }
+        if (current_data_count == 0)
+        {
+            return ATCA_GEN_FAIL;
+        }
         total_data_count += current_data_count;
+        #endif
+
+        /*Process the current set of data*/
+        if ((status = handler(context, sha_data, current_data_count)) != ATCA_SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    return ATCA_SUCCESS;
+}
+#endif /* SECURE_BOOT_STREAM_APPLICATION */
+
+#if SECURE_BOOT_SEGMENTED
+#if !SECURE_BOOT_SEGMENT_LAZY
+typedef struct
+{
+    atcac_sha2_256_ctx sha_context;
+    uint32_t           index;
+    uint32_t           filled;
+}secure_boot_segment_stream;
+
+/** \brief Completes the leaf digest of the current segment and checks it
+ *         against the (verified) segment table.
+ */
+static ATCA_STATUS secure_boot_segment_stream_close(secure_boot_segment_stream* stream)
+{
+    ATCA_STATUS status;
+    uint8_t digest[ATCA_SHA_DIGEST_SIZE];
+
+    if ((status = atcac_sw_sha2_256_finish(&stream->sha_context, digest)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+    if (memcmp(digest, secure_boot_segment_table[stream->index], ATCA_SHA_DIGEST_SIZE) != 0)
+    {
+        return ATCA_CHECKMAC_VERIFY_FAILED;
+    }
+    secure_boot_segment_state[stream->index] = SECURE_BOOT_SEGMENT_VERIFIED;
+    stream->index++;
+    stream->filled = 0;
 
-        /*Calculate SHA for the current set of data*/
-        if ((status = atcac_sw_sha2_256_update(&secure_boot_params->s_sha_context, sha_data, current_data_count)) != ATCA_SUCCESS)
+    return ATCA_SUCCESS;
+}
+
+/** \brief Chunk handler hashing every segment into its own leaf digest. */
+static ATCA_STATUS secure_boot_segment_chunk(void* context, const uint8_t* data, uint32_t length)
+{
+    secure_boot_segment_stream* stream = (secure_boot_segment_stream*)context;
+    ATCA_STATUS status;
+    uint32_t take;
+
+    while (length > 0)
+    {
+        if ((stream->filled == 0) && ((status = secure_boot_merkle_leaf_init(&stream->sha_context)) != ATCA_SUCCESS))
+        {
+            return status;
+        }
+
+        take = SECURE_BOOT_SEGMENT_SIZE - stream->filled;
+        take = (length < take) ? length : take;
+        if ((status = atcac_sw_sha2_256_update(&stream->sha_context, data, take)) != ATCA_SUCCESS)
         {
             return status;
         }
+        stream->filled += take;
+        data += take;
+        length -= take;
+
+        if ((stream->filled == SECURE_BOOT_SEGMENT_SIZE) && ((status = secure_boot_segment_stream_close(stream)) != ATCA_SUCCESS))
+        {
+            return status;
+        }
+    }
+
+    return ATCA_SUCCESS;
+}
+#endif
+
+/** \brief Reads the segment table stored with the application and calculates
+ *         its Merkle root, which takes the place of the application digest in
+ *         the SecureBoot command. The application itself is not read.
+ *  \param[in,out] secure_boot_params  Secure boot parameters
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+static ATCA_STATUS secure_boot_calc_segment_root(secure_boot_parameters* secure_boot_params)
+{
+    ATCA_STATUS status;
+    uint32_t count = secure_boot_segment_count(secure_boot_params->memory_params.memory_size);
+
+    secure_boot_segments_trusted = false;
+    secure_boot_segments = 0;
+    memset((void*)secure_boot_segment_state, SECURE_BOOT_SEGMENT_UNCHECKED, sizeof(secure_boot_segment_state));
+
+    if ((count == 0) || (count > SECURE_BOOT_MAX_SEGMENTS))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    if ((status = secure_boot_read_segment_table(&secure_boot_segment_table[0][0], count)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+    secure_boot_segments = count;
+
+    return secure_boot_merkle_root(&secure_boot_segment_table[0][0], count, secure_boot_params->app_digest);
+}
+
+#if !SECURE_BOOT_SEGMENT_LAZY
+/** \brief Reads the whole application and checks every segment against the
+ *         verified segment table.
+ *  \param[in,out] secure_boot_params  Secure boot parameters
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+static ATCA_STATUS secure_boot_verify_all_segments(secure_boot_parameters* secure_boot_params)
+{
+    ATCA_STATUS status;
+    secure_boot_segment_stream stream;
+
+    memset(&stream, 0, sizeof(stream));
+    if ((status = secure_boot_stream_memory(secure_boot_params->memory_params.memory_size, secure_boot_segment_chunk, &stream)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+
+    /*Last segment may be short*/
+    if (stream.filled > 0)
+    {
+        status = secure_boot_segment_stream_close(&stream);
+    }
+
+    return status;
+}
+#endif
+
+/** \brief Verifies one application segment against the segment table the
+ *         ATECC608 verified during secure_boot_process. Intended to be called
+ *         before a segment is first used when SECURE_BOOT_SEGMENT_LAZY is set;
+ *         segments already verified return immediately. Different segments
+ *         may be verified concurrently (for example one per core).
+ *  \param[in] index   Segment index
+ *  \param[in] data    Segment contents (memory mapped or read by the caller)
+ *  \param[in] length  Segment length, SECURE_BOOT_SEGMENT_SIZE except for the
+ *                     last segment
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS secure_boot_verify_segment(uint32_t index, const uint8_t* data, uint32_t length)
+{
+    ATCA_STATUS status;
+    uint8_t digest[ATCA_SHA_DIGEST_SIZE];
+
+    if (!secure_boot_segments_trusted)
+    {
+        return ATCA_NOT_INITIALIZED;
+    }
+    if ((index >= secure_boot_segments) || (data == NULL) || (length == 0) || (length > SECURE_BOOT_SEGMENT_SIZE))
+    {
+        return ATCA_BAD_PARAM;
+    }
+    if (secure_boot_segment_state[index] == SECURE_BOOT_SEGMENT_VERIFIED)
+    {
+        return ATCA_SUCCESS;
+    }
+
+    if ((status = secure_boot_merkle_leaf(data, length, digest)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+    if (memcmp(digest, secure_boot_segment_table[index], ATCA_SHA_DIGEST_SIZE) != 0)
+    {
+        return ATCA_CHECKMAC_VERIFY_FAILED;
+    }
+    secure_boot_segment_state[index] = SECURE_BOOT_SEGMENT_VERIFIED;
+
+    return ATCA_SUCCESS;
+}
+
+#else
+
+/** \brief Chunk handler feeding the application digest. */
+static ATCA_STATUS secure_boot_digest_chunk(void* context, const uint8_t* data, uint32_t length)
+{
+    return atcac_sw_sha2_256_update((atcac_sha2_256_ctx*)context, data, length);
+}
+
+/** \brief Calculates the application digest using the host SHA256
+ *         implementation (hardware accelerated when CryptoAuthLib is built on
+ *         a crypto library that uses it).
+ *  \param[in,out] secure_boot_params  Secure boot parameters
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+static ATCA_STATUS secure_boot_calc_app_digest(secure_boot_parameters* secure_boot_params)
+{
+    ATCA_STATUS status;
+
+    /*Initialize SHA engine*/
+    if ((status = atcac_sw_sha2_256_init(&secure_boot_params->s_sha_context)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+
+    if ((status = secure_boot_stream_memory(secure_boot_params->memory_params.memory_size, secure_boot_digest_chunk, &secure_boot_params->s_sha_context)) != ATCA_SUCCESS)
+    {
+        return status;
     }
 
     /*Initiate final step and get SHA output*/
@@ -219,6 +517,8 @@ static ATCA_STATUS secure_boot_calc_app_digest(secure_boot_parameters* secure_bo
 
     return ATCA_SUCCESS;
 }
+#endif /* SECURE_BOOT_SEGMENTED */
+
 /** \brief Binds host MCU and Secure element with IO protection key.
  *  \param[in]  slot    The slot number of IO protection Key.
  *  \return ATCA_SUCCESS on success, otherwise an error code.
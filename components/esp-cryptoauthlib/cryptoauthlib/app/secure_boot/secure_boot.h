@@ -37,6 +37,9 @@ extern "C" {
 #include "secure_boot_memory.h"
 #include "atca_command.h"
 #include "crypto/atca_crypto_sw_sha2.h"
+#if SECURE_BOOT_SEGMENTED
+#include "secure_boot_merkle.h"
+#endif
 
 #define SECURE_BOOT_CONFIG_DISABLE              0
 #define SECURE_BOOT_CONFIG_FULL_BOTH            1
@@ -55,6 +58,18 @@ extern "C" {
 #define SECURE_BOOT_UPGRADE_SUPPORT             true
 #endif
 
+/* Bytes read from memory per call while calculating the application digest */
+#ifndef SECURE_BOOT_DIGEST_CHUNK_SIZE
+#define SECURE_BOOT_DIGEST_CHUNK_SIZE           (4096)
+#endif
+
+/* With SECURE_BOOT_SEGMENTED, leave segment checks to the application
+   (secure_boot_verify_segment on first access) instead of hashing every
+   segment during secure_boot_process */
+#ifndef SECURE_BOOT_SEGMENT_LAZY
+#define SECURE_BOOT_SEGMENT_LAZY                false
+#endif
+
 typedef struct
 {
     uint16_t secure_boot_mode : 2;
@@ -80,6 +95,9 @@ typedef struct
 
 ATCA_STATUS secure_boot_process(void);
 ATCA_STATUS bind_host_and_secure_element_with_io_protection(uint16_t slot);
+#if SECURE_BOOT_SEGMENTED
+ATCA_STATUS secure_boot_verify_segment(uint32_t index, const uint8_t* data, uint32_t length);
+#endif
 extern ATCA_STATUS host_generate_random_number(uint8_t *rand);
 
 #ifdef __cplusplus
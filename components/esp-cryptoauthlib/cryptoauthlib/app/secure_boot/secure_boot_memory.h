@@ -36,6 +36,17 @@ extern "C" {
 #include "atca_status.h"
 #include "atca_command.h"
 
+/* Set when the platform can read memory asynchronously (DMA) so the next
+   chunk is fetched while the current one is being hashed */
+#ifndef SECURE_BOOT_ASYNC_READ
+#define SECURE_BOOT_ASYNC_READ                  false
+#endif
+
+/* Set when the application is stored with a table of per segment digests and
+   the ATECC608 verifies the Merkle root of that table (secure_boot_merkle.h) */
+#ifndef SECURE_BOOT_SEGMENTED
+#define SECURE_BOOT_SEGMENTED                   false
+#endif
 
 /*Blocking last USER_APPLICATION_HEADER_SIZE bytes for Signature and memory/application specific information*/
 typedef struct
@@ -50,6 +61,16 @@ typedef struct
 extern ATCA_STATUS secure_boot_init_memory(memory_parameters* memory_params);
 extern ATCA_STATUS secure_boot_read_memory(uint8_t* pu8_data, uint32_t* pu32_target_length);
 extern ATCA_STATUS secure_boot_write_memory(uint8_t* pu8_data, uint32_t* pu32_target_length);
+#if SECURE_BOOT_ASYNC_READ
+/* Start reading the next u32_target_length bytes into pu8_data and return
+   without waiting; secure_boot_read_memory_wait completes the read */
+extern ATCA_STATUS secure_boot_read_memory_start(uint8_t* pu8_data, uint32_t u32_target_length);
+extern ATCA_STATUS secure_boot_read_memory_wait(uint32_t* pu32_read_length);
+#endif
+#if SECURE_BOOT_SEGMENTED
+/* Read the table of count 32 byte leaf digests stored with the application */
+extern ATCA_STATUS secure_boot_read_segment_table(uint8_t* pu8_digests, uint32_t u32_count);
+#endif
 extern void secure_boot_deinit_memory(memory_parameters* memory_params);
 extern ATCA_STATUS secure_boot_mark_full_copy_completion(void);
 extern bool secure_boot_check_full_copy_completion(void);
@@ -0,0 +1,160 @@
+/**
+ * \file
+ *
+ * \brief Merkle tree over fixed size application segments for segmented secure boot.
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include "secure_boot_merkle.h"
+
+/* Tree hashing follows RFC 6962 (Certificate Transparency) so images can be
+   prepared with any tool implementing it:
+     leaf = SHA256(0x00 || segment)
+     node = SHA256(0x01 || left || right)
+   and a level with an odd count splits at the largest power of two. */
+#define SECURE_BOOT_MERKLE_LEAF_PREFIX          0x00
+#define SECURE_BOOT_MERKLE_NODE_PREFIX          0x01
+
+/** \brief Starts a leaf digest that is fed with the segment contents in
+ *         pieces and completed with atcac_sw_sha2_256_finish.
+ *  \param[out] ctx  SHA256 context to initialize
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS secure_boot_merkle_leaf_init(atcac_sha2_256_ctx* ctx)
+{
+    uint8_t prefix = SECURE_BOOT_MERKLE_LEAF_PREFIX;
+    ATCA_STATUS status;
+
+    if ((status = atcac_sw_sha2_256_init(ctx)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+
+    return atcac_sw_sha2_256_update(ctx, &prefix, 1);
+}
+
+/** \brief Calculates the leaf digest of one application segment.
+ *  \param[in]  data    Segment contents
+ *  \param[in]  length  Segment length (SECURE_BOOT_SEGMENT_SIZE except for
+ *                      the last segment)
+ *  \param[out] digest  32 byte leaf digest
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS secure_boot_merkle_leaf(const uint8_t* data, uint32_t length, uint8_t* digest)
+{
+    atcac_sha2_256_ctx ctx;
+    ATCA_STATUS status;
+
+    if (((data == NULL) && (length > 0)) || (digest == NULL))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    if ((status = secure_boot_merkle_leaf_init(&ctx)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+    if ((length > 0) && ((status = atcac_sw_sha2_256_update(&ctx, data, length)) != ATCA_SUCCESS))
+    {
+        return status;
+    }
+
+    return atcac_sw_sha2_256_finish(&ctx, digest);
+}
+
+/** \brief Combines two child digests into their parent node digest. */
+static ATCA_STATUS secure_boot_merkle_node(const uint8_t* left, const uint8_t* right, uint8_t* parent)
+{
+    uint8_t node[1 + 2 * ATCA_SHA_DIGEST_SIZE];
+
+    node[0] = SECURE_BOOT_MERKLE_NODE_PREFIX;
+    memcpy(&node[1], left, ATCA_SHA_DIGEST_SIZE);
+    memcpy(&node[1 + ATCA_SHA_DIGEST_SIZE], right, ATCA_SHA_DIGEST_SIZE);
+
+    return atcac_sw_sha2_256(node, sizeof(node), parent);
+}
+
+/** \brief Calculates the Merkle root of a table of leaf digests. This is the
+ *         digest the ATECC608 verifies in place of the whole image digest.
+ *
+ *  Leaves are pushed onto a stack of complete subtrees which are merged as
+ *  soon as two of the same height are on top; folding what is left from the
+ *  top gives the RFC 6962 root with O(log n) memory and n - 1 node hashes.
+ *  \param[in]  leaves  count * 32 bytes of leaf digests
+ *  \param[in]  count   Number of leaves (1 to SECURE_BOOT_MAX_SEGMENTS)
+ *  \param[out] root    32 byte root digest
+ *  \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS secure_boot_merkle_root(const uint8_t* leaves, uint32_t count, uint8_t* root)
+{
+    uint8_t stack[SECURE_BOOT_MERKLE_DEPTH][ATCA_SHA_DIGEST_SIZE];
+    uint8_t height[SECURE_BOOT_MERKLE_DEPTH];
+    uint32_t top = 0;
+    uint32_t i;
+    ATCA_STATUS status;
+
+    if ((leaves == NULL) || (root == NULL) || (count == 0) || (count > SECURE_BOOT_MAX_SEGMENTS))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        memcpy(stack[top], &leaves[i * ATCA_SHA_DIGEST_SIZE], ATCA_SHA_DIGEST_SIZE);
+        height[top++] = 0;
+
+        /*Merge complete subtrees of equal height*/
+        while ((top >= 2) && (height[top - 1] == height[top - 2]))
+        {
+            if ((status = secure_boot_merkle_node(stack[top - 2], stack[top - 1], stack[top - 2])) != ATCA_SUCCESS)
+            {
+                return status;
+            }
+            height[top - 2]++;
+            top--;
+        }
+    }
+
+    /*Fold the remaining subtrees, smallest (rightmost) first*/
+    while (top >= 2)
+    {
+        if ((status = secure_boot_merkle_node(stack[top - 2], stack[top - 1], stack[top - 2])) != ATCA_SUCCESS)
+        {
+            return status;
+        }
+        top--;
+    }
+
+    memcpy(root, stack[0], ATCA_SHA_DIGEST_SIZE);
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Number of segments an application of memory_size bytes is split
+ *         into. */
+uint32_t secure_boot_segment_count(uint32_t memory_size)
+{
+    return (memory_size + SECURE_BOOT_SEGMENT_SIZE - 1) / SECURE_BOOT_SEGMENT_SIZE;
+}
@@ -0,0 +1,71 @@
+/**
+ * \file
+ *
+ * \brief Merkle tree over fixed size application segments for segmented secure boot.
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+#ifndef SECURE_BOOT_MERKLE_H
+#define SECURE_BOOT_MERKLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "atca_status.h"
+#include "atca_command.h"
+#include "crypto/atca_crypto_sw_sha2.h"
+
+/* Size of one application segment. The application digest table holds one
+   leaf digest per segment; the last segment may be shorter */
+#ifndef SECURE_BOOT_SEGMENT_SIZE
+#define SECURE_BOOT_SEGMENT_SIZE                (65536)
+#endif
+
+/* Largest number of segments an application may have */
+#ifndef SECURE_BOOT_MAX_SEGMENTS
+#define SECURE_BOOT_MAX_SEGMENTS                (64)
+#endif
+
+/* Stack depth needed to fold SECURE_BOOT_MAX_SEGMENTS leaves into a root: a
+   stack of depth d holds the subtrees of up to 2^(d - 1) leaves */
+#ifndef SECURE_BOOT_MERKLE_DEPTH
+#define SECURE_BOOT_MERKLE_DEPTH                (17)
+#endif
+
+#if (SECURE_BOOT_MERKLE_DEPTH < 1) || (SECURE_BOOT_MERKLE_DEPTH > 32) || \
+    (SECURE_BOOT_MAX_SEGMENTS > (1ul << (SECURE_BOOT_MERKLE_DEPTH - 1)))
+#error "SECURE_BOOT_MERKLE_DEPTH is too small for SECURE_BOOT_MAX_SEGMENTS"
+#endif
+
+ATCA_STATUS secure_boot_merkle_leaf_init(atcac_sha2_256_ctx* ctx);
+ATCA_STATUS secure_boot_merkle_leaf(const uint8_t* data, uint32_t length, uint8_t* digest);
+ATCA_STATUS secure_boot_merkle_root(const uint8_t* leaves, uint32_t count, uint8_t* root);
+uint32_t secure_boot_segment_count(uint32_t memory_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * \file
+ * \brief  Signatures per second of atcab_sign_batch against one atcab_sign per
+ *         digest, measured on an attached device
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cryptoauthlib.h"
+
+#define SIGN_BENCH_DEFAULT_COUNT    (64)
+#define SIGN_BENCH_DEFAULT_KEY_ID   (0)
+
+static double sign_bench_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* Default configurations of the interfaces the library is built with */
+static ATCAIfaceCfg* sign_bench_iface(const char* name)
+{
+#ifdef ATCA_HAL_I2C
+    if (!strcmp(name, "i2c"))
+    {
+        return &cfg_ateccx08a_i2c_default;
+    }
+#endif
+#ifdef ATCA_HAL_KIT_UART
+    if (!strcmp(name, "cdc"))
+    {
+        return &cfg_ateccx08a_kitcdc_default;
+    }
+#endif
+#ifdef ATCA_HAL_KIT_HID
+    if (!strcmp(name, "hid"))
+    {
+        return &cfg_ateccx08a_kithid_default;
+    }
+#endif
+    ((void)name);
+    return NULL;
+}
+
+/* Check a signature with the device so a wrong batch result cannot pass as fast */
+static bool sign_bench_verify(const uint8_t* digest, const uint8_t* signature, const uint8_t* public_key)
+{
+    bool verified = false;
+
+    return (ATCA_SUCCESS == atcab_verify_extern(digest, signature, public_key, &verified)) && verified;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : SIGN_BENCH_DEFAULT_COUNT;
+    uint16_t key_id = (argc > 2) ? (uint16_t)strtoul(argv[2], NULL, 10) : SIGN_BENCH_DEFAULT_KEY_ID;
+    ATCAIfaceCfg* cfg = sign_bench_iface((argc > 3) ? argv[3] : "i2c");
+    uint8_t public_key[ATCA_ECCP256_PUBKEY_SIZE];
+    uint8_t* digests;
+    uint8_t* signatures;
+    ATCA_STATUS status;
+    double start, single_time, batch_time;
+    size_t i;
+    int ret = EXIT_FAILURE;
+
+    if (!count || !cfg)
+    {
+        fprintf(stderr, "usage: %s [count] [key_id] [i2c|cdc|hid]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    digests = malloc(count * ATCA_SHA256_DIGEST_SIZE);
+    signatures = malloc(count * ATCA_ECCP256_SIG_SIZE);
+    if (!digests || !signatures)
+    {
+        fprintf(stderr, "Out of memory\n");
+        free(digests);
+        free(signatures);
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    for (i = 0; i < count * ATCA_SHA256_DIGEST_SIZE; i++)
+    {
+        digests[i] = (uint8_t)rand();
+    }
+
+    do
+    {
+        if (ATCA_SUCCESS != (status = atcab_init(cfg)))
+        {
+            fprintf(stderr, "Unable to open the device: %02X\n", status);
+            break;
+        }
+        if (ATCA_SUCCESS != (status = atcab_get_pubkey(key_id, public_key)))
+        {
+            fprintf(stderr, "Unable to read the public key of slot %u: %02X\n", key_id, status);
+            break;
+        }
+
+        /* One wake, RNG seed update, Nonce and Sign per digest */
+        start = sign_bench_now();
+        for (i = 0; (i < count) && (ATCA_SUCCESS == status); i++)
+        {
+            status = atcab_sign(key_id, &digests[i * ATCA_SHA256_DIGEST_SIZE], &signatures[i * ATCA_ECCP256_SIG_SIZE]);
+        }
+        single_time = sign_bench_now() - start;
+        if (ATCA_SUCCESS != status)
+        {
+            fprintf(stderr, "atcab_sign failed: %02X\n", status);
+            break;
+        }
+
+        /* Held awake for as many signatures as the watchdog allows */
+        memset(signatures, 0, count * ATCA_ECCP256_SIG_SIZE);
+        start = sign_bench_now();
+        status = atcab_sign_batch(key_id, digests, count, signatures);
+        batch_time = sign_bench_now() - start;
+        if (ATCA_SUCCESS != status)
+        {
+            fprintf(stderr, "atcab_sign_batch failed: %02X\n", status);
+            break;
+        }
+
+        if (!sign_bench_verify(digests, signatures, public_key)
+            || !sign_bench_verify(&digests[(count - 1) * ATCA_SHA256_DIGEST_SIZE],
+                                  &signatures[(count - 1) * ATCA_ECCP256_SIG_SIZE], public_key))
+        {
+            fprintf(stderr, "Batch signatures do not verify against slot %u\n", key_id);
+            break;
+        }
+
+        printf("%zu signatures with slot %u\n", count, key_id);
+        printf("atcab_sign:       %.1f signatures/s\n", count / single_time);
+        printf("atcab_sign_batch: %.1f signatures/s (x%.2f)\n", count / batch_time, single_time / batch_time);
+        ret = EXIT_SUCCESS;
+    }
+    while (0);
+
+    (void)atcab_release();
+    free(signatures);
+    free(digests);
+
+    return ret;
+}
@@ -77,6 +77,113 @@ SHARED_LIB_EXPORT const atcacert_cert_element_t g_tngtls_cert_elements_1_signer[
     }
 };
 
+static const atcacert_device_loc_t g_cert_compiled_locs_tngtls_1_signer[] = {
+    { .zone = DEVZONE_DATA, .slot = 12, .is_genkey = 0, .offset = 0, .count = 96 },
+    { .zone = DEVZONE_DATA, .slot = 11, .is_genkey = 0, .offset = 0, .count = 96 }
+};
+
+// { .zone = DEVZONE_DATA, .slot = 12, .is_genkey = 0, .offset = 0, .count = 96 }
+static int atcacert_build_loc0_tngtls_1_signer(atcacert_build_state_t* build_state, const uint8_t* device_data)
+{
+    uint8_t* cert = build_state->cert;
+    int ret;
+    const uint8_t* comp_cert;
+    atcacert_tm_utc_t issue_date;
+    atcacert_tm_utc_t expire_date;
+    size_t date_size;
+    static const char hex_digits[] = "0123456789ABCDEF";
+
+    comp_cert = &device_data[0];
+    if ((comp_cert[70] & 0x0F) != 0)
+    {
+        return ATCACERT_E_DECODING_ERROR;  // Unknown format
+    }
+    if (comp_cert[69] != 0x10 || (comp_cert[70] >> 4) != SNSRC_PUB_KEY_HASH)
+    {
+        return ATCACERT_E_WRONG_CERT_DEF;
+    }
+    ret = atcacert_set_signature(build_state->cert_def, cert, build_state->cert_size, build_state->max_cert_size, comp_cert);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    ret = atcacert_date_dec_compcert(&comp_cert[64], DATEFMT_RFC5280_GEN, &issue_date, &expire_date);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    date_size = 13;
+    ret = atcacert_date_enc(DATEFMT_RFC5280_UTC, &issue_date, &cert[128], &date_size);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (date_size != 13)
+    {
+        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;
+    }
+    date_size = 15;
+    ret = atcacert_date_enc(DATEFMT_RFC5280_GEN, &expire_date, &cert[143], &date_size);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (date_size != 15)
+    {
+        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;
+    }
+    cert[235] = (uint8_t)hex_digits[comp_cert[67] >> 4];
+    cert[236] = (uint8_t)hex_digits[comp_cert[67] & 0x0F];
+    cert[237] = (uint8_t)hex_digits[comp_cert[68] >> 4];
+    cert[238] = (uint8_t)hex_digits[comp_cert[68] & 0x0F];
+
+    return ATCACERT_E_SUCCESS;
+}
+
+// { .zone = DEVZONE_DATA, .slot = 11, .is_genkey = 0, .offset = 0, .count = 96 }
+static int atcacert_build_loc1_tngtls_1_signer(atcacert_build_state_t* build_state, const uint8_t* device_data)
+{
+    uint8_t* cert = build_state->cert;
+    int ret;
+
+    atcacert_public_key_remove_padding(&device_data[0], &cert[266]);
+    ret = atcacert_get_key_id(&cert[266], &cert[381]);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+
+    return ATCACERT_E_SUCCESS;
+}
+
+static int atcacert_build_process_tngtls_1_signer(struct atcacert_build_state_s* build_state, size_t index, const uint8_t* device_data)
+{
+    if (build_state == NULL || device_data == NULL)
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+    if (*build_state->cert_size < 434)
+    {
+        return ATCACERT_E_ELEM_OUT_OF_BOUNDS;
+    }
+
+    switch (index)
+    {
+    case 0:
+        return atcacert_build_loc0_tngtls_1_signer(build_state, device_data);
+    case 1:
+        return atcacert_build_loc1_tngtls_1_signer(build_state, device_data);
+    default:
+        return ATCACERT_E_BAD_PARAMS;
+    }
+}
+
+const atcacert_compiled_def_t g_cert_compiled_tngtls_1_signer = {
+    .device_locs       = g_cert_compiled_locs_tngtls_1_signer,
+    .device_locs_count = sizeof(g_cert_compiled_locs_tngtls_1_signer) / sizeof(g_cert_compiled_locs_tngtls_1_signer[0]),
+    .build_process     = atcacert_build_process_tngtls_1_signer
+};
+
 SHARED_LIB_EXPORT const atcacert_def_t g_tngtls_cert_def_1_signer = {
     .type                = CERTTYPE_X509,
     .template_id         = 1,
@@ -149,5 +256,6 @@ SHARED_LIB_EXPORT const atcacert_def_t g_tngtls_cert_def_1_signer = {
     .cert_elements_count = 1,
     .cert_template       = g_tngtls_cert_template_1_signer,
     .cert_template_size  = sizeof(g_tngtls_cert_template_1_signer),
-    .ca_cert_def         = NULL
+    .ca_cert_def         = NULL,
+    .compiled            = &g_cert_compiled_tngtls_1_signer
 };
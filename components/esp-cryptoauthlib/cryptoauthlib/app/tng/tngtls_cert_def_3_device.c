@@ -124,6 +124,166 @@ SHARED_LIB_EXPORT const atcacert_cert_element_t g_tngtls_cert_elements_3_device[
     }
 };
 
+static const atcacert_device_loc_t g_cert_compiled_locs_tngtls_3_device[] = {
+    { .zone = DEVZONE_DATA, .slot = 10, .is_genkey = 0, .offset = 0, .count = 96 },
+    { .zone = DEVZONE_DATA, .slot = 0, .is_genkey = 1, .offset = 0, .count = 64 },
+    { .zone = DEVZONE_CONFIG, .slot = 0, .is_genkey = 0, .offset = 0, .count = 32 },
+    { .zone = DEVZONE_DATA, .slot = 5, .is_genkey = 0, .offset = 0, .count = 32 }
+};
+
+// { .zone = DEVZONE_DATA, .slot = 10, .is_genkey = 0, .offset = 0, .count = 96 }
+static int atcacert_build_loc0_tngtls_3_device(atcacert_build_state_t* build_state, const uint8_t* device_data)
+{
+    uint8_t* cert = build_state->cert;
+    int ret;
+    const uint8_t* comp_cert;
+    atcacert_tm_utc_t issue_date;
+    atcacert_tm_utc_t expire_date;
+    size_t date_size;
+    static const char hex_digits[] = "0123456789ABCDEF";
+
+    comp_cert = &device_data[0];
+    if ((comp_cert[70] & 0x0F) != 0)
+    {
+        return ATCACERT_E_DECODING_ERROR;  // Unknown format
+    }
+    if (comp_cert[69] != 0x30 || (comp_cert[70] >> 4) != SNSRC_PUB_KEY_HASH)
+    {
+        return ATCACERT_E_WRONG_CERT_DEF;
+    }
+    ret = atcacert_set_signature(build_state->cert_def, cert, build_state->cert_size, build_state->max_cert_size, comp_cert);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    ret = atcacert_date_dec_compcert(&comp_cert[64], DATEFMT_RFC5280_GEN, &issue_date, &expire_date);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    date_size = 13;
+    ret = atcacert_date_enc(DATEFMT_RFC5280_UTC, &issue_date, &cert[128], &date_size);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (date_size != 13)
+    {
+        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;
+    }
+    date_size = 15;
+    ret = atcacert_date_enc(DATEFMT_RFC5280_GEN, &expire_date, &cert[143], &date_size);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (date_size != 15)
+    {
+        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;
+    }
+    cert[120] = (uint8_t)hex_digits[comp_cert[67] >> 4];
+    cert[121] = (uint8_t)hex_digits[comp_cert[67] & 0x0F];
+    cert[122] = (uint8_t)hex_digits[comp_cert[68] >> 4];
+    cert[123] = (uint8_t)hex_digits[comp_cert[68] & 0x0F];
+
+    return ATCACERT_E_SUCCESS;
+}
+
+// { .zone = DEVZONE_DATA, .slot = 0, .is_genkey = 1, .offset = 0, .count = 64 }
+static int atcacert_build_loc1_tngtls_3_device(atcacert_build_state_t* build_state, const uint8_t* device_data)
+{
+    uint8_t* cert = build_state->cert;
+    int ret;
+
+    memcpy(&cert[253], &device_data[0], 64);  // Public key
+    ret = atcacert_get_key_id(&cert[253], &cert[408]);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+
+    return ATCACERT_E_SUCCESS;
+}
+
+// { .zone = DEVZONE_CONFIG, .slot = 0, .is_genkey = 0, .offset = 0, .count = 32 }
+static int atcacert_build_loc2_tngtls_3_device(atcacert_build_state_t* build_state, const uint8_t* device_data)
+{
+    uint8_t* cert = build_state->cert;
+    int ret;
+    uint8_t tf_buffer1[256];
+    size_t tf_size;
+
+    tf_size = sizeof(tf_buffer1);
+    ret = atcacert_transform_data(TF_BIN2HEX_UC, &device_data[0], 4, tf_buffer1, &tf_size);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (tf_size != 8)
+    {
+        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;
+    }
+    memcpy(&cert[208], tf_buffer1, 8);  // SN03
+    tf_size = sizeof(tf_buffer1);
+    ret = atcacert_transform_data(TF_BIN2HEX_UC, &device_data[8], 5, tf_buffer1, &tf_size);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (tf_size != 10)
+    {
+        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;
+    }
+    memcpy(&cert[216], tf_buffer1, 10);  // SN48
+    build_state->is_device_sn = TRUE;
+    memcpy(&build_state->device_sn[0], &device_data[0], 4);
+    memcpy(&build_state->device_sn[4], &device_data[8], 5);
+
+    return ATCACERT_E_SUCCESS;
+}
+
+// { .zone = DEVZONE_DATA, .slot = 5, .is_genkey = 0, .offset = 0, .count = 32 }
+static int atcacert_build_loc3_tngtls_3_device(atcacert_build_state_t* build_state, const uint8_t* device_data)
+{
+    uint8_t* cert = build_state->cert;
+
+    memcpy(&cert[355], &device_data[0], 12);  // EUI-48
+
+    return ATCACERT_E_SUCCESS;
+}
+
+static int atcacert_build_process_tngtls_3_device(struct atcacert_build_state_s* build_state, size_t index, const uint8_t* device_data)
+{
+    if (build_state == NULL || device_data == NULL)
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+    if (*build_state->cert_size < 461)
+    {
+        return ATCACERT_E_ELEM_OUT_OF_BOUNDS;
+    }
+
+    switch (index)
+    {
+    case 0:
+        return atcacert_build_loc0_tngtls_3_device(build_state, device_data);
+    case 1:
+        return atcacert_build_loc1_tngtls_3_device(build_state, device_data);
+    case 2:
+        return atcacert_build_loc2_tngtls_3_device(build_state, device_data);
+    case 3:
+        return atcacert_build_loc3_tngtls_3_device(build_state, device_data);
+    default:
+        return ATCACERT_E_BAD_PARAMS;
+    }
+}
+
+const atcacert_compiled_def_t g_cert_compiled_tngtls_3_device = {
+    .device_locs       = g_cert_compiled_locs_tngtls_3_device,
+    .device_locs_count = sizeof(g_cert_compiled_locs_tngtls_3_device) / sizeof(g_cert_compiled_locs_tngtls_3_device[0]),
+    .build_process     = atcacert_build_process_tngtls_3_device
+};
+
 SHARED_LIB_EXPORT const atcacert_def_t g_tngtls_cert_def_3_device = {
     .type                = CERTTYPE_X509,
     .template_id         = 3,
@@ -196,5 +356,6 @@ SHARED_LIB_EXPORT const atcacert_def_t g_tngtls_cert_def_3_device = {
     .cert_elements_count = sizeof(g_tngtls_cert_elements_3_device) / sizeof(g_tngtls_cert_elements_3_device[0]),
     .cert_template       = g_tngtls_cert_template_3_device,
     .cert_template_size  = sizeof(g_tngtls_cert_template_3_device),
-    .ca_cert_def         = &g_tngtls_cert_def_1_signer
+    .ca_cert_def         = &g_tngtls_cert_def_1_signer,
+    .compiled            = &g_cert_compiled_tngtls_3_device
 };
@@ -2225,6 +2225,62 @@ ATCA_STATUS atcab_random(uint8_t* rand_out)
 {
     return atcab_random_ext(_gDevice, rand_out);
 }
+
+/** \brief Executes a series of Random commands, keeping the device awake
+ *          between them, to fill a buffer of blocks * 32 bytes.
+ *
+ * \param[in]  device    Device context pointer
+ * \param[out] rand_out  blocks * 32 bytes of random data are returned here.
+ * \param[in]  blocks    Number of 32 byte random numbers to generate
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcab_random_batch_ext(ATCADevice device, uint8_t* rand_out, size_t blocks)
+{
+    ATCA_STATUS status = ATCA_UNIMPLEMENTED;
+    ATCADeviceType dev_type = atcab_get_device_type_ext(device);
+
+    if (atcab_is_ca_device(dev_type) || atcab_is_ca2_device(dev_type))
+    {
+#if ATCA_CA_SUPPORT
+        status = calib_random_batch(device, rand_out, blocks);
+#endif
+    }
+    else if (atcab_is_ta_device(dev_type))
+    {
+#if ATCA_TA_SUPPORT
+        size_t i;
+
+        if (NULL == rand_out)
+        {
+            return ATCA_TRACE(ATCA_BAD_PARAM, "NULL pointer received");
+        }
+
+        status = ATCA_SUCCESS;
+        for (i = 0; (i < blocks) && (ATCA_SUCCESS == status); i++)
+        {
+            status = talib_random_compat(device, &rand_out[i * 32u]);
+        }
+#endif
+    }
+    else
+    {
+        status = ATCA_NOT_INITIALIZED;
+    }
+    return status;
+}
+
+/** \brief Executes a series of Random commands on the default device.
+ *
+ * \param[out] rand_out  blocks * 32 bytes of random data are returned here.
+ * \param[in]  blocks    Number of 32 byte random numbers to generate
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcab_random_batch(uint8_t* rand_out, size_t blocks)
+{
+    return atcab_random_batch_ext(_gDevice, rand_out, blocks);
+}
 #endif /* ATCAB_RANDOM_EN */
 
 // Read command functions
@@ -3469,6 +3525,72 @@ ATCA_STATUS atcab_sign(uint16_t key_id, const uint8_t* msg, uint8_t* signature)
 {
     return atcab_sign_ext(_gDevice, key_id, msg, signature);
 }
+
+/** \brief Sign a batch of 32-byte messages using the private key in the
+ *          specified slot. The device is kept awake across the batch so the
+ *          per-signature wake/idle overhead is amortised.
+ *
+ *  \param[in]  device      Device context pointer
+ *  \param[in]  key_id      Slot of the private key to be used to sign the
+ *                          messages.
+ *  \param[in]  msgs        count * 32 bytes of messages to be signed, stored
+ *                          back to back. Typically SHA256 digests.
+ *  \param[in]  count       Number of messages in msgs
+ *  \param[out] signatures  count * 64 bytes of signatures are returned here
+ *                          in the same order as msgs.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcab_sign_batch_ext(ATCADevice device, uint16_t key_id, const uint8_t* msgs, size_t count, uint8_t* signatures)
+{
+    ATCA_STATUS status = ATCA_UNIMPLEMENTED;
+    ATCADeviceType dev_type = atcab_get_device_type_ext(device);
+
+    if (atcab_is_ca_device(dev_type) || atcab_is_ca2_device(dev_type))
+    {
+#if ATCA_ECC_SUPPORT || defined(ATCA_ECC204_SUPPORT) || defined(ATCA_TA010_SUPPORT)
+        status = calib_sign_batch(device, key_id, msgs, count, signatures);
+#endif
+    }
+    else if (atcab_is_ta_device(dev_type))
+    {
+#if ATCA_TA_SUPPORT
+        size_t i;
+
+        if ((NULL == msgs) || (NULL == signatures))
+        {
+            return ATCA_TRACE(ATCA_BAD_PARAM, "NULL pointer received");
+        }
+
+        status = ATCA_SUCCESS;
+        for (i = 0; (i < count) && (ATCA_SUCCESS == status); i++)
+        {
+            status = talib_sign_compat(device, key_id, &msgs[i * ATCA_SHA256_DIGEST_SIZE], &signatures[i * ATCA_ECCP256_SIG_SIZE]);
+        }
+#endif
+    }
+    else
+    {
+        status = ATCA_NOT_INITIALIZED;
+    }
+    return status;
+}
+
+/** \brief Sign a batch of 32-byte messages using the private key in the
+ *          specified slot of the default device.
+ *
+ *  \param[in]  key_id      Slot of the private key to be used to sign the
+ *                          messages.
+ *  \param[in]  msgs        count * 32 bytes of messages to be signed
+ *  \param[in]  count       Number of messages in msgs
+ *  \param[out] signatures  count * 64 bytes of signatures are returned here
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcab_sign_batch(uint16_t key_id, const uint8_t* msgs, size_t count, uint8_t* signatures)
+{
+    return atcab_sign_batch_ext(_gDevice, key_id, msgs, count, signatures);
+}
 #endif
 
 #if ATCAB_SIGN_INTERNAL_EN && defined(ATCA_USE_ATCAB_FUNCTIONS)
@@ -183,6 +183,8 @@ ATCA_STATUS atcab_priv_write(uint16_t key_id, const uint8_t priv_key[36], uint16
 // Random command functions
 ATCA_STATUS atcab_random(uint8_t* rand_out);
 ATCA_STATUS atcab_random_ext(ATCADevice device, uint8_t* rand_out);
+ATCA_STATUS atcab_random_batch(uint8_t* rand_out, size_t blocks);
+ATCA_STATUS atcab_random_batch_ext(ATCADevice device, uint8_t* rand_out, size_t blocks);
 
 // Read command functions
 ATCA_STATUS atcab_read_zone(uint8_t zone, uint16_t slot, uint8_t block, uint8_t offset, uint8_t* data, uint8_t len);
@@ -239,6 +241,8 @@ ATCA_STATUS atcab_sha_hmac_ext(ATCADevice device, const uint8_t* data, size_t da
 ATCA_STATUS atcab_sign_base(uint8_t mode, uint16_t key_id, uint8_t* signature);
 ATCA_STATUS atcab_sign(uint16_t key_id, const uint8_t* msg, uint8_t* signature);
 ATCA_STATUS atcab_sign_ext(ATCADevice device, uint16_t key_id, const uint8_t* msg, uint8_t* signature);
+ATCA_STATUS atcab_sign_batch(uint16_t key_id, const uint8_t* msgs, size_t count, uint8_t* signatures);
+ATCA_STATUS atcab_sign_batch_ext(ATCADevice device, uint16_t key_id, const uint8_t* msgs, size_t count, uint8_t* signatures);
 ATCA_STATUS atcab_sign_internal(uint16_t key_id, bool is_invalidate, bool is_full_sn, uint8_t* signature);
 
 /* UpdateExtra command */
@@ -734,4 +734,41 @@
 #define ATCAC_SIGN_EN                       ATCA_HOSTLIB_EN
 #endif
 
+/** \def ATCA_JWT_KEY_ID_SIZE
+ *
+ * Size of the identifier used to look up public keys in the JWT verification
+ * key cache. Defaults to the device serial number size.
+ *
+ * Supported API's: atca_jwt_verify_batch
+ **/
+#ifndef ATCA_JWT_KEY_ID_SIZE
+#define ATCA_JWT_KEY_ID_SIZE                (9)
+#endif
+
+/** \def ATCA_JWT_VERIFY_THREADS_EN
+ *
+ * Requires: ATCAC_VERIFY_EN
+ *
+ * Enable ATCA_JWT_VERIFY_THREADS_EN to spread batch JWT verification across a
+ * pool of posix threads. When disabled the batch is verified on the calling
+ * thread.
+ *
+ * Supported API's: atca_jwt_verify_batch
+ **/
+#ifndef ATCA_JWT_VERIFY_THREADS_EN
+#if defined(__linux__) || defined(__APPLE__)
+#define ATCA_JWT_VERIFY_THREADS_EN          ATCAC_VERIFY_EN
+#else
+#define ATCA_JWT_VERIFY_THREADS_EN          DEFAULT_DISABLED
+#endif
+#endif
+
+/** \def ATCA_JWT_VERIFY_MAX_WORKERS
+ *
+ * Upper bound on the number of worker threads atca_jwt_verify_batch will start
+ **/
+#ifndef ATCA_JWT_VERIFY_MAX_WORKERS
+#define ATCA_JWT_VERIFY_MAX_WORKERS         (8)
+#endif
+
 #endif /* ATCA_CONFIG_CHECK_H */
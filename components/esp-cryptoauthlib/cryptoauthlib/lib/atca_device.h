@@ -141,6 +141,15 @@ typedef enum
 } ATCADeviceState;
 
 
+/* Shadow copies of the configuration and OTP zones (see calib_config_shadow.c) */
+#define ATCA_SHADOW_CONFIG_SIZE     (128)
+#define ATCA_SHADOW_OTP_SIZE        (64)
+
+#define ATCA_SHADOW_CONFIG          (0x01u)     /**< config_shadow is valid */
+#define ATCA_SHADOW_OTP             (0x02u)     /**< otp_shadow is valid */
+#define ATCA_SHADOW_UNLOCKED        (0x04u)     /**< Configuration zone found unlocked, read the device */
+#define ATCA_SHADOW_FILLING         (0x08u)     /**< Shadow is being read from the device */
+
 /** \brief atca_device is the C object backing ATCADevice.  See the atca_device.h file for
  * details on the ATCADevice methods
  */
@@ -160,6 +169,12 @@ struct atca_device
 
     uint16_t options;                   /**< Nested command details parameter */
 
+    uint8_t  hold_awake;                /**< Skip the post-command idle (batched operations) */
+
+    uint8_t  shadow_state;                              /**< ATCA_SHADOW_* validity flags */
+    uint8_t  config_shadow[ATCA_SHADOW_CONFIG_SIZE];    /**< Copy of the locked configuration zone */
+    uint8_t  otp_shadow[ATCA_SHADOW_OTP_SIZE];          /**< Copy of the OTP zone once the data zone is locked */
+
 };
 
 typedef struct atca_device * ATCADevice;
@@ -120,6 +120,7 @@ int atcacert_read_cert(const atcacert_def_t* cert_def,
 {
     int ret = 0;
     atcacert_device_loc_t device_locs[16];
+    const atcacert_device_loc_t* read_locs = device_locs;
     size_t device_locs_count = 0;
     size_t i = 0;
     atcacert_build_state_t build_state;
@@ -134,15 +135,24 @@ int atcacert_read_cert(const atcacert_def_t* cert_def,
         return atcacert_read_cert_size(cert_def, cert_size);
     }
 
-    ret = atcacert_get_device_locs(
-        cert_def,
-        device_locs,
-        &device_locs_count,
-        sizeof(device_locs) / sizeof(device_locs[0]),
-        ATCA_BLOCK_SIZE);
-    if (ret != ATCACERT_E_SUCCESS)
+    if (cert_def->compiled != NULL)
     {
-        return ret;
+        // Generated definitions come with their device locations already merged
+        read_locs = cert_def->compiled->device_locs;
+        device_locs_count = cert_def->compiled->device_locs_count;
+    }
+    else
+    {
+        ret = atcacert_get_device_locs(
+            cert_def,
+            device_locs,
+            &device_locs_count,
+            sizeof(device_locs) / sizeof(device_locs[0]),
+            ATCA_BLOCK_SIZE);
+        if (ret != ATCACERT_E_SUCCESS)
+        {
+            return ret;
+        }
     }
 
     ret = atcacert_cert_build_start(&build_state, cert_def, cert, cert_size, ca_public_key);
@@ -154,13 +164,20 @@ int atcacert_read_cert(const atcacert_def_t* cert_def,
     for (i = 0; i < device_locs_count; i++)
     {
         static uint8_t data[416];
-        ret = atcacert_read_device_loc(&device_locs[i], data);
+        ret = atcacert_read_device_loc(&read_locs[i], data);
         if (ret != ATCACERT_E_SUCCESS)
         {
             return ret;
         }
 
-        ret = atcacert_cert_build_process(&build_state, &device_locs[i], data);
+        if (cert_def->compiled != NULL)
+        {
+            ret = cert_def->compiled->build_process(&build_state, i, data);
+        }
+        else
+        {
+            ret = atcacert_cert_build_process(&build_state, &read_locs[i], data);
+        }
         if (ret != ATCACERT_E_SUCCESS)
         {
             return ret;
@@ -170,6 +170,25 @@ typedef struct ATCA_PACKED atcacert_cert_element_s
 #pragma pack(pop)
 #endif
 
+struct atcacert_build_state_s;
+
+/**
+ * Routines generated by cert2certdef.py for one certificate definition. The
+ * offsets and sizes of the definition are fixed in the generated code, which
+ * atcacert_read_cert() calls instead of interpreting the definition.
+ *
+ * The element getters (atcacert_get_subj_public_key() and the like) are not
+ * generated. Each works on a single element found through one std_cert_elements
+ * lookup, so a specialised version would only save that lookup.
+ */
+typedef struct atcacert_compiled_def_s
+{
+    const atcacert_device_loc_t* device_locs;                               //!< Device locations to read, as atcacert_get_device_locs() returns them for ATCA_BLOCK_SIZE.
+    size_t                       device_locs_count;                         //!< Number of device locations in device_locs.
+    int (*build_process)(struct atcacert_build_state_s* build_state,
+                         size_t index, const uint8_t* device_data);         //!< Incorporates the data read from device_locs[index], like atcacert_cert_build_process().
+} atcacert_compiled_def_t;
+
 /**
  * Defines a certificate and all the pieces to work with it.
  *
@@ -196,6 +215,7 @@ typedef struct atcacert_def_s
     const uint8_t*                 cert_template;                           //!< Pointer to the actual certificate template data.
     uint16_t                       cert_template_size;                      //!< Size of the certificate template in cert_template in bytes.
     const struct atcacert_def_s*   ca_cert_def;                             //!< Certificate definition of the CA certificate
+    const atcacert_compiled_def_t* compiled;                                //!< Routines generated for this definition. NULL when the definition is interpreted.
 } atcacert_def_t;
 
 /**
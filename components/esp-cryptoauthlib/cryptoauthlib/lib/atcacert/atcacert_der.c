@@ -557,4 +557,237 @@ int atcacert_der_dec_ecdsa_sig_value(const uint8_t* der_sig,
     return ATCACERT_E_SUCCESS;
 }
 
+void atcacert_der_cursor_init(atcacert_der_cursor_t* cursor, const uint8_t* der, size_t der_size)
+{
+    if (cursor != NULL)
+    {
+        cursor->ptr = der;
+        cursor->end = (der != NULL) ? &der[der_size] : NULL;
+    }
+}
+
+int atcacert_der_cursor_next(atcacert_der_cursor_t* cursor, atcacert_der_tlv_t* tlv)
+{
+    int ret = 0;
+    size_t remaining;
+    size_t length_size;
+    uint32_t length = 0;
+
+    if (cursor == NULL || tlv == NULL)
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+
+    if (cursor->ptr == NULL || cursor->ptr >= cursor->end)
+    {
+        return ATCACERT_E_ELEM_MISSING;  // No elements left
+    }
+    remaining = (size_t)(cursor->end - cursor->ptr);
+
+    if ((cursor->ptr[0] & 0x1F) == 0x1F)
+    {
+        return ATCACERT_E_DECODING_ERROR;  // Multi-byte tags aren't used in certificates
+    }
+
+    length_size = remaining - 1;
+    ret = atcacert_der_dec_length(&cursor->ptr[1], &length_size, &length);
+    if (ret != ATCACERT_E_SUCCESS)
+    {
+        return ret;
+    }
+    if (length > remaining - 1 - length_size)
+    {
+        return ATCACERT_E_DECODING_ERROR;  // Value runs past the end of the data
+    }
+
+    tlv->tag = cursor->ptr[0];
+    tlv->tlv = cursor->ptr;
+    tlv->value = &cursor->ptr[1 + length_size];
+    tlv->value_size = length;
+    tlv->tlv_size = 1 + length_size + length;
+
+    cursor->ptr += tlv->tlv_size;
+
+    return ATCACERT_E_SUCCESS;
+}
+
+int atcacert_der_cursor_expect(atcacert_der_cursor_t* cursor, uint8_t tag, atcacert_der_tlv_t* tlv)
+{
+    if (cursor == NULL || tlv == NULL)
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+
+    if (cursor->ptr == NULL || cursor->ptr >= cursor->end || cursor->ptr[0] != tag)
+    {
+        return ATCACERT_E_ELEM_MISSING;
+    }
+
+    return atcacert_der_cursor_next(cursor, tlv);
+}
+
+void atcacert_der_cursor_enter(atcacert_der_cursor_t* cursor, const atcacert_der_tlv_t* tlv)
+{
+    if (cursor != NULL && tlv != NULL)
+    {
+        atcacert_der_cursor_init(cursor, tlv->value, tlv->value_size);
+    }
+}
+
+int atcacert_der_parse_x509(const uint8_t* cert, size_t cert_size, atcacert_der_x509_t* x509)
+{
+    int ret = 0;
+    atcacert_der_cursor_t cursor;
+    atcacert_der_cursor_t tbs;
+    atcacert_der_cursor_t validity;
+    atcacert_der_tlv_t tlv;
+
+    if (cert == NULL || x509 == NULL)
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+
+    memset(x509, 0, sizeof(*x509));
+
+    // Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signatureValue }
+    atcacert_der_cursor_init(&cursor, cert, cert_size);
+    if (ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_SEQUENCE, &tlv)))
+    {
+        return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+    }
+    atcacert_der_cursor_enter(&cursor, &tlv);
+
+    if (ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_SEQUENCE, &x509->tbs))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_SEQUENCE, &tlv))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_BIT_STRING, &x509->signature)))
+    {
+        return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+    }
+
+    // TBSCertificate, the version is optional
+    atcacert_der_cursor_enter(&tbs, &x509->tbs);
+    ret = atcacert_der_cursor_expect(&tbs, ATCACERT_DER_TAG_CONTEXT(0), &tlv);
+    if (ret != ATCACERT_E_SUCCESS && ret != ATCACERT_E_ELEM_MISSING)
+    {
+        return ret;
+    }
+
+    if (ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&tbs, ATCACERT_DER_TAG_INTEGER, &x509->serial_number))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&tbs, ATCACERT_DER_TAG_SEQUENCE, &tlv))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&tbs, ATCACERT_DER_TAG_SEQUENCE, &x509->issuer))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&tbs, ATCACERT_DER_TAG_SEQUENCE, &tlv))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&tbs, ATCACERT_DER_TAG_SEQUENCE, &x509->subject))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_expect(&tbs, ATCACERT_DER_TAG_SEQUENCE, &x509->public_key_info)))
+    {
+        return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+    }
+
+    // Validity ::= SEQUENCE { notBefore Time, notAfter Time }
+    atcacert_der_cursor_enter(&validity, &tlv);
+    if (ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_next(&validity, &x509->not_before))
+        || ATCACERT_E_SUCCESS != (ret = atcacert_der_cursor_next(&validity, &x509->not_after)))
+    {
+        return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+    }
+
+    // Skip the optional unique IDs to the extensions
+    while (ATCACERT_E_SUCCESS == (ret = atcacert_der_cursor_next(&tbs, &tlv)))
+    {
+        if (tlv.tag == ATCACERT_DER_TAG_CONTEXT(3))
+        {
+            atcacert_der_cursor_enter(&cursor, &tlv);
+            ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_SEQUENCE, &x509->extensions);
+            return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+        }
+    }
+
+    return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_SUCCESS : ret;
+}
+
+int atcacert_der_x509_get_extension(const atcacert_der_x509_t* x509, const uint8_t* oid, size_t oid_size,
+                                    atcacert_der_tlv_t* ext_value)
+{
+    int ret = 0;
+    atcacert_der_cursor_t extensions;
+    atcacert_der_cursor_t extension;
+    atcacert_der_tlv_t tlv;
+    atcacert_der_tlv_t ext_oid;
+
+    if (x509 == NULL || oid == NULL || ext_value == NULL)
+    {
+        return ATCACERT_E_BAD_PARAMS;
+    }
+
+    // Extension ::= SEQUENCE { extnID OID, critical BOOLEAN DEFAULT FALSE, extnValue OCTET STRING }
+    atcacert_der_cursor_enter(&extensions, &x509->extensions);
+    while (ATCACERT_E_SUCCESS == (ret = atcacert_der_cursor_expect(&extensions, ATCACERT_DER_TAG_SEQUENCE, &tlv)))
+    {
+        atcacert_der_cursor_enter(&extension, &tlv);
+        ret = atcacert_der_cursor_expect(&extension, ATCACERT_DER_TAG_OID, &ext_oid);
+        if (ret != ATCACERT_E_SUCCESS)
+        {
+            return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+        }
+
+        if (ext_oid.value_size == oid_size && !memcmp(ext_oid.value, oid, oid_size))
+        {
+            ret = atcacert_der_cursor_expect(&extension, ATCACERT_DER_TAG_BOOLEAN, &tlv);
+            if (ret != ATCACERT_E_SUCCESS && ret != ATCACERT_E_ELEM_MISSING)
+            {
+                return ret;
+            }
+            ret = atcacert_der_cursor_expect(&extension, ATCACERT_DER_TAG_OCTET_STRING, ext_value);
+            return (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+        }
+    }
+
+    // Any other tag at this level is malformed
+    return (ret == ATCACERT_E_ELEM_MISSING && extensions.ptr < extensions.end) ? ATCACERT_E_DECODING_ERROR : ret;
+}
+
+int atcacert_der_x509_get_subj_key_id(const atcacert_der_x509_t* x509, atcacert_der_tlv_t* key_id)
+{
+    static const uint8_t oid_subj_key_id[] = { 0x55, 0x1D, 0x0E };   // 2.5.29.14
+    int ret = 0;
+    atcacert_der_tlv_t ext_value;
+    atcacert_der_cursor_t cursor;
+
+    // SubjectKeyIdentifier ::= KeyIdentifier (OCTET STRING)
+    ret = atcacert_der_x509_get_extension(x509, oid_subj_key_id, sizeof(oid_subj_key_id), &ext_value);
+    if (ret == ATCACERT_E_SUCCESS)
+    {
+        atcacert_der_cursor_enter(&cursor, &ext_value);
+        ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_OCTET_STRING, key_id);
+        ret = (ret == ATCACERT_E_ELEM_MISSING) ? ATCACERT_E_DECODING_ERROR : ret;
+    }
+    return ret;
+}
+
+int atcacert_der_x509_get_auth_key_id(const atcacert_der_x509_t* x509, atcacert_der_tlv_t* key_id)
+{
+    static const uint8_t oid_auth_key_id[] = { 0x55, 0x1D, 0x23 };   // 2.5.29.35
+    int ret = 0;
+    atcacert_der_tlv_t ext_value;
+    atcacert_der_tlv_t tlv;
+    atcacert_der_cursor_t cursor;
+
+    // AuthorityKeyIdentifier ::= SEQUENCE { keyIdentifier [0] IMPLICIT KeyIdentifier OPTIONAL, ... }
+    ret = atcacert_der_x509_get_extension(x509, oid_auth_key_id, sizeof(oid_auth_key_id), &ext_value);
+    if (ret == ATCACERT_E_SUCCESS)
+    {
+        atcacert_der_cursor_enter(&cursor, &ext_value);
+        ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_SEQUENCE, &tlv);
+        if (ret == ATCACERT_E_SUCCESS)
+        {
+            atcacert_der_cursor_enter(&cursor, &tlv);
+            ret = atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_IMPLICIT(0), key_id);
+        }
+        else if (ret == ATCACERT_E_ELEM_MISSING)
+        {
+            ret = ATCACERT_E_DECODING_ERROR;
+        }
+    }
+    return ret;
+}
+
 #endif
\ No newline at end of file
@@ -38,6 +38,57 @@
 extern "C" {
 #endif
 
+/** \brief DER tags used when walking X.509 certificates */
+#define ATCACERT_DER_TAG_BOOLEAN        ((uint8_t)0x01)
+#define ATCACERT_DER_TAG_INTEGER        ((uint8_t)0x02)
+#define ATCACERT_DER_TAG_BIT_STRING     ((uint8_t)0x03)
+#define ATCACERT_DER_TAG_OCTET_STRING   ((uint8_t)0x04)
+#define ATCACERT_DER_TAG_OID            ((uint8_t)0x06)
+#define ATCACERT_DER_TAG_UTC_TIME       ((uint8_t)0x17)
+#define ATCACERT_DER_TAG_GENERALIZED    ((uint8_t)0x18)
+#define ATCACERT_DER_TAG_SEQUENCE       ((uint8_t)0x30)
+#define ATCACERT_DER_TAG_SET            ((uint8_t)0x31)
+#define ATCACERT_DER_TAG_CONTEXT(n)     ((uint8_t)(0xA0 | (n)))    //!< Constructed context specific tag [n]
+#define ATCACERT_DER_TAG_IMPLICIT(n)    ((uint8_t)(0x80 | (n)))    //!< Primitive context specific tag [n]
+
+/** \brief Position in a DER encoding. Walks the elements at one level of
+ *         nesting without copying or allocating; atcacert_der_cursor_enter()
+ *         descends into a constructed element.
+ */
+typedef struct atcacert_der_cursor_s
+{
+    const uint8_t* ptr;         //!< Next element
+    const uint8_t* end;         //!< End of the elements at this level
+} atcacert_der_cursor_t;
+
+/** \brief One DER element (tag, length and value), as pointers into the
+ *         buffer the cursor walks.
+ */
+typedef struct atcacert_der_tlv_s
+{
+    uint8_t        tag;         //!< Tag byte (single byte tags only)
+    const uint8_t* tlv;         //!< Start of the element, at the tag
+    size_t         tlv_size;    //!< Size of the whole element encoding
+    const uint8_t* value;       //!< Start of the value
+    size_t         value_size;  //!< Size of the value
+} atcacert_der_tlv_t;
+
+/** \brief Fields of an X.509 certificate (RFC 5280), as elements of the
+ *         certificate buffer. Optional fields that are absent have a NULL tlv.
+ */
+typedef struct atcacert_der_x509_s
+{
+    atcacert_der_tlv_t tbs;             //!< TBSCertificate, the signed data
+    atcacert_der_tlv_t serial_number;   //!< CertificateSerialNumber INTEGER
+    atcacert_der_tlv_t issuer;          //!< Issuer Name
+    atcacert_der_tlv_t not_before;      //!< Validity notBefore time
+    atcacert_der_tlv_t not_after;       //!< Validity notAfter time
+    atcacert_der_tlv_t subject;         //!< Subject Name
+    atcacert_der_tlv_t public_key_info; //!< SubjectPublicKeyInfo
+    atcacert_der_tlv_t extensions;      //!< Extensions SEQUENCE (inside the [3] tag)
+    atcacert_der_tlv_t signature;       //!< signatureValue BIT STRING
+} atcacert_der_x509_t;
+
 /** \defgroup atcacert_ Certificate manipulation methods (atcacert_)
  *
  * \brief
@@ -157,6 +208,94 @@ int atcacert_der_dec_ecdsa_sig_value(const uint8_t * der_sig,
                                      size_t *        der_sig_size,
                                      uint8_t         raw_sig[64]);
 
+/**
+ * \brief Start walking the DER elements of a buffer.
+ *
+ * \param[out] cursor    Cursor to initialize.
+ * \param[in]  der       DER encoded elements. Must stay valid while the cursor
+ *                       and the elements returned from it are used.
+ * \param[in]  der_size  Size of der in bytes.
+ */
+void atcacert_der_cursor_init(atcacert_der_cursor_t* cursor, const uint8_t* der, size_t der_size);
+
+/**
+ * \brief Decode the next element of a cursor and move past it.
+ *
+ * \param[in,out] cursor  Cursor to read from.
+ * \param[out]    tlv     Element found, pointing into the cursor buffer.
+ *
+ * \return ATCACERT_E_SUCCESS on success, ATCACERT_E_ELEM_MISSING when there are
+ *         no elements left, otherwise an error code.
+ */
+int atcacert_der_cursor_next(atcacert_der_cursor_t* cursor, atcacert_der_tlv_t* tlv);
+
+/**
+ * \brief Decode the next element of a cursor, which must have the given tag.
+ *
+ * \param[in,out] cursor  Cursor to read from. Not moved when the tag differs.
+ * \param[in]     tag     Expected tag.
+ * \param[out]    tlv     Element found, pointing into the cursor buffer.
+ *
+ * \return ATCACERT_E_SUCCESS on success, ATCACERT_E_ELEM_MISSING when the next
+ *         element has an other tag or there is none, otherwise an error code.
+ */
+int atcacert_der_cursor_expect(atcacert_der_cursor_t* cursor, uint8_t tag, atcacert_der_tlv_t* tlv);
+
+/**
+ * \brief Start walking the elements inside a constructed element.
+ *
+ * \param[out] cursor  Cursor over the contents of tlv.
+ * \param[in]  tlv     Constructed element (SEQUENCE, SET, [n]...) or an OCTET
+ *                     STRING wrapping DER, as in extension values.
+ */
+void atcacert_der_cursor_enter(atcacert_der_cursor_t* cursor, const atcacert_der_tlv_t* tlv);
+
+/**
+ * \brief Locate the fields of a DER encoded X.509 certificate in place.
+ *
+ * \param[in]  cert       DER encoded X.509 certificate.
+ * \param[in]  cert_size  Size of cert in bytes.
+ * \param[out] x509       Fields of the certificate, pointing into cert.
+ *
+ * \return ATCACERT_E_SUCCESS on success, otherwise an error code.
+ */
+int atcacert_der_parse_x509(const uint8_t* cert, size_t cert_size, atcacert_der_x509_t* x509);
+
+/**
+ * \brief Find an extension of a parsed X.509 certificate.
+ *
+ * \param[in]  x509      Parsed certificate.
+ * \param[in]  oid       Value of the extension OID (without tag and length).
+ * \param[in]  oid_size  Size of oid in bytes.
+ * \param[out] ext_value extnValue OCTET STRING of the extension.
+ *
+ * \return ATCACERT_E_SUCCESS on success, ATCACERT_E_ELEM_MISSING when the
+ *         certificate has no such extension, otherwise an error code.
+ */
+int atcacert_der_x509_get_extension(const atcacert_der_x509_t* x509, const uint8_t* oid, size_t oid_size,
+                                    atcacert_der_tlv_t* ext_value);
+
+/**
+ * \brief Get the subject key identifier extension of a parsed X.509 certificate.
+ *
+ * \param[in]  x509    Parsed certificate.
+ * \param[out] key_id  Key identifier OCTET STRING.
+ *
+ * \return ATCACERT_E_SUCCESS on success, otherwise an error code.
+ */
+int atcacert_der_x509_get_subj_key_id(const atcacert_der_x509_t* x509, atcacert_der_tlv_t* key_id);
+
+/**
+ * \brief Get the keyIdentifier of the authority key identifier extension of a
+ *        parsed X.509 certificate.
+ *
+ * \param[in]  x509    Parsed certificate.
+ * \param[out] key_id  keyIdentifier [0] element.
+ *
+ * \return ATCACERT_E_SUCCESS on success, otherwise an error code.
+ */
+int atcacert_der_x509_get_auth_key_id(const atcacert_der_x509_t* x509, atcacert_der_tlv_t* key_id);
+
 /** @} */
 #ifdef __cplusplus
 }
@@ -39,6 +39,11 @@ ATCA_STATUS calib_is_locked_ext(ATCADevice device, uint8_t zone, bool* is_locked
 ATCA_STATUS calib_is_private(ATCADevice device, uint16_t slot, bool* is_private);
 #endif
 
+#if CALIB_CONFIG_SHADOW_EN
+ATCA_STATUS calib_config_shadow_read(ATCADevice device, uint8_t zone, uint8_t block, uint8_t offset, uint8_t* data, uint8_t len);
+void calib_config_shadow_invalidate(ATCADevice device);
+#endif
+
 #if ATCA_CA2_SUPPORT
 ATCADeviceType calib_get_devicetype_with_device_id(uint8_t device_id,uint8_t device_revision);
 #endif
@@ -184,6 +189,7 @@ ATCA_STATUS calib_priv_write(ATCADevice device, uint16_t key_id, const uint8_t p
 // Random command functions
 #if CALIB_RANDOM_EN
 ATCA_STATUS calib_random(ATCADevice device, uint8_t* rand_out);
+ATCA_STATUS calib_random_batch(ATCADevice device, uint8_t* rand_out, size_t blocks);
 #endif
 
 // Read command functions
@@ -274,6 +280,7 @@ ATCA_STATUS calib_sign(ATCADevice device, uint16_t key_id, const uint8_t *msg, u
 #endif
 #if CALIB_SIGN_EN || CALIB_SIGN_CA2_EN
 ATCA_STATUS calib_sign_ext(ATCADevice device, uint16_t key_id, const uint8_t *msg, uint8_t *signature);
+ATCA_STATUS calib_sign_batch(ATCADevice device, uint16_t key_id, const uint8_t *msgs, size_t count, uint8_t *signatures);
 #endif
 #if CALIB_SIGN_INTERNAL_EN
 ATCA_STATUS calib_sign_internal(ATCADevice device, uint16_t key_id, bool is_invalidate, bool is_full_sn, uint8_t *signature);
@@ -462,6 +469,8 @@ ATCA_STATUS calib_ca2_write_enc(ATCADevice device, uint16_t slot, uint8_t* data,
 // Random command functions
 #define atcab_random(...)                       calib_random(_gDevice, __VA_ARGS__)
 #define atcab_random_ext                        calib_random
+#define atcab_random_batch(...)                 calib_random_batch(_gDevice, __VA_ARGS__)
+#define atcab_random_batch_ext                  calib_random_batch
 
 // Read command functions
 #define atcab_is_slot_locked(...)               calib_is_slot_locked(_gDevice, __VA_ARGS__)
@@ -530,6 +539,8 @@ ATCA_STATUS calib_ca2_write_enc(ATCADevice device, uint16_t slot, uint8_t* data,
 #define atcab_sign(...)                         calib_sign_ext(_gDevice, __VA_ARGS__)
 #define atcab_sign_ext                          calib_sign_ext
 #endif
+#define atcab_sign_batch(...)                   calib_sign_batch(_gDevice, __VA_ARGS__)
+#define atcab_sign_batch_ext                    calib_sign_batch
 
 #define atcab_sign_internal(...)                calib_sign_internal(_gDevice, __VA_ARGS__)
 
@@ -386,6 +386,20 @@
 #define CALIB_READ_EN                 (ATCAB_READ_EN && (CALIB_FULL_FEATURE || CALIB_SHA206_EN))
 #endif
 
+/** \def CALIB_CONFIG_SHADOW_EN
+  * 
+  * Enable CALIB_CONFIG_SHADOW_EN to answer reads of a locked configuration zone
+  * (and of the OTP zone once the data zone is locked) from a copy kept in the
+  * device context
+  * 
+  * Supported API's: calib_read_zone, calib_is_locked, calib_is_slot_locked,
+  *                  calib_is_private, calib_read_serial_number
+  * 
+ **/
+#ifndef CALIB_CONFIG_SHADOW_EN
+#define CALIB_CONFIG_SHADOW_EN        (CALIB_READ_EN && (CALIB_ECC108_EN || CALIB_ECC508_EN || CALIB_ECC608_EN))
+#endif
+
 /** \def CALIB_READ_ZONE
   * 
   * Enable CALIB_READ_ZONE which reads either 4 or 32 bytes of data from a given slot, 
@@ -529,6 +543,20 @@
 #define CALIB_SIGN_CA2_EN          (ATCAB_SIGN_EN && (CALIB_ECC204_EN || CALIB_TA010_EN))
 #endif
 
+/** \def CALIB_SIGN_BATCH_WAKE_BUDGET_MSEC
+  *
+  * Time in milliseconds a batched sign or random operation may keep the
+  * device awake before it issues an idle to reset the watchdog. Must stay
+  * below the minimum watchdog timeout of the device (0.7s for the default
+  * setting)
+  *
+  * Supported API's: calib_sign_batch, calib_random_batch
+  *
+**/
+#ifndef CALIB_SIGN_BATCH_WAKE_BUDGET_MSEC
+#define CALIB_SIGN_BATCH_WAKE_BUDGET_MSEC   (600)
+#endif
+
 /** \def CALIB_SIGN_MODE_ENCODING
   * 
   * Requires: CALIB_RANDOM
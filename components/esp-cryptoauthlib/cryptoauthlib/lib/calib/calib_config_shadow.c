@@ -0,0 +1,205 @@
+/**
+ * \file
+ * \brief CryptoAuthLib Basic API - Shadow copy of the configuration and OTP
+ *        zones kept in the device context.
+ *
+ * Once the configuration zone is locked its contents can only change through
+ * the Lock and UpdateExtra commands, so the helpers that query lock state,
+ * slot and key configuration, the serial number or ChipMode can be answered
+ * from memory instead of waking the device for every 4 byte read. The OTP zone
+ * is shadowed the same way once the data zone is locked.
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+#include "cryptoauthlib.h"
+
+#if CALIB_CONFIG_SHADOW_EN
+
+/* Configuration bytes that change without a Write, Lock or UpdateExtra command
+   (monotonic counters and LastKeyUse) are always read from the device */
+#define CALIB_SHADOW_VOLATILE_START     (52u)
+#define CALIB_SHADOW_VOLATILE_END       (84u)
+
+/* LockValue and LockConfig bytes within the configuration zone */
+#define CALIB_SHADOW_LOCK_VALUE         (86u)
+#define CALIB_SHADOW_LOCK_CONFIG        (87u)
+
+/** \brief Check if the device keeps the classic 128 byte configuration zone
+ *         layout the shadow is built for.
+ */
+static bool calib_config_shadow_supported(ATCADevice device)
+{
+    ATCADeviceType device_type = atcab_get_device_type_ext(device);
+
+    return (ATECC108A == device_type) || (ATECC508A == device_type) || (ATECC608 == device_type);
+}
+
+/** \brief Read a whole zone from the device into a shadow buffer, 32 bytes
+ *         at a time.
+ */
+static ATCA_STATUS calib_config_shadow_fill(ATCADevice device, uint8_t zone, uint8_t* shadow, size_t size)
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+    uint8_t block;
+
+    device->shadow_state |= ATCA_SHADOW_FILLING;
+    for (block = 0; (block * ATCA_BLOCK_SIZE) < size; block++)
+    {
+        if ((status = calib_read_zone(device, zone, 0, block, 0, &shadow[block * ATCA_BLOCK_SIZE], ATCA_BLOCK_SIZE)) != ATCA_SUCCESS)
+        {
+            ATCA_TRACE(status, "calib_read_zone - failed");
+            break;
+        }
+    }
+    device->shadow_state &= (uint8_t)~ATCA_SHADOW_FILLING;
+
+    return status;
+}
+
+/** \brief Bring the configuration shadow up to date, reading the zone from
+ *         the device on first use.
+ *
+ *  \return ATCA_SUCCESS when config_shadow holds the locked configuration
+ *          zone, otherwise the read has to go to the device.
+ */
+static ATCA_STATUS calib_config_shadow_load(ATCADevice device)
+{
+    ATCA_STATUS status;
+
+    if (device->shadow_state & ATCA_SHADOW_CONFIG)
+    {
+        return ATCA_SUCCESS;
+    }
+    if (device->shadow_state & ATCA_SHADOW_UNLOCKED)
+    {
+        return ATCA_NOT_LOCKED;
+    }
+
+    if ((status = calib_config_shadow_fill(device, ATCA_ZONE_CONFIG, device->config_shadow, ATCA_ECC_CONFIG_SIZE)) != ATCA_SUCCESS)
+    {
+        return status;
+    }
+
+    /* An unlocked configuration zone can still be written, remember that
+       until the next Lock so provisioning flows do not pay for refills */
+    if (0x55 == device->config_shadow[CALIB_SHADOW_LOCK_CONFIG])
+    {
+        device->shadow_state |= ATCA_SHADOW_UNLOCKED;
+        return ATCA_NOT_LOCKED;
+    }
+
+    device->shadow_state |= ATCA_SHADOW_CONFIG;
+    return ATCA_SUCCESS;
+}
+
+/** \brief Serve a Read command for the configuration or OTP zone from the
+ *         shadow copy held in the device context.
+ *
+ * Called by calib_read_zone before a command is built. The first call reads
+ * the whole configuration zone (and the OTP zone once the data zone is
+ * locked) so later lock, slot configuration, serial number and ChipMode
+ * queries complete without any bus traffic.
+ *
+ *  \param[in]  device   Device context pointer
+ *  \param[in]  zone     ATCA_ZONE_CONFIG or ATCA_ZONE_OTP, other zones are
+ *                       never shadowed.
+ *  \param[in]  block    32 byte block index within the zone.
+ *  \param[in]  offset   4 byte word index within the block. Ignored for 32
+ *                       byte reads.
+ *  \param[out] data     Read data is returned here.
+ *  \param[in]  len      Length of the data to be read. Must be either 4 or 32.
+ *
+ *  \return ATCA_SUCCESS if data was served from the shadow, otherwise the read
+ *          has to be sent to the device.
+ */
+ATCA_STATUS calib_config_shadow_read(ATCADevice device, uint8_t zone, uint8_t block, uint8_t offset, uint8_t* data, uint8_t len)
+{
+    ATCA_STATUS status;
+    size_t start = (size_t)block * ATCA_BLOCK_SIZE + ((ATCA_BLOCK_SIZE == len) ? 0u : (size_t)offset * ATCA_WORD_SIZE);
+
+    if ((device->shadow_state & ATCA_SHADOW_FILLING) || !calib_config_shadow_supported(device))
+    {
+        return ATCA_UNIMPLEMENTED;
+    }
+
+    if (ATCA_ZONE_CONFIG == zone)
+    {
+        if ((start + len > ATCA_ECC_CONFIG_SIZE)
+            || ((start < CALIB_SHADOW_VOLATILE_END) && (start + len > CALIB_SHADOW_VOLATILE_START)))
+        {
+            return ATCA_UNIMPLEMENTED;
+        }
+        if ((status = calib_config_shadow_load(device)) != ATCA_SUCCESS)
+        {
+            return status;
+        }
+        memcpy(data, &device->config_shadow[start], len);
+        return ATCA_SUCCESS;
+    }
+
+    if (ATCA_ZONE_OTP == zone)
+    {
+        if (start + len > ATCA_OTP_SIZE)
+        {
+            return ATCA_UNIMPLEMENTED;
+        }
+        if (!(device->shadow_state & ATCA_SHADOW_OTP))
+        {
+            /* OTP is only readable, and read-only, once the data zone is locked */
+            if ((status = calib_config_shadow_load(device)) != ATCA_SUCCESS)
+            {
+                return status;
+            }
+            if (0x55 == device->config_shadow[CALIB_SHADOW_LOCK_VALUE])
+            {
+                return ATCA_NOT_LOCKED;
+            }
+            if ((status = calib_config_shadow_fill(device, ATCA_ZONE_OTP, device->otp_shadow, ATCA_OTP_SIZE)) != ATCA_SUCCESS)
+            {
+                return status;
+            }
+            device->shadow_state |= ATCA_SHADOW_OTP;
+        }
+        memcpy(data, &device->otp_shadow[start], len);
+        return ATCA_SUCCESS;
+    }
+
+    return ATCA_UNIMPLEMENTED;
+}
+
+/** \brief Drop the shadow copies so the next configuration or OTP read goes
+ *         to the device. Called ahead of every command that can change them
+ *         (Write to the config or OTP zone, Lock, UpdateExtra).
+ *
+ *  \param[in]  device   Device context pointer
+ */
+void calib_config_shadow_invalidate(ATCADevice device)
+{
+    if (device)
+    {
+        device->shadow_state &= ATCA_SHADOW_FILLING;
+    }
+}
+
+#endif /* CALIB_CONFIG_SHADOW_EN */
@@ -38,8 +38,14 @@
 #warning "ATECC608B supports only polling mode, if you are using an ATECC608A specify ATCA_ATECC608A_SUPPORT manually"
 #endif
 
+/* The batched sign and random commands size their wake windows from the
+   execution times, so the tables are also kept for polling builds */
+#if defined(ATCA_NO_POLL) || CALIB_SIGN_EN || CALIB_RANDOM_EN
+#define CALIB_EXECUTION_TIME_TABLES
+#endif
 
-#ifdef ATCA_NO_POLL
+
+#ifdef CALIB_EXECUTION_TIME_TABLES
 // *INDENT-OFF* - Preserve time formatting from the code formatter
 /*Execution times for ATSHA204A supported commands...*/
 static const device_execution_time_t device_execution_time_204[] = {
@@ -240,7 +246,7 @@ ATCA_STATUS calib_get_execution_time(uint8_t opcode, ATCADevice device)
 
     switch (device->mIface.mIfaceCFG->devtype)
     {
-#ifdef ATCA_NO_POLL
+#ifdef CALIB_EXECUTION_TIME_TABLES
     case ATSHA204A:
         execution_times = device_execution_time_204;
         no_of_commands = sizeof(device_execution_time_204) / sizeof(device_execution_time_t);
@@ -320,6 +326,28 @@ ATCA_STATUS calib_get_execution_time(uint8_t opcode, ATCADevice device)
     return status;
 }
 
+/** \brief Worst case execution time of a command on the device, for callers
+ *         that fit several commands into one wake window
+ *
+ *  \param[in] device  Device context pointer
+ *  \param[in] opcode  Opcode value of the command
+ *  \return Execution time in milliseconds, ATCA_POLLING_MAX_TIME_MSEC if the
+ *          command is not listed for the device
+ */
+uint16_t calib_get_max_execution_time(ATCADevice device, uint8_t opcode)
+{
+    uint16_t saved = device->execution_time_msec;
+    uint16_t execution_time_msec = ATCA_POLLING_MAX_TIME_MSEC;
+
+    if (ATCA_SUCCESS == calib_get_execution_time(opcode, device))
+    {
+        execution_time_msec = device->execution_time_msec;
+    }
+    device->execution_time_msec = saved;
+
+    return execution_time_msec;
+}
+
 ATCA_STATUS calib_execute_send(ATCADevice device, uint8_t device_address, uint8_t* txdata, uint16_t txlength)
 {
     ATCA_STATUS status = ATCA_COMM_FAIL;
@@ -592,8 +620,8 @@ ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device)
     }
     while (0);
 
-    // Skip Idle for ECC204 device
-    if (!atcab_is_ca2_device(device->mIface.mIfaceCFG->devtype))
+    // Skip Idle for ECC204 device and while a batched operation holds the device awake
+    if (!atcab_is_ca2_device(device->mIface.mIfaceCFG->devtype) && !device->hold_awake)
     {
         (void)calib_idle(device);
         device->device_state = ATCA_DEVICE_STATE_IDLE;
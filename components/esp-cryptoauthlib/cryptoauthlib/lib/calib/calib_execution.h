@@ -63,6 +63,7 @@ typedef struct
 }device_execution_time_t;
 
 ATCA_STATUS calib_get_execution_time(uint8_t opcode, ATCADevice device);
+uint16_t calib_get_max_execution_time(ATCADevice device, uint8_t opcode);
 
 #ifndef ATCA_HAL_LEGACY_API
 ATCA_STATUS calib_execute_receive(ATCADevice device, uint8_t device_address, uint8_t* rxdata, uint16_t* rxlength);
@@ -71,6 +71,10 @@ ATCA_STATUS calib_lock(ATCADevice device, uint8_t mode, uint16_t summary_crc)
             break;
         }
 
+#if CALIB_CONFIG_SHADOW_EN
+        calib_config_shadow_invalidate(device);
+#endif
+
         if ((status = atca_execute_command(&packet, device)) != ATCA_SUCCESS)
         {
             ATCA_TRACE(status, "calib_lock - execution failed");
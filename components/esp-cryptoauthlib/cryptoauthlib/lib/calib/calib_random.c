@@ -85,6 +85,71 @@ ATCA_STATUS calib_random(ATCADevice device, uint8_t *rand_out)
     while (0);
 
 
+    return status;
+}
+
+/** \brief Executes a series of Random commands to fill a larger buffer. The
+ *          device is held awake between commands and is only idled when the
+ *          watchdog budget would otherwise be exceeded, so the wake sequence is
+ *          paid once per wake window rather than once per 32 bytes.
+ *
+ * \param[in]  device    Device context pointer
+ * \param[out] rand_out  blocks * 32 bytes of random data are returned here.
+ * \param[in]  blocks    Number of Random commands to run
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code. On failure the
+ *         blocks up to the failing command are valid.
+ */
+ATCA_STATUS calib_random_batch(ATCADevice device, uint8_t *rand_out, size_t blocks)
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+    size_t per_wake;
+    size_t i;
+
+    if ((NULL == device) || (NULL == rand_out))
+    {
+        return ATCA_TRACE(ATCA_BAD_PARAM, "NULL pointer received");
+    }
+
+    if (atcab_is_ca2_device(atcab_get_device_type_ext(device)))
+    {
+        /* CA2 devices do not idle between commands so there is nothing to amortise */
+        for (i = 0; (i < blocks) && (ATCA_SUCCESS == status); i++)
+        {
+            status = calib_random(device, &rand_out[i * RANDOM_NUM_SIZE]);
+        }
+        return status;
+    }
+
+    /* Random takes from 23ms (ATECC) to 50ms (ATSHA204A) */
+    per_wake = CALIB_SIGN_BATCH_WAKE_BUDGET_MSEC / calib_get_max_execution_time(device, ATCA_RANDOM);
+    if (0u == per_wake)
+    {
+        per_wake = 1u;
+    }
+
+    device->hold_awake = 1;
+
+    for (i = 0; i < blocks; i++)
+    {
+        if ((i > 0u) && (0u == (i % per_wake)))
+        {
+            // Reset the watchdog - the next command wakes the device again
+            (void)calib_idle(device);
+            device->device_state = ATCA_DEVICE_STATE_IDLE;
+        }
+
+        if ((status = calib_random(device, &rand_out[i * RANDOM_NUM_SIZE])) != ATCA_SUCCESS)
+        {
+            ATCA_TRACE(status, "calib_random - failed");
+            break;
+        }
+    }
+
+    device->hold_awake = 0;
+    (void)calib_idle(device);
+    device->device_state = ATCA_DEVICE_STATE_IDLE;
+
     return status;
 }
 #endif  /* CALIB_RANDOM_EN */
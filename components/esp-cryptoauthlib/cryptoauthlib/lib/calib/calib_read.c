@@ -70,6 +70,14 @@ ATCA_STATUS calib_read_zone(ATCADevice device, uint8_t zone, uint16_t slot, uint
         ATCA_CHECK_INVALID_MSG((!device || !data), ATCA_BAD_PARAM, "NULL pointer received");
         ATCA_CHECK_INVALID_MSG((len != 4 && len != 32), ATCA_BAD_PARAM, "NULL pointer received");
 
+#if CALIB_CONFIG_SHADOW_EN
+        // Locked configuration and OTP contents are served from the device context
+        if ((status = calib_config_shadow_read(device, zone, block, offset, data, len)) == ATCA_SUCCESS)
+        {
+            break;
+        }
+#endif
+
         // The get address function checks the remaining variables
         if ((status = calib_get_addr(zone, slot, block, offset, &addr)) != ATCA_SUCCESS)
         {
@@ -184,6 +184,161 @@ ATCA_STATUS calib_sign_ext(ATCADevice device, uint16_t key_id, const uint8_t *ms
     }
     return status;
 }
+
+#if CALIB_SIGN_EN
+/** \brief Estimate how many external signs fit into one wake window without
+ *          tripping the device watchdog
+ *
+ *  \param[in]  device     Device context pointer
+ *
+ *  \return Number of signatures to issue between idle commands (at least 1)
+ */
+static size_t calib_sign_batch_per_wake(ATCADevice device)
+{
+    /* Each signature is a Nonce load and a Sign, and every wake starts with
+       a Random to update the RNG seed */
+    uint32_t sign_time_msec = (uint32_t)calib_get_max_execution_time(device, ATCA_NONCE)
+                              + calib_get_max_execution_time(device, ATCA_SIGN);
+    uint32_t budget_msec = CALIB_SIGN_BATCH_WAKE_BUDGET_MSEC;
+    size_t per_wake;
+
+#if CALIB_RANDOM_EN
+    uint32_t random_time_msec = calib_get_max_execution_time(device, ATCA_RANDOM);
+
+    budget_msec = (budget_msec > random_time_msec) ? (budget_msec - random_time_msec) : 0u;
+#endif
+
+    per_wake = budget_msec / sign_time_msec;
+
+    return (per_wake > 0u) ? per_wake : 1u;
+}
+
+/** \brief Sign a batch of 32-byte digests with the ATECC family devices. The
+ *          device is held awake between signatures and is only idled when the
+ *          watchdog budget would otherwise be exceeded, so the RNG seed update
+ *          and the wake sequence are paid once per wake window rather than
+ *          once per signature.
+ */
+static ATCA_STATUS calib_sign_batch_ecc(ATCADevice device, uint16_t key_id, const uint8_t *msgs, size_t count, uint8_t *signatures)
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+    uint8_t nonce_target = NONCE_MODE_TARGET_TEMPKEY;
+    uint8_t sign_source = SIGN_MODE_SOURCE_TEMPKEY;
+    size_t per_wake = calib_sign_batch_per_wake(device);
+    size_t i;
+
+#ifdef ATCA_ATECC608_SUPPORT
+    if (ATECC608 == device->mIface.mIfaceCFG->devtype)
+    {
+        // Use the Message Digest Buffer for the ATECC608
+        nonce_target = NONCE_MODE_TARGET_MSGDIGBUF;
+        sign_source = SIGN_MODE_SOURCE_MSGDIGBUF;
+    }
+#endif
+
+    device->hold_awake = 1;
+
+    for (i = 0; (i < count) && (ATCA_SUCCESS == status); i++)
+    {
+        if ((i > 0u) && (0u == (i % per_wake)))
+        {
+            // Reset the watchdog - the next command wakes the device again
+            (void)calib_idle(device);
+            device->device_state = ATCA_DEVICE_STATE_IDLE;
+        }
+
+#if CALIB_RANDOM_EN
+        if (0u == (i % per_wake))
+        {
+            // Make sure RNG has updated its seed
+            if ((status = calib_random(device, NULL)) != ATCA_SUCCESS)
+            {
+                ATCA_TRACE(status, "calib_random - failed");
+                break;
+            }
+        }
+#endif
+
+        if ((status = calib_nonce_load(device, nonce_target, &msgs[i * ATCA_SHA256_DIGEST_SIZE], 32)) != ATCA_SUCCESS)
+        {
+            ATCA_TRACE(status, "calib_nonce_load - failed");
+            break;
+        }
+
+        if ((status = calib_sign_base(device, SIGN_MODE_EXTERNAL | sign_source, key_id, &signatures[i * ATCA_SIG_SIZE])) != ATCA_SUCCESS)
+        {
+            ATCA_TRACE(status, "calib_sign_base - failed");
+            break;
+        }
+    }
+
+    device->hold_awake = 0;
+    (void)calib_idle(device);
+    device->device_state = ATCA_DEVICE_STATE_IDLE;
+
+    return status;
+}
+#endif
+
+/** \brief Sign a batch of 32-byte messages with the private key in the
+ *          specified slot. Equivalent to calling calib_sign_ext for each
+ *          message but keeps the device awake across the batch.
+ *
+ *  \param[in]  device      Device context pointer
+ *  \param[in]  key_id      Slot of the private key to be used to sign the
+ *                          messages.
+ *  \param[in]  msgs        count * 32 bytes of messages to be signed, stored
+ *                          back to back. Typically SHA256 digests.
+ *  \param[in]  count       Number of messages in msgs
+ *  \param[out] signatures  count * 64 bytes of signatures are returned here
+ *                          in the same order as msgs. Format is R and S
+ *                          integers in big-endian format.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code. On failure the
+ *         signatures up to the failing message are valid.
+ */
+ATCA_STATUS calib_sign_batch(ATCADevice device, uint16_t key_id, const uint8_t *msgs, size_t count, uint8_t *signatures)
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+
+    if ((NULL == device) || (NULL == msgs) || (NULL == signatures))
+    {
+        return ATCA_TRACE(ATCA_BAD_PARAM, "NULL pointer received");
+    }
+
+    switch (atcab_get_device_type_ext(device))
+    {
+#if CALIB_SIGN_EN
+        case ATECC108A:
+            /* fall-through */
+        case ATECC508A:
+            /* fall-through */
+        case ATECC608:
+            status = calib_sign_batch_ecc(device, key_id, msgs, count, signatures);
+            break;
+#endif
+
+#if CALIB_SIGN_CA2_EN
+        case ECC204:
+        /* fallthrough */
+        case TA010:
+        {
+            /* CA2 devices do not idle between commands so there is nothing to amortise */
+            size_t i;
+            for (i = 0; (i < count) && (ATCA_SUCCESS == status); i++)
+            {
+                status = calib_ca2_sign(device, key_id, &msgs[i * ATCA_SHA256_DIGEST_SIZE], &signatures[i * ATCA_SIG_SIZE]);
+            }
+        }
+        break;
+#endif
+        default:
+            status = ATCA_UNIMPLEMENTED;
+            break;
+    }
+
+    return status;
+}
 #endif
 
 #if CALIB_SIGN_INTERNAL_EN
@@ -95,6 +95,13 @@ ATCA_STATUS calib_write(ATCADevice device, uint8_t zone, uint16_t address, const
             break;
         }
 
+#if CALIB_CONFIG_SHADOW_EN
+        if ((zone & ATCA_ZONE_MASK) != ATCA_ZONE_DATA)
+        {
+            calib_config_shadow_invalidate(device);
+        }
+#endif
+
         if ((status = atca_execute_command(&packet, device)) != ATCA_SUCCESS)
         {
             ATCA_TRACE(status, "calib_write - execution failed");
@@ -209,6 +209,20 @@
 #define ATCA_CRYPTO_SHA2_EN                 (ATCAC_SHA256_EN && !ATCA_HOSTLIB_EN)
 #endif
 
+/** \def ATCA_CRYPTO_SHA2_MIDSTATE_EN
+  * 
+  * Requires: ATCAC_SHA256_EN
+  * 
+  * Build the built-in SHA256 routines (sw_sha256_*) even when a host crypto
+  * library provides SHA256. Their context can be copied, which the host side
+  * prefix contexts use to keep the state after a constant leading block.
+  * 
+  * Supported API's: atcah_*_prefix, atcah_*_prefixed
+ **/
+#ifndef ATCA_CRYPTO_SHA2_MIDSTATE_EN
+#define ATCA_CRYPTO_SHA2_MIDSTATE_EN        ATCAC_SHA256_EN
+#endif
+
 /** \def ATCA_CRYPTO_SHA2_HMAC_EN
   * 
   * Requires: ATCAC_SHA256_EN
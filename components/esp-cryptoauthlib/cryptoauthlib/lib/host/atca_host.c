@@ -1917,4 +1917,334 @@ ATCA_STATUS atcah_delete_mac(struct atca_delete_in_out *param)
 }
 #endif /* ATCAH_DELETE_MAC */
 
+#if ATCAH_PREFIX_CTX
+/** \brief Hash the constant first block shared by the GenDig, DeriveKey and
+ *         diversified key calculations: 32 bytes key, 4 bytes opcode and
+ *         parameters (or other data), SN[8], SN[0:1] and 25 zeros.
+ */
+static void atcah_prefix_key_block(sw_sha256_ctx* ctx, const uint8_t* key, const uint8_t* params, const uint8_t* sn)
+{
+    uint8_t block[ATCA_SHA2_256_BLOCK_SIZE];
+    uint8_t *p_temp = block;
+
+    memcpy(p_temp, key, ATCA_KEY_SIZE);
+    p_temp += ATCA_KEY_SIZE;
+
+    memcpy(p_temp, params, ATCA_WORD_SIZE);
+    p_temp += ATCA_WORD_SIZE;
+
+    *p_temp++ = sn[8];
+    *p_temp++ = sn[0];
+    *p_temp++ = sn[1];
+
+    memset(p_temp, 0, ATCA_GENDIG_ZEROS_SIZE);
+
+    sw_sha256_init(ctx);
+    sw_sha256_update(ctx, block, sizeof(block));
+    memset(block, 0, sizeof(block));
+}
+
+/** \brief Hash the variable tail of a message starting from a copy of a
+ *         prefix state.
+ */
+static void atcah_prefix_finish(const sw_sha256_ctx* prefix, const uint8_t* tail, size_t tail_len, uint8_t* digest)
+{
+    sw_sha256_ctx ctx;
+
+    memcpy(&ctx, prefix, sizeof(ctx));
+    sw_sha256_update(&ctx, tail, (uint32_t)tail_len);
+    sw_sha256_final(&ctx, digest);
+    memset(&ctx, 0, sizeof(ctx));
+}
+
+/** \brief Build a prefix context for repeated GenDig calculations with the
+ *         same stored value, for example an encryption key used by many
+ *         encrypted reads and writes.
+ *
+ * \param[out] ctx           Prefix context
+ * \param[in]  zone          GenDig zone. Only GENDIG_ZONE_CONFIG, GENDIG_ZONE_OTP
+ *                           and GENDIG_ZONE_DATA (without NoMac) are supported.
+ * \param[in]  key_id        GenDig KeyID parameter
+ * \param[in]  stored_value  32-byte slot value, config block or OTP block
+ * \param[in]  sn            Device serial number SN[0:8]
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_gen_dig_prefix(atca_host_prefix_ctx_t* ctx, uint8_t zone, uint16_t key_id, const uint8_t* stored_value, const uint8_t* sn)
+{
+    uint8_t params[ATCA_WORD_SIZE];
+
+    if (!ctx || !stored_value || !sn || (zone > GENDIG_ZONE_DATA))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    params[0] = ATCA_GENDIG;
+    params[1] = zone;
+    params[2] = (uint8_t)(key_id & 0xFF);
+    params[3] = (uint8_t)(key_id >> 8);
+
+    atcah_prefix_key_block(&ctx->inner, stored_value, params, sn);
+    ctx->mode = zone;
+    ctx->key_id = key_id;
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Same as atcah_gen_dig() for the stored value of a prefix context,
+ *         hashing only the current TempKey.
+ *
+ * \param[in]     ctx       Prefix context built by atcah_gen_dig_prefix()
+ * \param[in,out] temp_key  Current state of TempKey
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_gen_dig_prefixed(const atca_host_prefix_ctx_t* ctx, struct atca_temp_key* temp_key)
+{
+    if (!ctx || !temp_key)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    atcah_prefix_finish(&ctx->inner, temp_key->value, ATCA_KEY_SIZE, temp_key->value);
+
+    // Update TempKey fields
+    temp_key->valid = 1;
+
+    if ((ctx->mode == GENDIG_ZONE_DATA) && (ctx->key_id <= 15))
+    {
+        temp_key->gen_dig_data = 1;
+        temp_key->key_id = (ctx->key_id & 0xF);    // mask lower 4-bit only
+    }
+    else
+    {
+        temp_key->gen_dig_data = 0;
+        temp_key->key_id = 0;
+    }
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Build a prefix context for deriving keys from the same parent key.
+ *
+ * \param[out] ctx            Prefix context
+ * \param[in]  mode           DeriveKey mode parameter
+ * \param[in]  target_key_id  Key ID of the derived key
+ * \param[in]  parent_key     32-byte parent key
+ * \param[in]  sn             Device serial number SN[0:8]
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_derive_key_prefix(atca_host_prefix_ctx_t* ctx, uint8_t mode, uint16_t target_key_id, const uint8_t* parent_key, const uint8_t* sn)
+{
+    uint8_t params[ATCA_WORD_SIZE];
+
+    if (!ctx || !parent_key || !sn || (mode & ~DERIVE_KEY_RANDOM_FLAG) || (target_key_id > ATCA_KEY_ID_MAX))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    params[0] = ATCA_DERIVE_KEY;
+    params[1] = mode;
+    params[2] = (uint8_t)(target_key_id & 0xFF);
+    params[3] = (uint8_t)(target_key_id >> 8);
+
+    atcah_prefix_key_block(&ctx->inner, parent_key, params, sn);
+    ctx->mode = mode;
+    ctx->key_id = target_key_id;
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Same as atcah_derive_key() for the parent key of a prefix context,
+ *         hashing only the current TempKey.
+ *
+ * \param[in]     ctx         Prefix context built by atcah_derive_key_prefix()
+ * \param[in,out] temp_key    Current state of TempKey
+ * \param[out]    target_key  Derived key is returned here (32 bytes)
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_derive_key_prefixed(const atca_host_prefix_ctx_t* ctx, struct atca_temp_key* temp_key, uint8_t* target_key)
+{
+    if (!ctx || !temp_key || !target_key)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    // Check TempKey fields validity (TempKey is always used)
+    if ( // TempKey.CheckFlag must be 0 and TempKey.Valid must be 1
+        temp_key->no_mac_flag || (temp_key->valid != 1)
+        // The random parameter bit 2 must match temp_key.source_flag
+        || (!(ctx->mode & DERIVE_KEY_RANDOM_FLAG) != !(temp_key->source_flag))
+        )
+    {
+        // Invalidate TempKey, then return
+        temp_key->valid = 0;
+        return ATCA_EXECUTION_ERROR;
+    }
+
+    atcah_prefix_finish(&ctx->inner, temp_key->value, ATCA_KEY_SIZE, target_key);
+
+    // Update TempKey fields
+    temp_key->valid = 0;
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Build a prefix context for calculating diversified keys from the
+ *         same parent key and other data.
+ *
+ * \param[out] ctx         Prefix context
+ * \param[in]  parent_key  32-byte parent key
+ * \param[in]  other_data  4 bytes of other data
+ * \param[in]  sn          Device serial number SN[0:8]
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_gendivkey_prefix(atca_host_prefix_ctx_t* ctx, const uint8_t* parent_key, const uint8_t* other_data, const uint8_t* sn)
+{
+    if (!ctx || !parent_key || !other_data || !sn)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    atcah_prefix_key_block(&ctx->inner, parent_key, other_data, sn);
+    ctx->mode = 0;
+    ctx->key_id = 0;
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Same as atcah_gendivkey() for the parent key of a prefix context,
+ *         hashing only the input data.
+ *
+ * \param[in]  ctx         Prefix context built by atcah_gendivkey_prefix()
+ * \param[in]  input_data  32 bytes fixed input data
+ * \param[out] temp_key    Diversified key is returned in temp_key->value
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_gendivkey_prefixed(const atca_host_prefix_ctx_t* ctx, const uint8_t* input_data, struct atca_temp_key* temp_key)
+{
+    if (!ctx || !input_data || !temp_key)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    atcah_prefix_finish(&ctx->inner, input_data, ATCA_KEY_SIZE, temp_key->value);
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Build a prefix context holding the inner (K0 ^ ipad) and outer
+ *         (K0 ^ opad) HMAC states of a key.
+ *
+ * \param[out] ctx  Prefix context
+ * \param[in]  key  32-byte HMAC key
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_hmac_prefix(atca_host_prefix_ctx_t* ctx, const uint8_t* key)
+{
+    uint8_t block[ATCA_HMAC_BLOCK_SIZE];
+    uint8_t i;
+
+    if (!ctx || !key)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memset(block, 0x36, sizeof(block));
+    for (i = 0; i < ATCA_KEY_SIZE; i++)
+    {
+        block[i] ^= key[i];
+    }
+    sw_sha256_init(&ctx->inner);
+    sw_sha256_update(&ctx->inner, block, sizeof(block));
+
+    memset(block, 0x5C, sizeof(block));
+    for (i = 0; i < ATCA_KEY_SIZE; i++)
+    {
+        block[i] ^= key[i];
+    }
+    sw_sha256_init(&ctx->outer);
+    sw_sha256_update(&ctx->outer, block, sizeof(block));
+
+    memset(block, 0, sizeof(block));
+    ctx->mode = 0;
+    ctx->key_id = 0;
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Same as atcah_hmac() for the key of a prefix context. Hashes three
+ *         SHA256 blocks instead of five; param->key is not used.
+ *
+ * \param[in]     ctx    Prefix context built by atcah_hmac_prefix()
+ * \param[in,out] param  Input and output parameters
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS atcah_hmac_prefixed(const atca_host_prefix_ctx_t* ctx, struct atca_hmac_in_out* param)
+{
+    struct atca_include_data_in_out include_data;
+    uint8_t temporary[ATCA_MSG_SIZE_HMAC];
+    uint8_t *p_temp = temporary;
+
+    // Check parameters
+    if (!ctx || !param || !param->response || !param->temp_key
+        || (param->mode & ~HMAC_MODE_MASK)
+        || (((param->mode & MAC_MODE_INCLUDE_OTP_64) || (param->mode & MAC_MODE_INCLUDE_OTP_88)) && !param->otp)
+        || (!param->sn)
+        )
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    // Check TempKey fields validity (TempKey is always used)
+    if ( // TempKey.CheckFlag must be 0 and TempKey.Valid must be 1
+        param->temp_key->no_mac_flag || (param->temp_key->valid != 1)
+        // The mode parameter bit 2 must match temp_key.source_flag.
+        || (!(param->mode & MAC_MODE_SOURCE_FLAG_MATCH) != !(param->temp_key->source_flag))
+        )
+    {
+        // Invalidate TempKey, then return
+        param->temp_key->valid = 0;
+        return ATCA_EXECUTION_ERROR;
+    }
+
+    // text = 32 zeros || TempKey || Opcode || Mode || KeyID || OTP and SN
+    memset(p_temp, 0, ATCA_KEY_SIZE);
+    p_temp += ATCA_KEY_SIZE;
+
+    memcpy(p_temp, param->temp_key->value, ATCA_KEY_SIZE);
+    p_temp += ATCA_KEY_SIZE;
+
+    *p_temp++ = ATCA_HMAC;
+    *p_temp++ = param->mode;
+    *p_temp++ = (uint8_t)(param->key_id >> 0);
+    *p_temp++ = (uint8_t)(param->key_id >> 8);
+
+    include_data.otp = param->otp;
+    include_data.sn = param->sn;
+    include_data.mode = param->mode;
+    include_data.p_temp = p_temp;
+    atcah_include_data(&include_data);
+
+    // H((K0 ^ ipad) || text), then H((K0 ^ opad) || inner digest)
+    atcah_prefix_finish(&ctx->inner, temporary, sizeof(temporary), param->response);
+    atcah_prefix_finish(&ctx->outer, param->response, ATCA_SHA_DIGEST_SIZE, param->response);
+
+    // Update TempKey fields
+    param->temp_key->valid = 0;
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Clear the key material held by a prefix context.
+ *
+ * \param[in,out] ctx  Prefix context
+ */
+void atcah_prefix_clear(atca_host_prefix_ctx_t* ctx)
+{
+    if (ctx)
+    {
+        memset(ctx, 0, sizeof(*ctx));
+    }
+}
+#endif /* ATCAH_PREFIX_CTX */
+
 #endif
\ No newline at end of file
@@ -34,6 +34,7 @@
 #include "calib/calib_basic.h"
 
 #include "atca_host_config_check.h"
+#include "crypto/hashes/sha2_routines.h"
 
 /** \defgroup atcah Host side crypto methods (atcah_)
  *
@@ -479,6 +480,21 @@ typedef struct atca_delete_in_out
     uint8_t*       mac;
 }atca_delete_in_out_t;
 
+/** \brief SHA256 state after the constant leading block of a host side
+ *         calculation (key, opcode, parameters and fixed serial number bytes).
+ *
+ * Built once per key with one of the atcah_*_prefix functions and reused by
+ * the matching atcah_*_prefixed function, which only hashes the variable tail
+ * of the message. Holds key material: clear it with atcah_prefix_clear().
+ */
+typedef struct atca_host_prefix_ctx
+{
+    sw_sha256_ctx inner;    //!< State after the first message block (K0 ^ ipad for HMAC)
+    sw_sha256_ctx outer;    //!< State after K0 ^ opad, HMAC only
+    uint8_t       mode;     //!< Zone or mode parameter the prefix was built for
+    uint16_t      key_id;   //!< Key ID parameter the prefix was built for
+} atca_host_prefix_ctx_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -509,6 +525,15 @@ ATCA_STATUS atcah_ecc204_write_auth_mac(struct atca_write_mac_in_out *param);
 ATCA_STATUS atcah_gen_session_key(atca_session_key_in_out_t *param);
 ATCA_STATUS atcah_gen_output_resp_mac(struct atca_resp_mac_in_out *param);
 ATCA_STATUS atcah_delete_mac(struct atca_delete_in_out *param);
+ATCA_STATUS atcah_gen_dig_prefix(atca_host_prefix_ctx_t* ctx, uint8_t zone, uint16_t key_id, const uint8_t* stored_value, const uint8_t* sn);
+ATCA_STATUS atcah_gen_dig_prefixed(const atca_host_prefix_ctx_t* ctx, struct atca_temp_key* temp_key);
+ATCA_STATUS atcah_derive_key_prefix(atca_host_prefix_ctx_t* ctx, uint8_t mode, uint16_t target_key_id, const uint8_t* parent_key, const uint8_t* sn);
+ATCA_STATUS atcah_derive_key_prefixed(const atca_host_prefix_ctx_t* ctx, struct atca_temp_key* temp_key, uint8_t* target_key);
+ATCA_STATUS atcah_gendivkey_prefix(atca_host_prefix_ctx_t* ctx, const uint8_t* parent_key, const uint8_t* other_data, const uint8_t* sn);
+ATCA_STATUS atcah_gendivkey_prefixed(const atca_host_prefix_ctx_t* ctx, const uint8_t* input_data, struct atca_temp_key* temp_key);
+ATCA_STATUS atcah_hmac_prefix(atca_host_prefix_ctx_t* ctx, const uint8_t* key);
+ATCA_STATUS atcah_hmac_prefixed(const atca_host_prefix_ctx_t* ctx, struct atca_hmac_in_out* param);
+void atcah_prefix_clear(atca_host_prefix_ctx_t* ctx);
 #ifdef __cplusplus
 }
 #endif
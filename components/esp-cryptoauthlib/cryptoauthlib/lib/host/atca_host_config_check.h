@@ -354,6 +354,23 @@
 #define ATCAH_DELETE_MAC  (CALIB_DELETE_EN)
 #endif
 
+/** \def ATCAH_PREFIX_CTX
+  * 
+  * Requires: ATCA_CRYPTO_SHA2_MIDSTATE_EN
+  * 
+  * Supported API's: atcah_gen_dig_prefix, atcah_gen_dig_prefixed,
+  *                  atcah_derive_key_prefix, atcah_derive_key_prefixed,
+  *                  atcah_gendivkey_prefix, atcah_gendivkey_prefixed,
+  *                  atcah_hmac_prefix, atcah_hmac_prefixed, atcah_prefix_clear
+  * 
+  * Enable ATCAH_PREFIX_CTX to keep the SHA256 state of the constant key block
+  * of GenDig, DeriveKey, diversified key and HMAC calculations so repeated
+  * calculations with the same key only hash their variable part
+ **/
+#ifndef ATCAH_PREFIX_CTX
+#define ATCAH_PREFIX_CTX  (ATCA_CRYPTO_SHA2_MIDSTATE_EN)
+#endif
+
 /* ATCA CRYPTO REQUIREMENTS  */
 
 #ifndef ATCAC_SW_SHA2_256
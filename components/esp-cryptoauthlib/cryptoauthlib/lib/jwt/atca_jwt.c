@@ -34,6 +34,112 @@
 /** \brief The only supported JWT format for this library */
 static const char g_jwt_header[] = "{\"alg\":\"ES256\",\"typ\":\"JWT\"}";
 
+/** \brief base64url alphabet used for the streamed payload */
+static const char g_jwt_b64url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/**
+ * \brief Number of encoded characters the payload will grow by when len more
+ * bytes are streamed into it
+ */
+static size_t atca_jwt_encoded_growth(
+    const atca_jwt_t* jwt,  /**< [in] JWT Context to use */
+    size_t            len   /**< [in] Number of payload bytes to be added */
+    )
+{
+    return ((jwt->pending_len + len) / 3) * 4;
+}
+
+/**
+ * \brief Encode the pending group into the buffer and add it to the digest.
+ * Partial groups are emitted unpadded which is only valid at the end of the
+ * payload.
+ */
+static ATCA_STATUS atca_jwt_flush_group(
+    atca_jwt_t* jwt     /**< [in] JWT Context to use */
+    )
+{
+    char* out = &jwt->buf[jwt->cur];
+    uint8_t* in = jwt->pending;
+    size_t olen = (size_t)jwt->pending_len + 1;
+
+    if (!jwt->pending_len)
+    {
+        return ATCA_SUCCESS;
+    }
+
+    if (jwt->pending_len < 3)
+    {
+        memset(&in[jwt->pending_len], 0, 3u - jwt->pending_len);
+    }
+
+    out[0] = g_jwt_b64url[in[0] >> 2];
+    out[1] = g_jwt_b64url[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+    out[2] = g_jwt_b64url[((in[1] & 0x0F) << 2) | (in[2] >> 6)];
+    out[3] = g_jwt_b64url[in[2] & 0x3F];
+
+    jwt->cur += (uint16_t)olen;
+    jwt->pending_len = 0;
+
+    return (ATCA_STATUS)atcac_sw_sha2_256_update(&jwt->sha, (const uint8_t*)out, olen);
+}
+
+/**
+ * \brief Stream raw payload bytes into the token. The caller must have
+ * checked there is room using atca_jwt_encoded_growth
+ */
+static ATCA_STATUS atca_jwt_append(
+    atca_jwt_t*  jwt,   /**< [in] JWT Context to use */
+    const char*  data,  /**< [in] Raw payload bytes */
+    size_t       len    /**< [in] Number of bytes */
+    )
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+
+    while (len-- && (ATCA_SUCCESS == status))
+    {
+        jwt->pending[jwt->pending_len++] = (uint8_t)*data++;
+        if (3 == jwt->pending_len)
+        {
+            status = atca_jwt_flush_group(jwt);
+        }
+    }
+    return status;
+}
+
+/**
+ * \brief Add a claim made of a list of raw fragments to the payload. Room
+ * is checked for the whole claim before anything is written so a failed add
+ * leaves the token untouched.
+ */
+static ATCA_STATUS atca_jwt_add_claim(
+    atca_jwt_t* jwt,    /**< [in] JWT Context to use */
+    const char* parts[] /**< [in] Null terminated list of fragments */
+    )
+{
+    ATCA_STATUS status = ATCA_SUCCESS;
+    size_t len = 1;     /* '{' or ',' */
+    size_t i;
+
+    for (i = 0; parts[i]; i++)
+    {
+        len += strlen(parts[i]);
+    }
+
+    /* Leave space for the terminating null */
+    if (jwt->cur + atca_jwt_encoded_growth(jwt, len) >= jwt->buflen)
+    {
+        return ATCA_GEN_FAIL;
+    }
+
+    atca_jwt_check_payload_start(jwt);
+
+    for (i = 0; parts[i] && (ATCA_SUCCESS == status); i++)
+    {
+        status = atca_jwt_append(jwt, parts[i], strlen(parts[i]));
+    }
+    return status;
+}
+
 /**
  * \brief Check the provided context to see what character needs to be added in
  * order to append a claim
@@ -43,17 +149,16 @@ void atca_jwt_check_payload_start(
     )
 {
     /* Rationality checks: a) must be valid, b) buf must be valid, c) must not be at the start, d) must have room */
-    if (jwt && jwt->buf && jwt->cur && (jwt->cur < jwt->buflen - 1))
+    if (jwt && jwt->buf && jwt->cur && (jwt->cur + atca_jwt_encoded_growth(jwt, 1) < jwt->buflen))
     {
-        /* Check the previous */
-        char c = jwt->buf[jwt->cur - 1];
-        if ('.' == c)
+        if (!jwt->claims)
         {
-            jwt->buf[jwt->cur++] = '{';
+            jwt->claims = 1;
+            (void)atca_jwt_append(jwt, "{", 1);
         }
-        else if ('{' != c)
+        else
         {
-            jwt->buf[jwt->cur++] = ',';
+            (void)atca_jwt_append(jwt, ",", 1);
         }
     }
 }
@@ -75,6 +180,8 @@ ATCA_STATUS atca_jwt_init(
         jwt->buf = buf;
         jwt->buflen = buflen;
         jwt->cur = 0;
+        jwt->pending_len = 0;
+        jwt->claims = 0;
 
         /* Encode the header into the buffer */
         tSize = jwt->buflen;
@@ -95,12 +202,24 @@ ATCA_STATUS atca_jwt_init(
                 ret = ATCA_INVALID_SIZE;
             }
         }
+
+        /* Start the digest with the encoded header and separator */
+        if (ATCA_SUCCESS == ret)
+        {
+            ret = (ATCA_STATUS)atcac_sw_sha2_256_init(&jwt->sha);
+        }
+
+        if (ATCA_SUCCESS == ret)
+        {
+            ret = (ATCA_STATUS)atcac_sw_sha2_256_update(&jwt->sha, (const uint8_t*)jwt->buf, jwt->cur);
+        }
     }
     return ret;
 }
 
 /**
- * \brief Close the claims of a token, encode them, then sign the result
+ * \brief Close the claims of a token and sign the digest accumulated while
+ * the claims were added
  */
 ATCA_STATUS atca_jwt_finalize(
     atca_jwt_t* jwt,    /**< [in] JWT Context to use */
@@ -108,8 +227,8 @@ ATCA_STATUS atca_jwt_finalize(
     )
 {
     ATCA_STATUS status;
-    uint16_t i;
-    size_t rem;
+    uint8_t digest[ATCA_SHA256_DIGEST_SIZE];
+    uint8_t signature[ATCA_ECCP256_SIG_SIZE];
     size_t tSize;
 
     if (!jwt || !jwt->buf || !jwt->buflen || !jwt->cur)
@@ -117,75 +236,50 @@ ATCA_STATUS atca_jwt_finalize(
         return ATCA_BAD_PARAM;
     }
 
-    /* Verify the payload is closed */
-    if ('}' != jwt->buf[jwt->cur - 1])
+    /* Make sure there is room for the rest of the token up front: the closing
+       brace and final partial group (up to 4 characters), the '.' and the
+       signature ECDSA(P256) -> 64 bytes -> base64 -> 86.3 (87) -> 88 + null */
+    tSize = jwt->claims ? 1u : 2u;
+    if ((size_t)jwt->cur + atca_jwt_encoded_growth(jwt, tSize) + 4u + 1u + 89u > jwt->buflen)
     {
-        jwt->buf[jwt->cur++] = '}';
+        return ATCA_INVALID_SIZE;
     }
 
-    /* Find the start of the "claims" portion of the token - header should
-       already be encoded */
-    for (i = 0; i < jwt->cur; i++)
+    if (!jwt->claims)
     {
-        if ('.' == jwt->buf[i])
-        {
-            i++;
-            break;
-        }
+        jwt->claims = 1;
+        status = atca_jwt_append(jwt, "{}", 2);
     }
-
-    /* Make sure there is enough remaining buffer given base64 4/3 expansion */
-    rem = (jwt->cur - i + ATCA_ECCP256_SIG_SIZE) * 4;
-    rem /= 3;
-
-    /* Increase Count to accomodate: 1 for the '.', 1 for the null terminator,
-        and 1 for padding */
-    rem += 3;
-
-    if (rem > (size_t)(jwt->buflen - jwt->cur))
+    else
     {
-        return ATCA_INVALID_SIZE;
+        status = atca_jwt_append(jwt, "}", 1);
     }
 
-    /* Calculate the payload length */
-    rem = jwt->cur - i;
-    /* Move the payload to make room for the encoding */
-    memmove(jwt->buf + jwt->buflen - jwt->cur, &jwt->buf[i], rem);
-
-    /* Encode the payload into the buffer */
-    tSize = jwt->buflen;
-    status = atcab_base64encode_((uint8_t*)(jwt->buf + jwt->buflen - jwt->cur), rem,
-                                 &jwt->buf[i], &tSize, atcab_b64rules_urlsafe);
-    if (ATCA_SUCCESS != status)
+    if (ATCA_SUCCESS == status)
     {
-        return status;
+        status = atca_jwt_flush_group(jwt);
     }
 
-    jwt->cur = (uint16_t)(i + tSize);
-
-    /* Make sure there room to add the signature
-        ECDSA(P256) -> 64 bytes -> base64 -> 86.3 (87) -> 88 including null */
-    if (jwt->cur >= jwt->buflen - 88)
+    if (ATCA_SUCCESS == status)
     {
-        /* Something broke */
-        return ATCA_INVALID_SIZE;
+        status = (ATCA_STATUS)atcac_sw_sha2_256_finish(&jwt->sha, digest);
     }
 
-    /* Create digest of the message store and store in the buffer */
-    status = (ATCA_STATUS)atcac_sw_sha2_256((const uint8_t*)jwt->buf, jwt->cur, (uint8_t*)(jwt->buf + jwt->buflen - 32));
     if (ATCA_SUCCESS != status)
     {
         return status;
     }
 
-    /* Create ECSDA signature of the digest and store it back in the buffer */
+    /* Create ECSDA signature of the digest */
 #if CALIB_SIGN_EN || CALIB_SIGN_ECC204_EN || TALIB_SIGN_EN
-    status = atcab_sign(key_id, (const uint8_t*)(jwt->buf + jwt->buflen - ATCA_SHA256_DIGEST_SIZE),
-                        (uint8_t*)(jwt->buf + jwt->buflen - 64));
+    status = atcab_sign(key_id, digest, signature);
     if (ATCA_SUCCESS != status)
     {
         return status;
     }
+#else
+    ((void)key_id);
+    memset(signature, 0, sizeof(signature));
 #endif
 
     /* Add the separator */
@@ -193,8 +287,11 @@ ATCA_STATUS atca_jwt_finalize(
 
     /* Encode the signature and store it in the buffer */
     tSize = jwt->buflen - jwt->cur;
-    atcab_base64encode_((const uint8_t*)(jwt->buf + jwt->buflen - ATCA_ECCP256_SIG_SIZE), ATCA_ECCP256_SIG_SIZE,
-                        &jwt->buf[jwt->cur], &tSize, atcab_b64rules_urlsafe);
+    status = atcab_base64encode_(signature, ATCA_ECCP256_SIG_SIZE, &jwt->buf[jwt->cur], &tSize, atcab_b64rules_urlsafe);
+    if (ATCA_SUCCESS != status)
+    {
+        return status;
+    }
     jwt->cur += (uint16_t)tSize;
 
     if (jwt->cur >= jwt->buflen)
@@ -220,24 +317,11 @@ ATCA_STATUS atca_jwt_add_claim_string(
     const char* value   /**< [in] Null terminated string to be insterted */
     )
 {
-    int32_t written;
-    int32_t remaining;
-
     if (jwt && jwt->buf && jwt->buflen && claim && value)
     {
-        atca_jwt_check_payload_start(jwt);
+        const char* parts[] = { "\"", claim, "\":\"", value, "\"", NULL };
 
-        remaining = jwt->buflen - jwt->cur;
-        written = snprintf(&jwt->buf[jwt->cur], (size_t)remaining, "\"%s\":\"%s\"", claim, value);
-        if (0 < written && written < remaining)
-        {
-            jwt->cur += written;
-            return ATCA_SUCCESS;
-        }
-        else
-        {
-            return ATCA_GEN_FAIL;
-        }
+        return atca_jwt_add_claim(jwt, parts);
     }
     else
     {
@@ -256,24 +340,14 @@ ATCA_STATUS atca_jwt_add_claim_numeric(
     int32_t     value   /**< [in] integer value to be inserted */
     )
 {
-    int32_t written;
-    int32_t remaining;
+    char number[12];
 
     if (jwt && jwt->buf && jwt->buflen && claim)
     {
-        atca_jwt_check_payload_start(jwt);
+        const char* parts[] = { "\"", claim, "\":", number, NULL };
 
-        remaining = jwt->buflen - jwt->cur;
-        written = snprintf(&jwt->buf[jwt->cur], (size_t)remaining, "\"%s\":%ld", claim, (long)value);
-        if (0 < written && written < remaining)
-        {
-            jwt->cur += written;
-            return ATCA_SUCCESS;
-        }
-        else
-        {
-            return ATCA_GEN_FAIL;
-        }
+        (void)snprintf(number, sizeof(number), "%ld", (long)value);
+        return atca_jwt_add_claim(jwt, parts);
     }
     else
     {
@@ -282,6 +356,56 @@ ATCA_STATUS atca_jwt_add_claim_numeric(
 }
 
 #if ATCA_HOSTLIB_EN || CALIB_VERIFY_EXTERN_EN || TALIB_VERIFY_EXTERN_EN
+/**
+ * \brief Split an encoded jwt, digest the header and payload and decode the
+ * signature
+ */
+static ATCA_STATUS atca_jwt_parse_signed(
+    const char* buf,        /**< [in] Buffer holding an encoded jwt */
+    uint16_t    buflen,     /**< [in] Length of the buffer/jwt */
+    uint8_t*    digest,     /**< [out] SHA256 of the signed portion */
+    uint8_t*    signature   /**< [out] Raw P256 signature (R,S) */
+    )
+{
+    ATCA_STATUS status;
+    size_t sig_len = ATCA_ECCP256_SIG_SIZE;
+    const char* pEnd = buf + buflen;
+    const char* pStr;
+
+    /* Payload */
+    if (NULL == (pStr = memchr(buf, '.', buflen)))
+    {
+        return ATCA_BAD_PARAM;
+    }
+    pStr++;
+
+    /* Signature */
+    if (NULL == (pStr = memchr(pStr, '.', (size_t)(pEnd - pStr))))
+    {
+        return ATCA_BAD_PARAM;
+    }
+    pStr++;
+
+    /* The buffer may hold a null terminated token shorter than buflen */
+    {
+        const char* pNull = memchr(pStr, 0, (size_t)(pEnd - pStr));
+        if (pNull)
+        {
+            pEnd = pNull;
+        }
+    }
+
+    /* Extract the signature */
+    if (ATCA_SUCCESS != (status = atcab_base64decode_(pStr, (size_t)(pEnd - pStr),
+                                                      signature, &sig_len, atcab_b64rules_urlsafe)))
+    {
+        return status;
+    }
+
+    /* Digest the token */
+    return (ATCA_STATUS)atcac_sw_sha2_256((const uint8_t*)buf, (size_t)(pStr - buf - 1), digest);
+}
+
 /**
  * \brief Verifies the signature of a jwt using the provided public key
  */
@@ -294,8 +418,6 @@ ATCA_STATUS atca_jwt_verify(
     ATCA_STATUS status = ATCA_GEN_FAIL;
     uint8_t digest[ATCA_SHA256_DIGEST_SIZE];
     uint8_t signature[ATCA_ECCP256_SIG_SIZE];
-    size_t sig_len = sizeof(signature);
-    const char* pStr = buf;
 
     bool verified = false;
 
@@ -306,29 +428,7 @@ ATCA_STATUS atca_jwt_verify(
 
     do
     {
-        /* Payload */
-        pStr = strchr(pStr, '.') + 1;
-        if (!pStr)
-        {
-            break;
-        }
-
-        /* Signature */
-        pStr = strchr(pStr, '.') + 1;
-        if (!pStr)
-        {
-            break;
-        }
-
-        /* Extract the signature */
-        if (ATCA_SUCCESS != (status = atcab_base64decode_(pStr, strlen(pStr),
-                                                          signature, &sig_len, atcab_b64rules_urlsafe)))
-        {
-            break;
-        }
-
-        /* Digest the token */
-        if (ATCA_SUCCESS != (status = (ATCA_STATUS)atcac_sw_sha2_256((const uint8_t*)buf, (size_t)(pStr - buf - 1), digest)))
+        if (ATCA_SUCCESS != (status = atca_jwt_parse_signed(buf, buflen, digest, signature)))
         {
             break;
         }
@@ -345,7 +445,7 @@ ATCA_STATUS atca_jwt_verify(
 
         /* Initialize the key using the provided X,Y cordinantes */
         if(ATCA_SUCCESS != (status = atcac_pk_init(&pkey_ctx, pubkey, 
-                                                   sizeof(pubkey), 0, true)))
+                                                   ATCA_ECCP256_PUBKEY_SIZE, 0, true)))
         {
             break;
         }
@@ -372,3 +472,396 @@ ATCA_STATUS atca_jwt_verify(
     return status;
 }
 #endif
+
+#if ATCA_HOSTLIB_EN && ATCAC_VERIFY_EN
+
+#if ATCA_JWT_VERIFY_THREADS_EN
+#include <pthread.h>
+#endif
+
+/** \brief Maximum number of slots probed when looking up a key */
+#define ATCA_JWT_KEY_CACHE_PROBES   (8u)
+
+/** \brief Work shared between the verification workers */
+typedef struct
+{
+    atca_jwt_key_cache_t*   cache;
+    atca_jwt_verify_item_t* items;
+    atca_jwt_key_entry_t**  keys;
+    size_t                  count;
+    size_t                  next;
+#if ATCA_JWT_VERIFY_THREADS_EN
+    pthread_mutex_t         lock;
+#endif
+} atca_jwt_batch_t;
+
+static void atca_jwt_key_lock(atca_jwt_key_entry_t* entry)
+{
+#if ATCA_JWT_VERIFY_THREADS_EN
+    (void)pthread_mutex_lock((pthread_mutex_t*)entry->lock);
+#else
+    ((void)entry);
+#endif
+}
+
+static void atca_jwt_key_unlock(atca_jwt_key_entry_t* entry)
+{
+#if ATCA_JWT_VERIFY_THREADS_EN
+    (void)pthread_mutex_unlock((pthread_mutex_t*)entry->lock);
+#else
+    ((void)entry);
+#endif
+}
+
+static void atca_jwt_key_cache_lock(atca_jwt_key_cache_t* cache)
+{
+#if ATCA_JWT_VERIFY_THREADS_EN
+    (void)pthread_mutex_lock((pthread_mutex_t*)cache->lock);
+#else
+    ((void)cache);
+#endif
+}
+
+static void atca_jwt_key_cache_unlock(atca_jwt_key_cache_t* cache)
+{
+#if ATCA_JWT_VERIFY_THREADS_EN
+    (void)pthread_mutex_unlock((pthread_mutex_t*)cache->lock);
+#else
+    ((void)cache);
+#endif
+}
+
+/**
+ * \brief Initialize a key cache over caller provided entry storage
+ */
+ATCA_STATUS atca_jwt_key_cache_init(
+    atca_jwt_key_cache_t* cache,    /**< [in] Cache to initialize */
+    atca_jwt_key_entry_t* entries,  /**< [in] Storage for the cached keys */
+    size_t                count     /**< [in] Number of entries */
+    )
+{
+    size_t i;
+
+    if (!cache || !entries || !count)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memset(entries, 0, count * sizeof(*entries));
+    cache->entries = entries;
+    cache->count = count;
+    cache->lock = NULL;
+
+#if ATCA_JWT_VERIFY_THREADS_EN
+    if (NULL == (cache->lock = hal_malloc(sizeof(pthread_mutex_t))))
+    {
+        atca_jwt_key_cache_free(cache);
+        return ATCA_ALLOC_FAILURE;
+    }
+    (void)pthread_mutex_init((pthread_mutex_t*)cache->lock, NULL);
+
+    for (i = 0; i < count; i++)
+    {
+        if (NULL == (entries[i].lock = hal_malloc(sizeof(pthread_mutex_t))))
+        {
+            atca_jwt_key_cache_free(cache);
+            return ATCA_ALLOC_FAILURE;
+        }
+        (void)pthread_mutex_init((pthread_mutex_t*)entries[i].lock, NULL);
+    }
+#else
+    ((void)i);
+#endif
+    return ATCA_SUCCESS;
+}
+
+/**
+ * \brief Release every parsed key held by the cache
+ */
+void atca_jwt_key_cache_free(
+    atca_jwt_key_cache_t* cache     /**< [in] Cache to release */
+    )
+{
+    size_t i;
+
+    if (cache && cache->entries)
+    {
+        for (i = 0; i < cache->count; i++)
+        {
+            atca_jwt_key_entry_t* entry = &cache->entries[i];
+            if (entry->valid)
+            {
+                (void)atcac_pk_free(&entry->pkey);
+                entry->valid = 0;
+            }
+#if ATCA_JWT_VERIFY_THREADS_EN
+            if (entry->lock)
+            {
+                (void)pthread_mutex_destroy((pthread_mutex_t*)entry->lock);
+                hal_free(entry->lock);
+                entry->lock = NULL;
+            }
+#endif
+        }
+#if ATCA_JWT_VERIFY_THREADS_EN
+        if (cache->lock)
+        {
+            (void)pthread_mutex_destroy((pthread_mutex_t*)cache->lock);
+            hal_free(cache->lock);
+            cache->lock = NULL;
+        }
+#endif
+        cache->entries = NULL;
+        cache->count = 0;
+    }
+}
+
+/**
+ * \brief Find the cached key for key_id, parsing pubkey into a free or
+ * unpinned slot if it is not cached yet. A cached key that differs from
+ * pubkey is replaced, unless a token in progress still references it.
+ * Called with the cache locked.
+ */
+static ATCA_STATUS atca_jwt_key_cache_get(
+    atca_jwt_key_cache_t*  cache,   /**< [in] Key cache */
+    const uint8_t*         key_id,  /**< [in] Key identifier */
+    const uint8_t*         pubkey,  /**< [in] Raw public key or NULL */
+    atca_jwt_key_entry_t** ppEntry  /**< [out] Cache entry holding the key */
+    )
+{
+    atca_jwt_key_entry_t* victim = NULL;
+    size_t home = 0;
+    size_t i;
+
+    /* FNV-1a of the key id selects the home slot */
+    {
+        uint32_t hash = 0x811C9DC5u;
+        for (i = 0; i < ATCA_JWT_KEY_ID_SIZE; i++)
+        {
+            hash = (hash ^ key_id[i]) * 0x01000193u;
+        }
+        home = (size_t)hash % cache->count;
+    }
+
+    for (i = 0; i < ATCA_JWT_KEY_CACHE_PROBES && i < cache->count; i++)
+    {
+        atca_jwt_key_entry_t* entry = &cache->entries[(home + i) % cache->count];
+
+        if (entry->valid && !memcmp(entry->key_id, key_id, ATCA_JWT_KEY_ID_SIZE))
+        {
+            if (!pubkey || !memcmp(entry->pubkey, pubkey, ATCA_ECCP256_PUBKEY_SIZE))
+            {
+                *ppEntry = entry;
+                return ATCA_SUCCESS;
+            }
+            if (entry->pinned)
+            {
+                /* Tokens verified against the cached key are in progress */
+                return ATCA_BAD_PARAM;
+            }
+            /* The key for this id changed - parse the new one in place */
+            victim = entry;
+            break;
+        }
+
+        if (!victim && (!entry->valid || !entry->pinned))
+        {
+            victim = entry;
+        }
+    }
+
+    if (!pubkey)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    if (!victim)
+    {
+        /* Every candidate is in use by this batch */
+        return ATCA_ALLOC_FAILURE;
+    }
+
+    if (victim->valid)
+    {
+        (void)atcac_pk_free(&victim->pkey);
+        victim->valid = 0;
+    }
+
+    if (ATCA_SUCCESS != atcac_pk_init(&victim->pkey, pubkey, ATCA_ECCP256_PUBKEY_SIZE, 0, true))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    memcpy(victim->key_id, key_id, ATCA_JWT_KEY_ID_SIZE);
+    memcpy(victim->pubkey, pubkey, ATCA_ECCP256_PUBKEY_SIZE);
+    victim->valid = 1;
+    *ppEntry = victim;
+
+    return ATCA_SUCCESS;
+}
+
+/**
+ * \brief Pull tokens off the batch until it is exhausted
+ */
+static void* atca_jwt_verify_worker(void* arg)
+{
+    atca_jwt_batch_t* batch = (atca_jwt_batch_t*)arg;
+    uint8_t digest[ATCA_SHA256_DIGEST_SIZE];
+    uint8_t signature[ATCA_ECCP256_SIG_SIZE];
+
+    for (;;)
+    {
+        atca_jwt_verify_item_t* item;
+        atca_jwt_key_entry_t* entry;
+        size_t idx;
+
+#if ATCA_JWT_VERIFY_THREADS_EN
+        (void)pthread_mutex_lock(&batch->lock);
+#endif
+        idx = batch->next++;
+#if ATCA_JWT_VERIFY_THREADS_EN
+        (void)pthread_mutex_unlock(&batch->lock);
+#endif
+
+        if (idx >= batch->count)
+        {
+            break;
+        }
+
+        item = &batch->items[idx];
+        if (NULL == (entry = batch->keys[idx]))
+        {
+            continue;
+        }
+
+        if (ATCA_SUCCESS != (item->status = atca_jwt_parse_signed(item->token, item->token_len, digest, signature)))
+        {
+            continue;
+        }
+
+        atca_jwt_key_lock(entry);
+        item->status = atcac_pk_verify(&entry->pkey, digest, sizeof(digest), signature, sizeof(signature));
+        atca_jwt_key_unlock(entry);
+
+        if (ATCA_SUCCESS != item->status)
+        {
+            item->status = ATCA_CHECKMAC_VERIFY_FAILED;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Verify a batch of jwts signed by keys held in (or added to) the key
+ * cache. Keys are resolved up front so the workers only hash and verify.
+ * A token whose pubkey differs from the key cached for its key_id replaces
+ * the cached key, or fails with ATCA_BAD_PARAM while tokens verified against
+ * the cached key are in progress.
+ *
+ * \return ATCA_SUCCESS if the batch was processed - the result for each token
+ *         is reported in its status field
+ */
+ATCA_STATUS atca_jwt_verify_batch(
+    atca_jwt_key_cache_t*   cache,      /**< [in] Parsed public key cache */
+    atca_jwt_verify_item_t* items,      /**< [inout] Tokens to verify */
+    size_t                  count,      /**< [in] Number of tokens */
+    size_t                  workers     /**< [in] Number of worker threads (0 or 1 verifies on the calling thread) */
+    )
+{
+    atca_jwt_batch_t batch;
+    size_t i;
+
+    if (!cache || !cache->entries || !items || !count)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    if (NULL == (batch.keys = hal_malloc(count * sizeof(atca_jwt_key_entry_t*))))
+    {
+        return ATCA_ALLOC_FAILURE;
+    }
+
+    batch.cache = cache;
+    batch.items = items;
+    batch.count = count;
+    batch.next = 0;
+
+    /* Resolve every key before verification starts - entries are pinned so
+       they can not be evicted or replaced by a later token in this or a
+       concurrent batch */
+    atca_jwt_key_cache_lock(cache);
+    for (i = 0; i < count; i++)
+    {
+        batch.keys[i] = NULL;
+        if (!items[i].token || !items[i].token_len || !items[i].key_id)
+        {
+            items[i].status = ATCA_BAD_PARAM;
+        }
+        else if (ATCA_SUCCESS == (items[i].status = atca_jwt_key_cache_get(cache, items[i].key_id,
+                                                                           items[i].pubkey, &batch.keys[i])))
+        {
+            batch.keys[i]->pinned++;
+        }
+    }
+    atca_jwt_key_cache_unlock(cache);
+
+#if ATCA_JWT_VERIFY_THREADS_EN
+    (void)pthread_mutex_init(&batch.lock, NULL);
+
+    if (workers > ATCA_JWT_VERIFY_MAX_WORKERS)
+    {
+        workers = ATCA_JWT_VERIFY_MAX_WORKERS;
+    }
+    if (workers > count)
+    {
+        workers = count;
+    }
+
+    if (workers > 1)
+    {
+        pthread_t threads[ATCA_JWT_VERIFY_MAX_WORKERS];
+        size_t started = 0;
+
+        /* The calling thread is one of the workers */
+        for (i = 1; i < workers; i++)
+        {
+            if (0 == pthread_create(&threads[started], NULL, atca_jwt_verify_worker, &batch))
+            {
+                started++;
+            }
+        }
+
+        (void)atca_jwt_verify_worker(&batch);
+
+        for (i = 0; i < started; i++)
+        {
+            (void)pthread_join(threads[i], NULL);
+        }
+    }
+    else
+    {
+        (void)atca_jwt_verify_worker(&batch);
+    }
+
+    (void)pthread_mutex_destroy(&batch.lock);
+#else
+    ((void)workers);
+    (void)atca_jwt_verify_worker(&batch);
+#endif
+
+    atca_jwt_key_cache_lock(cache);
+    for (i = 0; i < count; i++)
+    {
+        if (batch.keys[i])
+        {
+            batch.keys[i]->pinned--;
+        }
+    }
+    atca_jwt_key_cache_unlock(cache);
+
+    hal_free(batch.keys);
+
+    return ATCA_SUCCESS;
+}
+#endif
@@ -33,17 +33,27 @@
    @{ */
 
 #include "cryptoauthlib.h"
+#include "crypto/atca_crypto_sw_sha2.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/** \brief Structure to hold metadata information about the jwt being built */
+/** \brief Structure to hold metadata information about the jwt being built
+ *
+ * Claims are base64url encoded as they are added and the encoded output is
+ * fed to a running SHA-256 context so finalizing only has to sign the digest
+ * and append the encoded signature.
+ */
 typedef struct
 {
-    char*    buf;          /* Input buffer */
-    uint16_t buflen;       /* Total buffer size */
-    uint16_t cur;          /* Current location in the buffer */
+    char*              buf;         /* Input buffer */
+    uint16_t           buflen;      /* Total buffer size */
+    uint16_t           cur;         /* Current location in the buffer */
+    atcac_sha2_256_ctx sha;         /* Digest of the encoded header and payload */
+    uint8_t            pending[3];  /* Payload bytes waiting for a full base64 group */
+    uint8_t            pending_len; /* Number of valid bytes in pending */
+    uint8_t            claims;      /* Non-zero once the payload object has been opened */
 } atca_jwt_t;
 
 ATCA_STATUS atca_jwt_init(atca_jwt_t* jwt, char* buf, uint16_t buflen);
@@ -56,6 +66,44 @@ void atca_jwt_check_payload_start(atca_jwt_t* jwt);
 ATCA_STATUS atca_jwt_verify(const char* buf, uint16_t buflen, const uint8_t* pubkey);
 #endif
 
+#if ATCA_HOSTLIB_EN && ATCAC_VERIFY_EN
+/** \brief Parsed public key held by the verification key cache */
+typedef struct
+{
+    uint8_t      key_id[ATCA_JWT_KEY_ID_SIZE];     /* Lookup key (e.g. device serial number) */
+    uint8_t      pubkey[ATCA_ECCP256_PUBKEY_SIZE]; /* Raw public key the entry was parsed from */
+    uint8_t      valid;                            /* Entry holds a parsed key */
+    size_t       pinned;                           /* Number of batches in progress referencing the key */
+    void*        lock;                             /* Serializes use of pkey between workers */
+    atcac_pk_ctx pkey;                             /* Parsed public key */
+} atca_jwt_key_entry_t;
+
+/** \brief Keyed cache of parsed public keys for atca_jwt_verify_batch. The
+ * entry storage is provided by the caller. With ATCA_JWT_VERIFY_THREADS_EN the
+ * cache may be shared by concurrent batches, otherwise it must only be used
+ * from one thread. */
+typedef struct
+{
+    atca_jwt_key_entry_t* entries;
+    size_t                count;
+    void*                 lock;     /* Serializes lookups and pinning between batches */
+} atca_jwt_key_cache_t;
+
+/** \brief One token of a verification batch */
+typedef struct
+{
+    const char*    token;       /* [in] Encoded jwt */
+    uint16_t       token_len;   /* [in] Length of the encoded jwt */
+    const uint8_t* key_id;      /* [in] ATCA_JWT_KEY_ID_SIZE byte key identifier */
+    const uint8_t* pubkey;      /* [in] Raw public key, only needed if not cached yet (may be NULL) */
+    ATCA_STATUS    status;      /* [out] Result of the verification */
+} atca_jwt_verify_item_t;
+
+ATCA_STATUS atca_jwt_key_cache_init(atca_jwt_key_cache_t* cache, atca_jwt_key_entry_t* entries, size_t count);
+void atca_jwt_key_cache_free(atca_jwt_key_cache_t* cache);
+ATCA_STATUS atca_jwt_verify_batch(atca_jwt_key_cache_t* cache, atca_jwt_verify_item_t* items, size_t count, size_t workers);
+#endif
+
 /** @} */
 #ifdef __cplusplus
 }
@@ -42,8 +42,293 @@
 #include "cryptoauthlib.h"
 #include "atca_basic.h"
 #include "atca_mbedtls_wrap.h"
+#include "atca_mbedtls_offload.h"
 #include <string.h>
 
+/* Ephemeral key pool
+ *
+ * GenKey is by far the slowest step of an ECDHE handshake so keys can be
+ * generated ahead of time into spare slots and handed out when the handshake
+ * asks for one. Every key is handed out exactly once: it is regenerated by
+ * atca_mbedtls_ecdh_pool_refill after the shared secret has been computed
+ * with it, after the handshake gave it back with atca_mbedtls_ecdh_pool_abandon
+ * or once it has been out for ATCA_MBEDTLS_ECDH_POOL_TIMEOUT_MS. The private
+ * key value handed to mbedTLS carries a ticket next to the slot so a
+ * handshake whose key was reclaimed cannot use the replacement key. TempKey
+ * is not pooled as any Nonce/Sign between generation and use would overwrite
+ * it.
+ */
+
+#define ATCA_MBEDTLS_ECDH_POOL_EMPTY        (0u)   /**< Needs a new key */
+#define ATCA_MBEDTLS_ECDH_POOL_READY        (1u)   /**< Key generated and unused */
+#define ATCA_MBEDTLS_ECDH_POOL_IN_USE       (2u)   /**< Handed out to a handshake */
+
+/** \brief Bytes of the private key value: ticket (4) followed by the slot (2) */
+#define ATCA_MBEDTLS_ECDH_KEY_REF_SIZE      (6u)
+
+typedef struct
+{
+    uint16_t slot;
+    uint8_t  state;
+    uint32_t ticket;
+    uint64_t issued_us;
+    uint8_t  public_key[ATCA_PUB_KEY_SIZE];
+} atca_mbedtls_ecdh_pool_entry;
+
+static atca_mbedtls_ecdh_pool_entry g_ecdh_pool[ATCA_MBEDTLS_ECDH_POOL_SIZE];
+static size_t g_ecdh_pool_count;
+static uint32_t g_ecdh_pool_ticket;
+static void* g_ecdh_pool_mutex;
+
+static void atca_mbedtls_ecdh_pool_lock(void)
+{
+    if (g_ecdh_pool_mutex)
+    {
+        (void)hal_lock_mutex(g_ecdh_pool_mutex);
+    }
+}
+
+static void atca_mbedtls_ecdh_pool_unlock(void)
+{
+    if (g_ecdh_pool_mutex)
+    {
+        (void)hal_unlock_mutex(g_ecdh_pool_mutex);
+    }
+}
+
+/** \brief Assign the slots the ephemeral key pool may use. The slots must be
+ * configured for ECC private keys with GenKey allowed and ECDH enabled.
+ * Keys are not generated until atca_mbedtls_ecdh_pool_refill is called.
+ *
+ * \param[in] slots  List of slots reserved for ephemeral keys
+ * \param[in] count  Number of slots (0 disables the pool)
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+int atca_mbedtls_ecdh_pool_init(const uint16_t* slots, size_t count)
+{
+    size_t i;
+
+    if ((count && !slots) || (count > ATCA_MBEDTLS_ECDH_POOL_SIZE))
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    if (!g_ecdh_pool_mutex)
+    {
+        (void)hal_create_mutex(&g_ecdh_pool_mutex, "atca_ecdh_pool");
+    }
+
+    atca_mbedtls_ecdh_pool_lock();
+    mbedtls_platform_zeroize(g_ecdh_pool, sizeof(g_ecdh_pool));
+    for (i = 0; i < count; i++)
+    {
+        g_ecdh_pool[i].slot = slots[i];
+        g_ecdh_pool[i].state = ATCA_MBEDTLS_ECDH_POOL_EMPTY;
+    }
+    g_ecdh_pool_count = count;
+    atca_mbedtls_ecdh_pool_unlock();
+
+    return ATCA_SUCCESS;
+}
+
+/** \brief Generate keys for pool entries that are empty or whose key has
+ * been handed out for longer than ATCA_MBEDTLS_ECDH_POOL_TIMEOUT_MS. Intended
+ * to be called when the device is otherwise idle.
+ *
+ * \param[in] max_keys  Maximum number of GenKey commands to run (0 for no
+ *                      limit) so the caller can bound the time spent
+ * \return Number of keys generated or a negative value on error
+ */
+int atca_mbedtls_ecdh_pool_refill(size_t max_keys)
+{
+    int generated = 0;
+    uint64_t now = atca_mbedtls_offload_start();
+    size_t i;
+
+    for (i = 0; i < g_ecdh_pool_count; i++)
+    {
+        atca_mbedtls_ecdh_pool_entry* entry = &g_ecdh_pool[i];
+        uint8_t public_key[ATCA_PUB_KEY_SIZE];
+        bool refill;
+        int ret;
+
+        if (max_keys && ((size_t)generated >= max_keys))
+        {
+            break;
+        }
+
+        atca_mbedtls_ecdh_pool_lock();
+        /* Without a clock a key only comes back through the handshake */
+        refill = (ATCA_MBEDTLS_ECDH_POOL_EMPTY == entry->state)
+                 || ((ATCA_MBEDTLS_ECDH_POOL_IN_USE == entry->state) && now && entry->ticket
+                     && ((now - entry->issued_us) >= (uint64_t)ATCA_MBEDTLS_ECDH_POOL_TIMEOUT_MS * 1000u));
+        if (refill)
+        {
+            /* Take the entry out of circulation while the key is replaced.
+               Ticket 0 is never issued so the old holder's ECDH is refused */
+            entry->state = ATCA_MBEDTLS_ECDH_POOL_IN_USE;
+            entry->ticket = 0;
+        }
+        atca_mbedtls_ecdh_pool_unlock();
+
+        if (!refill)
+        {
+            continue;
+        }
+
+        ret = atcab_genkey(entry->slot, public_key);
+
+        atca_mbedtls_ecdh_pool_lock();
+        if (ATCA_SUCCESS == ret)
+        {
+            memcpy(entry->public_key, public_key, ATCA_PUB_KEY_SIZE);
+            entry->state = ATCA_MBEDTLS_ECDH_POOL_READY;
+        }
+        else
+        {
+            entry->state = ATCA_MBEDTLS_ECDH_POOL_EMPTY;
+        }
+        atca_mbedtls_ecdh_pool_unlock();
+
+        if (ATCA_SUCCESS != ret)
+        {
+            return -ret;
+        }
+        generated++;
+    }
+
+    return generated;
+}
+
+/** \brief Number of pre-generated keys ready to be handed out */
+size_t atca_mbedtls_ecdh_pool_ready(void)
+{
+    size_t ready = 0;
+    size_t i;
+
+    atca_mbedtls_ecdh_pool_lock();
+    for (i = 0; i < g_ecdh_pool_count; i++)
+    {
+        if (ATCA_MBEDTLS_ECDH_POOL_READY == g_ecdh_pool[i].state)
+        {
+            ready++;
+        }
+    }
+    atca_mbedtls_ecdh_pool_unlock();
+
+    return ready;
+}
+
+/** \brief Release the pool - pending keys are discarded */
+void atca_mbedtls_ecdh_pool_release(void)
+{
+    (void)atca_mbedtls_ecdh_pool_init(NULL, 0);
+    if (g_ecdh_pool_mutex)
+    {
+        (void)hal_destroy_mutex(g_ecdh_pool_mutex);
+        g_ecdh_pool_mutex = NULL;
+    }
+}
+
+#ifdef MBEDTLS_ECDH_GEN_PUBLIC_ALT
+/** \brief Hand out a ready key - returns false if the pool is exhausted */
+static bool atca_mbedtls_ecdh_pool_take(uint16_t* slotid, uint32_t* ticket, uint8_t* public_key)
+{
+    bool found = false;
+    size_t i;
+
+    atca_mbedtls_ecdh_pool_lock();
+    for (i = 0; i < g_ecdh_pool_count; i++)
+    {
+        atca_mbedtls_ecdh_pool_entry* entry = &g_ecdh_pool[i];
+        if (ATCA_MBEDTLS_ECDH_POOL_READY == entry->state)
+        {
+            if (!++g_ecdh_pool_ticket)
+            {
+                g_ecdh_pool_ticket = 1;
+            }
+            entry->state = ATCA_MBEDTLS_ECDH_POOL_IN_USE;
+            entry->ticket = g_ecdh_pool_ticket;
+            entry->issued_us = atca_mbedtls_offload_start();
+            *slotid = entry->slot;
+            *ticket = entry->ticket;
+            memcpy(public_key, entry->public_key, ATCA_PUB_KEY_SIZE);
+            found = true;
+            break;
+        }
+    }
+    atca_mbedtls_ecdh_pool_unlock();
+
+    return found;
+}
+#endif
+
+/** \brief Split the private key value set by mbedtls_ecdh_gen_public into
+ * the slot and the pool ticket (0 for a key that was not pooled) */
+static int atca_mbedtls_ecdh_key_ref(const mbedtls_mpi* d, uint16_t* slotid, uint32_t* ticket)
+{
+    uint8_t ref[ATCA_MBEDTLS_ECDH_KEY_REF_SIZE];
+    int ret;
+
+    if (0 == (ret = mbedtls_mpi_write_binary(d, ref, sizeof(ref))))
+    {
+        *ticket = ((uint32_t)ref[0] << 24) | ((uint32_t)ref[1] << 16) | ((uint32_t)ref[2] << 8) | ref[3];
+        *slotid = (uint16_t)(((uint16_t)ref[4] << 8) | ref[5]);
+    }
+    return ret;
+}
+
+/** \brief Check that the pooled key in slotid is still held under ticket.
+ * Returns false if slotid is a pool slot whose key was reclaimed and must not
+ * be used. With release the key is taken out of circulation so it gets
+ * replaced, otherwise the entry stays in use and its timeout starts over so
+ * the key cannot be reclaimed while the ECDH runs with it. */
+static bool atca_mbedtls_ecdh_pool_check(uint16_t slotid, uint32_t ticket, bool release)
+{
+    bool valid = true;
+    size_t i;
+
+    atca_mbedtls_ecdh_pool_lock();
+    for (i = 0; i < g_ecdh_pool_count; i++)
+    {
+        atca_mbedtls_ecdh_pool_entry* entry = &g_ecdh_pool[i];
+        if (entry->slot == slotid)
+        {
+            valid = (ATCA_MBEDTLS_ECDH_POOL_IN_USE == entry->state) && ticket && (entry->ticket == ticket);
+            if (valid && release)
+            {
+                entry->state = ATCA_MBEDTLS_ECDH_POOL_EMPTY;
+                entry->ticket = 0;
+            }
+            else if (valid)
+            {
+                entry->issued_us = atca_mbedtls_offload_start();
+            }
+        }
+    }
+    atca_mbedtls_ecdh_pool_unlock();
+
+    return valid;
+}
+
+/** \brief Give back a pooled key whose handshake ended without computing
+ * the shared secret, e.g. from the path freeing the SSL context, so the key
+ * is replaced without waiting for ATCA_MBEDTLS_ECDH_POOL_TIMEOUT_MS.
+ *
+ * \param[in] d  Private key value of the ECDH context (keys that were not
+ *               pooled or were already consumed are ignored)
+ */
+void atca_mbedtls_ecdh_pool_abandon(const mbedtls_mpi* d)
+{
+    uint16_t slotid;
+    uint32_t ticket;
+
+    if (d && !atca_mbedtls_ecdh_key_ref(d, &slotid, &ticket) && ticket)
+    {
+        (void)atca_mbedtls_ecdh_pool_check(slotid, ticket, true);
+    }
+}
+
 #ifdef MBEDTLS_ECDH_GEN_PUBLIC_ALT
 /** Generate ECDH keypair */
 int mbedtls_ecdh_gen_public(mbedtls_ecp_group *grp, mbedtls_mpi *d, mbedtls_ecp_point *Q,
@@ -53,7 +338,10 @@ int mbedtls_ecdh_gen_public(mbedtls_ecp_group *grp, mbedtls_mpi *d, mbedtls_ecp_
     int ret = 0;
     uint8_t public_key[ATCA_PUB_KEY_SIZE];
     uint8_t temp = 1;
-    uint16_t slotid = atca_mbedtls_ecdh_slot_cb();
+    uint8_t ref[ATCA_MBEDTLS_ECDH_KEY_REF_SIZE] = { 0 };
+    uint16_t slotid = 0;
+    uint32_t ticket = 0;
+    bool pooled = false;
 
     if (!grp || !d || !Q)
     {
@@ -67,10 +355,21 @@ int mbedtls_ecdh_gen_public(mbedtls_ecp_group *grp, mbedtls_mpi *d, mbedtls_ecp_
 
     if (!ret)
     {
-        ret = mbedtls_mpi_lset(d, slotid);
+        /* Use a pre-generated key if there is one, otherwise pay for GenKey now */
+        if (!(pooled = atca_mbedtls_ecdh_pool_take(&slotid, &ticket, public_key)))
+        {
+            slotid = (uint16_t)atca_mbedtls_ecdh_slot_cb();
+        }
+        ref[0] = (uint8_t)(ticket >> 24);
+        ref[1] = (uint8_t)(ticket >> 16);
+        ref[2] = (uint8_t)(ticket >> 8);
+        ref[3] = (uint8_t)ticket;
+        ref[4] = (uint8_t)(slotid >> 8);
+        ref[5] = (uint8_t)slotid;
+        ret = mbedtls_mpi_read_binary(d, ref, sizeof(ref));
     }
 
-    if (!ret)
+    if (!ret && !pooled)
     {
         ret = atcab_genkey(slotid, public_key);
     }
@@ -108,7 +407,9 @@ int mbedtls_ecdh_compute_shared(mbedtls_ecp_group *grp, mbedtls_mpi *z,
     uint8_t public_key[ATCA_PUB_KEY_SIZE];
     uint8_t shared_key[ATCA_KEY_SIZE];
     uint16_t slotid;
+    uint32_t ticket;
     uint8_t secret[ATCA_KEY_SIZE];
+    uint64_t start;
 
     if (!grp || !z || !Q || !d)
     {
@@ -132,7 +433,21 @@ int mbedtls_ecdh_compute_shared(mbedtls_ecp_group *grp, mbedtls_mpi *z,
 
     if (!ret)
     {
-        slotid = *(uint16_t*)d->p;
+        ret = atca_mbedtls_ecdh_key_ref(d, &slotid, &ticket);
+    }
+
+    /* A key that was reclaimed from this handshake is refused. The entry
+       stays in use until the ECDH has returned so a refill cannot replace the
+       key under it */
+    if (!ret && !atca_mbedtls_ecdh_pool_check(slotid, ticket, false))
+    {
+        ret = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    if (!ret)
+    {
+        /* The private key only exists inside the device */
+        start = atca_mbedtls_offload_start();
         if (ATECC608 == atcab_get_device_type())
         {
             ret = atca_mbedtls_ecdh_ioprot_cb(secret);
@@ -153,6 +468,10 @@ int mbedtls_ecdh_compute_shared(mbedtls_ecp_group *grp, mbedtls_mpi *z,
         {
             ret = atcab_ecdh(slotid, public_key, shared_key);
         }
+        atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_ECDH, ATCA_MBEDTLS_OFFLOAD_PATH_HW, start, ret);
+
+        /* A pooled key is single use whether or not the ECDH succeeded */
+        (void)atca_mbedtls_ecdh_pool_check(slotid, ticket, true);
     }
 
     if (!ret)
@@ -52,6 +52,7 @@
 #include <string.h>
 
 #include "mbedtls/atca_mbedtls_wrap.h"
+#include "mbedtls/atca_mbedtls_offload.h"
 #include "mbedtls/ecdsa.h"
 
 
@@ -64,15 +65,19 @@ int atca_mbedtls_ecdsa_sign(const mbedtls_mpi* d, mbedtls_mpi* r, mbedtls_mpi* s
     {
         atca_mbedtls_eckey_t key_info;
         uint8_t raw_sig[ATCA_ECCP256_SIG_SIZE];
+        uint64_t start;
 
         ret = mbedtls_mpi_write_binary(d, (unsigned char*)&key_info, sizeof(atca_mbedtls_eckey_t));
 
         if (!ret)
         {
+            /* The private key never leaves the device */
+            start = atca_mbedtls_offload_start();
             if (ATCA_SUCCESS != atcab_sign_ext(key_info.device, key_info.handle, msg, raw_sig))
             {
                 ret = -1;
             }
+            atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_SIGN, ATCA_MBEDTLS_OFFLOAD_PATH_HW, start, ret);
         }
 
         if (!ret)
@@ -120,17 +125,34 @@ int mbedtls_ecdsa_verify(mbedtls_ecp_group *grp,
     int ret = 0;
     uint8_t raw_sig[ATCA_SIG_SIZE];
     bool verified = false;
+    atca_mbedtls_offload_path_t path = ATCA_MBEDTLS_OFFLOAD_PATH_HW;
+    uint64_t start;
 
     if (!grp || !buf || !Q || !r || !s)
     {
         ret = MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
     }
 
-    if (grp->id != MBEDTLS_ECP_DP_SECP256R1)
+    if (!ret && grp->id != MBEDTLS_ECP_DP_SECP256R1)
     {
         ret = MBEDTLS_ERR_ECP_FEATURE_UNAVAILABLE;
     }
 
+    /* Public keys held by the host may be verified by either path */
+    if (!ret && Q->MBEDTLS_PRIVATE(Z).MBEDTLS_PRIVATE(n) == 1)
+    {
+        path = atca_mbedtls_offload_select(ATCA_MBEDTLS_OFFLOAD_VERIFY, false);
+    }
+
+    if (!ret && ATCA_MBEDTLS_OFFLOAD_PATH_SW == path)
+    {
+        start = atca_mbedtls_offload_start();
+        ret = atca_mbedtls_offload_sw_verify(grp, buf, blen, Q, r, s);
+        atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_VERIFY, path, start,
+                                    (MBEDTLS_ERR_ECP_VERIFY_FAILED == ret) ? 0 : ret);
+        return ret;
+    }
+
     /* Convert the signature to binary */
     if (!ret)
     {
@@ -141,7 +163,13 @@ int mbedtls_ecdsa_verify(mbedtls_ecp_group *grp,
         ret = mbedtls_mpi_write_binary(s, &raw_sig[ATCA_SIG_SIZE / 2], ATCA_SIG_SIZE / 2);
     }
 
-    if (Q->MBEDTLS_PRIVATE(Z).MBEDTLS_PRIVATE(n) == 1)
+    start = atca_mbedtls_offload_start();
+
+    if (ret)
+    {
+        /* Bad parameters - nothing to verify */
+    }
+    else if (Q->MBEDTLS_PRIVATE(Z).MBEDTLS_PRIVATE(n) == 1)
     {
         uint8_t public_key[ATCA_PUB_KEY_SIZE];
 
@@ -184,6 +212,12 @@ int mbedtls_ecdsa_verify(mbedtls_ecp_group *grp,
         }
     }
 
+    if (MBEDTLS_ERR_ECP_BAD_INPUT_DATA != ret && MBEDTLS_ERR_ECP_FEATURE_UNAVAILABLE != ret)
+    {
+        atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_VERIFY, path, start,
+                                    (MBEDTLS_ERR_ECP_VERIFY_FAILED == ret) ? 0 : ret);
+    }
+
     return ret;
 }
 #endif /* !MBEDTLS_ECDSA_VERIFY_ALT */
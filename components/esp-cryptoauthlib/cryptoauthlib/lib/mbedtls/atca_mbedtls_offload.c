@@ -0,0 +1,374 @@
+/**
+ * \file
+ * \brief Hardware/software offload policy for the mbedTLS integration
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+/* mbedTLS boilerplate includes */
+#include "mbedtls/version.h"
+
+#if (MBEDTLS_VERSION_NUMBER < 0x03000000)
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+/**
+ * Mbedtls-3.0 forward compatibility
+ */
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+#else /* (MBEDTLS_VERSION_NUMBER < 0x03000000) */
+#include "mbedtls/build_info.h"
+#endif /* !(MBEDTLS_VERSION_NUMBER < 0x03000000) */
+
+#include "mbedtls/ecp.h"
+#include "mbedtls/bignum.h"
+
+/* Cryptoauthlib Includes */
+#include "cryptoauthlib.h"
+#include "atca_basic.h"
+#include "crypto/atca_crypto_sw_sha2.h"
+#include "atca_mbedtls_wrap.h"
+#include "atca_mbedtls_offload.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#elif defined(__linux__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+/* Signing, key agreement and random numbers stay on the device unless told
+   otherwise - verification and hashing pick the faster path. */
+static atca_mbedtls_offload_policy_t g_offload_policy[ATCA_MBEDTLS_OFFLOAD_OP_COUNT] =
+{
+    ATCA_MBEDTLS_OFFLOAD_HW_ONLY,       /* SIGN */
+    ATCA_MBEDTLS_OFFLOAD_AUTO,          /* VERIFY */
+    ATCA_MBEDTLS_OFFLOAD_HW_ONLY,       /* ECDH */
+    ATCA_MBEDTLS_OFFLOAD_AUTO,          /* SHA */
+    ATCA_MBEDTLS_OFFLOAD_HW_ONLY,       /* RANDOM */
+};
+
+static atca_mbedtls_offload_stats_t g_offload_stats[ATCA_MBEDTLS_OFFLOAD_OP_COUNT];
+
+/** \brief Set the security policy for an operation */
+void atca_mbedtls_offload_set_policy(atca_mbedtls_offload_op_t op, atca_mbedtls_offload_policy_t policy)
+{
+    if (op < ATCA_MBEDTLS_OFFLOAD_OP_COUNT)
+    {
+        g_offload_policy[op] = policy;
+    }
+}
+
+/** \brief Get the security policy for an operation */
+atca_mbedtls_offload_policy_t atca_mbedtls_offload_get_policy(atca_mbedtls_offload_op_t op)
+{
+    return (op < ATCA_MBEDTLS_OFFLOAD_OP_COUNT) ? g_offload_policy[op] : ATCA_MBEDTLS_OFFLOAD_HW_ONLY;
+}
+
+/** \brief Choose where to run an operation
+ *
+ * \param[in] op             Operation about to be performed
+ * \param[in] key_in_device  The key only exists inside the device
+ * \return Path the operation should take
+ */
+atca_mbedtls_offload_path_t atca_mbedtls_offload_select(atca_mbedtls_offload_op_t op, bool key_in_device)
+{
+    const atca_mbedtls_offload_stats_t* stats;
+    uint32_t hw;
+    uint32_t sw;
+
+    if (key_in_device || (op >= ATCA_MBEDTLS_OFFLOAD_OP_COUNT))
+    {
+        return ATCA_MBEDTLS_OFFLOAD_PATH_HW;
+    }
+
+    switch (g_offload_policy[op])
+    {
+    case ATCA_MBEDTLS_OFFLOAD_HW_ONLY:
+        return ATCA_MBEDTLS_OFFLOAD_PATH_HW;
+    case ATCA_MBEDTLS_OFFLOAD_SW_ONLY:
+        return ATCA_MBEDTLS_OFFLOAD_PATH_SW;
+    default:
+        break;
+    }
+
+    stats = &g_offload_stats[op];
+    hw = stats->count[ATCA_MBEDTLS_OFFLOAD_PATH_HW];
+    sw = stats->count[ATCA_MBEDTLS_OFFLOAD_PATH_SW];
+
+    /* Measure both paths before trusting the averages */
+    if (hw < ATCA_MBEDTLS_OFFLOAD_PROBES)
+    {
+        return ATCA_MBEDTLS_OFFLOAD_PATH_HW;
+    }
+    if (sw < ATCA_MBEDTLS_OFFLOAD_PROBES)
+    {
+        return ATCA_MBEDTLS_OFFLOAD_PATH_SW;
+    }
+
+    if (stats->avg_us[ATCA_MBEDTLS_OFFLOAD_PATH_SW] < stats->avg_us[ATCA_MBEDTLS_OFFLOAD_PATH_HW])
+    {
+        /* Occasionally re-measure the slower path */
+        return (0 == ((hw + sw) % ATCA_MBEDTLS_OFFLOAD_REPROBE)) ? ATCA_MBEDTLS_OFFLOAD_PATH_HW : ATCA_MBEDTLS_OFFLOAD_PATH_SW;
+    }
+    else
+    {
+        return (0 == ((hw + sw) % ATCA_MBEDTLS_OFFLOAD_REPROBE)) ? ATCA_MBEDTLS_OFFLOAD_PATH_SW : ATCA_MBEDTLS_OFFLOAD_PATH_HW;
+    }
+}
+
+/** \brief Timestamp in microseconds used to measure an operation - 0 when
+ * the platform provides no clock (AUTO then prefers the device) */
+uint64_t atca_mbedtls_offload_start(void)
+{
+#if defined(ESP_PLATFORM)
+    return (uint64_t)esp_timer_get_time();
+#elif defined(__linux__) || defined(__APPLE__)
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+#else
+    return 0;
+#endif
+}
+
+/** \brief Record the outcome of an operation started with
+ * atca_mbedtls_offload_start */
+void atca_mbedtls_offload_record(atca_mbedtls_offload_op_t op, atca_mbedtls_offload_path_t path, uint64_t start, int result)
+{
+    atca_mbedtls_offload_stats_t* stats;
+    uint32_t elapsed;
+
+    if ((op >= ATCA_MBEDTLS_OFFLOAD_OP_COUNT) || (path >= ATCA_MBEDTLS_OFFLOAD_PATH_COUNT))
+    {
+        return;
+    }
+
+    stats = &g_offload_stats[op];
+    elapsed = (uint32_t)(atca_mbedtls_offload_start() - start);
+
+    if (result)
+    {
+        stats->failures[path]++;
+    }
+
+    /* Moving average over the last 8 samples */
+    if (stats->count[path]++)
+    {
+        stats->avg_us[path] = stats->avg_us[path] - (stats->avg_us[path] >> 3) + (elapsed >> 3);
+    }
+    else
+    {
+        stats->avg_us[path] = elapsed;
+    }
+
+    if (elapsed > stats->max_us[path])
+    {
+        stats->max_us[path] = elapsed;
+    }
+}
+
+/** \brief Copy the statistics for an operation */
+int atca_mbedtls_offload_get_stats(atca_mbedtls_offload_op_t op, atca_mbedtls_offload_stats_t* stats)
+{
+    if ((op >= ATCA_MBEDTLS_OFFLOAD_OP_COUNT) || !stats)
+    {
+        return ATCA_BAD_PARAM;
+    }
+    memcpy(stats, &g_offload_stats[op], sizeof(*stats));
+    return ATCA_SUCCESS;
+}
+
+/** \brief Clear all statistics - AUTO will re-measure both paths */
+void atca_mbedtls_offload_reset_stats(void)
+{
+    memset(g_offload_stats, 0, sizeof(g_offload_stats));
+}
+
+/** \brief SHA256 of a message using the path chosen by the policy */
+int atca_mbedtls_offload_sha256(const uint8_t* data, size_t data_size, uint8_t* digest)
+{
+    atca_mbedtls_offload_path_t path = ATCA_MBEDTLS_OFFLOAD_PATH_SW;
+    uint64_t start;
+    int ret;
+
+    if (!data || !digest)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    /* The device API takes a 16 bit length */
+    if (data_size <= UINT16_MAX)
+    {
+        path = atca_mbedtls_offload_select(ATCA_MBEDTLS_OFFLOAD_SHA, false);
+    }
+
+    start = atca_mbedtls_offload_start();
+    if (ATCA_MBEDTLS_OFFLOAD_PATH_HW == path)
+    {
+        ret = atcab_sha((uint16_t)data_size, data, digest);
+    }
+    else
+    {
+        ret = atcac_sw_sha2_256(data, data_size, digest);
+    }
+    atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_SHA, path, start, ret);
+
+    return ret;
+}
+
+/** \brief Random bytes either straight from the device RNG or from the
+ * host DRBG that the device entropy pool seeds (atca_mbedtls_rng_random) */
+int atca_mbedtls_offload_random(uint8_t* data, size_t data_size)
+{
+    uint8_t block[RANDOM_NUM_SIZE];
+    uint64_t start;
+    size_t copy;
+    int ret = ATCA_SUCCESS;
+
+    if (!data)
+    {
+        return ATCA_BAD_PARAM;
+    }
+
+    start = atca_mbedtls_offload_start();
+#if defined(MBEDTLS_CTR_DRBG_C)
+    if (ATCA_MBEDTLS_OFFLOAD_PATH_SW == atca_mbedtls_offload_select(ATCA_MBEDTLS_OFFLOAD_RANDOM, false))
+    {
+        ret = atca_mbedtls_rng_random(NULL, data, data_size);
+        atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_RANDOM, ATCA_MBEDTLS_OFFLOAD_PATH_SW, start, ret);
+        return ret;
+    }
+#endif
+    while (data_size && (ATCA_SUCCESS == ret))
+    {
+        if (ATCA_SUCCESS == (ret = atcab_random(block)))
+        {
+            copy = (data_size < sizeof(block)) ? data_size : sizeof(block);
+            memcpy(data, block, copy);
+            data += copy;
+            data_size -= copy;
+        }
+    }
+    memset(block, 0, sizeof(block));
+    atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_RANDOM, ATCA_MBEDTLS_OFFLOAD_PATH_HW, start, ret);
+
+    return ret;
+}
+
+/** \brief Software ECDSA verification (SEC1 4.1.4) built on the public ECP
+ * API so it is still available when MBEDTLS_ECDSA_VERIFY_ALT replaces
+ * mbedtls_ecdsa_verify
+ */
+int atca_mbedtls_offload_sw_verify(
+    struct mbedtls_ecp_group*       grp,
+    const unsigned char*            buf,
+    size_t                          blen,
+    const struct mbedtls_ecp_point* Q,
+    const struct mbedtls_mpi*       r,
+    const struct mbedtls_mpi*       s
+    )
+{
+    int ret;
+    mbedtls_mpi e, s_inv, u1, u2;
+    mbedtls_ecp_point R;
+    size_t n_size;
+
+    if (!grp || !buf || !Q || !r || !s)
+    {
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+
+    /* 1 <= r, s < n */
+    if ((mbedtls_mpi_cmp_int(r, 1) < 0) || (mbedtls_mpi_cmp_mpi(r, &grp->N) >= 0)
+        || (mbedtls_mpi_cmp_int(s, 1) < 0) || (mbedtls_mpi_cmp_mpi(s, &grp->N) >= 0))
+    {
+        return MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+    mbedtls_mpi_init(&e);
+    mbedtls_mpi_init(&s_inv);
+    mbedtls_mpi_init(&u1);
+    mbedtls_mpi_init(&u2);
+    mbedtls_ecp_point_init(&R);
+
+    /* Use the leftmost bits of the hash (n is byte aligned for P256) */
+    n_size = (grp->nbits + 7) / 8;
+    ret = mbedtls_mpi_read_binary(&e, buf, (blen < n_size) ? blen : n_size);
+
+    if (!ret)
+    {
+        ret = mbedtls_mpi_inv_mod(&s_inv, s, &grp->N);
+    }
+
+    /* u1 = e / s mod n, u2 = r / s mod n */
+    if (!ret)
+    {
+        ret = mbedtls_mpi_mul_mpi(&u1, &e, &s_inv);
+    }
+    if (!ret)
+    {
+        ret = mbedtls_mpi_mod_mpi(&u1, &u1, &grp->N);
+    }
+    if (!ret)
+    {
+        ret = mbedtls_mpi_mul_mpi(&u2, r, &s_inv);
+    }
+    if (!ret)
+    {
+        ret = mbedtls_mpi_mod_mpi(&u2, &u2, &grp->N);
+    }
+
+    /* R = u1 G + u2 Q */
+    if (!ret)
+    {
+        ret = mbedtls_ecp_muladd(grp, &R, &u1, &grp->G, &u2, Q);
+    }
+
+    if (!ret && mbedtls_ecp_is_zero(&R))
+    {
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+    /* Check R.x mod n == r */
+    if (!ret)
+    {
+        ret = mbedtls_mpi_mod_mpi(&R.MBEDTLS_PRIVATE(X), &R.MBEDTLS_PRIVATE(X), &grp->N);
+    }
+    if (!ret && mbedtls_mpi_cmp_mpi(&R.MBEDTLS_PRIVATE(X), r))
+    {
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+    mbedtls_ecp_point_free(&R);
+    mbedtls_mpi_free(&u2);
+    mbedtls_mpi_free(&u1);
+    mbedtls_mpi_free(&s_inv);
+    mbedtls_mpi_free(&e);
+
+    return ret;
+}
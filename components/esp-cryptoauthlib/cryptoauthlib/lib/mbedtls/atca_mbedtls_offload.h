@@ -0,0 +1,120 @@
+/**
+ * \file
+ * \brief Hardware/software offload policy for the mbedTLS integration
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+#ifndef _ATCA_MBEDTLS_OFFLOAD_H_
+#define _ATCA_MBEDTLS_OFFLOAD_H_
+
+/** \defgroup atca_mbedtls_offload_ mbedTLS Offload Policy (atca_mbedtls_offload_)
+ *
+ * \brief
+ * Routes each cryptographic operation either to the device or to the host's
+ * software implementation based on where the key lives, the configured
+ * security policy and the latency measured for each path.
+ *
+   @{ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Number of samples taken of each path before AUTO starts choosing */
+#ifndef ATCA_MBEDTLS_OFFLOAD_PROBES
+#define ATCA_MBEDTLS_OFFLOAD_PROBES     (4)
+#endif
+
+/** \brief AUTO takes the slower path once every this many operations so its
+ * latency estimate stays current */
+#ifndef ATCA_MBEDTLS_OFFLOAD_REPROBE
+#define ATCA_MBEDTLS_OFFLOAD_REPROBE    (64)
+#endif
+
+/** \brief Operations routed by the offload policy */
+typedef enum
+{
+    ATCA_MBEDTLS_OFFLOAD_SIGN = 0,
+    ATCA_MBEDTLS_OFFLOAD_VERIFY,
+    ATCA_MBEDTLS_OFFLOAD_ECDH,
+    ATCA_MBEDTLS_OFFLOAD_SHA,
+    ATCA_MBEDTLS_OFFLOAD_RANDOM,
+    ATCA_MBEDTLS_OFFLOAD_OP_COUNT
+} atca_mbedtls_offload_op_t;
+
+/** \brief Where an operation was executed */
+typedef enum
+{
+    ATCA_MBEDTLS_OFFLOAD_PATH_HW = 0,
+    ATCA_MBEDTLS_OFFLOAD_PATH_SW,
+    ATCA_MBEDTLS_OFFLOAD_PATH_COUNT
+} atca_mbedtls_offload_path_t;
+
+/** \brief Security policy for an operation */
+typedef enum
+{
+    ATCA_MBEDTLS_OFFLOAD_AUTO = 0,      /**< Use the path with the lowest measured latency */
+    ATCA_MBEDTLS_OFFLOAD_HW_ONLY,       /**< Always use the device */
+    ATCA_MBEDTLS_OFFLOAD_SW_ONLY        /**< Use software unless the key only exists in the device */
+} atca_mbedtls_offload_policy_t;
+
+/** \brief Per operation statistics, indexed by atca_mbedtls_offload_path_t */
+typedef struct
+{
+    uint32_t count[ATCA_MBEDTLS_OFFLOAD_PATH_COUNT];
+    uint32_t failures[ATCA_MBEDTLS_OFFLOAD_PATH_COUNT];
+    uint32_t avg_us[ATCA_MBEDTLS_OFFLOAD_PATH_COUNT];   /**< Moving average latency */
+    uint32_t max_us[ATCA_MBEDTLS_OFFLOAD_PATH_COUNT];
+} atca_mbedtls_offload_stats_t;
+
+void atca_mbedtls_offload_set_policy(atca_mbedtls_offload_op_t op, atca_mbedtls_offload_policy_t policy);
+atca_mbedtls_offload_policy_t atca_mbedtls_offload_get_policy(atca_mbedtls_offload_op_t op);
+atca_mbedtls_offload_path_t atca_mbedtls_offload_select(atca_mbedtls_offload_op_t op, bool key_in_device);
+uint64_t atca_mbedtls_offload_start(void);
+void atca_mbedtls_offload_record(atca_mbedtls_offload_op_t op, atca_mbedtls_offload_path_t path, uint64_t start, int result);
+int atca_mbedtls_offload_get_stats(atca_mbedtls_offload_op_t op, atca_mbedtls_offload_stats_t* stats);
+void atca_mbedtls_offload_reset_stats(void);
+
+int atca_mbedtls_offload_sha256(const uint8_t* data, size_t data_size, uint8_t* digest);
+int atca_mbedtls_offload_random(uint8_t* data, size_t data_size);
+
+struct mbedtls_ecp_group;
+struct mbedtls_ecp_point;
+struct mbedtls_mpi;
+
+int atca_mbedtls_offload_sw_verify(struct mbedtls_ecp_group* grp, const unsigned char* buf, size_t blen,
+                                   const struct mbedtls_ecp_point* Q, const struct mbedtls_mpi* r,
+                                   const struct mbedtls_mpi* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif /* _ATCA_MBEDTLS_OFFLOAD_H_ */
@@ -0,0 +1,439 @@
+/**
+ * \brief Buffered hardware entropy pool feeding an mbedTLS CTR_DRBG.
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+/* mbedTLS boilerplate includes */
+#include "mbedtls/version.h"
+
+#if (MBEDTLS_VERSION_NUMBER < 0x03000000)
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+#else /* (MBEDTLS_VERSION_NUMBER < 0x03000000) */
+#include "mbedtls/build_info.h"
+#endif /* !(MBEDTLS_VERSION_NUMBER < 0x03000000) */
+
+#if defined(MBEDTLS_CTR_DRBG_C)
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/platform_util.h"
+
+/* Cryptoauthlib Includes */
+#include "cryptoauthlib.h"
+#include "atca_basic.h"
+#include "atca_mbedtls_wrap.h"
+#include <string.h>
+
+/* Entropy pool
+ *
+ * Every Random command costs a wake/execute/idle cycle on the bus, which is
+ * milliseconds for 32 bytes, while TLS asks for nonces, IVs and blinding
+ * values a few bytes at a time. Output is served from a CTR_DRBG instead and
+ * the device is only used to (re)seed it. Seed material is collected ahead of
+ * time by atca_mbedtls_rng_refill in batched Random commands (one wake for
+ * several blocks) and the DRBG reseeds from the pool whenever enough output
+ * has been drawn and fresh entropy is waiting, so reads never touch the bus
+ * unless the pool has run dry at the hard reseed limit. The library does not
+ * talk to the device on its own - the application calls
+ * atca_mbedtls_rng_refill from the same context as its other device
+ * operations (e.g. between TLS sessions) so the Random commands never
+ * interleave with them.
+ *
+ * Every block taken from the device goes through continuous health tests
+ * (NIST SP 800-90B 4.4, assuming 4 bits of min-entropy per byte) before it
+ * is accepted into the pool.
+ */
+
+/* Repetition count test: cutoff for H = 4 bits/byte at alpha = 2^-20 */
+#define ATCA_MBEDTLS_RNG_RCT_CUTOFF         (6u)
+/* Adaptive proportion test: window and cutoff for H = 4 bits/byte */
+#define ATCA_MBEDTLS_RNG_APT_WINDOW         (512u)
+#define ATCA_MBEDTLS_RNG_APT_CUTOFF         (62u)
+/* Bytes the DRBG asks for on reseed */
+#define ATCA_MBEDTLS_RNG_ENTROPY_LEN        (32u)
+/* Largest single request CTR_DRBG accepts */
+#define ATCA_MBEDTLS_RNG_MAX_REQUEST        (1024u)
+
+#define ATCA_MBEDTLS_RNG_POOL_SIZE          (ATCA_MBEDTLS_RNG_POOL_BLOCKS * RANDOM_NUM_SIZE)
+
+typedef struct
+{
+    uint8_t  last;          /**< Previous byte (repetition count test) */
+    uint8_t  run;           /**< Length of the current run */
+    uint8_t  apt_value;     /**< Byte counted in the current window */
+    uint16_t apt_count;     /**< Occurrences of apt_value in the window */
+    uint16_t apt_seen;      /**< Bytes seen in the current window */
+    bool     primed;        /**< At least one byte has been tested */
+} atca_mbedtls_rng_health;
+
+static mbedtls_ctr_drbg_context g_rng_drbg;
+static uint8_t g_rng_pool[ATCA_MBEDTLS_RNG_POOL_SIZE];
+static size_t g_rng_pool_len;
+static atca_mbedtls_rng_health g_rng_health;
+static uint32_t g_rng_generated;
+static uint32_t g_rng_failures;
+static bool g_rng_seeded;
+static void* g_rng_mutex;
+
+/* The mutex is created on first use so the RNG works without
+   atca_mbedtls_rng_init, like the DRBG is seeded on first use */
+static void atca_mbedtls_rng_lock(void)
+{
+    if (!g_rng_mutex && (ATCA_SUCCESS != hal_create_mutex(&g_rng_mutex, "atca_rng_pool")))
+    {
+        g_rng_mutex = NULL;
+    }
+    if (g_rng_mutex)
+    {
+        (void)hal_lock_mutex(g_rng_mutex);
+    }
+}
+
+static void atca_mbedtls_rng_unlock(void)
+{
+    if (g_rng_mutex)
+    {
+        (void)hal_unlock_mutex(g_rng_mutex);
+    }
+}
+
+/** \brief Run the continuous health tests over one block from the device.
+ * The block is rejected when a test trips or when every 4 byte word in it is
+ * the same (a device with an unlocked configuration zone returns a fixed
+ * 0xFF 0xFF 0x00 0x00 pattern instead of random data).
+ */
+static bool atca_mbedtls_rng_health_check(atca_mbedtls_rng_health* health, const uint8_t* block)
+{
+    bool ok = false;
+    size_t i;
+
+    for (i = ATCA_WORD_SIZE; i < RANDOM_NUM_SIZE; i++)
+    {
+        if (block[i] != block[i % ATCA_WORD_SIZE])
+        {
+            ok = true;
+            break;
+        }
+    }
+
+    for (i = 0; ok && (i < RANDOM_NUM_SIZE); i++)
+    {
+        uint8_t value = block[i];
+
+        if (health->primed && (value == health->last))
+        {
+            if (++health->run >= ATCA_MBEDTLS_RNG_RCT_CUTOFF)
+            {
+                ok = false;
+            }
+        }
+        else
+        {
+            health->last = value;
+            health->run = 1;
+        }
+
+        if (!health->primed || (health->apt_seen >= ATCA_MBEDTLS_RNG_APT_WINDOW))
+        {
+            health->apt_value = value;
+            health->apt_count = 1;
+            health->apt_seen = 1;
+        }
+        else
+        {
+            health->apt_seen++;
+            if ((value == health->apt_value) && (++health->apt_count >= ATCA_MBEDTLS_RNG_APT_CUTOFF))
+            {
+                ok = false;
+            }
+        }
+        health->primed = true;
+    }
+
+    if (!ok)
+    {
+        /* Start the tests over so one bad block does not poison the next */
+        memset(health, 0, sizeof(*health));
+        g_rng_failures++;
+    }
+
+    return ok;
+}
+
+/** \brief Append health tested blocks to the pool. Must be called with the
+ * pool locked.
+ * \return ATCA_SUCCESS if every block passed, ATCA_HEALTH_TEST_ERROR otherwise
+ */
+static int atca_mbedtls_rng_pool_add(const uint8_t* blocks, size_t count)
+{
+    int ret = ATCA_SUCCESS;
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        const uint8_t* block = &blocks[i * RANDOM_NUM_SIZE];
+
+        if (!atca_mbedtls_rng_health_check(&g_rng_health, block))
+        {
+            ret = ATCA_HEALTH_TEST_ERROR;
+            continue;
+        }
+        if ((g_rng_pool_len + RANDOM_NUM_SIZE) <= sizeof(g_rng_pool))
+        {
+            memcpy(&g_rng_pool[g_rng_pool_len], block, RANDOM_NUM_SIZE);
+            g_rng_pool_len += RANDOM_NUM_SIZE;
+        }
+    }
+
+    return ret;
+}
+
+/** \brief mbedTLS entropy callback for the DRBG. Takes seed material from
+ * the pool and only goes to the device when the pool cannot cover the
+ * request. Called with the pool locked.
+ */
+static int atca_mbedtls_rng_entropy(void* ctx, unsigned char* output, size_t len)
+{
+    uint8_t blocks[2 * RANDOM_NUM_SIZE];
+    size_t copy;
+
+    ((void)ctx);
+
+    while (len)
+    {
+        if (!g_rng_pool_len)
+        {
+            if (ATCA_SUCCESS != atcab_random_batch(blocks, sizeof(blocks) / RANDOM_NUM_SIZE))
+            {
+                break;
+            }
+            (void)atca_mbedtls_rng_pool_add(blocks, sizeof(blocks) / RANDOM_NUM_SIZE);
+            if (!g_rng_pool_len)
+            {
+                break;
+            }
+        }
+
+        /* Consume from the end so the rest of the pool stays in place */
+        copy = (len < g_rng_pool_len) ? len : g_rng_pool_len;
+        g_rng_pool_len -= copy;
+        memcpy(output, &g_rng_pool[g_rng_pool_len], copy);
+        mbedtls_platform_zeroize(&g_rng_pool[g_rng_pool_len], copy);
+        output += copy;
+        len -= copy;
+    }
+    mbedtls_platform_zeroize(blocks, sizeof(blocks));
+
+    return len ? MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED : 0;
+}
+
+/** \brief Seed the DRBG from the device. Called with the pool locked. */
+static int atca_mbedtls_rng_seed(void)
+{
+    static const unsigned char personalization[] = "atca_mbedtls_rng";
+    int ret;
+
+    mbedtls_ctr_drbg_init(&g_rng_drbg);
+    mbedtls_ctr_drbg_set_entropy_len(&g_rng_drbg, ATCA_MBEDTLS_RNG_ENTROPY_LEN);
+    /* Hard limit - only reached if the pool is never refilled */
+    mbedtls_ctr_drbg_set_reseed_interval(&g_rng_drbg, 4 * ATCA_MBEDTLS_RNG_RESEED_INTERVAL);
+
+    ret = mbedtls_ctr_drbg_seed(&g_rng_drbg, atca_mbedtls_rng_entropy, NULL, personalization, sizeof(personalization) - 1);
+    if (ret)
+    {
+        mbedtls_ctr_drbg_free(&g_rng_drbg);
+        return ret;
+    }
+
+    g_rng_seeded = true;
+    g_rng_generated = 0;
+
+    return 0;
+}
+
+/** \brief Seed the DRBG from the device and fill the pool ahead of time.
+ * Optional - the RNG seeds itself on first use otherwise - but keeps the
+ * device traffic out of the first handshake.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+int atca_mbedtls_rng_init(void)
+{
+    int ret = ATCA_SUCCESS;
+
+    atca_mbedtls_rng_lock();
+    if (!g_rng_seeded && atca_mbedtls_rng_seed())
+    {
+        ret = ATCA_FUNC_FAIL;
+    }
+    atca_mbedtls_rng_unlock();
+
+    if (ATCA_SUCCESS == ret)
+    {
+        /* Seeding leaves less than a reseed worth in the pool - top it up so
+           the first soft reseed does not have to wait for a refill */
+        (void)atca_mbedtls_rng_refill(0);
+    }
+
+    return ret;
+}
+
+/** \brief Top the pool up from the device. Call it when the device is
+ * otherwise idle, from the context that owns the device - the library has no
+ * device lock, so it must not run alongside other atcab_ calls. The Random
+ * commands run in one wake window and the pool is not locked while they
+ * execute.
+ *
+ * \param[in] max_blocks  Maximum number of Random commands to run (0 for as
+ *                        many as the pool has room for)
+ * \return Number of 32 byte blocks added or a negative value on error
+ */
+int atca_mbedtls_rng_refill(size_t max_blocks)
+{
+    uint8_t blocks[ATCA_MBEDTLS_RNG_POOL_SIZE];
+    size_t count;
+    size_t before;
+    int ret;
+
+    atca_mbedtls_rng_lock();
+    count = (sizeof(g_rng_pool) - g_rng_pool_len) / RANDOM_NUM_SIZE;
+    atca_mbedtls_rng_unlock();
+
+    if (max_blocks && (count > max_blocks))
+    {
+        count = max_blocks;
+    }
+    if (!count)
+    {
+        return 0;
+    }
+
+    if (ATCA_SUCCESS != (ret = atcab_random_batch(blocks, count)))
+    {
+        mbedtls_platform_zeroize(blocks, sizeof(blocks));
+        return -ret;
+    }
+
+    atca_mbedtls_rng_lock();
+    before = g_rng_pool_len;
+    ret = atca_mbedtls_rng_pool_add(blocks, count);
+    count = (g_rng_pool_len - before) / RANDOM_NUM_SIZE;
+    atca_mbedtls_rng_unlock();
+    mbedtls_platform_zeroize(blocks, sizeof(blocks));
+
+    return (ATCA_SUCCESS == ret) ? (int)count : -ret;
+}
+
+/** \brief Bytes of health tested seed material waiting in the pool */
+size_t atca_mbedtls_rng_available(void)
+{
+    size_t available;
+
+    atca_mbedtls_rng_lock();
+    available = g_rng_pool_len;
+    atca_mbedtls_rng_unlock();
+
+    return available;
+}
+
+/** \brief Number of device blocks rejected by the health tests */
+uint32_t atca_mbedtls_rng_failures(void)
+{
+    return g_rng_failures;
+}
+
+/** \brief Random bytes from the DRBG - mbedTLS f_rng compatible so it can be
+ * handed to mbedtls_ssl_conf_rng, mbedtls_pk_sign and similar directly.
+ *
+ * \param[in]  p_rng       Unused, may be NULL
+ * \param[out] output      Random bytes are returned here
+ * \param[in]  output_len  Number of bytes requested
+ * \return 0 on success, otherwise an mbedTLS error code
+ */
+int atca_mbedtls_rng_random(void* p_rng, unsigned char* output, size_t output_len)
+{
+    int ret = 0;
+    size_t chunk;
+
+    ((void)p_rng);
+
+    if (!output)
+    {
+        return MBEDTLS_ERR_CTR_DRBG_INPUT_TOO_BIG;
+    }
+
+    atca_mbedtls_rng_lock();
+    if (!g_rng_seeded && atca_mbedtls_rng_seed())
+    {
+        atca_mbedtls_rng_unlock();
+        return MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+    }
+
+    if ((g_rng_generated >= ATCA_MBEDTLS_RNG_RESEED_INTERVAL) && (g_rng_pool_len >= ATCA_MBEDTLS_RNG_ENTROPY_LEN))
+    {
+        /* Fresh entropy is waiting - reseed now rather than at the hard limit */
+        if (0 == mbedtls_ctr_drbg_reseed(&g_rng_drbg, NULL, 0))
+        {
+            g_rng_generated = 0;
+        }
+    }
+
+    while (output_len && !ret)
+    {
+        chunk = (output_len < ATCA_MBEDTLS_RNG_MAX_REQUEST) ? output_len : ATCA_MBEDTLS_RNG_MAX_REQUEST;
+        ret = mbedtls_ctr_drbg_random(&g_rng_drbg, output, chunk);
+        output += chunk;
+        output_len -= chunk;
+        g_rng_generated++;
+    }
+    atca_mbedtls_rng_unlock();
+
+    return ret;
+}
+
+/** \brief Release the DRBG and wipe the pool */
+void atca_mbedtls_rng_release(void)
+{
+    atca_mbedtls_rng_lock();
+    if (g_rng_seeded)
+    {
+        mbedtls_ctr_drbg_free(&g_rng_drbg);
+        g_rng_seeded = false;
+    }
+    mbedtls_platform_zeroize(g_rng_pool, sizeof(g_rng_pool));
+    g_rng_pool_len = 0;
+    memset(&g_rng_health, 0, sizeof(g_rng_health));
+    atca_mbedtls_rng_unlock();
+
+    if (g_rng_mutex)
+    {
+        (void)hal_destroy_mutex(g_rng_mutex);
+        g_rng_mutex = NULL;
+    }
+}
+
+#endif /* MBEDTLS_CTR_DRBG_C */
@@ -69,6 +69,7 @@
 #include "cryptoauthlib.h"
 #include "atca_mbedtls_wrap.h"
 #include "atca_mbedtls_patch.h"
+#include "atca_mbedtls_offload.h"
 
 #include "crypto/atca_crypto_sw.h"
 #if ATCA_CA_SUPPORT
@@ -82,7 +83,7 @@
  */
 int atcac_sw_random(uint8_t* data, size_t data_size)
 {
-    return mbedtls_ctr_drbg_random(mbedtls_entropy_func, data, data_size);
+    return atca_mbedtls_rng_random(NULL, data, data_size);
 }
 
 
@@ -572,6 +573,8 @@ ATCA_STATUS atcac_sha256_hmac_finish(
 }
 
 /** \brief Set up a public/private key structure for use in asymmetric cryptographic functions
+ *
+ * A public key that is not a point on the curve is rejected.
  *
  * \return ATCA_SUCCESS on success, otherwise an error code.
  */
@@ -618,6 +621,11 @@ ATCA_STATUS atcac_pk_init(
             {
                 ret = mbedtls_mpi_read_binary(&(ecp->MBEDTLS_PRIVATE(Q).MBEDTLS_PRIVATE(Z)), &temp, 1);
             }
+
+            if (!ret)
+            {
+                ret = mbedtls_ecp_check_pubkey(&ecp->MBEDTLS_PRIVATE(grp), &ecp->MBEDTLS_PRIVATE(Q));
+            }
         }
         else
         {
@@ -627,6 +635,10 @@ ATCA_STATUS atcac_pk_init(
             }
         }
 
+        if (ret)
+        {
+            mbedtls_pk_free(ctx);
+        }
         status = (!ret) ? ATCA_SUCCESS : ATCA_FUNC_FAIL;
     }
     return status;
@@ -659,7 +671,7 @@ ATCA_STATUS atcac_pk_init_pem(
 #ifdef MBEDTLS_2X_COMPAT
             ret = mbedtls_pk_parse_key(ctx, buf, buflen, NULL, 0);
 #else
-            ret = mbedtls_pk_parse_key(ctx, buf, buflen, NULL, 0, mbedtls_ctr_drbg_random, NULL);
+            ret = mbedtls_pk_parse_key(ctx, buf, buflen, NULL, 0, atca_mbedtls_rng_random, NULL);
 #endif
         }
         status = (!ret) ? ATCA_SUCCESS : ATCA_FUNC_FAIL;
@@ -679,7 +691,8 @@ ATCA_STATUS atcac_pk_free(
 
     if (ctx)
     {
-        mbedtls_pk_init(ctx);
+        /* Releases the key and leaves the context initialized */
+        mbedtls_pk_free(ctx);
         status = ATCA_SUCCESS;
     }
     return status;
@@ -750,7 +763,7 @@ ATCA_STATUS atcac_pk_sign(
 #ifdef MBEDTLS_2X_COMPAT
             ret = mbedtls_ecdsa_sign_det(&mbedtls_pk_ec(*ctx)->MBEDTLS_PRIVATE(grp), &r, &s, &mbedtls_pk_ec(*ctx)->MBEDTLS_PRIVATE(d), digest, dig_len, MBEDTLS_MD_SHA256);
 #else
-            ret = mbedtls_ecdsa_sign_det_ext(&mbedtls_pk_ec(*ctx)->MBEDTLS_PRIVATE(grp), &r, &s, &mbedtls_pk_ec(*ctx)->MBEDTLS_PRIVATE(d), digest, dig_len, MBEDTLS_MD_SHA256, mbedtls_ctr_drbg_random, NULL);
+            ret = mbedtls_ecdsa_sign_det_ext(&mbedtls_pk_ec(*ctx)->MBEDTLS_PRIVATE(grp), &r, &s, &mbedtls_pk_ec(*ctx)->MBEDTLS_PRIVATE(d), digest, dig_len, MBEDTLS_MD_SHA256, atca_mbedtls_rng_random, NULL);
 #endif
             if (!ret)
             {
@@ -772,7 +785,7 @@ ATCA_STATUS atcac_pk_sign(
 #ifdef MBEDTLS_2X_COMPAT
             ret = mbedtls_pk_sign(ctx, MBEDTLS_MD_SHA256, digest, dig_len, signature, sig_len, NULL, NULL);
 #else
-            ret = mbedtls_pk_sign(ctx, MBEDTLS_MD_SHA256, digest, dig_len, signature, *sig_len, sig_len, mbedtls_ctr_drbg_random, NULL);
+            ret = mbedtls_pk_sign(ctx, MBEDTLS_MD_SHA256, digest, dig_len, signature, *sig_len, sig_len, atca_mbedtls_rng_random, NULL);
 #endif
         break;
         default:
@@ -901,10 +914,20 @@ static int atca_mbedtls_eckey_verify(void *ctx, mbedtls_md_type_t md_alg,
 #else
     int ret = -1;
     mbedtls_ecp_keypair *ecp = (mbedtls_ecp_keypair*)ctx;
+    uint64_t start = atca_mbedtls_offload_start();
 
     (void)md_alg;
     (void)hash_len;
 
+    /* The public key is held by the host so software may be faster */
+    if (ATCA_MBEDTLS_OFFLOAD_PATH_SW == atca_mbedtls_offload_select(ATCA_MBEDTLS_OFFLOAD_VERIFY, false))
+    {
+        ret = mbedtls_pk_info_from_type(MBEDTLS_PK_ECKEY)->verify_func(ctx, md_alg, hash, hash_len, sig, sig_len);
+        atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_VERIFY, ATCA_MBEDTLS_OFFLOAD_PATH_SW, start,
+                                    (MBEDTLS_ERR_ECP_VERIFY_FAILED == ret) ? 0 : ret);
+        return ret;
+    }
+
     if (ecp && hash && sig)
     {
         mbedtls_mpi r, s;
@@ -972,6 +995,8 @@ static int atca_mbedtls_eckey_verify(void *ctx, mbedtls_md_type_t md_alg,
 //                ret = atcab_verify_stored_ext(key_info.device, hash, signature, key_info.handle, &is_verified);
 //            }
 
+            atca_mbedtls_offload_record(ATCA_MBEDTLS_OFFLOAD_VERIFY, ATCA_MBEDTLS_OFFLOAD_PATH_HW, start, ret);
+
             if (ATCA_SUCCESS == ret)
             {
                 ret = is_verified ? 0 : -1;
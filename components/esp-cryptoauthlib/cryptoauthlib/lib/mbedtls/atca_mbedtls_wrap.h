@@ -65,6 +65,45 @@ int atca_mbedtls_pk_init_ext(ATCADevice device, struct mbedtls_pk_context * pkey
 int atca_mbedtls_pk_init(struct mbedtls_pk_context * pkey, const uint16_t slotid);
 int atca_mbedtls_cert_add(struct mbedtls_x509_crt * cert, const struct atcacert_def_s * cert_def);
 
+/** \brief Maximum number of slots that can be assigned to the ephemeral ECDH
+ * key pool */
+#ifndef ATCA_MBEDTLS_ECDH_POOL_SIZE
+#define ATCA_MBEDTLS_ECDH_POOL_SIZE     (4)
+#endif
+
+/** \brief Time after which a pooled key handed out to a handshake that
+ * neither used nor gave it back is regenerated by the refill */
+#ifndef ATCA_MBEDTLS_ECDH_POOL_TIMEOUT_MS
+#define ATCA_MBEDTLS_ECDH_POOL_TIMEOUT_MS   (60000)
+#endif
+
+/* Ephemeral ECDH key pool */
+int atca_mbedtls_ecdh_pool_init(const uint16_t* slots, size_t count);
+int atca_mbedtls_ecdh_pool_refill(size_t max_keys);
+size_t atca_mbedtls_ecdh_pool_ready(void);
+void atca_mbedtls_ecdh_pool_abandon(const mbedtls_mpi* d);
+void atca_mbedtls_ecdh_pool_release(void);
+
+/** \brief Number of 32 byte device blocks the entropy pool holds */
+#ifndef ATCA_MBEDTLS_RNG_POOL_BLOCKS
+#define ATCA_MBEDTLS_RNG_POOL_BLOCKS    (4)
+#endif
+
+/** \brief DRBG requests served before it reseeds from the entropy pool. The
+ * DRBG only blocks on the device after four times as many requests without
+ * a refill */
+#ifndef ATCA_MBEDTLS_RNG_RESEED_INTERVAL
+#define ATCA_MBEDTLS_RNG_RESEED_INTERVAL    (1024)
+#endif
+
+/* Buffered hardware entropy pool and DRBG */
+int atca_mbedtls_rng_init(void);
+int atca_mbedtls_rng_refill(size_t max_blocks);
+size_t atca_mbedtls_rng_available(void);
+uint32_t atca_mbedtls_rng_failures(void);
+int atca_mbedtls_rng_random(void* p_rng, unsigned char* output, size_t output_len);
+void atca_mbedtls_rng_release(void);
+
 /* Application Callback definitions */
 
 /** \brief ECDH Callback to obtain the "slot" used in ECDH operations from the
@@ -576,6 +576,8 @@ ATCA_STATUS atcac_sha256_hmac_finish(
 }
 
 /** \brief Set up a public/private key structure for use in asymmetric cryptographic functions
+ *
+ * A public key that is not a point on the curve is rejected.
  *
  * \return ATCA_SUCCESS on success, otherwise an error code.
  */
@@ -608,6 +610,7 @@ ATCA_STATUS atcac_pk_init(
                 {
                     BIGNUM * x = BN_bin2bn(buf, 32, NULL);
                     BIGNUM * y = BN_bin2bn(&buf[32], 32, NULL);
+                    /* Fails for a point that is not on the curve */
                     ret = EC_POINT_set_affine_coordinates(ec_group, ec_point, x, y, NULL);
                     BN_free(y);
                     BN_free(x);
@@ -730,8 +733,8 @@ ATCA_STATUS atcac_pk_public(
 
                 if (1 == (ret = EC_POINT_get_affine_coordinates(EC_KEY_get0_group(ec_key), EC_KEY_get0_public_key(ec_key), x, y, NULL)))
             {
-                    BN_bn2bin(x, buf);
-                    BN_bn2bin(y, &buf[32]);
+                    BN_bn2binpad(x, buf, 32);
+                    BN_bn2binpad(y, &buf[32], 32);
                     *buflen = 64;
                 }
                 BN_free(x);
@@ -766,11 +769,11 @@ ATCA_STATUS atcac_pk_sign(
 
             if (ec_sig)
             {
-                ret = BN_bn2bin(ECDSA_SIG_get0_r(ec_sig), signature);
+                ret = BN_bn2binpad(ECDSA_SIG_get0_r(ec_sig), signature, 32);
                 if (0 < ret)
                 {
                     *sig_len = ret;
-                    ret = BN_bn2bin(ECDSA_SIG_get0_s(ec_sig), &signature[ret]);
+                    ret = BN_bn2binpad(ECDSA_SIG_get0_s(ec_sig), &signature[ret], 32);
                 }
                 if (0 < ret)
                 {
@@ -28,6 +28,7 @@
 #include "cryptoauthlib.h"
 #include "atcacert/atcacert_def.h"
 #include "atcacert/atcacert_client.h"
+#include "atcacert/atcacert_der.h"
 #if defined(ATCA_TNGTLS_SUPPORT) || defined(ATCA_TNGLORA_SUPPORT) || defined(ATCA_TFLEX_SUPPORT)
 #include "tng_atca.h"
 #endif
@@ -179,6 +180,17 @@ static CK_RV pkcs11_cert_load(pkcs11_object_ptr pObject, CK_ATTRIBUTE_PTR pAttri
     return ret;
 }
 
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+/* Certificate of an object with its fields located in place. The certificate
+   bytes follow the structure in the same allocation */
+typedef struct pkcs11_cert_x509_s
+{
+    atcacert_der_x509_t x509;
+    const uint8_t*      cert;
+    size_t              cert_size;
+} pkcs11_cert_x509_t;
+#endif
+
 CK_RV pkcs11_cert_get_encoded(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
 {
     pkcs11_object_ptr obj_ptr = (pkcs11_object_ptr)pObject;
@@ -187,6 +199,14 @@ CK_RV pkcs11_cert_get_encoded(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
     {
 #if defined(ATCA_TNGTLS_SUPPORT) || defined(ATCA_TNGLORA_SUPPORT) || defined(ATCA_TFLEX_SUPPORT)
         pkcs11_cert_check_trust_data(obj_ptr);
+#endif
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+        if (obj_ptr->cert_x509)
+        {
+            /* Already loaded for another attribute of this request */
+            const pkcs11_cert_x509_t* cert_x509 = (const pkcs11_cert_x509_t*)obj_ptr->cert_x509;
+            return pkcs11_attrib_fill(pAttribute, (CK_VOID_PTR)cert_x509->cert, (CK_ULONG)cert_x509->cert_size);
+        }
 #endif
         return pkcs11_cert_load(obj_ptr, pAttribute);
     }
@@ -247,72 +267,218 @@ CK_RV pkcs11_cert_get_type(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
     return rv;
 }
 
-CK_RV pkcs11_cert_get_subject(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
-{
 #if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+static CK_RV pkcs11_cert_load_x509(pkcs11_object_ptr obj_ptr)
+{
+    pkcs11_cert_x509_t* cert_x509;
+    CK_ATTRIBUTE cert_attr = { CKA_VALUE, NULL, 0 };
+    CK_RV rv;
+
+    /* Get the buffer size required first */
+    rv = pkcs11_cert_load(obj_ptr, &cert_attr);
+
+    if (CKR_OK == rv)
+    {
+        if (NULL == (cert_x509 = pkcs11_os_malloc(sizeof(pkcs11_cert_x509_t) + cert_attr.ulValueLen)))
+        {
+            return CKR_HOST_MEMORY;
+        }
+        cert_attr.pValue = &cert_x509[1];
+        rv = pkcs11_cert_load(obj_ptr, &cert_attr);
+
+        if (CKR_OK == rv && atcacert_der_parse_x509(cert_attr.pValue, cert_attr.ulValueLen, &cert_x509->x509))
+        {
+            rv = CKR_DATA_INVALID;
+        }
+
+        if (CKR_OK == rv)
+        {
+            cert_x509->cert = cert_attr.pValue;
+            cert_x509->cert_size = cert_attr.ulValueLen;
+            obj_ptr->cert_x509 = cert_x509;
+        }
+        else
+        {
+            pkcs11_os_free(cert_x509);
+        }
+    }
+
+    return rv;
+}
+
+/* Parsed certificate of the object, or NULL when it has none. It is loaded by
+   the first attribute of a request that needs it and kept for the others until
+   pkcs11_cert_release_x509() */
+static CK_RV pkcs11_cert_get_x509(CK_VOID_PTR pObject, const pkcs11_cert_x509_t** cert_x509)
+{
     pkcs11_object_ptr obj_ptr = (pkcs11_object_ptr)pObject;
-    CK_RV rv = CKR_ARGUMENTS_BAD;
+    CK_RV rv = CKR_OK;
 
-    if (obj_ptr)
+    if (!obj_ptr)
     {
+        return CKR_ARGUMENTS_BAD;
+    }
+
 #if defined(ATCA_TNGTLS_SUPPORT) || defined(ATCA_TNGLORA_SUPPORT) || defined(ATCA_TFLEX_SUPPORT)
-        pkcs11_cert_check_trust_data(obj_ptr);
+    pkcs11_cert_check_trust_data(obj_ptr);
 #endif
 
-        if (obj_ptr->data)
-        {
-            atcacert_def_t* cert_def = (atcacert_def_t*)obj_ptr->data;
-            const atcacert_cert_element_t * subj_element = NULL;
+    if (obj_ptr->data && !obj_ptr->cert_x509)
+    {
+        rv = pkcs11_cert_load_x509(obj_ptr);
+    }
 
-            if (cert_def->cert_elements)
-            {
-                int i;
-                for (i = 0; i < cert_def->cert_elements_count; i++)
-                {
-                    if (!strcmp(cert_def->cert_elements[i].id, "subject"))
-                    {
-                        subj_element = &cert_def->cert_elements[i];
-                        break;
-                    }
-                }
-            }
+    *cert_x509 = (CKR_OK == rv && obj_ptr->data) ? (const pkcs11_cert_x509_t*)obj_ptr->cert_x509 : NULL;
 
-            if (subj_element)
-            {
-                CK_ATTRIBUTE cert_attr = { 0, NULL, 0 };
+    return rv;
+}
 
-                /* Get the buffer size required first */
-                rv = pkcs11_cert_load(obj_ptr, &cert_attr);
+/* Fill an attribute with the DER encoding of a certificate field, empty when
+   the object has no certificate */
+static CK_RV pkcs11_cert_fill_field(CK_ATTRIBUTE_PTR pAttribute, const atcacert_der_tlv_t* field)
+{
+    if (field)
+    {
+        return pkcs11_attrib_fill(pAttribute, (CK_VOID_PTR)field->tlv, (CK_ULONG)field->tlv_size);
+    }
+    return pkcs11_attrib_empty(NULL, pAttribute);
+}
+#endif
 
-                if (CKR_OK == rv)
-                {
-                    cert_attr.pValue = pkcs11_os_malloc(cert_attr.ulValueLen);
-                    rv = pkcs11_cert_load(obj_ptr, &cert_attr);
-                }
+void pkcs11_cert_release_x509(pkcs11_object_ptr pObject)
+{
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    if (pObject && pObject->cert_x509)
+    {
+        pkcs11_os_free(pObject->cert_x509);
+        pObject->cert_x509 = NULL;
+    }
+#else
+    ((void)pObject);
+#endif
+}
 
-                if (CKR_OK == rv)
-                {
-                    rv = pkcs11_attrib_fill(pAttribute, &((uint8_t*)cert_attr.pValue)[subj_element->cert_loc.offset],
-                                            subj_element->cert_loc.count);
-                }
+CK_RV pkcs11_cert_get_subject(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
+{
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    const pkcs11_cert_x509_t* cert_x509;
+    CK_RV rv = pkcs11_cert_get_x509(pObject, &cert_x509);
 
-                if (cert_attr.pValue)
-                {
-                    pkcs11_os_free(cert_attr.pValue);
-                }
-            }
-        }
+    if (CKR_OK == rv)
+    {
+        rv = pkcs11_cert_fill_field(pAttribute, cert_x509 ? &cert_x509->x509.subject : NULL);
+    }
+    return rv;
+#else
+    return pkcs11_attrib_empty(pObject, pAttribute);
+#endif
+}
+
+static CK_RV pkcs11_cert_get_issuer(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
+{
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    const pkcs11_cert_x509_t* cert_x509;
+    CK_RV rv = pkcs11_cert_get_x509(pObject, &cert_x509);
+
+    if (CKR_OK == rv)
+    {
+        rv = pkcs11_cert_fill_field(pAttribute, cert_x509 ? &cert_x509->x509.issuer : NULL);
     }
+    return rv;
+#else
+    return pkcs11_attrib_empty(pObject, pAttribute);
+#endif
+}
 
+static CK_RV pkcs11_cert_get_serial_number(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
+{
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    const pkcs11_cert_x509_t* cert_x509;
+    CK_RV rv = pkcs11_cert_get_x509(pObject, &cert_x509);
+
+    if (CKR_OK == rv)
+    {
+        rv = pkcs11_cert_fill_field(pAttribute, cert_x509 ? &cert_x509->x509.serial_number : NULL);
+    }
     return rv;
 #else
     return pkcs11_attrib_empty(pObject, pAttribute);
 #endif
 }
 
-CK_RV pkcs11_cert_get_subject_key_id(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
+static CK_RV pkcs11_cert_get_public_key_info(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
 {
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    const pkcs11_cert_x509_t* cert_x509;
+    CK_RV rv = pkcs11_cert_get_x509(pObject, &cert_x509);
+
+    if (CKR_OK == rv)
+    {
+        rv = pkcs11_cert_fill_field(pAttribute, cert_x509 ? &cert_x509->x509.public_key_info : NULL);
+    }
+    return rv;
+#else
+    return pkcs11_attrib_empty(pObject, pAttribute);
+#endif
+}
+
 #if ATCA_CA_SUPPORT
+/* Subject key identifier computed from the public key on the device, for
+   certificates without the extension */
+static CK_RV pkcs11_cert_read_subject_key_id(pkcs11_object_ptr obj_ptr, CK_ATTRIBUTE_PTR pAttribute)
+{
+    if (pAttribute->pValue && pAttribute->ulValueLen)
+    {
+        atcacert_def_t * cert_cfg = (atcacert_def_t*)obj_ptr->data;
+        uint8_t subj_key_id[20];
+        ATCA_STATUS status;
+
+        status = atcacert_read_subj_key_id(cert_cfg, subj_key_id);
+
+        if (status)
+        {
+            return CKR_DEVICE_ERROR;
+        }
+
+        return pkcs11_attrib_fill(pAttribute, subj_key_id, sizeof(subj_key_id));
+    }
+    else
+    {
+        pAttribute->ulValueLen = 20;
+        if (pAttribute->pValue == NULL)
+        {
+            return CKR_OK;
+        }
+    }
+
+    return CKR_ARGUMENTS_BAD;
+}
+#endif
+
+CK_RV pkcs11_cert_get_subject_key_id(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
+{
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    const pkcs11_cert_x509_t* cert_x509;
+    atcacert_der_tlv_t key_id;
+    CK_RV rv = pkcs11_cert_get_x509(pObject, &cert_x509);
+
+    if (CKR_OK == rv)
+    {
+        if (!cert_x509)
+        {
+            rv = pkcs11_attrib_empty(NULL, pAttribute);
+        }
+        else if (ATCACERT_E_SUCCESS == atcacert_der_x509_get_subj_key_id(&cert_x509->x509, &key_id))
+        {
+            rv = pkcs11_attrib_fill(pAttribute, (CK_VOID_PTR)key_id.value, (CK_ULONG)key_id.value_size);
+        }
+        else
+        {
+            rv = pkcs11_cert_read_subject_key_id((pkcs11_object_ptr)pObject, pAttribute);
+        }
+    }
+    return rv;
+#elif ATCA_CA_SUPPORT
     pkcs11_object_ptr obj_ptr = (pkcs11_object_ptr)pObject;
 
     if (obj_ptr)
@@ -323,29 +489,7 @@ CK_RV pkcs11_cert_get_subject_key_id(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttr
 
         if (obj_ptr->data)
         {
-            if (pAttribute->pValue && pAttribute->ulValueLen)
-            {
-                atcacert_def_t * cert_cfg = (atcacert_def_t*)obj_ptr->data;
-                uint8_t subj_key_id[20];
-                ATCA_STATUS status;
-
-                status = atcacert_read_subj_key_id(cert_cfg, subj_key_id);
-
-                if (status)
-                {
-                    return CKR_DEVICE_ERROR;
-                }
-
-                return pkcs11_attrib_fill(pAttribute, subj_key_id, sizeof(subj_key_id));
-            }
-            else
-            {
-                pAttribute->ulValueLen = 20;
-                if (pAttribute->pValue == NULL)
-                {
-                    return CKR_OK;
-                }
-            }
+            return pkcs11_cert_read_subject_key_id(obj_ptr, pAttribute);
         }
         else
         {
@@ -361,7 +505,27 @@ CK_RV pkcs11_cert_get_subject_key_id(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttr
 
 CK_RV pkcs11_cert_get_authority_key_id(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
 {
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    const pkcs11_cert_x509_t* cert_x509;
+    atcacert_der_tlv_t auth_key_id;
+    CK_RV rv = pkcs11_cert_get_x509(pObject, &cert_x509);
+
+    if (CKR_OK == rv)
+    {
+        /* The issuer key hash is the key identifier of the authority key identifier extension */
+        if (cert_x509 && ATCACERT_E_SUCCESS == atcacert_der_x509_get_auth_key_id(&cert_x509->x509, &auth_key_id))
+        {
+            rv = pkcs11_attrib_fill(pAttribute, (CK_VOID_PTR)auth_key_id.value, (CK_ULONG)auth_key_id.value_size);
+        }
+        else
+        {
+            rv = pkcs11_attrib_empty(NULL, pAttribute);
+        }
+    }
+    return rv;
+#else
     return pkcs11_attrib_empty(pObject, pAttribute);
+#endif
 }
 
 CK_RV pkcs11_cert_get_trusted_flag(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
@@ -446,15 +610,15 @@ const pkcs11_attrib_model pkcs11_cert_x509public_attributes[] = {
        SubjectPublicKeyInfo ::= SEQUENCE {
        algorithm AlgorithmIdentifier,
        subjectPublicKey BIT_STRING } */
-    { CKA_PUBLIC_KEY_INFO,            pkcs11_attrib_empty                                                                                                                                                                                                                               },
+    { CKA_PUBLIC_KEY_INFO,            pkcs11_cert_get_public_key_info                                                                                                                                                                                                                   },
     /** DER-encoded Certificate subject name */
     { CKA_SUBJECT,                    pkcs11_cert_get_subject                                                                                                                                                                                                                           },
     /** Key identifier for public/private key pair (default empty) */
     { CKA_ID,                         pkcs11_cert_get_id                                                                                                                                                                                                                                },
     /** DER-encoded Certificate issuer name (default empty)*/
-    { CKA_ISSUER,                     pkcs11_attrib_empty                                                                                                                                                                                                                               },
+    { CKA_ISSUER,                     pkcs11_cert_get_issuer                                                                                                                                                                                                                            },
     /** DER-encoding of the certificate serial number (default empty) */
-    { CKA_SERIAL_NUMBER,              pkcs11_attrib_empty                                                                                                                                                                                                                               },
+    { CKA_SERIAL_NUMBER,              pkcs11_cert_get_serial_number                                                                                                                                                                                                                     },
     /** BER-encoded Complete Certificate */
     { CKA_VALUE,                      pkcs11_cert_get_encoded                                                                                                                                                                                                                           },
     /** If not empty this attribute gives the URL where the complete
@@ -604,6 +768,8 @@ CK_RV pkcs11_cert_x509_write(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute)
         return CKR_ARGUMENTS_BAD;
     }
 
+    pkcs11_cert_release_x509(obj_ptr);
+
     if (atcab_is_ca_device(atcab_get_device_type()))
     {
 #if ATCA_CA_SUPPORT
@@ -48,5 +48,6 @@ extern const pkcs11_attrib_model pkcs11_cert_x509_attributes[];
 extern const CK_ULONG pkcs11_cert_x509_attributes_count;
 
 CK_RV pkcs11_cert_x509_write(CK_VOID_PTR pObject, CK_ATTRIBUTE_PTR pAttribute);
+void pkcs11_cert_release_x509(pkcs11_object_ptr pObject);
 
 #endif /* PKCS11_CERT_H_ */
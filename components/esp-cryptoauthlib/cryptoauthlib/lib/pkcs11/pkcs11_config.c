@@ -797,6 +797,9 @@ CK_RV pkcs11_config_key(pkcs11_lib_ctx_ptr pLibCtx, pkcs11_slot_ctx_ptr pSlot, p
                 fprintf(fp, "label = %s\n", pObject->name);
                 fclose(fp);
                 rv = CKR_OK;
+#if PKCS11_CONFIG_CACHE_ENABLE
+                pkcs11_config_cache_invalidate(pLibCtx);
+#endif
             }
         }
     }
@@ -815,6 +818,9 @@ CK_RV pkcs11_config_remove_object(pkcs11_lib_ctx_ptr pLibCtx, pkcs11_slot_ctx_pt
     {
         remove(filename);
         pSlot->flags |= (1 << pObject->slot);
+#if PKCS11_CONFIG_CACHE_ENABLE
+        pkcs11_config_cache_invalidate(pLibCtx);
+#endif
     }
 
     return CKR_OK;
@@ -830,6 +836,10 @@ CK_RV pkcs11_config_load_objects(pkcs11_slot_ctx_ptr slot_ctx)
     size_t buflen;
     char* argv[2 * (PKCS11_MAX_OBJECTS_ALLOWED + PKCS11_MAX_CONFIG_ALLOWED)];
     int argc = 0;
+#if PKCS11_CONFIG_CACHE_ENABLE
+    uint64_t fingerprint = 0;
+    CK_BBOOL save_cache = FALSE;
+#endif
 
     pkcs11_lib_ctx_ptr pLibCtx = pkcs11_get_context();
     CK_RV rv = CKR_OK;
@@ -866,6 +876,20 @@ CK_RV pkcs11_config_load_objects(pkcs11_slot_ctx_ptr slot_ctx)
         }
     }
 
+#if PKCS11_CONFIG_CACHE_ENABLE
+    if (CKR_OK == pkcs11_config_cache_fingerprint(pLibCtx, &fingerprint))
+    {
+        /* A stale or missing cache leaves the slot untouched so fall through to the
+           full parse, which then saves a fresh cache */
+        if (CKR_FUNCTION_FAILED != (rv = pkcs11_config_cache_load(pLibCtx, slot_ctx, fingerprint)))
+        {
+            return rv;
+        }
+        rv = CKR_OK;
+        save_cache = TRUE;
+    }
+#endif
+
     if (NULL != (d = opendir((char*)pLibCtx->config_path)))
     {
         while((CKR_OK == rv) && (NULL != (de = readdir(d))))
@@ -992,7 +1016,18 @@ CK_RV pkcs11_config_load_objects(pkcs11_slot_ctx_ptr slot_ctx)
                 }
             }
         }
+        closedir(d);
+    }
+
+#if PKCS11_CONFIG_CACHE_ENABLE
+    if ((CKR_OK == rv) && save_cache)
+    {
+        if (CKR_OK != pkcs11_config_cache_save(pLibCtx, fingerprint))
+        {
+            PKCS11_DEBUG("Unable to write the configuration cache\n");
+        }
     }
+#endif
 
     return rv;
 }
@@ -0,0 +1,730 @@
+/**
+ * \file
+ * \brief PKCS11 Library Compiled Configuration Cache
+ *
+ * The text configuration files are parsed once and the resulting slot and
+ * object descriptions are written to a binary cache in the filestore. On the
+ * next C_Initialize the cache is memory mapped and restored directly as long
+ * as the fingerprint (name, size and modification time) of every source .conf
+ * file still matches.
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+#include "cryptoauthlib.h"
+#include "pkcs11_config.h"
+#include "pkcs11_debug.h"
+#include "pkcs11_slot.h"
+#include "pkcs11_object.h"
+#include "pkcs11_os.h"
+
+#if !PKCS11_USE_STATIC_CONFIG && PKCS11_CONFIG_CACHE_ENABLE
+
+#include <stdio.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(ATCA_TNGTLS_SUPPORT) || defined(ATCA_TNGLORA_SUPPORT) || defined(ATCA_TFLEX_SUPPORT)
+CK_RV pkcs11_trust_load_objects(pkcs11_slot_ctx_ptr pSlot);
+#endif
+
+/**
+ * \defgroup pkcs11 Configuration Cache (pkcs11_config_cache_)
+   @{ */
+
+#define PKCS11_CONFIG_CACHE_MAGIC       (0x43503131u)   /* "11PC" */
+#define PKCS11_CONFIG_CACHE_VERSION     (2u)
+
+#define PKCS11_CONFIG_CACHE_REC_OBJECT  (0u)            /**< Plain configured object */
+#define PKCS11_CONFIG_CACHE_REC_TRUST   (1u)            /**< Replay pkcs11_trust_load_objects for the slot */
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t slot_rec_size;
+    uint16_t object_rec_size;
+    uint32_t slot_count;
+    uint32_t object_count;
+    uint64_t fingerprint;
+    CK_CHAR  config_path[200];
+} pkcs11_config_cache_header;
+
+/* The interface settings a slot configuration can produce. ATCAIfaceCfg itself
+   holds pointers and padding so it is stored field by field */
+typedef struct
+{
+    uint32_t iface_type;
+    uint32_t devtype;
+    uint32_t wake_delay;
+    int32_t  rx_retries;
+    uint32_t dev_interface;     /**< hid and kit interface type */
+    uint32_t address;           /**< i2c address, spi select pin, hid and kit device identity */
+    uint32_t bus;
+    uint32_t baud;
+    uint32_t vid;
+    uint32_t pid;
+    uint32_t packetsize;
+} pkcs11_config_cache_iface;
+
+typedef struct
+{
+    uint32_t                  slot_id;
+    pkcs11_config_cache_iface iface;
+    uint32_t                  flags;
+    uint16_t     user_pin_handle;
+    uint16_t     so_pin_handle;
+#if ((defined(ATCA_HAL_KIT_BRIDGE) && defined(PKCS11_TESTING_ENABLE)) || \
+    (defined(__linux__) && (defined(ATCA_HAL_SWI_UART) || defined(ATCA_HAL_KIT_UART))))
+    uint8_t      devpath[24];
+#endif
+#ifndef PKCS11_LABEL_IS_SERNUM
+    CK_UTF8CHAR  label[PKCS11_MAX_LABEL_SIZE + 1];
+#endif
+} pkcs11_config_cache_slot;
+
+typedef struct
+{
+    uint32_t    type;
+    uint32_t    owner;
+    uint32_t    class_id;
+    uint32_t    class_type;
+    uint32_t    size;
+    uint32_t    flags;
+    uint16_t    slot;
+    CK_UTF8CHAR name[PKCS11_MAX_LABEL_SIZE + 1];
+} pkcs11_config_cache_object;
+
+static void pkcs11_config_cache_get_path(pkcs11_lib_ctx_ptr pLibCtx, char* path, size_t len)
+{
+    (void)snprintf(path, len, "%s%s", (char*)pLibCtx->config_path, PKCS11_CONFIG_CACHE_FILE);
+}
+
+/* FNV-1a over a block of bytes */
+static uint64_t pkcs11_config_cache_hash(uint64_t hash, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+
+    while (len--)
+    {
+        hash ^= *p++;
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/* A file is identified by its name, size and modification time to the
+   nanosecond, so checking the cache does not read the files it saves parsing */
+static CK_RV pkcs11_config_cache_hash_file(const char* name, const char* filename, uint64_t* hash)
+{
+    struct stat st;
+    uint64_t meta[3];
+
+    if (0 != stat(filename, &st))
+    {
+        return CKR_GENERAL_ERROR;
+    }
+
+    meta[0] = (uint64_t)st.st_size;
+    meta[1] = (uint64_t)st.st_mtime;
+#if defined(__APPLE__)
+    meta[2] = (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+    meta[2] = (uint64_t)st.st_mtim.tv_nsec;
+#endif
+
+    *hash = pkcs11_config_cache_hash(0xCBF29CE484222325ull, name, strlen(name) + 1);
+    *hash = pkcs11_config_cache_hash(*hash, meta, sizeof(meta));
+
+    return CKR_OK;
+}
+
+/** \brief Compute a fingerprint over every configuration source that feeds
+ * the slot database. Per file hashes are summed so the result does not depend
+ * on directory iteration order. */
+CK_RV pkcs11_config_cache_fingerprint(pkcs11_lib_ctx_ptr pLibCtx, uint64_t* fingerprint)
+{
+    DIR * d;
+    struct dirent *de;
+    char filename[256];
+    uint64_t sum = 0;
+    uint64_t hash;
+    CK_RV rv = CKR_OK;
+
+    if (!pLibCtx || !fingerprint)
+    {
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (CKR_OK == pkcs11_config_cache_hash_file(ATCA_LIBRARY_CONF, ATCA_LIBRARY_CONF, &hash))
+    {
+        sum += hash;
+    }
+
+    if (NULL == (d = opendir((char*)pLibCtx->config_path)))
+    {
+        return CKR_GENERAL_ERROR;
+    }
+
+    while ((CKR_OK == rv) && (NULL != (de = readdir(d))))
+    {
+        size_t nlen = strlen(de->d_name);
+
+        if ((DT_REG != de->d_type) || (nlen < 5) || strcmp(&de->d_name[nlen - 5], ".conf"))
+        {
+            continue;
+        }
+
+        int ret = snprintf(filename, sizeof(filename), "%s%s", (char*)pLibCtx->config_path, de->d_name);
+        if ((ret > 0) && (ret < (int)sizeof(filename))
+            && (CKR_OK == pkcs11_config_cache_hash_file(de->d_name, filename, &hash)))
+        {
+            sum += hash;
+        }
+        else
+        {
+            rv = CKR_GENERAL_ERROR;
+        }
+    }
+    closedir(d);
+
+    *fingerprint = sum;
+    return rv;
+}
+
+/** \brief Remove the compiled configuration so the next load reparses the
+ * text configuration */
+void pkcs11_config_cache_invalidate(pkcs11_lib_ctx_ptr pLibCtx)
+{
+    char filename[256];
+
+    if (pLibCtx)
+    {
+        pkcs11_config_cache_get_path(pLibCtx, filename, sizeof(filename));
+        (void)remove(filename);
+    }
+}
+
+/* Store the settings pkcs11_config_parse_interface() sets, FALSE for an
+   interface the slot configuration can not describe */
+static CK_BBOOL pkcs11_config_cache_put_iface(pkcs11_config_cache_iface* rec, ATCAIfaceCfg* cfg)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->iface_type = (uint32_t)cfg->iface_type;
+    rec->devtype = (uint32_t)cfg->devtype;
+    rec->wake_delay = (uint32_t)cfg->wake_delay;
+    rec->rx_retries = (int32_t)cfg->rx_retries;
+
+    switch (cfg->iface_type)
+    {
+    case ATCA_I2C_IFACE:
+#ifdef ATCA_ENABLE_DEPRECATED
+        rec->address = ATCA_IFACECFG_VALUE(cfg, atcai2c.slave_address);
+#else
+        rec->address = ATCA_IFACECFG_VALUE(cfg, atcai2c.address);
+#endif
+        rec->bus = ATCA_IFACECFG_VALUE(cfg, atcai2c.bus);
+        rec->baud = ATCA_IFACECFG_VALUE(cfg, atcai2c.baud);
+        break;
+    case ATCA_SPI_IFACE:
+        rec->bus = ATCA_IFACECFG_VALUE(cfg, atcaspi.bus);
+        rec->address = ATCA_IFACECFG_VALUE(cfg, atcaspi.select_pin);
+        rec->baud = ATCA_IFACECFG_VALUE(cfg, atcaspi.baud);
+        break;
+    case ATCA_HID_IFACE:
+        rec->dev_interface = (uint32_t)ATCA_IFACECFG_VALUE(cfg, atcahid.dev_interface);
+        rec->address = ATCA_IFACECFG_VALUE(cfg, atcahid.dev_identity);
+        rec->vid = ATCA_IFACECFG_VALUE(cfg, atcahid.vid);
+        rec->pid = ATCA_IFACECFG_VALUE(cfg, atcahid.pid);
+        rec->packetsize = ATCA_IFACECFG_VALUE(cfg, atcahid.packetsize);
+        break;
+    case ATCA_KIT_IFACE:
+        rec->dev_interface = (uint32_t)ATCA_IFACECFG_VALUE(cfg, atcakit.dev_interface);
+        rec->address = ATCA_IFACECFG_VALUE(cfg, atcakit.dev_identity);
+        break;
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static CK_BBOOL pkcs11_config_cache_get_iface(ATCAIfaceCfg* cfg, const pkcs11_config_cache_iface* rec)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->iface_type = (ATCAIfaceType)rec->iface_type;
+    cfg->devtype = (ATCADeviceType)rec->devtype;
+    cfg->wake_delay = (uint16_t)rec->wake_delay;
+    cfg->rx_retries = (int)rec->rx_retries;
+
+    switch (cfg->iface_type)
+    {
+    case ATCA_I2C_IFACE:
+#ifdef ATCA_ENABLE_DEPRECATED
+        ATCA_IFACECFG_VALUE(cfg, atcai2c.slave_address) = (uint8_t)rec->address;
+#else
+        ATCA_IFACECFG_VALUE(cfg, atcai2c.address) = (uint8_t)rec->address;
+#endif
+        ATCA_IFACECFG_VALUE(cfg, atcai2c.bus) = (uint8_t)rec->bus;
+        ATCA_IFACECFG_VALUE(cfg, atcai2c.baud) = rec->baud;
+        break;
+    case ATCA_SPI_IFACE:
+        ATCA_IFACECFG_VALUE(cfg, atcaspi.bus) = (uint8_t)rec->bus;
+        ATCA_IFACECFG_VALUE(cfg, atcaspi.select_pin) = (uint8_t)rec->address;
+        ATCA_IFACECFG_VALUE(cfg, atcaspi.baud) = rec->baud;
+        break;
+    case ATCA_HID_IFACE:
+        ATCA_IFACECFG_VALUE(cfg, atcahid.dev_interface) = (ATCAKitType)rec->dev_interface;
+        ATCA_IFACECFG_VALUE(cfg, atcahid.dev_identity) = (uint8_t)rec->address;
+        ATCA_IFACECFG_VALUE(cfg, atcahid.vid) = rec->vid;
+        ATCA_IFACECFG_VALUE(cfg, atcahid.pid) = rec->pid;
+        ATCA_IFACECFG_VALUE(cfg, atcahid.packetsize) = rec->packetsize;
+        break;
+    case ATCA_KIT_IFACE:
+        ATCA_IFACECFG_VALUE(cfg, atcakit.dev_interface) = (ATCAKitType)rec->dev_interface;
+        ATCA_IFACECFG_VALUE(cfg, atcakit.dev_identity) = (uint8_t)rec->address;
+        break;
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void pkcs11_config_cache_restore_slot(pkcs11_slot_ctx_ptr slot_ctx, const pkcs11_config_cache_slot* rec)
+{
+    slot_ctx->slot_id = (CK_SLOT_ID)rec->slot_id;
+    (void)pkcs11_config_cache_get_iface(&slot_ctx->interface_config, &rec->iface);
+    slot_ctx->flags = (CK_FLAGS)rec->flags;
+    slot_ctx->user_pin_handle = rec->user_pin_handle;
+    slot_ctx->so_pin_handle = rec->so_pin_handle;
+#if ((defined(ATCA_HAL_KIT_BRIDGE) && defined(PKCS11_TESTING_ENABLE)) || \
+    (defined(__linux__) && (defined(ATCA_HAL_SWI_UART) || defined(ATCA_HAL_KIT_UART))))
+    memcpy(slot_ctx->devpath, rec->devpath, sizeof(slot_ctx->devpath));
+#endif
+#ifndef PKCS11_LABEL_IS_SERNUM
+    memcpy(slot_ctx->label, rec->label, sizeof(slot_ctx->label));
+#endif
+}
+
+/* Records that pkcs11_config_cache_restore_object can rebuild - anything else
+   (e.g. a CKO_DATA object) is only recreated by the full parse */
+static CK_BBOOL pkcs11_config_cache_restorable(const pkcs11_config_cache_object* rec)
+{
+    if (PKCS11_CONFIG_CACHE_REC_TRUST == rec->type)
+    {
+#if defined(ATCA_TNGTLS_SUPPORT) || defined(ATCA_TNGLORA_SUPPORT) || defined(ATCA_TFLEX_SUPPORT)
+        return TRUE;
+#else
+        return FALSE;
+#endif
+    }
+
+    switch (rec->class_id)
+    {
+    case CKO_PRIVATE_KEY:
+    case CKO_PUBLIC_KEY:
+    case CKO_SECRET_KEY:
+    case CKO_CERTIFICATE:
+        return (PKCS11_CONFIG_CACHE_REC_OBJECT == rec->type) ? TRUE : FALSE;
+    default:
+        return FALSE;
+    }
+}
+
+static CK_RV pkcs11_config_cache_restore_object(pkcs11_slot_ctx_ptr owner, const pkcs11_config_cache_object* rec)
+{
+    pkcs11_object_ptr pObject = NULL;
+    CK_RV rv;
+
+    if (PKCS11_CONFIG_CACHE_REC_TRUST == rec->type)
+    {
+#if defined(ATCA_TNGTLS_SUPPORT) || defined(ATCA_TNGLORA_SUPPORT) || defined(ATCA_TFLEX_SUPPORT)
+        return pkcs11_trust_load_objects(owner);
+#else
+        return CKR_GENERAL_ERROR;
+#endif
+    }
+
+    if (CKR_OK == (rv = pkcs11_object_alloc(owner->slot_id, &pObject)))
+    {
+        char * name = (char*)rec->name;
+
+        switch (rec->class_id)
+        {
+        case CKO_PRIVATE_KEY:
+            pkcs11_config_init_private(pObject, name, strlen(name));
+            break;
+        case CKO_PUBLIC_KEY:
+            pkcs11_config_init_public(pObject, name, strlen(name));
+            break;
+        case CKO_SECRET_KEY:
+            pkcs11_config_init_secret(pObject, name, strlen(name), (uint8_t)rec->size);
+            break;
+        case CKO_CERTIFICATE:
+            pkcs11_config_init_cert(pObject, name, strlen(name));
+            break;
+        default:
+            rv = CKR_GENERAL_ERROR;
+            break;
+        }
+
+        if (CKR_OK == rv)
+        {
+            pObject->class_type = (CK_ULONG)rec->class_type;
+            pObject->size = (CK_ULONG)rec->size;
+            pObject->slot = rec->slot;
+            pObject->flags = (CK_FLAGS)rec->flags;
+#if ATCA_CA_SUPPORT
+            pObject->config = &owner->cfg_zone;
+#endif
+        }
+        else
+        {
+            pkcs11_object_free(pObject);
+        }
+    }
+    return rv;
+}
+
+/** \brief Restore the slot database from the compiled cache
+ *
+ * \return CKR_OK if the configuration was restored, CKR_FUNCTION_FAILED if the
+ * cache is missing or stale (nothing has been modified in that case) or any
+ * other error if restoring a valid cache failed.
+ */
+CK_RV pkcs11_config_cache_load(pkcs11_lib_ctx_ptr pLibCtx, pkcs11_slot_ctx_ptr slot_ctx, uint64_t fingerprint)
+{
+    char filename[256];
+    pkcs11_config_cache_header hdr;
+    pkcs11_slot_ctx_ptr slots[PKCS11_MAX_SLOTS_ALLOWED];
+    const uint8_t* map;
+    const uint8_t* p;
+    struct stat st;
+    size_t expected;
+    uint32_t i;
+    int fd;
+    CK_RV rv = CKR_FUNCTION_FAILED;
+
+    if (!pLibCtx || !slot_ctx)
+    {
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    pkcs11_config_cache_get_path(pLibCtx, filename, sizeof(filename));
+
+    if (0 > (fd = open(filename, O_RDONLY)))
+    {
+        return CKR_FUNCTION_FAILED;
+    }
+
+    if ((0 != fstat(fd, &st)) || ((size_t)st.st_size < sizeof(hdr)))
+    {
+        close(fd);
+        return CKR_FUNCTION_FAILED;
+    }
+
+    map = (const uint8_t*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == (const void*)map)
+    {
+        return CKR_FUNCTION_FAILED;
+    }
+
+    memcpy(&hdr, map, sizeof(hdr));
+    expected = sizeof(hdr) + (size_t)hdr.slot_count * sizeof(pkcs11_config_cache_slot)
+               + (size_t)hdr.object_count * sizeof(pkcs11_config_cache_object);
+
+    /* Anything unexpected means the cache is simply ignored */
+    if ((PKCS11_CONFIG_CACHE_MAGIC == hdr.magic) && (PKCS11_CONFIG_CACHE_VERSION == hdr.version)
+        && (sizeof(hdr) == hdr.header_size) && (sizeof(pkcs11_config_cache_slot) == hdr.slot_rec_size)
+        && (sizeof(pkcs11_config_cache_object) == hdr.object_rec_size)
+        && (fingerprint == hdr.fingerprint) && (expected == (size_t)st.st_size)
+        && (0 < hdr.slot_count) && (PKCS11_MAX_SLOTS_ALLOWED >= hdr.slot_count)
+        && (PKCS11_MAX_OBJECTS_ALLOWED >= hdr.object_count)
+        && !strcmp((char*)hdr.config_path, (char*)pLibCtx->config_path))
+    {
+        rv = CKR_OK;
+    }
+
+    /* Check every record before touching the slots so a cache that can not
+       be fully restored still falls back to the full parse */
+    p = map + sizeof(hdr);
+    for (i = 0; (CKR_OK == rv) && (i < hdr.slot_count); i++)
+    {
+        pkcs11_config_cache_slot rec;
+        ATCAIfaceCfg cfg;
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+
+        if (!pkcs11_config_cache_get_iface(&cfg, &rec.iface))
+        {
+            rv = CKR_FUNCTION_FAILED;
+        }
+    }
+
+    for (i = 0; (CKR_OK == rv) && (i < hdr.object_count); i++)
+    {
+        pkcs11_config_cache_object rec;
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+
+        if ((rec.owner >= hdr.slot_count) || !pkcs11_config_cache_restorable(&rec))
+        {
+            rv = CKR_FUNCTION_FAILED;
+        }
+    }
+
+    p = map + sizeof(hdr);
+
+    for (i = 0; (CKR_OK == rv) && (i < hdr.slot_count); i++)
+    {
+        pkcs11_config_cache_slot rec;
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+
+        slots[i] = (0 == i) ? slot_ctx : pkcs11_slot_get_new_context(pLibCtx);
+        if (slots[i])
+        {
+            pkcs11_config_cache_restore_slot(slots[i], &rec);
+        }
+        else
+        {
+            rv = CKR_GENERAL_ERROR;
+        }
+    }
+
+    for (i = 0; (CKR_OK == rv) && (i < hdr.object_count); i++)
+    {
+        pkcs11_config_cache_object rec;
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+
+        rec.name[PKCS11_MAX_LABEL_SIZE] = '\0';
+        rv = pkcs11_config_cache_restore_object(slots[rec.owner], &rec);
+    }
+
+    (void)munmap((void*)map, (size_t)st.st_size);
+
+    if (CKR_OK == rv)
+    {
+        PKCS11_DEBUG("Restored configuration from %s\n", filename);
+    }
+
+    return rv;
+}
+
+static uint32_t pkcs11_config_cache_slot_index(pkcs11_lib_ctx_ptr pLibCtx, CK_SLOT_ID slot_id, pkcs11_slot_ctx_ptr * ppSlot)
+{
+    pkcs11_slot_ctx_ptr slot_ctx = (pkcs11_slot_ctx_ptr)pLibCtx->slots;
+    uint32_t idx = 0;
+    CK_ULONG i;
+
+    for (i = 0; i < pLibCtx->slot_cnt; i++, slot_ctx++)
+    {
+#ifndef PKCS11_LABEL_IS_SERNUM
+        if (!slot_ctx->label[0])
+        {
+            continue;
+        }
+#endif
+        if (slot_ctx->slot_id == slot_id)
+        {
+            *ppSlot = slot_ctx;
+            return idx;
+        }
+        idx++;
+    }
+    return UINT32_MAX;
+}
+
+/** \brief Compile the currently loaded slot database into the cache file.
+ * The file is written to a temporary name and renamed into place so readers
+ * never see a partial cache. */
+CK_RV pkcs11_config_cache_save(pkcs11_lib_ctx_ptr pLibCtx, uint64_t fingerprint)
+{
+    char filename[256];
+    char tmpname[260];
+    pkcs11_config_cache_header hdr;
+    pkcs11_slot_ctx_ptr slot_ctx;
+    CK_ULONG trust_owners = 0;
+    CK_ULONG i;
+    FILE* fp;
+    CK_RV rv = CKR_OK;
+
+    if (!pLibCtx || !pLibCtx->slots)
+    {
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    pkcs11_config_cache_get_path(pLibCtx, filename, sizeof(filename));
+    (void)snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+
+    if (NULL == (fp = fopen(tmpname, "wb")))
+    {
+        return CKR_FUNCTION_FAILED;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = PKCS11_CONFIG_CACHE_MAGIC;
+    hdr.version = PKCS11_CONFIG_CACHE_VERSION;
+    hdr.header_size = (uint16_t)sizeof(hdr);
+    hdr.slot_rec_size = (uint16_t)sizeof(pkcs11_config_cache_slot);
+    hdr.object_rec_size = (uint16_t)sizeof(pkcs11_config_cache_object);
+    hdr.fingerprint = fingerprint;
+    memcpy(hdr.config_path, pLibCtx->config_path, sizeof(hdr.config_path));
+
+    /* Reserve the header - it is rewritten once the counts are known */
+    if (1 != fwrite(&hdr, sizeof(hdr), 1, fp))
+    {
+        rv = CKR_FUNCTION_FAILED;
+    }
+
+    slot_ctx = (pkcs11_slot_ctx_ptr)pLibCtx->slots;
+    for (i = 0; (CKR_OK == rv) && (i < pLibCtx->slot_cnt); i++, slot_ctx++)
+    {
+        pkcs11_config_cache_slot rec;
+
+#ifndef PKCS11_LABEL_IS_SERNUM
+        if (!slot_ctx->label[0])
+        {
+            continue;
+        }
+#endif
+        memset(&rec, 0, sizeof(rec));
+        rec.slot_id = (uint32_t)slot_ctx->slot_id;
+        if (!pkcs11_config_cache_put_iface(&rec.iface, &slot_ctx->interface_config))
+        {
+            rv = CKR_FUNCTION_FAILED;
+            break;
+        }
+        rec.flags = (uint32_t)slot_ctx->flags;
+        rec.user_pin_handle = slot_ctx->user_pin_handle;
+        rec.so_pin_handle = slot_ctx->so_pin_handle;
+#if ((defined(ATCA_HAL_KIT_BRIDGE) && defined(PKCS11_TESTING_ENABLE)) || \
+        (defined(__linux__) && (defined(ATCA_HAL_SWI_UART) || defined(ATCA_HAL_KIT_UART))))
+        memcpy(rec.devpath, slot_ctx->devpath, sizeof(rec.devpath));
+#endif
+#ifndef PKCS11_LABEL_IS_SERNUM
+        memcpy(rec.label, slot_ctx->label, sizeof(rec.label));
+#endif
+        if (1 == fwrite(&rec, sizeof(rec), 1, fp))
+        {
+            hdr.slot_count++;
+        }
+        else
+        {
+            rv = CKR_FUNCTION_FAILED;
+        }
+    }
+
+    /* Objects are stored in allocation order so handles come out the same */
+    for (i = 0; (CKR_OK == rv) && (i < PKCS11_MAX_OBJECTS_ALLOWED); i++)
+    {
+        pkcs11_object_ptr pObject = pkcs11_object_cache[i].object;
+        pkcs11_config_cache_object rec;
+        uint32_t owner;
+
+        if (!pObject || (CKO_HW_FEATURE == pObject->class_id))
+        {
+            continue;
+        }
+
+        slot_ctx = NULL;
+        if (UINT32_MAX == (owner = pkcs11_config_cache_slot_index(pLibCtx, pkcs11_object_cache[i].slotid, &slot_ctx)))
+        {
+            rv = CKR_GENERAL_ERROR;
+            break;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        rec.owner = owner;
+
+        if (pObject->flags & PKCS11_OBJECT_FLAG_TRUST_TYPE)
+        {
+            /* Trust objects reference compiled certificate definitions so the
+               loader is replayed once per slot instead of storing them */
+            if (trust_owners & (1u << owner))
+            {
+                continue;
+            }
+            trust_owners |= (1u << owner);
+            rec.type = PKCS11_CONFIG_CACHE_REC_TRUST;
+        }
+        else
+        {
+            rec.type = PKCS11_CONFIG_CACHE_REC_OBJECT;
+            rec.class_id = (uint32_t)pObject->class_id;
+            rec.class_type = (uint32_t)pObject->class_type;
+            rec.size = (uint32_t)pObject->size;
+            rec.flags = (uint32_t)pObject->flags;
+            rec.slot = pObject->slot;
+            memcpy(rec.name, pObject->name, sizeof(rec.name));
+        }
+
+        /* A cache the loader would reject is not worth writing */
+        if (!pkcs11_config_cache_restorable(&rec))
+        {
+            rv = CKR_FUNCTION_FAILED;
+            break;
+        }
+
+        if (1 == fwrite(&rec, sizeof(rec), 1, fp))
+        {
+            hdr.object_count++;
+        }
+        else
+        {
+            rv = CKR_FUNCTION_FAILED;
+        }
+    }
+
+    if (CKR_OK == rv)
+    {
+        if ((0 != fseek(fp, 0L, SEEK_SET)) || (1 != fwrite(&hdr, sizeof(hdr), 1, fp)))
+        {
+            rv = CKR_FUNCTION_FAILED;
+        }
+    }
+
+    if (0 != fclose(fp))
+    {
+        rv = CKR_FUNCTION_FAILED;
+    }
+
+    if ((CKR_OK != rv) || (0 != rename(tmpname, filename)))
+    {
+        (void)remove(tmpname);
+        (void)remove(filename);
+        rv = CKR_FUNCTION_FAILED;
+    }
+
+    return rv;
+}
+
+/** @} */
+
+#endif /* !PKCS11_USE_STATIC_CONFIG && PKCS11_CONFIG_CACHE_ENABLE */
@@ -33,6 +33,7 @@
 #include "pkcs11_slot.h"
 #include "pkcs11_session.h"
 #include "pkcs11_find.h"
+#include "pkcs11_cert.h"
 #include "pkcs11_util.h"
 
 /**
@@ -219,6 +220,8 @@ static CK_OBJECT_HANDLE pkcs11_find_handle(const CK_SLOT_ID slotid, const CK_ATT
                     break;
                 }
             }
+            pkcs11_cert_release_x509(pObject);
+
             if (j == ulCount)
             {
                 /* Full match */
@@ -463,6 +466,13 @@ CK_RV pkcs11_find_get_attribute(CK_SESSION_HANDLE hSession, CK_OBJECT_HANDLE hOb
         }
     }
 
+    /* Drop the certificate the attributes were served from */
+    if (CKR_OK == pkcs11_lock_both(pLibCtx))
+    {
+        pkcs11_cert_release_x509(pObject);
+        (void)pkcs11_unlock_both(pLibCtx);
+    }
+
     return rv;
 }
 
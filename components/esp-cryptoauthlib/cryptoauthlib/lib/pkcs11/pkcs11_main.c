@@ -623,6 +623,15 @@ CK_RV C_Sign(CK_SESSION_HANDLE hSession, CK_BYTE_PTR pData, CK_ULONG ulDataLen,
     PKCS11_DEBUG_RETURN(pkcs11_signature_sign(hSession, pData, ulDataLen, pSignature, pulSignatureLen));
 }
 
+/**
+ * \brief Sign an array of digests in a single operation (vendor extension)
+ */
+CK_RV C_SignBatch(CK_SESSION_HANDLE hSession, CK_BYTE_PTR pData, CK_ULONG ulDataLen, CK_ULONG ulCount, CK_BYTE_PTR pSignature, CK_ULONG_PTR pulSignatureLen)
+{
+    PKCS11_DEBUG("\r\n");
+    PKCS11_DEBUG_RETURN(pkcs11_signature_sign_batch(hSession, pData, ulDataLen, ulCount, pSignature, pulSignatureLen));
+}
+
 /**
  * \brief Continues a multiple-part signature operation
  */
@@ -181,6 +181,8 @@ CK_RV pkcs11_object_free(pkcs11_object_ptr pObject)
 
     if (pObject)
     {
+        pkcs11_cert_release_x509(pObject);
+
 #if ATCA_CA_SUPPORT
         if (pObject->data)
         {
@@ -56,6 +56,10 @@ typedef struct _pkcs11_object
     CK_VOID_PTR config;
 #endif
     CK_VOID_PTR data;
+#if !defined(ATCA_NO_HEAP) && ATCA_CA_SUPPORT
+    /** Certificate parsed for the attribute request being served */
+    CK_VOID_PTR cert_x509;
+#endif
 #if ATCA_TA_SUPPORT
     ta_element_attributes_t handle_info;
 #endif
@@ -36,6 +36,8 @@
 
 #include "atcacert/atcacert_der.h"
 
+#include <limits.h>
+
 /**
  * \defgroup pkcs11 Signature (pkcs11_signature_)
    @{ */
@@ -258,6 +260,96 @@ CK_RV pkcs11_signature_sign(
     return rv;
 }
 
+/**
+ * \brief Sign a batch of digests in a single operation (vendor extension)
+ *
+ * The session must have been initialized with C_SignInit using CKM_ECDSA.
+ * pData holds ulCount digests of ulDataLen bytes each stored back to back and
+ * the signatures are returned back to back in pSignature. The session and key
+ * are checked once and the library and device are locked once for the whole
+ * batch. Calling with a NULL pSignature returns the required buffer size
+ * without ending the operation.
+ */
+CK_RV pkcs11_signature_sign_batch(
+    CK_SESSION_HANDLE hSession,
+    CK_BYTE_PTR pData,
+    CK_ULONG ulDataLen,
+    CK_ULONG ulCount,
+    CK_BYTE_PTR pSignature,
+    CK_ULONG_PTR pulSignatureLen
+    )
+{
+    pkcs11_lib_ctx_ptr pLibCtx = NULL;
+    pkcs11_session_ctx_ptr pSession;
+    pkcs11_object_ptr pKey;
+    CK_ULONG siglen;
+    CK_RV rv;
+
+    /* Check parameters */
+    if (!pData || !pulSignatureLen || !ulCount)
+    {
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (ATCA_SHA256_DIGEST_SIZE != ulDataLen)
+    {
+        return CKR_DATA_LEN_RANGE;
+    }
+
+    rv = pkcs11_init_check(&pLibCtx, FALSE);
+    if (rv)
+    {
+        return rv;
+    }
+
+    rv = pkcs11_session_check(&pSession, hSession);
+    if (rv)
+    {
+        return rv;
+    }
+
+    rv = pkcs11_object_check(&pKey, pSession->active_object);
+    if (rv)
+    {
+        return rv;
+    }
+
+    if (CKM_ECDSA != pSession->active_mech)
+    {
+        return CKR_OPERATION_NOT_INITIALIZED;
+    }
+
+    /* The total signature length must not wrap around */
+    siglen = pkcs11_signature_get_len(pKey);
+    if (!siglen || (ulCount > ULONG_MAX / siglen) || ((size_t)ulCount != ulCount))
+    {
+        return CKR_ARGUMENTS_BAD;
+    }
+
+    if (CKR_OK == (rv = pkcs11_signature_check_params(pSignature, pulSignatureLen, ulCount * siglen)))
+    {
+        if (CKR_OK == (rv = pkcs11_lock_both(pLibCtx)))
+        {
+            rv = pkcs11_util_convert_rv(atcab_sign_batch(pKey->slot, pData, (size_t)ulCount, pSignature));
+
+            (void)pkcs11_unlock_both(pLibCtx);
+        }
+    }
+
+    if (CKR_VENDOR_DEFINED == rv)
+    {
+        /* Made it through the pSignature buffer check so pulSignatureLen is populated */
+        rv = CKR_OK;
+    }
+    else
+    {
+        /* Any other condition resets the sign operation */
+        pSession->active_mech = CKM_VENDOR_DEFINED;
+    }
+
+    return rv;
+}
+
 /**
  * \brief Continues a multiple-part signature operation
  */
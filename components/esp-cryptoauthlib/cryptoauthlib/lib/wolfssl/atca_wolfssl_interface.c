@@ -336,6 +336,8 @@ ATCA_STATUS atcac_sha256_hmac_finish(
 }
 
 /** \brief Set up a public/private key structure for use in asymmetric cryptographic functions
+ *
+ * A public key that is not a point on the curve is rejected.
  *
  * \return ATCA_SUCCESS on success, otherwise an error code.
  */
@@ -367,6 +369,10 @@ ATCA_STATUS atcac_pk_init(
                     {
                         /* Configure the public key */
                         ret = wc_ecc_import_unsigned((ecc_key*)ctx->ptr, (byte*)buf, (byte*)&buf[32], NULL, ECC_SECP256R1);
+                        if (!ret)
+                        {
+                            ret = wc_ecc_check_key((ecc_key*)ctx->ptr);
+                        }
                     }
                     else
                     {
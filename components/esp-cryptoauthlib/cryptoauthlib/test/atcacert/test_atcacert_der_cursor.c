@@ -0,0 +1,228 @@
+/**
+ * \file
+ * \brief  Host tests of the DER cursor and the X.509 field lookup built on it
+ *
+ * Not part of the library. Build against a host build of the library (with
+ * TNGTLS support) and run from the cryptoauthlib directory. atcacert_der.c is
+ * compiled in so the address sanitizer covers it:
+ *
+ *   cc -Wall -fsanitize=address -Ilib -I<build dir> test/atcacert/test_atcacert_der_cursor.c \
+ *       lib/atcacert/atcacert_der.c -L<build dir> -lcryptoauth -o test_atcacert_der_cursor
+ *   ./test_atcacert_der_cursor
+ *
+ * The X.509 tests parse the TNGTLS certificate templates and check the fields
+ * found against the locations in their certificate definitions. Every
+ * truncation of the templates is parsed from an allocation of exactly that
+ * size, so reads past the end are caught.
+ *
+ * \copyright (c) 2015-2020 Microchip Technology Inc. and its subsidiaries.
+ *
+ * \page License
+ *
+ * Subject to your compliance with these terms, you may use Microchip software
+ * and any derivatives exclusively with Microchip products. It is your
+ * responsibility to comply with third party license terms applicable to your
+ * use of third party software (including open source software) that may
+ * accompany Microchip software.
+ *
+ * THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+ * EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY IMPLIED
+ * WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS FOR A
+ * PARTICULAR PURPOSE. IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT,
+ * SPECIAL, PUNITIVE, INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE
+ * OF ANY KIND WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF
+ * MICROCHIP HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE
+ * FORESEEABLE. TO THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL
+ * LIABILITY ON ALL CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED
+ * THE AMOUNT OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR
+ * THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atcacert/atcacert_def.h"
+#include "atcacert/atcacert_der.h"
+
+extern const atcacert_def_t g_tngtls_cert_def_1_signer;
+extern const atcacert_def_t g_tngtls_cert_def_2_device;
+
+static int test_failures = 0;
+
+#define TEST_CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+static void test_cursor_walk(void)
+{
+    /* SEQUENCE { INTEGER 5, OCTET STRING (130 bytes, long form length) }, NULL */
+    uint8_t der[2 + 3 + 4 + 130 + 2];
+    atcacert_der_cursor_t cursor;
+    atcacert_der_cursor_t inner;
+    atcacert_der_tlv_t tlv;
+    atcacert_der_tlv_t seq;
+
+    der[0] = 0x30; der[1] = 0x81; der[2] = 3 + 3 + 130;
+    der[3] = 0x02; der[4] = 0x01; der[5] = 0x05;
+    der[6] = 0x04; der[7] = 0x81; der[8] = 130;
+    memset(&der[9], 0xAA, 130);
+    der[139] = 0x05; der[140] = 0x00;
+
+    atcacert_der_cursor_init(&cursor, der, 141);
+
+    /* A tag mismatch leaves the cursor where it was */
+    TEST_CHECK(atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_SET, &tlv) == ATCACERT_E_ELEM_MISSING);
+    TEST_CHECK(cursor.ptr == der);
+
+    TEST_CHECK(atcacert_der_cursor_expect(&cursor, ATCACERT_DER_TAG_SEQUENCE, &seq) == ATCACERT_E_SUCCESS);
+    TEST_CHECK(seq.tlv == der && seq.tlv_size == 139);
+    TEST_CHECK(seq.value == &der[3] && seq.value_size == 136);
+
+    atcacert_der_cursor_enter(&inner, &seq);
+    TEST_CHECK(atcacert_der_cursor_next(&inner, &tlv) == ATCACERT_E_SUCCESS);
+    TEST_CHECK(tlv.tag == ATCACERT_DER_TAG_INTEGER && tlv.value == &der[5] && tlv.value_size == 1);
+    TEST_CHECK(atcacert_der_cursor_next(&inner, &tlv) == ATCACERT_E_SUCCESS);
+    TEST_CHECK(tlv.tag == ATCACERT_DER_TAG_OCTET_STRING && tlv.value == &der[9] && tlv.value_size == 130);
+    TEST_CHECK(tlv.tlv_size == 133);
+    TEST_CHECK(atcacert_der_cursor_next(&inner, &tlv) == ATCACERT_E_ELEM_MISSING);
+
+    /* The outer level continues after the sequence */
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, &tlv) == ATCACERT_E_SUCCESS);
+    TEST_CHECK(tlv.tag == 0x05 && tlv.value_size == 0 && tlv.tlv_size == 2);
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, &tlv) == ATCACERT_E_ELEM_MISSING);
+    TEST_CHECK(atcacert_der_cursor_expect(&cursor, 0x05, &tlv) == ATCACERT_E_ELEM_MISSING);
+}
+
+static void test_cursor_bad_input(void)
+{
+    static const uint8_t multi_byte_tag[] = { 0x1F, 0x81, 0x01, 0x00 };
+    static const uint8_t value_overrun[] = { 0x04, 0x05, 0x01, 0x02, 0x03, 0x04 };
+    static const uint8_t length_overrun[] = { 0x04, 0x82, 0x01 };
+    static const uint8_t no_length[] = { 0x04 };
+    atcacert_der_cursor_t cursor;
+    atcacert_der_tlv_t tlv;
+
+    atcacert_der_cursor_init(&cursor, multi_byte_tag, sizeof(multi_byte_tag));
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, &tlv) == ATCACERT_E_DECODING_ERROR);
+
+    atcacert_der_cursor_init(&cursor, value_overrun, sizeof(value_overrun));
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, &tlv) == ATCACERT_E_DECODING_ERROR);
+    TEST_CHECK(cursor.ptr == value_overrun);
+
+    atcacert_der_cursor_init(&cursor, length_overrun, sizeof(length_overrun));
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, &tlv) != ATCACERT_E_SUCCESS);
+
+    atcacert_der_cursor_init(&cursor, no_length, sizeof(no_length));
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, &tlv) != ATCACERT_E_SUCCESS);
+
+    atcacert_der_cursor_init(&cursor, NULL, 0);
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, &tlv) == ATCACERT_E_ELEM_MISSING);
+    TEST_CHECK(atcacert_der_cursor_next(NULL, &tlv) == ATCACERT_E_BAD_PARAMS);
+    TEST_CHECK(atcacert_der_cursor_next(&cursor, NULL) == ATCACERT_E_BAD_PARAMS);
+}
+
+static size_t test_offset(const atcacert_def_t* cert_def, const uint8_t* ptr)
+{
+    return (size_t)(ptr - cert_def->cert_template);
+}
+
+static void test_x509_fields(const atcacert_def_t* cert_def)
+{
+    static const uint8_t oid_basic_constraints[] = { 0x55, 0x1D, 0x13 };
+    static const uint8_t oid_missing[] = { 0x55, 0x1D, 0x7F };
+    const atcacert_cert_loc_t* std = cert_def->std_cert_elements;
+    atcacert_der_x509_t x509;
+    atcacert_der_tlv_t tlv;
+
+    TEST_CHECK(atcacert_der_parse_x509(cert_def->cert_template, cert_def->cert_template_size, &x509) == ATCACERT_E_SUCCESS);
+
+    TEST_CHECK(test_offset(cert_def, x509.tbs.tlv) == cert_def->tbs_cert_loc.offset);
+    TEST_CHECK(x509.tbs.tlv_size == cert_def->tbs_cert_loc.count);
+    TEST_CHECK(x509.serial_number.tag == ATCACERT_DER_TAG_INTEGER);
+    TEST_CHECK(test_offset(cert_def, x509.serial_number.value) == std[STDCERT_CERT_SN].offset);
+    TEST_CHECK(x509.serial_number.value_size == std[STDCERT_CERT_SN].count);
+    TEST_CHECK(test_offset(cert_def, x509.not_before.value) == std[STDCERT_ISSUE_DATE].offset);
+    TEST_CHECK(x509.not_before.value_size == std[STDCERT_ISSUE_DATE].count);
+    TEST_CHECK(test_offset(cert_def, x509.not_after.value) == std[STDCERT_EXPIRE_DATE].offset);
+    TEST_CHECK(x509.not_after.value_size == std[STDCERT_EXPIRE_DATE].count);
+    TEST_CHECK(x509.issuer.tag == ATCACERT_DER_TAG_SEQUENCE && x509.subject.tag == ATCACERT_DER_TAG_SEQUENCE);
+
+    /* The uncompressed point ends the SubjectPublicKeyInfo */
+    TEST_CHECK(test_offset(cert_def, x509.public_key_info.tlv + x509.public_key_info.tlv_size - 64) == std[STDCERT_PUBLIC_KEY].offset);
+    TEST_CHECK(x509.signature.tag == ATCACERT_DER_TAG_BIT_STRING);
+    TEST_CHECK(x509.signature.tlv + x509.signature.tlv_size == cert_def->cert_template + cert_def->cert_template_size);
+
+    TEST_CHECK(atcacert_der_x509_get_subj_key_id(&x509, &tlv) == ATCACERT_E_SUCCESS);
+    TEST_CHECK(test_offset(cert_def, tlv.value) == std[STDCERT_SUBJ_KEY_ID].offset && tlv.value_size == 20);
+    TEST_CHECK(atcacert_der_x509_get_auth_key_id(&x509, &tlv) == ATCACERT_E_SUCCESS);
+    TEST_CHECK(test_offset(cert_def, tlv.value) == std[STDCERT_AUTH_KEY_ID].offset && tlv.value_size == 20);
+
+    TEST_CHECK(atcacert_der_x509_get_extension(&x509, oid_basic_constraints, sizeof(oid_basic_constraints), &tlv) == ATCACERT_E_SUCCESS);
+    TEST_CHECK(tlv.tag == ATCACERT_DER_TAG_OCTET_STRING);
+    TEST_CHECK(atcacert_der_x509_get_extension(&x509, oid_missing, sizeof(oid_missing), &tlv) == ATCACERT_E_ELEM_MISSING);
+}
+
+static void test_x509_truncated(const atcacert_def_t* cert_def)
+{
+    atcacert_der_x509_t x509;
+    size_t size;
+    int accepted = 0;
+
+    for (size = 0; size < cert_def->cert_template_size; size++)
+    {
+        /* Exactly the truncated size, so reading past it is caught */
+        uint8_t* cert = malloc(size ? size : 1);
+
+        memcpy(cert, cert_def->cert_template, size);
+        if (atcacert_der_parse_x509(cert, size, &x509) == ATCACERT_E_SUCCESS)
+        {
+            accepted++;
+        }
+        free(cert);
+    }
+    TEST_CHECK(accepted == 0);
+}
+
+static void test_x509_bad_lengths(const atcacert_def_t* cert_def)
+{
+    uint8_t* cert = malloc(cert_def->cert_template_size);
+    atcacert_der_x509_t x509;
+
+    /* The outer SEQUENCE claims one byte more than there is */
+    memcpy(cert, cert_def->cert_template, cert_def->cert_template_size);
+    cert[3]++;
+    TEST_CHECK(atcacert_der_parse_x509(cert, cert_def->cert_template_size, &x509) != ATCACERT_E_SUCCESS);
+
+    /* The TBSCertificate runs into the signature algorithm */
+    memcpy(cert, cert_def->cert_template, cert_def->cert_template_size);
+    cert[cert_def->tbs_cert_loc.offset + 3] += 8;
+    TEST_CHECK(atcacert_der_parse_x509(cert, cert_def->cert_template_size, &x509) != ATCACERT_E_SUCCESS);
+
+    TEST_CHECK(atcacert_der_parse_x509(NULL, 0, &x509) == ATCACERT_E_BAD_PARAMS);
+    TEST_CHECK(atcacert_der_parse_x509(cert, cert_def->cert_template_size, NULL) == ATCACERT_E_BAD_PARAMS);
+    free(cert);
+}
+
+int main(void)
+{
+    const atcacert_def_t* cert_defs[] = { &g_tngtls_cert_def_1_signer, &g_tngtls_cert_def_2_device };
+    size_t i;
+
+    test_cursor_walk();
+    test_cursor_bad_input();
+    for (i = 0; i < sizeof(cert_defs) / sizeof(cert_defs[0]); i++)
+    {
+        test_x509_fields(cert_defs[i]);
+        test_x509_truncated(cert_defs[i]);
+        test_x509_bad_lengths(cert_defs[i]);
+    }
+
+    printf("%s\n", test_failures ? "FAILED" : "OK");
+    return test_failures ? 1 : 0;
+}
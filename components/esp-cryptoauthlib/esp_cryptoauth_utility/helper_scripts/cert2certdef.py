@@ -35,6 +35,7 @@
 # limitations under the License.
 # #############################################################################
 
+import re
 import string
 import datetime
 import argparse
@@ -68,16 +69,42 @@ def main():
         default=None,
         metavar='file',
         help='Generate device CSR definition from sample CSR.')
+    group.add_argument(
+        '--cert-def',
+        dest='cert_def_filenames',
+        nargs='+',
+        default=None,
+        metavar='file',
+        help='Generate the compiled routines for the existing definition --def-name in the given C sources and headers.')
+    parser.add_argument(
+        '--def-name',
+        dest='def_name',
+        default=None,
+        metavar='name',
+        help='Variable name of the atcacert_def_t to compile with --cert-def, e.g. g_tngtls_cert_def_2_device.')
+    parser.add_argument(
+        '--compiled',
+        dest='compiled',
+        action='store_true',
+        help='Also generate build routines specialised for the certificate definition.')
     args = parser.parse_args()
 
     if args.signer_cert_filename is not None:
         cert_der = pem.readPemFromFile(open(args.signer_cert_filename))
-        print(gen_cert_def_c_signer(cert_der))
+        print(gen_cert_def_c_signer(cert_der, args.compiled))
         return
 
     if args.device_cert_filename is not None:
         cert_der = pem.readPemFromFile(open(args.device_cert_filename))
-        print(gen_cert_def_c_device(cert_der))
+        print(gen_cert_def_c_device(cert_der, args.compiled))
+        return
+
+    if args.cert_def_filenames is not None:
+        if args.def_name is None:
+            parser.error('--cert-def requires --def-name')
+        text = '\n'.join(open(filename).read() for filename in args.cert_def_filenames)
+        name = re.sub(r'^g_|_cert_def', '', args.def_name)
+        print(gen_compiled_c(parse_cert_def_c(text, args.def_name), name))
         return
 
     if args.device_csr_filename is not None:
@@ -334,7 +361,7 @@ const atcacert_cert_element_t g_cert_elements_1_signer[] = {
 const uint8_t g_cert_template_1_signer[] = {
 ${cert_template}
 };
-
+${compiled}
 const atcacert_def_t g_cert_def_1_signer = {
     .type                   = CERTTYPE_X509,
     .template_id            = 1,
@@ -406,7 +433,7 @@ const atcacert_def_t g_cert_def_1_signer = {
     .cert_elements          = g_cert_elements_1_signer,
     .cert_elements_count    = sizeof(g_cert_elements_1_signer) / sizeof(g_cert_elements_1_signer[0]),
     .cert_template          = g_cert_template_1_signer,
-    .cert_template_size     = sizeof(g_cert_template_1_signer)
+    .cert_template_size     = sizeof(g_cert_template_1_signer)${compiled_ref}
 };
 """
 
@@ -417,7 +444,7 @@ cert_def_2_device_c = """
 const uint8_t g_cert_template_2_device[] = {
 ${cert_template}
 };
-
+${compiled}
 const atcacert_def_t g_cert_def_2_device = {
     .type                   = CERTTYPE_X509,
     .template_id            = 2,
@@ -489,7 +516,7 @@ const atcacert_def_t g_cert_def_2_device = {
     .cert_elements          = NULL,
     .cert_elements_count    = 0,
     .cert_template          = g_cert_template_2_device,
-    .cert_template_size     = sizeof(g_cert_template_2_device)
+    .cert_template_size     = sizeof(g_cert_template_2_device)${compiled_ref}
 };
 """
 
@@ -577,7 +604,403 @@ const atcacert_def_t g_csr_def_3_device = {
 """
 
 
-def gen_cert_def_c_signer(cert_der):
+# Size of the reads atcacert_read_cert() merges the device locations into (ATCA_BLOCK_SIZE)
+ATCA_BLOCK_SIZE = 32
+
+# Size of the read buffer in atcacert_read_cert()
+ATCACERT_MAX_DEVICE_LOC_READ = 416
+
+STD_CERT_ELEMENTS = ['public_key', 'signature', 'issue_date', 'expire_date', 'signer_id', 'cert_sn', 'auth_key_id', 'subj_key_id']
+
+
+def device_loc(zone, slot, is_genkey, offset, count):
+    return {'zone':zone, 'slot':slot, 'is_genkey':is_genkey, 'offset':offset, 'count':count}
+
+
+# Device serial number, config zone bytes 0-3 and 8-12
+device_sn_dev_loc = device_loc('DEVZONE_CONFIG', 0, 0, 0, 13)
+
+
+def c_strip_comments(text):
+    return re.sub(r'//[^\n]*|/\*.*?\*/', '', text, flags=re.S)
+
+
+def c_parse_initializer(text, pos=0):
+    """Parse the C initializer at text[pos:].
+
+    Braces with designated members give a dict, braces with plain members a
+    list and anything else the expression as a string. Returns the value and
+    the position after it.
+    """
+    pos = len(text) - len(text[pos:].lstrip())
+    if text[pos] != '{':
+        m = re.compile(r'("[^"]*"|[^,}])*').match(text, pos)
+        return m.group(0).strip(), m.end()
+    pos += 1
+    members = {}
+    items = []
+    while True:
+        pos = len(text) - len(text[pos:].lstrip())
+        if text[pos] == '}':
+            return (members if members else items), pos + 1
+        m = re.compile(r'\.(\w+)\s*=').match(text, pos)
+        if m:
+            members[m.group(1)], pos = c_parse_initializer(text, m.end())
+        else:
+            value, pos = c_parse_initializer(text, pos)
+            items.append(value)
+        pos = len(text) - len(text[pos:].lstrip())
+        if text[pos] == ',':
+            pos += 1
+
+
+def c_find_initializer(text, c_type, name):
+    m = re.search(r'\b%s\s+%s\s*(\[[^\]]*\])?\s*=' % (c_type, name), text)
+    if m is None:
+        raise ValueError('%s %s not found' % (c_type, name))
+    return c_parse_initializer(text, m.end())[0]
+
+
+def c_defines(text):
+    """Object-like macros with a plain value, as the definition headers use them for sizes and counts."""
+    return {m.group(1): m.group(2).strip('() ') for m in re.finditer(r'^[ \t]*#define[ \t]+(\w+)[ \t]+([^\n]+)$', text, re.M)}
+
+
+def c_int(expr, defines={}):
+    """Value of an integer expression made of constants, + and -, as written in the templates."""
+    expr = re.sub(r'\b[A-Za-z_]\w*\b', lambda m: defines.get(m.group(0), m.group(0)), expr)
+    if not re.match(r'^\s*\d+(\s*[+-]\s*\d+)*\s*$', expr):
+        raise ValueError('Unsupported expression: %s' % expr)
+    return sum(int(re.sub(r'\s', '', term)) for term in re.findall(r'[+-]?\s*\d+', expr))
+
+
+def c_to_device_loc(loc):
+    # Members left out of a designated initializer are zero
+    return device_loc(loc['zone'], *[c_int(loc.get(member, '0')) for member in ('slot', 'is_genkey', 'offset', 'count')])
+
+
+def c_to_cert_loc(loc):
+    return {'offset':c_int(loc['offset']), 'count':c_int(loc['count'])}
+
+
+def parse_cert_def_c(text, def_name):
+    """Read the atcacert_def_t def_name back from C source, for gen_compiled_c().
+
+    text must hold everything the definition refers to, so pass the headers and
+    the sources of any certificate elements it shares with other definitions.
+    """
+    defines = c_defines(text)
+    text = c_strip_comments(text)
+    cert_def = c_find_initializer(text, 'atcacert_def_t', def_name)
+
+    cert_elements = []
+    if cert_def.get('cert_elements', 'NULL') != 'NULL':
+        for element in c_find_initializer(text, 'atcacert_cert_element_t', cert_def['cert_elements']):
+            cert_elements.append({
+                'id':         element['id'].strip('"'),
+                'device_loc': c_to_device_loc(element['device_loc']),
+                'cert_loc':   c_to_cert_loc(element['cert_loc']),
+                'transforms': [tf for tf in element.get('transforms', []) if tf != 'TF_NONE']
+            })
+        # A definition may use only the first elements of a shared list, sizeof() means all of them
+        count = cert_def.get('cert_elements_count', 'sizeof')
+        if 'sizeof' not in count:
+            cert_elements = cert_elements[:c_int(count, defines)]
+
+    return {
+        'template_id':        c_int(cert_def['template_id']),
+        'chain_id':           c_int(cert_def['chain_id']),
+        'sn_source':          cert_def['sn_source'],
+        'cert_sn_dev_loc':    c_to_device_loc(cert_def['cert_sn_dev_loc']),
+        'issue_date_format':  cert_def['issue_date_format'],
+        'expire_date_format': cert_def['expire_date_format'],
+        'public_key_dev_loc': c_to_device_loc(cert_def['public_key_dev_loc']),
+        'comp_cert_dev_loc':  c_to_device_loc(cert_def['comp_cert_dev_loc']),
+        'std_cert_elements':  dict(zip(STD_CERT_ELEMENTS, [c_to_cert_loc(loc) for loc in cert_def['std_cert_elements']])),
+        'cert_elements':      cert_elements
+    }
+
+
+def merge_device_loc(device_locs, loc, block_size):
+    """Same as atcacert_merge_device_loc()."""
+    if loc['zone'] == 'DEVZONE_NONE' or loc['count'] == 0:
+        return
+    new_offset = (loc['offset'] // block_size) * block_size
+    new_end = -(-(loc['offset'] + loc['count']) // block_size) * block_size
+    for cur in device_locs:
+        cur_end = cur['offset'] + cur['count']
+        if loc['zone'] != cur['zone']:
+            continue
+        if loc['zone'] == 'DEVZONE_DATA' and (loc['slot'] != cur['slot'] or loc['is_genkey'] != cur['is_genkey']):
+            continue
+        if new_end < cur['offset'] or new_offset > cur_end:
+            continue
+        if loc['offset'] < cur['offset']:
+            cur['offset'] = loc['offset']
+        cur['count'] = max(new_end, cur_end) - cur['offset']
+        return
+    device_locs.append(dict(loc, offset=new_offset, count=new_end - new_offset))
+
+
+def get_device_locs(cert_def, block_size=ATCA_BLOCK_SIZE):
+    """Same as atcacert_get_device_locs()."""
+    device_locs = []
+    merge_device_loc(device_locs, cert_def['comp_cert_dev_loc'], block_size)
+    merge_device_loc(device_locs, cert_def['cert_sn_dev_loc'], block_size)
+    merge_device_loc(device_locs, cert_def['public_key_dev_loc'], block_size)
+    for element in cert_def['cert_elements']:
+        merge_device_loc(device_locs, element['device_loc'], block_size)
+    if cert_def['sn_source'] in ('SNSRC_DEVICE_SN', 'SNSRC_DEVICE_SN_HASH', 'SNSRC_DEVICE_SN_HASH_POS', 'SNSRC_DEVICE_SN_HASH_RAW'):
+        merge_device_loc(device_locs, device_sn_dev_loc, block_size)
+    return device_locs
+
+
+def device_loc_data_offset(dest, src):
+    """Offset of dest in the data read from src, None when src doesn't hold dest (atcacert_is_device_loc_match())."""
+    if dest['zone'] == 'DEVZONE_NONE' or dest['count'] == 0 or src['zone'] == 'DEVZONE_NONE' or src['count'] == 0:
+        return None
+    if dest['zone'] != src['zone']:
+        return None
+    if dest['zone'] == 'DEVZONE_DATA' and (dest['slot'] != src['slot'] or dest['is_genkey'] != src['is_genkey']):
+        return None
+    if dest['offset'] < src['offset'] or dest['offset'] + dest['count'] > src['offset'] + src['count']:
+        return None
+    return dest['offset'] - src['offset']
+
+
+def c_device_loc(loc):
+    return '{ .zone = %s, .slot = %d, .is_genkey = %d, .offset = %d, .count = %d }' % (
+        loc['zone'], loc['slot'], loc['is_genkey'], loc['offset'], loc['count'])
+
+
+def c_set_element(lines, name, cert_loc, data, count):
+    if cert_loc['count'] == 0:
+        return
+    if cert_loc['count'] != count:
+        raise ValueError('%s is %d bytes on the device but %d in the certificate' % (name, count, cert_loc['count']))
+    lines.append('    memcpy(&cert[%d], %s, %d);  // %s' % (cert_loc['offset'], data, count, name))
+
+
+def c_comp_cert(lines, cert_def, offset):
+    """Straight-line version of atcacert_set_comp_cert()."""
+    std = cert_def['std_cert_elements']
+    lines.append('    comp_cert = &device_data[%d];' % offset)
+    lines.append('    if ((comp_cert[70] & 0x0F) != 0)')
+    lines.append('    {')
+    lines.append('        return ATCACERT_E_DECODING_ERROR;  // Unknown format')
+    lines.append('    }')
+    lines.append('    if (comp_cert[69] != 0x%02X || (comp_cert[70] >> 4) != %s)' % (
+        (cert_def['template_id'] << 4) | cert_def['chain_id'], cert_def['sn_source']))
+    lines.append('    {')
+    lines.append('        return ATCACERT_E_WRONG_CERT_DEF;')
+    lines.append('    }')
+    lines.append('    ret = atcacert_set_signature(build_state->cert_def, cert, build_state->cert_size, build_state->max_cert_size, comp_cert);')
+    lines.append('    if (ret != ATCACERT_E_SUCCESS)')
+    lines.append('    {')
+    lines.append('        return ret;')
+    lines.append('    }')
+    lines.append('    ret = atcacert_date_dec_compcert(&comp_cert[64], %s, &issue_date, &expire_date);' % cert_def['expire_date_format'])
+    lines.append('    if (ret != ATCACERT_E_SUCCESS)')
+    lines.append('    {')
+    lines.append('        return ret;')
+    lines.append('    }')
+    for name, fmt, date in (('issue_date', cert_def['issue_date_format'], 'issue_date'),
+                            ('expire_date', cert_def['expire_date_format'], 'expire_date')):
+        loc = std[name]
+        if loc['count'] == 0:
+            continue
+        lines.append('    date_size = %d;' % loc['count'])
+        lines.append('    ret = atcacert_date_enc(%s, &%s, &cert[%d], &date_size);' % (fmt, date, loc['offset']))
+        lines.append('    if (ret != ATCACERT_E_SUCCESS)')
+        lines.append('    {')
+        lines.append('        return ret;')
+        lines.append('    }')
+        lines.append('    if (date_size != %d)' % loc['count'])
+        lines.append('    {')
+        lines.append('        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;')
+        lines.append('    }')
+    loc = std['signer_id']
+    if loc['count'] != 0:
+        if loc['count'] != 4:
+            raise ValueError('Signer ID must be 4 hex digits')
+        for i in range(4):
+            lines.append('    cert[%d] = (uint8_t)hex_digits[%s];' % (
+                loc['offset'] + i, ('comp_cert[%d] >> 4' if i % 2 == 0 else 'comp_cert[%d] & 0x0F') % (67 + i // 2)))
+
+
+def c_build_loc(cert_def, loc):
+    """Body of the routine incorporating the data read from one device location, in the order of atcacert_cert_build_process()."""
+    std = cert_def['std_cert_elements']
+    lines = []
+    locals_used = set()
+
+    offset = device_loc_data_offset(cert_def['cert_sn_dev_loc'], loc)
+    if offset is not None:
+        if cert_def['sn_source'] == 'SNSRC_STORED_DYNAMIC':
+            raise ValueError('Dynamic certificate serial numbers move the certificate elements')
+        c_set_element(lines, 'Certificate SN', std['cert_sn'], '&device_data[%d]' % offset, cert_def['cert_sn_dev_loc']['count'])
+
+    offset = device_loc_data_offset(cert_def['public_key_dev_loc'], loc)
+    if offset is not None:
+        if std['public_key']['count'] != 64:
+            raise ValueError('Public key must be 64 bytes in the certificate')
+        if cert_def['public_key_dev_loc']['count'] == 72:
+            lines.append('    atcacert_public_key_remove_padding(&device_data[%d], &cert[%d]);' % (offset, std['public_key']['offset']))
+        elif cert_def['public_key_dev_loc']['count'] == 64:
+            c_set_element(lines, 'Public key', std['public_key'], '&device_data[%d]' % offset, 64)
+        else:
+            raise ValueError('Unexpected public key size')
+        if std['subj_key_id']['count'] != 0:
+            if std['subj_key_id']['count'] != 20:
+                raise ValueError('Subject key ID must be 20 bytes')
+            lines.append('    ret = atcacert_get_key_id(&cert[%d], &cert[%d]);' % (std['public_key']['offset'], std['subj_key_id']['offset']))
+            lines.append('    if (ret != ATCACERT_E_SUCCESS)')
+            lines.append('    {')
+            lines.append('        return ret;')
+            lines.append('    }')
+            locals_used.add('ret')
+
+    offset = device_loc_data_offset(cert_def['comp_cert_dev_loc'], loc)
+    if offset is not None:
+        if cert_def['comp_cert_dev_loc']['count'] != 72:
+            raise ValueError('Compressed certificate must be 72 bytes')
+        c_comp_cert(lines, cert_def, offset)
+        locals_used.update(['ret', 'comp_cert'])
+
+    for element in cert_def['cert_elements']:
+        offset = device_loc_data_offset(element['device_loc'], loc)
+        if offset is None:
+            continue
+        data = '&device_data[%d]' % offset
+        count = element['device_loc']['count']
+        for i, transform in enumerate(element['transforms']):
+            dest = 'tf_buffer%d' % (i % 2 + 1)
+            lines.append('    tf_size = sizeof(%s);' % dest)
+            lines.append('    ret = atcacert_transform_data(%s, %s, %s, %s, &tf_size);' % (transform, data, count, dest))
+            lines.append('    if (ret != ATCACERT_E_SUCCESS)')
+            lines.append('    {')
+            lines.append('        return ret;')
+            lines.append('    }')
+            data = dest
+            count = 'tf_size'
+            locals_used.update(['ret', 'tf', dest])
+        if element['transforms']:
+            lines.append('    if (tf_size != %d)' % element['cert_loc']['count'])
+            lines.append('    {')
+            lines.append('        return ATCACERT_E_UNEXPECTED_ELEM_SIZE;')
+            lines.append('    }')
+            count = element['cert_loc']['count']
+        c_set_element(lines, element['id'], element['cert_loc'], data, count)
+
+    offset = device_loc_data_offset(device_sn_dev_loc, loc)
+    if offset is not None:
+        lines.append('    build_state->is_device_sn = TRUE;')
+        lines.append('    memcpy(&build_state->device_sn[0], &device_data[%d], 4);' % offset)
+        lines.append('    memcpy(&build_state->device_sn[4], &device_data[%d], 5);' % (offset + 8))
+
+    decls = ['    uint8_t* cert = build_state->cert;']
+    if 'ret' in locals_used:
+        decls.append('    int ret;')
+    if 'comp_cert' in locals_used:
+        decls.append('    const uint8_t* comp_cert;')
+        decls.append('    atcacert_tm_utc_t issue_date;')
+        decls.append('    atcacert_tm_utc_t expire_date;')
+        decls.append('    size_t date_size;')
+        if std['signer_id']['count'] != 0:
+            decls.append('    static const char hex_digits[] = "0123456789ABCDEF";')
+    if 'tf' in locals_used:
+        for buffer in ('tf_buffer1', 'tf_buffer2'):
+            if buffer in locals_used:
+                decls.append('    uint8_t %s[256];' % buffer)
+        decls.append('    size_t tf_size;')
+
+    return decls + [''] + lines + ['', '    return ATCACERT_E_SUCCESS;']
+
+
+def cert_def_fixed_end(cert_def):
+    """End of the certificate elements the generated code writes at fixed offsets."""
+    end = 0
+    for name, loc in cert_def['std_cert_elements'].items():
+        if name != 'signature' and loc['count'] != 0:
+            end = max(end, loc['offset'] + loc['count'])
+    for element in cert_def['cert_elements']:
+        end = max(end, element['cert_loc']['offset'] + element['cert_loc']['count'])
+    if end > cert_def['std_cert_elements']['signature']['offset']:
+        raise ValueError('Certificate elements must be before the signature')
+    return end
+
+
+def gen_compiled_c(cert_def, name):
+    """Generate straight-line build routines for a certificate definition.
+
+    The routines do what atcacert_cert_build_process() does for the device
+    locations of the definition, with the offsets and sizes fixed at generation
+    time. atcacert_read_cert() uses them when the definition's compiled field
+    points to the generated atcacert_compiled_def_t. The element getters are
+    left to the library, they each find their element with a single lookup.
+    """
+    device_locs = get_device_locs(cert_def)
+    fixed_end = cert_def_fixed_end(cert_def)
+    out = ['']
+    for loc in device_locs:
+        if loc['count'] > ATCACERT_MAX_DEVICE_LOC_READ:
+            raise ValueError('Device location too large for atcacert_read_cert()')
+
+    out.append('static const atcacert_device_loc_t g_cert_compiled_locs_%s[] = {' % name)
+    out.append(',\n'.join('    ' + c_device_loc(loc) for loc in device_locs))
+    out.append('};')
+    out.append('')
+
+    for index, loc in enumerate(device_locs):
+        out.append('// %s' % c_device_loc(loc))
+        out.append('static int atcacert_build_loc%d_%s(atcacert_build_state_t* build_state, const uint8_t* device_data)' % (index, name))
+        out.append('{')
+        out.extend(c_build_loc(cert_def, loc))
+        out.append('}')
+        out.append('')
+
+    out.append('static int atcacert_build_process_%s(struct atcacert_build_state_s* build_state, size_t index, const uint8_t* device_data)' % name)
+    out.append('{')
+    out.append('    if (build_state == NULL || device_data == NULL)')
+    out.append('    {')
+    out.append('        return ATCACERT_E_BAD_PARAMS;')
+    out.append('    }')
+    out.append('    if (*build_state->cert_size < %d)' % fixed_end)
+    out.append('    {')
+    out.append('        return ATCACERT_E_ELEM_OUT_OF_BOUNDS;')
+    out.append('    }')
+    out.append('')
+    out.append('    switch (index)')
+    out.append('    {')
+    for index in range(len(device_locs)):
+        out.append('    case %d:' % index)
+        out.append('        return atcacert_build_loc%d_%s(build_state, device_data);' % (index, name))
+    out.append('    default:')
+    out.append('        return ATCACERT_E_BAD_PARAMS;')
+    out.append('    }')
+    out.append('}')
+    out.append('')
+    out.append('const atcacert_compiled_def_t g_cert_compiled_%s = {' % name)
+    out.append('    .device_locs       = g_cert_compiled_locs_%s,' % name)
+    out.append('    .device_locs_count = sizeof(g_cert_compiled_locs_%s) / sizeof(g_cert_compiled_locs_%s[0]),' % (name, name))
+    out.append('    .build_process     = atcacert_build_process_%s' % name)
+    out.append('};')
+    out.append('')
+    return '\n'.join(out)
+
+
+def set_compiled_params(params, template, name, compiled):
+    """The compiled routines are generated from the definition as it is written
+    out by template, so the two can not disagree."""
+    params['compiled'] = ''
+    params['compiled_ref'] = ''
+    if compiled:
+        cert_def = parse_cert_def_c(string.Template(template).substitute(params), 'g_cert_def_' + name)
+        params['compiled'] = gen_compiled_c(cert_def, name)
+        params['compiled_ref'] = ',\n    .compiled               = &g_cert_compiled_%s' % name
+
+
+def gen_cert_def_c_signer(cert_der, compiled=False):
     cert = decoder.decode(cert_der, asn1Spec=rfc2459.Certificate())[0]
 
     params = {}
@@ -633,10 +1056,12 @@ def gen_cert_def_c_signer(cert_der):
 
     params['cert_template'] = bin_to_c_hex(cert_der)
 
+    set_compiled_params(params, cert_def_1_signer_c, '1_signer', compiled)
+
     return string.Template(cert_def_1_signer_c).substitute(params)
 
 
-def gen_cert_def_c_device(cert_der):
+def gen_cert_def_c_device(cert_der, compiled=False):
     cert = decoder.decode(cert_der, asn1Spec=rfc2459.Certificate())[0]
 
     params = {}
@@ -692,6 +1117,8 @@ def gen_cert_def_c_device(cert_der):
 
     params['cert_template'] = bin_to_c_hex(cert_der)
 
+    set_compiled_params(params, cert_def_2_device_c, '2_device', compiled)
+
     return string.Template(cert_def_2_device_c).substitute(params)
 
 
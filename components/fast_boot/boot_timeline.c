@@ -0,0 +1,54 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "boot_timeline.h"
+
+typedef struct {
+    const char *phase;
+    // Time since boot in us
+    int64_t at;
+} boot_phase_t;
+
+static const char *TAG = "boot";
+static boot_phase_t s_phases[BOOT_TIMELINE_MAX];
+static int s_count = 0;
+// Set by boot_complete(), after which nothing more is recorded
+static bool s_complete = false;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void boot_mark(const char *phase) {
+    taskENTER_CRITICAL(&s_lock);
+    int64_t at = esp_timer_get_time();
+    bool recorded = !s_complete && (s_count < BOOT_TIMELINE_MAX);
+    if (recorded) {
+        s_phases[s_count].phase = phase;
+        s_phases[s_count].at = at;
+        s_count++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (recorded) {
+        ESP_LOGD(TAG, "%s at %" PRId64 " ms", phase, at / 1000);
+    }
+}
+
+void boot_complete(const char *phase) {
+    if (s_complete) {
+        return;
+    }
+    boot_mark(phase);
+    s_complete = true;
+
+    ESP_LOGI(TAG, "Boot timeline:");
+    int64_t previous = 0;
+    for (int i = 0; i < s_count; i++) {
+        ESP_LOGI(TAG, "%6" PRId64 " ms (+%5" PRId64 " ms) %s", s_phases[i].at / 1000,
+                 (s_phases[i].at - previous) / 1000, s_phases[i].phase);
+        previous = s_phases[i].at;
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most boot phases recorded */
+#define BOOT_TIMELINE_MAX 16
+
+/**
+ * \brief Record that a boot phase completed, from any task
+ */
+void boot_mark(const char *phase);
+
+/**
+ * \brief Record the last boot phase and log every phase with its time since boot and its own cost.
+ * Only the first call has any effect, so it can be called on every publish.
+ */
+void boot_complete(const char *phase);
+
+#ifdef __cplusplus
+}
+#endif
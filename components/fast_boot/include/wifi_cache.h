@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Boots in a row that reuse a cached DHCP lease before it is renewed with a full DHCP exchange */
+#define WIFI_CACHE_LEASE_REUSE_MAX 16
+/* Attempts at joining the cached AP before it is forgotten, so a missed association does not lose it */
+#define WIFI_CACHE_JOIN_ATTEMPTS 3
+
+/**
+ * Parameters of the last successful Wi-Fi connection.
+ * With the BSSID and channel the station joins the AP without scanning every channel. The DHCP
+ * lease is only kept in RTC memory, so it is reused after a reset or a deep sleep until it expires,
+ * but a cold boot still asks the DHCP server.
+ */
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    bool has_lease;
+    esp_netif_ip_info_t ip;
+    esp_netif_dns_info_t dns;
+    // End of the lease on the RTC timer (esp_clk_rtc_time)
+    uint64_t lease_expiry_us;
+    // Boots that used the lease without DHCP
+    uint16_t lease_reuses;
+    uint32_t check;
+} wifi_cache_t;
+
+/**
+ * \brief Set up a fast connection from the cached parameters, if they belong to the configured SSID:
+ * the BSSID and channel go into \p config and a reusable lease is set as a static IP on \p netif.
+ * Must be called after the netif is created and before the station connects. NVS must already be
+ * initialised.
+ *
+ * \return true if the connection will use the cached parameters
+ */
+bool wifi_cache_apply(esp_netif_t *netif, wifi_config_t *config);
+
+/**
+ * \brief Set the station configuration changed by wifi_cache_apply() or wifi_cache_forget() for this
+ * boot only. The Wi-Fi storage is switched to RAM for the call and back to flash afterwards, so the
+ * configuration stored in NVS keeps no cached BSSID and later esp_wifi_set_config() calls still persist.
+ */
+esp_err_t wifi_cache_set_config(wifi_config_t *config);
+
+/**
+ * \brief Hand the address back to the DHCP client once the network is no longer needed in a hurry, e.g.
+ * after the first publish, if the connection reused the cached lease. Without it the reused lease would
+ * stay a static address for the whole uptime and never be renewed. The cache is updated with the
+ * renewed lease. \p config must stay valid until then.
+ */
+void wifi_cache_renew(esp_netif_t *netif, const wifi_config_t *config);
+
+/**
+ * \brief Save the parameters of the connection that just got an IP.
+ * NVS is only written when the AP changed.
+ */
+void wifi_cache_store(esp_netif_t *netif, const wifi_config_t *config);
+
+/**
+ * \brief Drop the cached parameters, e.g. because the cached AP could not be joined, and go back to
+ * a full scan and DHCP. \p config must then be set again with wifi_cache_set_config() before reconnecting.
+ */
+void wifi_cache_forget(esp_netif_t *netif, wifi_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
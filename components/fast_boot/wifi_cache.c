@@ -0,0 +1,206 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_private/esp_clk.h"
+#include "esp_rom_crc.h"
+#include "lwip/dhcp.h"
+#include "nvs.h"
+
+#include "wifi_cache.h"
+
+#define WIFI_CACHE_NAMESPACE "wifi_cache"
+#define WIFI_CACHE_KEY "ap"
+
+static const char *TAG = "wifi_cache";
+
+/* Kept through software resets and deep sleep, lost on power down */
+static RTC_NOINIT_ATTR wifi_cache_t s_rtc_cache;
+
+/* The DHCP client was stopped to reuse the cached lease */
+static bool s_lease_reused = false;
+static esp_netif_t *s_renew_netif;
+static esp_event_handler_instance_t s_renew_instance;
+
+static uint32_t wifi_cache_check(const wifi_cache_t *cache) {
+    return esp_rom_crc32_le(0, (const uint8_t *)cache, offsetof(wifi_cache_t, check));
+}
+
+static bool wifi_cache_valid(const wifi_cache_t *cache) {
+    return cache->channel != 0 && cache->check == wifi_cache_check(cache);
+}
+
+/**
+ * Cached parameters from RTC memory, or from NVS after a power down
+ */
+static bool wifi_cache_load(wifi_cache_t *cache) {
+    if (wifi_cache_valid(&s_rtc_cache)) {
+        memcpy(cache, &s_rtc_cache, sizeof(*cache));
+        return true;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t size = sizeof(*cache);
+    esp_err_t err = nvs_get_blob(nvs, WIFI_CACHE_KEY, cache, &size);
+    nvs_close(nvs);
+    return err == ESP_OK && size == sizeof(*cache) && wifi_cache_valid(cache);
+}
+
+/**
+ * Lease time granted by the DHCP server in seconds, 0 if the netif has no DHCP lease
+ */
+static uint32_t wifi_cache_lease_time(esp_netif_t *netif) {
+    struct netif *lwip_netif = esp_netif_get_netif_impl(netif);
+    struct dhcp *dhcp = lwip_netif ? netif_dhcp_data(lwip_netif) : NULL;
+    return (dhcp && dhcp->state == DHCP_STATE_BOUND) ? dhcp->offered_t0_lease : 0;
+}
+
+bool wifi_cache_apply(esp_netif_t *netif, wifi_config_t *config) {
+    wifi_cache_t cache;
+    if (!wifi_cache_load(&cache) ||
+        strncmp(cache.ssid, (const char *)config->sta.ssid, sizeof(config->sta.ssid)) != 0) {
+        return false;
+    }
+
+    /* Join the known AP on its channel instead of scanning them all */
+    config->sta.bssid_set = true;
+    memcpy(config->sta.bssid, cache.bssid, sizeof(cache.bssid));
+    config->sta.channel = cache.channel;
+    config->sta.scan_method = WIFI_FAST_SCAN;
+
+    /* The RTC timer keeps counting through resets and deep sleep, like the lease on the server */
+    bool lease_current = cache.has_lease && esp_clk_rtc_time() < cache.lease_expiry_us;
+    if (cache.has_lease && !lease_current) {
+        ESP_LOGI(TAG, "Cached lease of " IPSTR " expired", IP2STR(&cache.ip.ip));
+    }
+    if (lease_current && cache.lease_reuses < WIFI_CACHE_LEASE_REUSE_MAX &&
+        esp_netif_dhcpc_stop(netif) == ESP_OK) {
+        esp_netif_set_ip_info(netif, &cache.ip);
+        esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &cache.dns);
+        s_rtc_cache.lease_reuses++;
+        s_rtc_cache.check = wifi_cache_check(&s_rtc_cache);
+        s_lease_reused = true;
+        ESP_LOGI(TAG, "Reusing " IPSTR " on channel %d", IP2STR(&cache.ip.ip), cache.channel);
+    }
+    else {
+        ESP_LOGI(TAG, "Joining the cached AP on channel %d", cache.channel);
+    }
+    return true;
+}
+
+esp_err_t wifi_cache_set_config(wifi_config_t *config) {
+    esp_err_t err = esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = esp_wifi_set_config(WIFI_IF_STA, config);
+    esp_wifi_set_storage(WIFI_STORAGE_FLASH);
+    return err;
+}
+
+/**
+ * Got an IP from the restarted DHCP client: save the new lease, once
+ */
+static void wifi_cache_renewed(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    wifi_cache_store(s_renew_netif, (const wifi_config_t *)arg);
+    esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, s_renew_instance);
+}
+
+void wifi_cache_renew(esp_netif_t *netif, const wifi_config_t *config) {
+    if (!s_lease_reused) {
+        return;
+    }
+    s_lease_reused = false;
+
+    /* With CONFIG_LWIP_DHCP_RESTORE_LAST_IP the client asks for the same address straight away */
+    s_renew_netif = netif;
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_cache_renewed, (void *)config,
+                                        &s_renew_instance);
+    if (esp_netif_dhcpc_start(netif) == ESP_OK) {
+        ESP_LOGI(TAG, "Renewing the cached lease with DHCP");
+    }
+}
+
+void wifi_cache_store(esp_netif_t *netif, const wifi_config_t *config) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+
+    wifi_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    strlcpy(cache.ssid, (const char *)config->sta.ssid, sizeof(cache.ssid));
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+
+    /* A lease obtained from the DHCP server restarts the count and the expiry, a reused one
+     * carries on with both */
+    esp_netif_dhcp_status_t dhcp = ESP_NETIF_DHCP_INIT;
+    esp_netif_dhcpc_get_status(netif, &dhcp);
+    bool same_ap = wifi_cache_valid(&s_rtc_cache) &&
+                   memcmp(s_rtc_cache.bssid, cache.bssid, sizeof(cache.bssid)) == 0 &&
+                   s_rtc_cache.channel == cache.channel;
+    cache.has_lease = (esp_netif_get_ip_info(netif, &cache.ip) == ESP_OK) &&
+                      (esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &cache.dns) == ESP_OK);
+    if (dhcp == ESP_NETIF_DHCP_STARTED) {
+        uint32_t lease_time = wifi_cache_lease_time(netif);
+        cache.has_lease = cache.has_lease && lease_time != 0;
+        cache.lease_expiry_us = esp_clk_rtc_time() + (uint64_t)lease_time * 1000000;
+        cache.lease_reuses = 0;
+    }
+    else if (same_ap && s_rtc_cache.has_lease) {
+        cache.lease_expiry_us = s_rtc_cache.lease_expiry_us;
+        cache.lease_reuses = s_rtc_cache.lease_reuses;
+    }
+    else {
+        cache.has_lease = false;
+    }
+    cache.check = wifi_cache_check(&cache);
+    memcpy(&s_rtc_cache, &cache, sizeof(cache));
+
+    /* Only the AP is persisted, so NVS is written when the device moves rather than on every boot */
+    wifi_cache_t stored;
+    memset(&stored, 0, sizeof(stored));
+    memcpy(stored.ssid, cache.ssid, sizeof(stored.ssid));
+    memcpy(stored.bssid, cache.bssid, sizeof(stored.bssid));
+    stored.channel = cache.channel;
+    stored.check = wifi_cache_check(&stored);
+
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    wifi_cache_t previous;
+    size_t size = sizeof(previous);
+    if (nvs_get_blob(nvs, WIFI_CACHE_KEY, &previous, &size) != ESP_OK || size != sizeof(previous) ||
+        memcmp(&previous, &stored, sizeof(stored)) != 0) {
+        if (nvs_set_blob(nvs, WIFI_CACHE_KEY, &stored, sizeof(stored)) == ESP_OK) {
+            nvs_commit(nvs);
+            ESP_LOGD(TAG, "Stored AP on channel %d", stored.channel);
+        }
+    }
+    nvs_close(nvs);
+}
+
+void wifi_cache_forget(esp_netif_t *netif, wifi_config_t *config) {
+    memset(&s_rtc_cache, 0, sizeof(s_rtc_cache));
+
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, WIFI_CACHE_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+
+    config->sta.bssid_set = false;
+    memset(config->sta.bssid, 0, sizeof(config->sta.bssid));
+    config->sta.channel = 0;
+    config->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    s_lease_reused = false;
+    esp_netif_dhcpc_start(netif);
+}
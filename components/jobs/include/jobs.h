@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/timers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Timed job.
+ * A one-shot FreeRTOS timer sets the job's bit in an event group when the job is due, and the task
+ * owning the group runs it and reports how it went with job_done(), which schedules the next run.
+ * Tasks therefore only wake for real work instead of polling.
+ */
+typedef struct {
+    TimerHandle_t timer;
+    EventGroupHandle_t events;
+    EventBits_t bit;
+    // Delay between successful runs in ms, 0 for a job that only runs when started
+    uint32_t period_ms;
+    // Each delay is moved by up to this much either way, so a fleet does not act in step
+    uint32_t jitter_ms;
+    // Delay after a first failure, doubled with each further failure up to backoff_max_ms.
+    // 0 to retry after the normal period.
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    // Current backoff, 0 after a success
+    uint32_t backoff_ms;
+    // Started and not yet reported done. Set and cleared from several tasks, only under lock.
+    bool pending;
+    portMUX_TYPE lock;
+} job_t;
+
+typedef struct {
+    uint32_t period_ms;
+    uint32_t jitter_ms;
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+} job_config_t;
+
+/**
+ * \brief Create the timer of a job that sets \p bit in \p events. The job is not started.
+ */
+esp_err_t job_init(job_t *job, const char *name, EventGroupHandle_t events, EventBits_t bit,
+                   const job_config_t *config);
+
+/**
+ * \brief Schedule the next run of a job, replacing any run already scheduled.
+ * A delay of 0 runs the job straight away, without jitter.
+ */
+void job_start(job_t *job, uint32_t delay_ms);
+
+/**
+ * \brief Report the outcome of a run and schedule the next one: after the period on success, after
+ * the backoff on failure.
+ */
+void job_done(job_t *job, bool ok);
+
+/**
+ * \brief Cancel the next run of a job
+ */
+void job_stop(job_t *job);
+
+/**
+ * \brief Whether the job is scheduled or due and not done yet
+ */
+bool job_pending(job_t *job);
+
+#ifdef __cplusplus
+}
+#endif
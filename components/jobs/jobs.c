@@ -0,0 +1,86 @@
+#include "esp_random.h"
+
+#include "jobs.h"
+
+static void job_set_pending(job_t *job, bool pending) {
+    taskENTER_CRITICAL(&job->lock);
+    job->pending = pending;
+    taskEXIT_CRITICAL(&job->lock);
+}
+
+static void job_timer_cb(TimerHandle_t timer) {
+    job_t *job = (job_t *)pvTimerGetTimerID(timer);
+    xEventGroupSetBits(job->events, job->bit);
+}
+
+esp_err_t job_init(job_t *job, const char *name, EventGroupHandle_t events, EventBits_t bit,
+                   const job_config_t *config) {
+    job->events = events;
+    job->bit = bit;
+    job->period_ms = config->period_ms;
+    job->jitter_ms = config->jitter_ms;
+    job->backoff_min_ms = config->backoff_min_ms;
+    job->backoff_max_ms = (config->backoff_max_ms > config->backoff_min_ms) ? config->backoff_max_ms
+                                                                            : config->backoff_min_ms;
+    job->backoff_ms = 0;
+    job->pending = false;
+    portMUX_INITIALIZE(&job->lock);
+    // The period is set whenever the job is started
+    job->timer = xTimerCreate(name, 1, pdFALSE, job, job_timer_cb);
+    return (job->timer != NULL) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void job_start(job_t *job, uint32_t delay_ms) {
+    job_set_pending(job, true);
+    if (delay_ms == 0) {
+        xTimerStop(job->timer, portMAX_DELAY);
+        xEventGroupSetBits(job->events, job->bit);
+        return;
+    }
+
+    int64_t delay = delay_ms;
+    if (job->jitter_ms > 0) {
+        delay += (int64_t)(esp_random() % (2 * job->jitter_ms + 1)) - job->jitter_ms;
+    }
+    TickType_t ticks = (delay > 0) ? (TickType_t)(delay * configTICK_RATE_HZ / 1000) : 0;
+    // A timer period cannot be 0
+    xTimerChangePeriod(job->timer, (ticks > 0) ? ticks : 1, portMAX_DELAY);
+}
+
+void job_done(job_t *job, bool ok) {
+    if (!ok && job->backoff_min_ms > 0) {
+        if (job->backoff_ms == 0) {
+            job->backoff_ms = job->backoff_min_ms;
+        }
+        else if (job->backoff_ms < job->backoff_max_ms / 2) {
+            job->backoff_ms *= 2;
+        }
+        else {
+            job->backoff_ms = job->backoff_max_ms;
+        }
+        job_start(job, job->backoff_ms);
+        return;
+    }
+
+    if (ok) {
+        job->backoff_ms = 0;
+    }
+    if (job->period_ms == 0) {
+        job_set_pending(job, false);
+        return;
+    }
+    job_start(job, job->period_ms);
+}
+
+void job_stop(job_t *job) {
+    xTimerStop(job->timer, portMAX_DELAY);
+    xEventGroupClearBits(job->events, job->bit);
+    job_set_pending(job, false);
+}
+
+bool job_pending(job_t *job) {
+    taskENTER_CRITICAL(&job->lock);
+    bool pending = job->pending;
+    taskEXIT_CRITICAL(&job->lock);
+    return pending;
+}
@@ -0,0 +1,212 @@
+/*
+ * Host unit tests of the JSON writer. Not part of the firmware. Build and run from the repository root:
+ *
+ *   cc -Wall -fsanitize=address -Icomponents/json_writer/include \
+ *       components/json_writer/host/jw_test.c components/json_writer/json_writer.c -o jw_test
+ *   ./jw_test
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_writer.h"
+
+#define CHECK(cond)                                                                      \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);     \
+            exit(1);                                                                     \
+        }                                                                                \
+    } while (0)
+
+/* The body of a Database Direct insertMany post */
+static void readings(jw_t *w) {
+    jw_object_begin(w);
+    jw_key(w, "collection");
+    jw_string(w, "dev\"1\\\n\x01");
+    jw_key(w, "documents");
+    jw_array_begin(w);
+    for (int i = 0; i < 3; i++) {
+        jw_object_begin(w);
+        jw_key(w, "count");
+        jw_int(w, i - 1);
+        jw_object_end(w);
+    }
+    jw_array_end(w);
+    jw_object_end(w);
+}
+
+static const char readings_json[] =
+    "{\"collection\":\"dev\\\"1\\\\\\n\\u0001\",\"documents\":[{\"count\":-1},{\"count\":0},{\"count\":1}]}";
+
+/**
+ * Measuring and writing give the same length, and the output is escaped and NUL terminated
+ */
+static void check_document(void) {
+    jw_t w;
+    char buf[256];
+
+    jw_init(&w, NULL, 0);
+    readings(&w);
+    CHECK(jw_ok(&w));
+    CHECK(jw_length(&w) == strlen(readings_json));
+
+    memset(buf, 'x', sizeof(buf));
+    jw_init(&w, buf, sizeof(buf));
+    readings(&w);
+    CHECK(jw_ok(&w));
+    CHECK(strcmp(buf, readings_json) == 0);
+
+    jw_init(&w, buf, sizeof(buf));
+    jw_array_begin(&w);
+    jw_int(&w, INT64_MIN);
+    jw_uint(&w, UINT64_MAX);
+    jw_bool(&w, true);
+    jw_bool(&w, false);
+    jw_null(&w);
+    jw_array_begin(&w);
+    jw_array_end(&w);
+    jw_object_begin(&w);
+    jw_object_end(&w);
+    jw_array_end(&w);
+    CHECK(jw_ok(&w));
+    CHECK(strcmp(buf, "[-9223372036854775808,18446744073709551615,true,false,null,[],{}]") == 0);
+
+    /* A scalar alone is a document too */
+    jw_init(&w, buf, sizeof(buf));
+    jw_string(&w, "");
+    CHECK(jw_ok(&w));
+    CHECK(strcmp(buf, "\"\"") == 0);
+}
+
+/**
+ * A document that does not fit with its NUL is reported, the buffer stays terminated and untouched past its end
+ */
+static void check_overflow(void) {
+    size_t n = strlen(readings_json);
+    char buf[sizeof(readings_json) + 1];
+    jw_t w;
+
+    for (size_t size = 1; size <= n + 1; size++) {
+        buf[size] = '#';
+        jw_init(&w, buf, size);
+        readings(&w);
+        CHECK(jw_ok(&w) == (size == n + 1));
+        CHECK(jw_length(&w) == n);
+        CHECK(strlen(buf) == size - 1);
+        CHECK(strncmp(buf, readings_json, size - 1) == 0);
+        CHECK(buf[size] == '#');
+    }
+
+    jw_init(&w, buf, 0);
+    jw_null(&w);
+    CHECK(!jw_ok(&w));
+}
+
+/**
+ * Misuse sets the error state, which stays set until the next jw_init
+ */
+static void check_errors(void) {
+    char buf[64];
+    jw_t w;
+
+    /* Nothing written */
+    jw_init(&w, buf, sizeof(buf));
+    CHECK(!jw_ok(&w));
+    CHECK(buf[0] == '\0');
+
+    /* Key inside an array */
+    jw_init(&w, buf, sizeof(buf));
+    jw_array_begin(&w);
+    jw_key(&w, "a");
+    jw_int(&w, 1);
+    jw_array_end(&w);
+    CHECK(w.error);
+    CHECK(!jw_ok(&w));
+
+    /* Key at the top level */
+    jw_init(&w, buf, sizeof(buf));
+    jw_key(&w, "a");
+    CHECK(w.error);
+
+    /* Two keys in a row */
+    jw_init(&w, buf, sizeof(buf));
+    jw_object_begin(&w);
+    jw_key(&w, "a");
+    jw_key(&w, "b");
+    CHECK(w.error);
+
+    /* Object member without a key */
+    jw_init(&w, buf, sizeof(buf));
+    jw_object_begin(&w);
+    jw_int(&w, 1);
+    jw_object_end(&w);
+    CHECK(w.error);
+    CHECK(!jw_ok(&w));
+
+    /* Key without its value */
+    jw_init(&w, buf, sizeof(buf));
+    jw_object_begin(&w);
+    jw_key(&w, "a");
+    jw_object_end(&w);
+    CHECK(w.error);
+
+    /* Second top level value, scalar or container */
+    jw_init(&w, buf, sizeof(buf));
+    jw_int(&w, 1);
+    CHECK(jw_ok(&w));
+    jw_int(&w, 2);
+    CHECK(w.error);
+    CHECK(!jw_ok(&w));
+
+    jw_init(&w, buf, sizeof(buf));
+    jw_object_begin(&w);
+    jw_object_end(&w);
+    jw_array_begin(&w);
+    jw_array_end(&w);
+    CHECK(w.error);
+
+    /* Mismatched and unbalanced containers */
+    jw_init(&w, buf, sizeof(buf));
+    jw_object_begin(&w);
+    jw_array_end(&w);
+    CHECK(w.error);
+
+    jw_init(&w, buf, sizeof(buf));
+    jw_array_begin(&w);
+    jw_object_end(&w);
+    CHECK(w.error);
+
+    jw_init(&w, buf, sizeof(buf));
+    jw_array_end(&w);
+    CHECK(w.error);
+
+    jw_init(&w, buf, sizeof(buf));
+    jw_array_begin(&w);
+    CHECK(!w.error);
+    CHECK(!jw_ok(&w));
+
+    /* Too deep */
+    jw_init(&w, NULL, 0);
+    for (int i = 0; i < JW_MAX_DEPTH; i++) {
+        jw_array_begin(&w);
+    }
+    CHECK(!w.error);
+    jw_array_begin(&w);
+    CHECK(w.error);
+
+    /* A fresh start clears the error */
+    jw_init(&w, buf, sizeof(buf));
+    jw_null(&w);
+    CHECK(jw_ok(&w));
+    CHECK(strcmp(buf, "null") == 0);
+}
+
+int main(void) {
+    check_document();
+    check_overflow();
+    check_errors();
+    printf("OK\n");
+    return 0;
+}
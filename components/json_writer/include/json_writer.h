@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Deepest nesting of objects and arrays */
+#define JW_MAX_DEPTH 16
+
+/**
+ * Streaming JSON writer.
+ * Writes straight into a caller supplied buffer without allocating. Initialised with a NULL buffer it
+ * only counts, so the exact length of a payload can be known before it is written, e.g. to send
+ * Content-Length ahead of the body.
+ */
+typedef struct {
+    char *buf;
+    size_t size;
+    // Length of the whole document, even past the end of the buffer
+    size_t len;
+    int depth;
+    // Bit n set when the container at depth n already holds a value
+    uint32_t has_value;
+    // Bit n set when the container at depth n is an object, clear for an array
+    uint32_t in_object;
+    // Next value is the value of a key
+    bool after_key;
+    // The top level value has been started
+    bool has_root;
+    bool error;
+} jw_t;
+
+/**
+ * \brief Start a document. A NULL buffer only measures the document.
+ * The output is kept NUL terminated, so the buffer needs one byte more than the document.
+ * Misuse (a key outside an object, a value without its key, a second top level value,
+ * mismatched or too deep containers) sets the error state reported by jw_ok().
+ */
+void jw_init(jw_t *w, char *buf, size_t size);
+
+void jw_object_begin(jw_t *w);
+void jw_object_end(jw_t *w);
+void jw_array_begin(jw_t *w);
+void jw_array_end(jw_t *w);
+
+/**
+ * \brief Write the key of the next object member. Only valid directly inside an object.
+ */
+void jw_key(jw_t *w, const char *key);
+
+void jw_string(jw_t *w, const char *value);
+void jw_int(jw_t *w, int64_t value);
+void jw_uint(jw_t *w, uint64_t value);
+void jw_bool(jw_t *w, bool value);
+void jw_null(jw_t *w);
+
+/**
+ * \brief Length of the document written so far, including anything that did not fit, without the NUL
+ */
+static inline size_t jw_length(const jw_t *w) {
+    return w->len;
+}
+
+/**
+ * \brief Whether the document is complete, well formed and fits the buffer with its NUL
+ */
+bool jw_ok(const jw_t *w);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,208 @@
+#include "json_writer.h"
+
+static void jw_put(jw_t *w, char c) {
+    /* The last byte of the buffer is kept for the terminating NUL */
+    if (w->len + 1 < w->size) {
+        w->buf[w->len] = c;
+        w->buf[w->len + 1] = '\0';
+    }
+    w->len++;
+}
+
+static void jw_put_raw(jw_t *w, const char *s) {
+    while (*s) {
+        jw_put(w, *s++);
+    }
+}
+
+/**
+ * Separate the new member or element from the previous one in its container
+ */
+static void jw_separate(jw_t *w) {
+    uint32_t bit = 1u << (w->depth - 1);
+    if (w->has_value & bit) {
+        jw_put(w, ',');
+    }
+    w->has_value |= bit;
+}
+
+/**
+ * Check a value may come here and separate it from the previous one.
+ * A document holds a single top level value and object members need a key.
+ */
+static void jw_value_start(jw_t *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth == 0) {
+        if (w->has_root) {
+            w->error = true;
+        }
+        w->has_root = true;
+        return;
+    }
+    if (w->in_object & (1u << (w->depth - 1))) {
+        w->error = true;
+    }
+    jw_separate(w);
+}
+
+static void jw_escaped(jw_t *w, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+
+    jw_put(w, '"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+            case '"':
+                jw_put_raw(w, "\\\"");
+                break;
+            case '\\':
+                jw_put_raw(w, "\\\\");
+                break;
+            case '\n':
+                jw_put_raw(w, "\\n");
+                break;
+            case '\r':
+                jw_put_raw(w, "\\r");
+                break;
+            case '\t':
+                jw_put_raw(w, "\\t");
+                break;
+            case '\b':
+                jw_put_raw(w, "\\b");
+                break;
+            case '\f':
+                jw_put_raw(w, "\\f");
+                break;
+            default:
+                if (c < 0x20) {
+                    jw_put_raw(w, "\\u00");
+                    jw_put(w, hex[c >> 4]);
+                    jw_put(w, hex[c & 0xF]);
+                }
+                else {
+                    jw_put(w, c);
+                }
+                break;
+        }
+    }
+    jw_put(w, '"');
+}
+
+static void jw_digits(jw_t *w, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    while (n) {
+        jw_put(w, digits[--n]);
+    }
+}
+
+static void jw_container_begin(jw_t *w, char open) {
+    jw_value_start(w);
+    if (w->depth == JW_MAX_DEPTH) {
+        w->error = true;
+        return;
+    }
+    jw_put(w, open);
+    w->depth++;
+    uint32_t bit = 1u << (w->depth - 1);
+    w->has_value &= ~bit;
+    if (open == '{') {
+        w->in_object |= bit;
+    }
+    else {
+        w->in_object &= ~bit;
+    }
+}
+
+static void jw_container_end(jw_t *w, char close) {
+    if (w->depth == 0 || w->after_key || (((w->in_object >> (w->depth - 1)) & 1) != (close == '}'))) {
+        w->error = true;
+        return;
+    }
+    jw_put(w, close);
+    w->depth--;
+}
+
+void jw_init(jw_t *w, char *buf, size_t size) {
+    w->buf = buf;
+    w->size = (buf != NULL) ? size : 0;
+    w->len = 0;
+    w->depth = 0;
+    w->has_value = 0;
+    w->in_object = 0;
+    w->after_key = false;
+    w->has_root = false;
+    w->error = false;
+    if (w->size > 0) {
+        buf[0] = '\0';
+    }
+}
+
+void jw_object_begin(jw_t *w) {
+    jw_container_begin(w, '{');
+}
+
+void jw_object_end(jw_t *w) {
+    jw_container_end(w, '}');
+}
+
+void jw_array_begin(jw_t *w) {
+    jw_container_begin(w, '[');
+}
+
+void jw_array_end(jw_t *w) {
+    jw_container_end(w, ']');
+}
+
+void jw_key(jw_t *w, const char *key) {
+    if (w->depth == 0 || w->after_key || !(w->in_object & (1u << (w->depth - 1)))) {
+        w->error = true;
+        return;
+    }
+    jw_separate(w);
+    jw_escaped(w, key);
+    jw_put(w, ':');
+    w->after_key = true;
+}
+
+void jw_string(jw_t *w, const char *value) {
+    jw_value_start(w);
+    jw_escaped(w, value);
+}
+
+void jw_int(jw_t *w, int64_t value) {
+    jw_value_start(w);
+    if (value < 0) {
+        jw_put(w, '-');
+        jw_digits(w, (uint64_t)0 - (uint64_t)value);
+    }
+    else {
+        jw_digits(w, (uint64_t)value);
+    }
+}
+
+void jw_uint(jw_t *w, uint64_t value) {
+    jw_value_start(w);
+    jw_digits(w, value);
+}
+
+void jw_bool(jw_t *w, bool value) {
+    jw_value_start(w);
+    jw_put_raw(w, value ? "true" : "false");
+}
+
+void jw_null(jw_t *w) {
+    jw_value_start(w);
+    jw_put_raw(w, "null");
+}
+
+bool jw_ok(const jw_t *w) {
+    return !w->error && w->has_root && w->depth == 0 && !w->after_key && (w->buf == NULL || w->len < w->size);
+}
@@ -0,0 +1,161 @@
+/*
+ * Host check and benchmark of the telemetry log, backed by a file standing in for the partition.
+ * Not part of the firmware. Build and run from the repository root:
+ *
+ *   cc -O2 -Wall -Icomponents/telemetry_log/host -Icomponents/telemetry_log/include \
+ *       components/telemetry_log/host/tlog_bench.c components/telemetry_log/telemetry_log.c -o tlog_bench
+ *   ./tlog_bench [log file]
+ *
+ * It checks ordered replay across a reopen, overflow and recovery from a torn record, then
+ * measures appends and batched replay on a log the size of the "tlog" partition.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry_log.h"
+
+/* Size of the "tlog" partition */
+#define BENCH_LOG_SIZE (32 * 1024)
+/* Replay batch of the Database Direct app (BATCH_CAPACITY) */
+#define BENCH_BATCH 24
+#define BENCH_APPENDS 200000
+
+#define CHECK(cond)                                                                      \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);     \
+            exit(1);                                                                     \
+        }                                                                                \
+    } while (0)
+
+static double now_s(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void open_log(tlog_t *log, const char *path, uint32_t size) {
+    CHECK(tlog_open_file(log, path, size) == ESP_OK);
+}
+
+/**
+ * Readings come back in order, also after a reopen and once the log has overflowed
+ */
+static void check_replay(const char *path) {
+    tlog_t log;
+    int32_t values[BENCH_BATCH];
+
+    unlink(path);
+    open_log(&log, path, BENCH_LOG_SIZE);
+    CHECK(tlog_pending(&log) == 0);
+    for (int32_t i = 0; i < 100; i++) {
+        CHECK(tlog_append(&log, i) == ESP_OK);
+    }
+    CHECK(tlog_peek(&log, values, BENCH_BATCH) == BENCH_BATCH);
+    CHECK(values[0] == 0 && values[BENCH_BATCH - 1] == BENCH_BATCH - 1);
+    CHECK(tlog_consume(&log, BENCH_BATCH) == ESP_OK);
+
+    tlog_close(&log);
+    open_log(&log, path, BENCH_LOG_SIZE);
+    CHECK(tlog_pending(&log) == 100 - BENCH_BATCH);
+    CHECK(tlog_peek(&log, values, 1) == 1 && values[0] == BENCH_BATCH);
+
+    /* Overflow: the oldest readings are dropped */
+    for (int32_t i = 100; i < 5000; i++) {
+        CHECK(tlog_append(&log, i) == ESP_OK);
+    }
+    CHECK(log.dropped > 0);
+    tlog_close(&log);
+    open_log(&log, path, BENCH_LOG_SIZE);
+
+    int n;
+    CHECK(tlog_peek(&log, values, 1) == 1);
+    int32_t expect = values[0];
+    while ((n = tlog_peek(&log, values, BENCH_BATCH)) > 0) {
+        for (int i = 0; i < n; i++) {
+            CHECK(values[i] == expect);
+            expect++;
+        }
+        CHECK(tlog_consume(&log, n) == ESP_OK);
+    }
+    CHECK(expect == 5000);
+    CHECK(tlog_pending(&log) == 0);
+    tlog_close(&log);
+    printf("replay: ok\n");
+}
+
+/**
+ * A record torn by a power loss is skipped and the readings around it are kept
+ */
+static void check_torn(const char *path) {
+    tlog_t log;
+    int32_t values[BENCH_BATCH];
+
+    unlink(path);
+    open_log(&log, path, BENCH_LOG_SIZE);
+    for (int32_t i = 0; i < 10; i++) {
+        CHECK(tlog_append(&log, i) == ESP_OK);
+    }
+    uint32_t head = log.head;
+    tlog_close(&log);
+
+    /* Half a record with a bad check word where the next one would have gone */
+    FILE *file = fopen(path, "r+b");
+    CHECK(file != NULL);
+    const uint8_t torn[8] = {1, 0, 0, 0, 2, 0, 0, 0};
+    CHECK(fseek(file, head, SEEK_SET) == 0 && fwrite(torn, 1, sizeof(torn), file) == sizeof(torn));
+    fclose(file);
+
+    /* The torn slot is stepped over and counted as dropped once replay reaches it */
+    open_log(&log, path, BENCH_LOG_SIZE);
+    CHECK(log.head == head + 16); // one 16 byte record further
+    CHECK(tlog_append(&log, 10) == ESP_OK);
+    CHECK(tlog_append(&log, 11) == ESP_OK);
+    int n = tlog_peek(&log, values, BENCH_BATCH);
+    CHECK(n == 10 && values[0] == 0 && values[9] == 9);
+    CHECK(tlog_consume(&log, n) == ESP_OK);
+    n = tlog_peek(&log, values, BENCH_BATCH);
+    CHECK(n == 2 && values[0] == 10 && values[1] == 11 && log.dropped == 1);
+    CHECK(tlog_consume(&log, n) == ESP_OK);
+    CHECK(tlog_pending(&log) == 0);
+    tlog_close(&log);
+    printf("torn record: ok\n");
+}
+
+static void bench(const char *path) {
+    tlog_t log;
+    int32_t values[BENCH_BATCH];
+
+    unlink(path);
+    open_log(&log, path, BENCH_LOG_SIZE);
+    double start = now_s();
+    for (int32_t i = 0; i < BENCH_APPENDS; i++) {
+        tlog_append(&log, i);
+    }
+    double append_s = now_s() - start;
+    printf("append: %.0f records/s (%.2f us/record), %" PRIu32 " dropped\n", BENCH_APPENDS / append_s,
+           append_s / BENCH_APPENDS * 1e6, log.dropped);
+
+    int n;
+    int replayed = 0;
+    start = now_s();
+    while ((n = tlog_peek(&log, values, BENCH_BATCH)) > 0) {
+        tlog_consume(&log, n);
+        replayed += n;
+    }
+    double replay_s = now_s() - start;
+    printf("replay: %.0f records/s (%d records, batches of %d)\n", replayed / replay_s, replayed, BENCH_BATCH);
+    tlog_close(&log);
+}
+
+int main(int argc, char **argv) {
+    const char *path = (argc > 1) ? argv[1] : "tlog_bench.bin";
+    check_replay(path);
+    check_torn(path);
+    bench(path);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_err.h"
+#if defined(ESP_PLATFORM)
+#include "esp_partition.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Label of the data partition holding the log */
+#define TLOG_PARTITION_LABEL "tlog"
+
+/**
+ * Persistent store-and-forward queue of telemetry readings.
+ * Readings are appended to a circular log spread over the whole partition, so every sector is
+ * erased equally often. Only the last reading of each replayed batch is marked as sent, which
+ * is enough to find where replay resumes after a reboot.
+ */
+typedef struct {
+#if defined(ESP_PLATFORM)
+    const esp_partition_t *partition;
+#else
+    FILE *file;
+#endif
+    uint32_t size;
+    // Offset of the next record to write
+    uint32_t head;
+    // Sequence number of the next record to write
+    uint32_t next_seq;
+    // Sequence number of the oldest reading not sent yet
+    uint32_t tail_seq;
+    // Readings overwritten before they could be sent
+    uint32_t dropped;
+} tlog_t;
+
+/**
+ * \brief Open the log in the TLOG_PARTITION_LABEL partition and recover its state.
+ */
+esp_err_t tlog_open(tlog_t *log);
+
+#if !defined(ESP_PLATFORM)
+/**
+ * \brief Open a log backed by a file of the given size, standing in for the partition on a host.
+ */
+esp_err_t tlog_open_file(tlog_t *log, const char *path, uint32_t size);
+
+void tlog_close(tlog_t *log);
+#endif
+
+/**
+ * \brief Append a reading. When the log is full the oldest readings are overwritten.
+ */
+esp_err_t tlog_append(tlog_t *log, int32_t value);
+
+/**
+ * \brief Copy up to max of the oldest readings not sent yet, in order.
+ * \return the number of readings copied
+ */
+int tlog_peek(tlog_t *log, int32_t *values, int max);
+
+/**
+ * \brief Mark the n oldest readings as sent.
+ */
+esp_err_t tlog_consume(tlog_t *log, int n);
+
+/**
+ * \brief Number of readings waiting to be sent
+ */
+static inline uint32_t tlog_pending(const tlog_t *log) {
+    return log->next_seq - log->tail_seq;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,273 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "telemetry_log.h"
+
+#define TLOG_SECTOR_SIZE 4096
+#define TLOG_EMPTY 0xFFFFFFFF
+
+typedef struct {
+    uint32_t seq;
+    int32_t value;
+    // Cleared once this and all the readings before it have been sent
+    uint32_t unsent;
+    // Detects records torn by a power loss
+    uint32_t check;
+} tlog_record_t;
+
+#define TLOG_RECORD_SIZE ((uint32_t)sizeof(tlog_record_t))
+#define TLOG_SECTOR_RECORDS (TLOG_SECTOR_SIZE / TLOG_RECORD_SIZE)
+
+/* Storage access */
+#if defined(ESP_PLATFORM)
+
+static esp_err_t tlog_read(tlog_t *log, uint32_t offset, void *data, size_t len) {
+    return esp_partition_read(log->partition, offset, data, len);
+}
+
+static esp_err_t tlog_write(tlog_t *log, uint32_t offset, const void *data, size_t len) {
+    return esp_partition_write(log->partition, offset, data, len);
+}
+
+static esp_err_t tlog_erase(tlog_t *log, uint32_t offset) {
+    return esp_partition_erase_range(log->partition, offset, TLOG_SECTOR_SIZE);
+}
+
+#else
+
+static esp_err_t tlog_read(tlog_t *log, uint32_t offset, void *data, size_t len) {
+    if (fseek(log->file, offset, SEEK_SET) != 0 || fread(data, 1, len, log->file) != len) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t tlog_write(tlog_t *log, uint32_t offset, const void *data, size_t len) {
+    if (fseek(log->file, offset, SEEK_SET) != 0 || fwrite(data, 1, len, log->file) != len ||
+        fflush(log->file) != 0) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t tlog_erase(tlog_t *log, uint32_t offset) {
+    uint8_t erased[TLOG_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    return tlog_write(log, offset, erased, sizeof(erased));
+}
+
+#endif
+
+static uint32_t tlog_check(const tlog_record_t *record) {
+    return ~(record->seq ^ (uint32_t)record->value);
+}
+
+static bool tlog_is_erased(const tlog_record_t *record) {
+    return record->seq == TLOG_EMPTY && record->value == -1 && record->unsent == TLOG_EMPTY &&
+           record->check == TLOG_EMPTY;
+}
+
+static bool tlog_is_valid(const tlog_record_t *record) {
+    return !tlog_is_erased(record) && record->check == tlog_check(record);
+}
+
+/**
+ * Offset of a stored record from its sequence number
+ */
+static uint32_t tlog_offset(const tlog_t *log, uint32_t seq) {
+    uint32_t back = (log->next_seq - seq) * TLOG_RECORD_SIZE;
+    return (log->head + log->size - back % log->size) % log->size;
+}
+
+/**
+ * Rebuild head and tail from the records in storage
+ */
+static esp_err_t tlog_recover(tlog_t *log) {
+    tlog_record_t records[TLOG_SECTOR_RECORDS];
+    bool found = false;
+    bool sent = false;
+    uint32_t max_seq = 0;
+    uint32_t min_seq = 0;
+    uint32_t max_sent = 0;
+    uint32_t max_offset = 0;
+
+    if (log->size < 2 * TLOG_SECTOR_SIZE || log->size % TLOG_SECTOR_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (uint32_t sector = 0; sector < log->size; sector += TLOG_SECTOR_SIZE) {
+        esp_err_t err = tlog_read(log, sector, records, sizeof(records));
+        if (err != ESP_OK) {
+            return err;
+        }
+        for (uint32_t i = 0; i < TLOG_SECTOR_RECORDS; i++) {
+            const tlog_record_t *record = &records[i];
+            if (!tlog_is_valid(record)) {
+                continue;
+            }
+            if (!found || record->seq > max_seq) {
+                max_seq = record->seq;
+                max_offset = sector + i * TLOG_RECORD_SIZE;
+            }
+            if (!found || record->seq < min_seq) {
+                min_seq = record->seq;
+            }
+            if (record->unsent == 0 && (!sent || record->seq > max_sent)) {
+                max_sent = record->seq;
+                sent = true;
+            }
+            found = true;
+        }
+    }
+
+    log->dropped = 0;
+    if (!found) {
+        log->head = 0;
+        log->next_seq = 1;
+        log->tail_seq = 1;
+    }
+    else {
+        log->head = (max_offset + TLOG_RECORD_SIZE) % log->size;
+        log->next_seq = max_seq + 1;
+        log->tail_seq = (sent && max_sent >= min_seq) ? max_sent + 1 : min_seq;
+    }
+
+    /* Step over records torn by a power loss, the sector is erased when the head enters the next one */
+    while (log->head % TLOG_SECTOR_SIZE) {
+        tlog_record_t record;
+        esp_err_t err = tlog_read(log, log->head, &record, sizeof(record));
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (tlog_is_erased(&record)) {
+            break;
+        }
+        log->head = (log->head + TLOG_RECORD_SIZE) % log->size;
+        log->next_seq++;
+    }
+    return ESP_OK;
+}
+
+#if defined(ESP_PLATFORM)
+
+esp_err_t tlog_open(tlog_t *log) {
+    memset(log, 0, sizeof(*log));
+    log->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                              TLOG_PARTITION_LABEL);
+    if (log->partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    log->size = log->partition->size;
+    return tlog_recover(log);
+}
+
+#else
+
+esp_err_t tlog_open_file(tlog_t *log, const char *path, uint32_t size) {
+    memset(log, 0, sizeof(*log));
+    log->size = size;
+    log->file = fopen(path, "r+b");
+    if (log->file == NULL) {
+        /* A new partition reads as erased */
+        log->file = fopen(path, "w+b");
+        if (log->file == NULL) {
+            return ESP_FAIL;
+        }
+        for (uint32_t sector = 0; sector < size; sector += TLOG_SECTOR_SIZE) {
+            if (tlog_erase(log, sector) != ESP_OK) {
+                tlog_close(log);
+                return ESP_FAIL;
+            }
+        }
+    }
+    esp_err_t err = tlog_recover(log);
+    if (err != ESP_OK) {
+        tlog_close(log);
+    }
+    return err;
+}
+
+void tlog_close(tlog_t *log) {
+    if (log->file != NULL) {
+        fclose(log->file);
+        log->file = NULL;
+    }
+}
+
+#endif
+
+esp_err_t tlog_append(tlog_t *log, int32_t value) {
+    if (log->size == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (log->head % TLOG_SECTOR_SIZE == 0) {
+        /* Entering a sector: it holds the oldest records, which are lost if not sent yet */
+        esp_err_t err = tlog_erase(log, log->head);
+        if (err != ESP_OK) {
+            return err;
+        }
+        uint32_t capacity = log->size / TLOG_RECORD_SIZE - TLOG_SECTOR_RECORDS;
+        if (log->next_seq - log->tail_seq > capacity) {
+            uint32_t oldest = log->next_seq - capacity;
+            log->dropped += oldest - log->tail_seq;
+            log->tail_seq = oldest;
+        }
+    }
+
+    tlog_record_t record = {
+        .seq = log->next_seq,
+        .value = value,
+        .unsent = TLOG_EMPTY,
+    };
+    record.check = tlog_check(&record);
+    esp_err_t err = tlog_write(log, log->head, &record, sizeof(record));
+    /* Even a failed write may have programmed the slot, so never reuse it. Its sequence number is
+     * used up as well, keeping sequence numbers and offsets in step; replay skips the slot. */
+    log->head = (log->head + TLOG_RECORD_SIZE) % log->size;
+    log->next_seq++;
+    return err;
+}
+
+int tlog_peek(tlog_t *log, int32_t *values, int max) {
+    int n = 0;
+    uint32_t seq = log->tail_seq;
+
+    while (n < max && seq != log->next_seq) {
+        tlog_record_t record;
+        if (tlog_read(log, tlog_offset(log, seq), &record, sizeof(record)) != ESP_OK) {
+            break;
+        }
+        if (!tlog_is_valid(&record) || record.seq != seq) {
+            if (n > 0) {
+                break;
+            }
+            /* Unreadable reading at the front of the queue: skip it rather than block replay */
+            log->tail_seq = ++seq;
+            log->dropped++;
+            continue;
+        }
+        values[n++] = record.value;
+        seq++;
+    }
+    return n;
+}
+
+esp_err_t tlog_consume(tlog_t *log, int n) {
+    if (n <= 0) {
+        return ESP_OK;
+    }
+    if ((uint32_t)n > tlog_pending(log)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Marking the last one is enough: everything before it is sent too */
+    uint32_t last = log->tail_seq + n - 1;
+    const uint32_t sent = 0;
+    esp_err_t err = tlog_write(log, tlog_offset(log, last) + offsetof(tlog_record_t, unsent), &sent,
+                               sizeof(sent));
+    if (err == ESP_OK) {
+        log->tail_seq = last + 1;
+    }
+    return err;
+}
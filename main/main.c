@@ -1,11 +1,20 @@
 #include <freertos/FreeRTOS.h>
 #include "esp_wifi.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
 
 #include "quarklink.h"
 
+#include "boot_timeline.h"
+#include "cbor_writer.h"
+#include "jobs.h"
+#include "json_writer.h"
 #include "mqtt_client.h"
+#include "telemetry_log.h"
+#include "wifi_cache.h"
 
 
 /* FreeRTOS event group to signal when we are connected */
@@ -19,6 +28,14 @@ static EventGroupHandle_t s_wifi_event_group;
 
 static int s_retry_num = 0;
 
+/* Station state kept between wifi_init_sta() and wifi_wait_connected() */
+static esp_netif_t *s_sta_netif;
+static wifi_config_t s_wifi_config;
+static esp_event_handler_instance_t s_instance_any_id;
+static esp_event_handler_instance_t s_instance_got_ip;
+// Connecting with the cached AP and lease, without a scan or DHCP
+static bool s_fast_connect = false;
+
 static int count = 0;
 
 static const char *TAG = "quarklink-getting-started";
@@ -27,8 +44,25 @@ quarklink_context_t quarklink;
 /* Intervals */
 // How often to check for status, in s
 static const int STATUS_CHECK_INTERVAL = 20;
+// Random spread of status checks either way, in s
+static const int STATUS_CHECK_JITTER = 2;
+// First and longest wait before retrying a failed status check, in s
+static const int STATUS_RETRY_MIN = 5;
+static const int STATUS_RETRY_MAX = 300;
+// First and longest wait before retrying a failed firmware update, in s
+static const int FWUPDATE_RETRY_MIN = 60;
+static const int FWUPDATE_RETRY_MAX = 3600;
 // mqtt publish interval in s
 static const int MQTT_PUBLISH_INTERVAL = 5;
+// Most stored readings replayed per publish, so the backlog never holds up new readings
+#define MQTT_REPLAY_MAX 4
+// How long replayed readings may wait for their PUBACK before they are replayed again, in s
+static const int MQTT_REPLAY_TIMEOUT = 60;
+
+// Publish readings as CBOR instead of JSON
+#ifndef TELEMETRY_CBOR
+#define TELEMETRY_CBOR 0
+#endif
 
 /* MQTT config */
 #define MAX_TOPIC_LENGTH    (QUARKLINK_MAX_DEVICE_ID_LENGTH + 30)
@@ -38,12 +72,71 @@ char mqtt_topic[MAX_TOPIC_LENGTH] = "";
 /* Variable to track if the MQTT Task is running */
 static bool is_running = false;
 
-
-static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+#if (TELEMETRY_CBOR)
+/* CBOR field names
+ * Field names are sent as small integer keys. Messages also carry the dictionary under key 0, mapping
+ * each key to its field name, until the broker has acknowledged one of them in the current session.
+ * Those messages are published with QoS 1 so that the acknowledgement comes back. */
+enum {
+    FIELD_DICTIONARY = 0,
+    FIELD_COUNT,
+    FIELD_LAST = FIELD_COUNT
+};
+
+static const char *const FIELD_NAMES[FIELD_LAST + 1] = {
+    [FIELD_COUNT] = "count",
+};
+
+/* Cleared on every (re)connection to the broker, set once the PUBACK for s_dictionary_msg_id arrives */
+static volatile bool s_dictionary_sent = false;
+static volatile int s_dictionary_msg_id = -1;
+#endif
+
+/* Scheduling
+ * Status checks, firmware updates and publishes are timed jobs. The task sleeps until a job timer
+ * sets its bit, so the CPU and radio are idle between real events. */
+#define STATUS_DUE_BIT BIT0
+#define FWUPDATE_DUE_BIT BIT1
+#define PUBLISH_DUE_BIT BIT2
+#define REPLAY_ACKED_BIT BIT3
+static EventGroupHandle_t s_job_events;
+static job_t s_status_job;
+static job_t s_fwupdate_job;
+static job_t s_publish_job;
+
+/* Readings that could not be published, replayed in order once the broker is reachable again.
+ * Replays are published with QoS 1 and only removed from the log once the broker has
+ * acknowledged them; the MQTT task passes the acknowledged message ids through s_replay_acks. */
+static tlog_t s_tlog;
+static bool s_tlog_ready = false;
+static QueueHandle_t s_replay_acks;
+static int s_replay_ids[MQTT_REPLAY_MAX];
+static bool s_replay_acked[MQTT_REPLAY_MAX];
+static int s_replay_sent = 0;
+static TickType_t s_replay_since;
+
+
+static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id,
+                          void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        if (s_fast_connect) {
+            if (++s_retry_num < WIFI_CACHE_JOIN_ATTEMPTS) {
+                ESP_LOGI(TAG, "Retry to connect to the cached AP (%d/%d)", s_retry_num, WIFI_CACHE_JOIN_ATTEMPTS);
+                esp_wifi_connect();
+                return;
+            }
+            /* The AP moved or changed channel: forget it and fall back to a full scan and DHCP */
+            ESP_LOGI(TAG, "Cached AP unavailable, scanning");
+            s_fast_connect = false;
+            s_retry_num = 0;
+            wifi_cache_forget(s_sta_netif, &s_wifi_config);
+            wifi_cache_set_config(&s_wifi_config);
+            esp_wifi_connect();
+            return;
+        }
         ESP_LOGI(TAG, "Connection to the AP failed");
         if (s_retry_num < 10) {
             esp_wifi_connect();
@@ -55,8 +148,10 @@ static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_
         }
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
-        // ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        // ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        ESP_LOGD(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        boot_mark("wifi connected");
+        wifi_cache_store(s_sta_netif, &s_wifi_config);
         s_retry_num = 0;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
@@ -80,6 +175,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGD(TAG, "MQTT_EVENT_CONNECTED");
+#if (TELEMETRY_CBOR)
+        s_dictionary_sent = false;
+        s_dictionary_msg_id = -1;
+#endif
         msg_id = esp_mqtt_client_subscribe(client, "topic/#", 0);
         ESP_LOGD(TAG, "sent subscribe successful, msg_id=%d", msg_id);
         break;
@@ -94,6 +193,15 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         break;
     case MQTT_EVENT_PUBLISHED:
         ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+#if (TELEMETRY_CBOR)
+        if (event->msg_id == s_dictionary_msg_id) {
+            s_dictionary_sent = true;
+        }
+#endif
+        /* Only the QoS 1 messages are acknowledged */
+        if (s_replay_acks != NULL && xQueueSend(s_replay_acks, &event->msg_id, 0) == pdTRUE) {
+            xEventGroupSetBits(s_job_events, REPLAY_ACKED_BIT);
+        }
         break;
     case MQTT_EVENT_DATA:
         ESP_LOGD(TAG, "MQTT_EVENT_DATA");
@@ -128,6 +236,86 @@ bool isAzure(quarklink_context_t *quarklink) {
     return ((strstr(quarklink->iotHubEndpoint, "azure") != 0)  && (strlen(quarklink->scopeID) == 0));
 }
 
+#if (TELEMETRY_CBOR)
+/**
+ * \brief Write the CBOR message for a reading, with the field dictionary first if requested.
+ */
+static void mqtt_message_cbor(cw_t *w, int32_t value, bool dictionary) {
+    cw_map(w, dictionary ? 2 : 1);
+    if (dictionary) {
+        cw_uint(w, FIELD_DICTIONARY);
+        cw_map(w, FIELD_LAST);
+        for (int key = FIELD_DICTIONARY + 1; key <= FIELD_LAST; key++) {
+            cw_uint(w, key);
+            cw_text(w, FIELD_NAMES[key]);
+        }
+    }
+    cw_uint(w, FIELD_COUNT);
+    cw_int(w, value);
+}
+#endif
+
+/**
+ * \brief Write the JSON message for a reading. With a NULL writer buffer this only measures it.
+ */
+static void mqtt_message_json(jw_t *w, int32_t value) {
+    jw_object_begin(w);
+    jw_key(w, "count");
+    jw_int(w, value);
+    jw_object_end(w);
+}
+
+/**
+ * \brief Build and publish the message for a reading.
+ * A message carrying the CBOR field dictionary is published with at least QoS 1.
+ *
+ * \return The message id, negative on failure
+ */
+static int mqtt_publish_reading(esp_mqtt_client_handle_t client, int32_t value, int qos) {
+    char message[MAX_MESSAGE_LENGTH];
+    int64_t start = esp_timer_get_time();
+#if (TELEMETRY_CBOR)
+    cw_t w;
+    bool dictionary = !s_dictionary_sent;
+    cw_init(&w, (uint8_t *)message, sizeof(message));
+    mqtt_message_cbor(&w, value, dictionary);
+    int64_t encode_us = esp_timer_get_time() - start;
+    if (!cw_ok(&w)) {
+        return -1;
+    }
+    int len = (int)cw_length(&w);
+
+    /* Report the size and encode time against the same message in JSON */
+    jw_t json;
+    start = esp_timer_get_time();
+    jw_init(&json, NULL, 0);
+    mqtt_message_json(&json, value);
+    int64_t json_us = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Message: %d bytes CBOR%s in %" PRId64 " us, %d bytes as JSON in %" PRId64 " us", len,
+             dictionary ? " with dictionary" : "", encode_us, (int)jw_length(&json), json_us);
+
+    if (dictionary && qos < 1) {
+        qos = 1;
+    }
+    int msg_id = esp_mqtt_client_publish(client, mqtt_topic, message, len, qos, 0);
+    if (dictionary && msg_id > 0) {
+        s_dictionary_msg_id = msg_id;
+    }
+    return msg_id;
+#else
+    jw_t w;
+    jw_init(&w, message, sizeof(message));
+    mqtt_message_json(&w, value);
+    int64_t encode_us = esp_timer_get_time() - start;
+    if (!jw_ok(&w)) {
+        return -1;
+    }
+    int len = (int)jw_length(&w);
+    ESP_LOGI(TAG, "Message: %d bytes JSON in %" PRId64 " us", len, encode_us);
+    return esp_mqtt_client_publish(client, mqtt_topic, message, len, qos, 0);
+#endif
+}
+
 bool isAzureCentral(quarklink_context_t *quarklink) {
     return ((strstr(quarklink->iotHubEndpoint, "azure") != 0)  && (strlen(quarklink->scopeID) != 0));
 }
@@ -188,54 +376,60 @@ int mqtt_init(quarklink_context_t *quarklink, esp_mqtt_client_handle_t* client)
     }
 }
 
+/**
+ * Start connecting to the AP without waiting, so the rest of the boot runs during association.
+ * The cached AP and DHCP lease of the last connection are used when there is one.
+ */
 void wifi_init_sta(void) {
     s_wifi_event_group = xEventGroupCreate();
 
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_sta_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &event_handler,
-                                                        NULL,
-                                                        &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &event_handler,
-                                                        NULL,
-                                                        &instance_got_ip));
-
-    wifi_config_t wifi_config;
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
+                                                        &event_handler, NULL, &s_instance_any_id));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
+                                                        &event_handler, NULL, &s_instance_got_ip));
+
     /* Load existing configuration and prompt user */
-    esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_get_config(WIFI_IF_STA, &s_wifi_config);
 
-    ESP_ERROR_CHECK(esp_wifi_start() );
-    ESP_LOGD(TAG, "wifi_init_sta finished.");
+    /* The cached AP only applies to this boot: it is kept out of the stored Wi-Fi configuration */
+    s_fast_connect = wifi_cache_apply(s_sta_netif, &s_wifi_config);
+    if (s_fast_connect) {
+        ESP_ERROR_CHECK(wifi_cache_set_config(&s_wifi_config));
+    }
 
-    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-     * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-            pdFALSE,
-            pdFALSE,
-            portMAX_DELAY);
+    ESP_ERROR_CHECK(esp_wifi_start());
+    boot_mark("wifi started");
+    ESP_LOGD(TAG, "wifi_init_sta finished.");
+}
 
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
+/**
+ * Wait for the connection started by wifi_init_sta(), restarting if it cannot be established
+ */
+void wifi_wait_connected(void) {
+    /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed
+     * for the maximum number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see
+     * above) */
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+                                           pdFALSE, pdFALSE, portMAX_DELAY);
+
+    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which
+     * event actually happened. */
     if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "connected to ap SSID: %s", wifi_config.sta.ssid);
+        ESP_LOGI(TAG, "connected to ap SSID: %s%s", s_wifi_config.sta.ssid,
+                 s_fast_connect ? " (cached)" : "");
     }
     else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID: %s", wifi_config.sta.ssid);
+        ESP_LOGI(TAG, "Failed to connect to SSID: %s", s_wifi_config.sta.ssid);
         ESP_LOGI(TAG, "Reached maximum retry limit for connection to the AP");
-        ESP_LOGI(TAG, "Restarting");    
+        ESP_LOGI(TAG, "Restarting");
         vTaskDelay(3000 / portTICK_PERIOD_MS);
         esp_restart();
     }
@@ -244,146 +438,317 @@ void wifi_init_sta(void) {
     }
 
     /* The event will not be processed after unregister */
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
+    ESP_ERROR_CHECK(
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, s_instance_got_ip));
+    ESP_ERROR_CHECK(
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, s_instance_any_id));
     vEventGroupDelete(s_wifi_event_group);
 }
 
-void getting_started_task(void *pvParameter) {
+/**
+ * \brief Check the device status with QuarkLink, enrol when needed and start the MQTT client once
+ * enrolled.
+ *
+ * \return false if any step failed
+ */
+static bool status_check(quarklink_return_t *ql_status, esp_mqtt_client_handle_t *mqtt_client) {
     quarklink_return_t ql_ret;
-    quarklink_return_t ql_status = QUARKLINK_ERROR;
 
-    esp_mqtt_client_handle_t mqtt_client = NULL;
-    char message[MAX_MESSAGE_LENGTH] = "";
-    uint32_t round = 0;
+    /* get status */
+    ESP_LOGI(TAG, "Get status");
+    *ql_status = quarklink_status(&quarklink);
+    switch (*ql_status) {
+        case QUARKLINK_STATUS_ENROLLED:
+            ESP_LOGI(TAG, "Enrolled");
+            if (strcmp(quarklink.iotHubEndpoint, "") == 0) {
+                ESP_LOGI(TAG, "No enrolment info saved. Re-enrolling");
+                *ql_status = QUARKLINK_STATUS_NOT_ENROLLED;
+            }
+            break;
+        case QUARKLINK_STATUS_FWUPDATE_REQUIRED:
+            ESP_LOGI(TAG, "Firmware Update required");
+            break;
+        case QUARKLINK_STATUS_NOT_ENROLLED:
+            ESP_LOGI(TAG, "Not enrolled");
+            break;
+        case QUARKLINK_STATUS_CERTIFICATE_EXPIRED:
+            ESP_LOGI(TAG, "Certificate expired");
+            break;
+        case QUARKLINK_STATUS_REVOKED:
+            ESP_LOGI(TAG, "Device revoked");
+            break;
+        default:
+            ESP_LOGE(TAG, "Error during status request");
+            return false;
+    }
 
-    while (1) {
+    if (*ql_status == QUARKLINK_STATUS_NOT_ENROLLED ||
+        *ql_status == QUARKLINK_STATUS_CERTIFICATE_EXPIRED ||
+        *ql_status == QUARKLINK_STATUS_REVOKED) {
+        /* Reset mqtt */
+        strcpy(mqtt_topic, "");
+        esp_mqtt_client_stop(*mqtt_client);
+        is_running = false;
+        /* enroll */
+        ESP_LOGI(TAG, "Enrol to %s", quarklink.endpoint);
+        ql_ret = quarklink_enrol(&quarklink);
+        switch (ql_ret) {
+            case QUARKLINK_SUCCESS:
+                ESP_LOGI(TAG, "Successfully enrolled");
+                ql_ret = quarklink_persistEnrolmentContext(&quarklink);
+                if (ql_ret != QUARKLINK_SUCCESS) {
+                    ESP_LOGW(TAG, "Failed to store the enrolment context");
+                }
+                /* Update Status to avoid delaying MQTT Client init */
+                *ql_status = QUARKLINK_STATUS_ENROLLED;
+                break;
+            case QUARKLINK_DEVICE_DOES_NOT_EXIST:
+                ESP_LOGW(TAG, "Device does not exist");
+                break;
+            case QUARKLINK_DEVICE_REVOKED:
+                ESP_LOGW(TAG, "Device revoked");
+                break;
+            case QUARKLINK_CACERTS_ERROR:
+            default:
+                ESP_LOGE(TAG, "Error during enrol");
+                return false;
+        }
+    }
 
-        // If it's time for a status check
-        if (round % STATUS_CHECK_INTERVAL == 0) {
-            /* get status */
-            ESP_LOGI(TAG, "Get status");
-            ql_status = quarklink_status(&quarklink);
-            switch (ql_status) {
-                case QUARKLINK_STATUS_ENROLLED:
-                    ESP_LOGI(TAG, "Enrolled");
-                    if (strcmp(quarklink.iotHubEndpoint, "") == 0) {
-                        ESP_LOGI(TAG, "No enrolment info saved. Re-enrolling");
-                        ql_status = QUARKLINK_STATUS_NOT_ENROLLED;
-                    }
-                    break;
-                case QUARKLINK_STATUS_FWUPDATE_REQUIRED:
-                    ESP_LOGI(TAG, "Firmware Update required");
-                    break;
-                case QUARKLINK_STATUS_NOT_ENROLLED:
-                    ESP_LOGI(TAG, "Not enrolled");
-                    break;
-                case QUARKLINK_STATUS_CERTIFICATE_EXPIRED:
-                    ESP_LOGI(TAG, "Certificate expired");
-                    break;
-                case QUARKLINK_STATUS_REVOKED:
-                    ESP_LOGI(TAG, "Device revoked");
+    if (*ql_status == QUARKLINK_STATUS_ENROLLED) {
+        /* Start the MQTT task */
+        if (mqtt_init(&quarklink, mqtt_client) != 0) {
+            ESP_LOGE(TAG, "Failed to initialise the MQTT Client");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief Download and install a firmware update.
+ *
+ * \return false if the update failed
+ */
+static bool firmware_update(void) {
+    /* firmware update */
+    ESP_LOGI(TAG, "Get firmware update");
+    quarklink_return_t ql_ret = quarklink_firmwareUpdate(&quarklink, NULL);
+    switch (ql_ret) {
+        case QUARKLINK_FWUPDATE_UPDATED:
+            ESP_LOGI(TAG, "Firmware updated. Rebooting...");
+            esp_restart();
+            break;
+        case QUARKLINK_FWUPDATE_NO_UPDATE:
+            ESP_LOGI(TAG, "No firmware update");
+            break;
+        case QUARKLINK_FWUPDATE_WRONG_SIGNATURE:
+            ESP_LOGI(TAG, "Wrong firmware signature");
+            return false;
+        case QUARKLINK_FWUPDATE_MISSING_SIGNATURE:
+            ESP_LOGI(TAG, "Missing required firmware signature");
+            return false;
+        case QUARKLINK_FWUPDATE_ERROR:
+        default:
+            ESP_LOGE(TAG, "Error while updating firmware");
+            return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Publish a reading, then part of the stored backlog.
+ *
+ * \return false if the reading could not be published
+ */
+static bool publish_reading(esp_mqtt_client_handle_t mqtt_client) {
+    bool ok;
+
+    if (strcmp(mqtt_topic, "") == 0) {
+        sprintf(mqtt_topic, "topic/%s", quarklink.deviceID);
+    }
+    int msg_id = mqtt_publish_reading(mqtt_client, count, 0);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish to %s (ret %d)", mqtt_topic, msg_id);
+        if (s_tlog_ready && tlog_append(&s_tlog, count) == ESP_OK) {
+            ESP_LOGI(TAG, "Stored data=%d, %" PRIu32 " waiting", count, tlog_pending(&s_tlog));
+        }
+        ok = false;
+    }
+    else {
+        ESP_LOGI(TAG, "Published data=%d to %s", count, mqtt_topic);
+        boot_complete("first publish");
+
+        if (s_replay_sent > 0 && xTaskGetTickCount() - s_replay_since >= pdMS_TO_TICKS(MQTT_REPLAY_TIMEOUT * 1000)) {
+            /* Still unacknowledged: replay them again, the broker may see duplicates */
+            ESP_LOGW(TAG, "%d replayed reading(s) not acknowledged", s_replay_sent);
+            s_replay_sent = 0;
+        }
+
+        /* Replay part of the backlog, one batch in flight at a time */
+        if (s_replay_sent == 0) {
+            int32_t stored[MQTT_REPLAY_MAX];
+            int n = s_tlog_ready ? tlog_peek(&s_tlog, stored, MQTT_REPLAY_MAX) : 0;
+            while (s_replay_sent < n) {
+                msg_id = mqtt_publish_reading(mqtt_client, stored[s_replay_sent], 1);
+                if (msg_id < 0) {
                     break;
-                default:
-                    ESP_LOGE(TAG, "Error during status request");
-                    continue;
+                }
+                s_replay_ids[s_replay_sent] = msg_id;
+                s_replay_acked[s_replay_sent] = false;
+                s_replay_sent++;
+            }
+            if (s_replay_sent > 0) {
+                s_replay_since = xTaskGetTickCount();
+                ESP_LOGI(TAG, "Replaying %d stored reading(s)", s_replay_sent);
             }
+        }
 
-            if (ql_status == QUARKLINK_STATUS_NOT_ENROLLED ||
-                ql_status == QUARKLINK_STATUS_CERTIFICATE_EXPIRED ||
-                ql_status == QUARKLINK_STATUS_REVOKED) {
-                /* Reset mqtt */
-                strcpy(mqtt_topic, "");
-                esp_mqtt_client_stop(mqtt_client);
-                is_running = false;
-                /* enroll */
-                ESP_LOGI(TAG, "Enrol to %s", quarklink.endpoint);
-                ql_ret = quarklink_enrol(&quarklink);
-                switch (ql_ret) {
-                    case QUARKLINK_SUCCESS:
-                        ESP_LOGI(TAG, "Successfully enrolled");
-                        ql_ret = quarklink_persistEnrolmentContext(&quarklink);
-                        if (ql_ret != QUARKLINK_SUCCESS) {
-                            ESP_LOGW(TAG, "Failed to store the enrolment context");
-                        }
-                        /* Update Status to avoid delaying MQTT Client init */
-                        ql_status = QUARKLINK_STATUS_ENROLLED;
-                        break;
-                    case QUARKLINK_DEVICE_DOES_NOT_EXIST:
-                        ESP_LOGW(TAG, "Device does not exist");
-                        break;
-                    case QUARKLINK_DEVICE_REVOKED:
-                        ESP_LOGW(TAG, "Device revoked");
-                        break;
-                    case QUARKLINK_CACERTS_ERROR:
-                    default:
-                        ESP_LOGE(TAG, "Error during enrol");
-                        continue;
-                }
+        /* The first publish is out: let DHCP take over a reused lease */
+        wifi_cache_renew(s_sta_netif, &s_wifi_config);
+        ok = true;
+    }
+    count++;
+    return ok;
+}
+
+/**
+ * \brief Remove the replayed readings the broker has acknowledged from the log.
+ * The log is consumed from the oldest reading, so only the acknowledged prefix is removed.
+ */
+static void replay_acked(void) {
+    int msg_id;
+    while (xQueueReceive(s_replay_acks, &msg_id, 0) == pdTRUE) {
+        for (int i = 0; i < s_replay_sent; i++) {
+            if (s_replay_ids[i] == msg_id) {
+                s_replay_acked[i] = true;
             }
+        }
+    }
 
-            if (ql_status == QUARKLINK_STATUS_FWUPDATE_REQUIRED) {
-                /* firmware update */
-                ESP_LOGI(TAG, "Get firmware update");
-                ql_ret = quarklink_firmwareUpdate(&quarklink, NULL);
-                switch (ql_ret) {
-                    case QUARKLINK_FWUPDATE_UPDATED:
-                        ESP_LOGI(TAG, "Firmware updated. Rebooting...");
-                        esp_restart();
-                        break;
-                    case QUARKLINK_FWUPDATE_NO_UPDATE:
-                        ESP_LOGI(TAG, "No firmware update");
-                        break;
-                    case QUARKLINK_FWUPDATE_WRONG_SIGNATURE:
-                        ESP_LOGI(TAG, "Wrong firmware signature");
-                        break;
-                    case QUARKLINK_FWUPDATE_MISSING_SIGNATURE:
-                        ESP_LOGI(TAG, "Missing required firmware signature");
-                        break;
-                    case QUARKLINK_FWUPDATE_ERROR:
-                    default:
-                        ESP_LOGE(TAG, "Error while updating firmware");
-                        continue;
-                }
+    int done = 0;
+    while (done < s_replay_sent && s_replay_acked[done]) {
+        done++;
+    }
+    if (done == 0) {
+        return;
+    }
+    tlog_consume(&s_tlog, done);
+    s_replay_sent -= done;
+    memmove(s_replay_ids, &s_replay_ids[done], s_replay_sent * sizeof(s_replay_ids[0]));
+    memmove(s_replay_acked, &s_replay_acked[done], s_replay_sent * sizeof(s_replay_acked[0]));
+    ESP_LOGI(TAG, "Replayed %d stored reading(s), %" PRIu32 " waiting", done, tlog_pending(&s_tlog));
+}
+
+void getting_started_task(void *pvParameter) {
+    quarklink_return_t ql_status = QUARKLINK_ERROR;
+    esp_mqtt_client_handle_t mqtt_client = NULL;
+
+    job_start(&s_status_job, 0);
+
+    while (1) {
+        EventBits_t due = xEventGroupWaitBits(s_job_events,
+                                              STATUS_DUE_BIT | FWUPDATE_DUE_BIT | PUBLISH_DUE_BIT | REPLAY_ACKED_BIT,
+                                              pdTRUE, pdFALSE, portMAX_DELAY);
+
+        if (due & REPLAY_ACKED_BIT) {
+            replay_acked();
+        }
+
+        if (due & STATUS_DUE_BIT) {
+            bool ok = status_check(&ql_status, &mqtt_client);
+            job_done(&s_status_job, ok);
+            if (ok) {
+                boot_mark("status checked");
             }
 
-            if (ql_status == QUARKLINK_STATUS_ENROLLED) {
-                /* Start the MQTT task */
-                if (mqtt_init(&quarklink, &mqtt_client) != 0) {
-                    ESP_LOGE(TAG, "Failed to initialise the MQTT Client");
-                    continue;
-                }
+            if (ql_status == QUARKLINK_STATUS_FWUPDATE_REQUIRED && !job_pending(&s_fwupdate_job)) {
+                job_start(&s_fwupdate_job, 0);
+            }
+            /* Readings are only published while enrolled */
+            if (ql_status == QUARKLINK_STATUS_ENROLLED && is_running && !job_pending(&s_publish_job)) {
+                job_start(&s_publish_job, 0);
             }
         }
 
-        // If it's time to publish
-        if ((round % MQTT_PUBLISH_INTERVAL == 0) && (ql_status == QUARKLINK_STATUS_ENROLLED)) {
-            if (strcmp(mqtt_topic, "") == 0) {
-                sprintf(mqtt_topic, "topic/%s", quarklink.deviceID);
-            }
-            sprintf(message, "{\"count\":%d}", count);
-            int msg_id = esp_mqtt_client_publish(mqtt_client, mqtt_topic, message, 0, 0, 0);
-            if (msg_id < 0) {
-                ESP_LOGE(TAG, "Failed to publish to %s (ret %d)", mqtt_topic, msg_id);
+        if (due & FWUPDATE_DUE_BIT) {
+            job_done(&s_fwupdate_job, firmware_update());
+        }
+
+        if (due & PUBLISH_DUE_BIT) {
+            if (ql_status != QUARKLINK_STATUS_ENROLLED || !is_running) {
+                job_stop(&s_publish_job);
             }
             else {
-                ESP_LOGI(TAG, "Published data=%d to %s", count, mqtt_topic);
+                job_done(&s_publish_job, publish_reading(mqtt_client));
             }
-            count++;
         }
+    }
+}
+
+/**
+ * \brief Create the timed jobs, none of them started
+ */
+static void jobs_init(void) {
+    const job_config_t status = {
+        .period_ms = STATUS_CHECK_INTERVAL * 1000,
+        .jitter_ms = STATUS_CHECK_JITTER * 1000,
+        .backoff_min_ms = STATUS_RETRY_MIN * 1000,
+        .backoff_max_ms = STATUS_RETRY_MAX * 1000,
+    };
+    const job_config_t fwupdate = {
+        .backoff_min_ms = FWUPDATE_RETRY_MIN * 1000,
+        .backoff_max_ms = FWUPDATE_RETRY_MAX * 1000,
+    };
+    // Readings are taken at a steady rate, failed ones are stored and replayed
+    const job_config_t publish = {
+        .period_ms = MQTT_PUBLISH_INTERVAL * 1000,
+    };
+
+    s_job_events = xEventGroupCreate();
+    s_replay_acks = xQueueCreate(2 * MQTT_REPLAY_MAX, sizeof(int));
+    if (s_job_events == NULL || s_replay_acks == NULL ||
+        job_init(&s_status_job, "status", s_job_events, STATUS_DUE_BIT, &status) != ESP_OK ||
+        job_init(&s_fwupdate_job, "fwupdate", s_job_events, FWUPDATE_DUE_BIT, &fwupdate) != ESP_OK ||
+        job_init(&s_publish_job, "publish", s_job_events, PUBLISH_DUE_BIT, &publish) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the job timers");
+        esp_restart();
+    }
+}
 
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        round++;
+/**
+ * \brief Let the idle task lower the CPU clock and enter light sleep while every task waits for a job
+ */
+static void power_init(void) {
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Power management not enabled (%s)", esp_err_to_name(err));
     }
+#endif
 }
 
 void app_main(void) {
+    boot_mark("app_main");
     ESP_LOGI(TAG, "quarklink-getting-started-m5edukit-ecc608");
+    power_init();
 
     /* quarklink init */
     ESP_LOGI(TAG, "Loading stored QuarkLink context");
     // Need to initialise a local quarklink_context_t in order to retrieve the stored one. Doesn't matter what values it is given.
     quarklink_return_t ql_ret = quarklink_init(&quarklink, "", 1, "");
+    boot_mark("quarklink init");
+
+    /* Associate while the context is loaded and the device certificate is rebuilt */
+    wifi_init_sta();
+
     ql_ret = quarklink_loadStoredContext(&quarklink);
     if (ql_ret == QUARKLINK_CONTEXT_NO_ENROLMENT_INFO_STORED) {
         // Should get here the first time after provisioning as the device hasn't enrolled yet
@@ -405,8 +770,20 @@ void app_main(void) {
 
     ESP_LOGI(TAG, "Successfully loaded QuarkLink details for: %s", quarklink.endpoint);
     ESP_LOGI(TAG, "Device ID: %s", quarklink.deviceID);
+    boot_mark("context loaded");
 
-    wifi_init_sta();
+    esp_err_t err = tlog_open(&s_tlog);
+    if (err == ESP_OK) {
+        s_tlog_ready = true;
+        ESP_LOGI(TAG, "%" PRIu32 " stored reading(s) waiting to be published", tlog_pending(&s_tlog));
+    }
+    else {
+        ESP_LOGW(TAG, "Telemetry log unavailable (%s)", esp_err_to_name(err));
+    }
+    boot_mark("telemetry log opened");
+
+    wifi_wait_connected();
 
+    jobs_init();
     xTaskCreate(&getting_started_task, "getting_started_task", 1024 * 8, NULL, 5, NULL);
 }
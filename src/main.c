@@ -1,14 +1,27 @@
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
 #include "esp_wifi.h"
 #include "freertos/event_groups.h"
+#include "freertos/task.h"
 #include <freertos/FreeRTOS.h>
+#include <sys/param.h>
+#include "mbedtls/base64.h"
 
 #include "led_strip.h"
 #include "quarklink.h"
 
 #include "quarklink_extras.h"
+#include "boot_timeline.h"
+#include "cbor_writer.h"
+#include "jobs.h"
+#include "json_writer.h"
 #include "rsa_sign_alt.h"
+#include "telemetry_log.h"
+#include "tls_session.h"
+#include "wifi_cache.h"
 
 #define LED_STRIP_BLINK_GPIO 8  // GPIO assignment
 #define LED_STRIP_LED_NUMBERS 1 // LED numbers in the strip
@@ -18,6 +31,11 @@
 #define LED_COLOUR 0
 #endif
 
+// Send readings as CBOR instead of JSON, e.g. -DTELEMETRY_CBOR=1 in build_flags
+#ifndef TELEMETRY_CBOR
+#define TELEMETRY_CBOR 0
+#endif
+
 #define RED 1
 #define GREEN 2
 #define BLUE 3
@@ -33,6 +51,14 @@ static EventGroupHandle_t s_wifi_event_group;
 
 static int s_retry_num = 0;
 
+/* Station state kept between wifi_init_sta() and wifi_wait_connected() */
+static esp_netif_t *s_sta_netif;
+static wifi_config_t s_wifi_config;
+static esp_event_handler_instance_t s_instance_any_id;
+static esp_event_handler_instance_t s_instance_got_ip;
+// Connecting with the cached AP and lease, without a scan or DHCP
+static bool s_fast_connect = false;
+
 static int count = 0;
 
 static const char *TAG = "quarklink-database-direct";
@@ -41,8 +67,86 @@ quarklink_context_t quarklink;
 /* Intervals */
 // How often to check for status, in s
 static const int STATUS_CHECK_INTERVAL = 20;
+// Random spread of status checks either way, in s
+static const int STATUS_CHECK_JITTER = 2;
+// First and longest wait before retrying a failed status check, in s
+static const int STATUS_RETRY_MIN = 5;
+static const int STATUS_RETRY_MAX = 300;
+// First and longest wait before retrying a failed firmware update, in s
+static const int FWUPDATE_RETRY_MIN = 60;
+static const int FWUPDATE_RETRY_MAX = 3600;
 // publish interval in s
 static const int PUBLISH_INTERVAL = 5;
+// Refresh the token this long before it expires, in s
+static const int TOKEN_REFRESH_MARGIN = 60;
+// Random spread of token refreshes either way, in s
+static const int TOKEN_REFRESH_JITTER = 10;
+// First and longest wait before retrying a failed token refresh, in s
+static const int TOKEN_REFRESH_RETRY = 30;
+static const int TOKEN_REFRESH_RETRY_MAX = 600;
+// Longest single wait of the refresh timer, in s; it is re-armed until the refresh is due
+static const int TOKEN_REFRESH_MAX_WAIT = 24 * 3600;
+// Refresh interval for tokens that carry no iat/exp claims, in s
+static const int TOKEN_REFRESH_DEFAULT = 3600;
+// First and longest wait before posting again after a failed post, in s
+static const int POST_RETRY_MIN = 5;
+static const int POST_RETRY_MAX = 300;
+// Number of queued readings that triggers a publish
+static const int BATCH_FLUSH_SIZE = 6;
+// Longest a reading waits before being published, in s
+static const int BATCH_MAX_AGE = 30;
+
+/* Telemetry batching
+ * Readings are queued in a ring buffer and published together in a single insertMany request, so
+ * the request headers (including the token) and the radio time are shared by the whole batch. When
+ * the hub cannot be reached the ring fills up and no new readings are taken until it drains. */
+#define BATCH_CAPACITY 24
+
+typedef struct {
+    int count;
+    // Uptime in s at which the reading was taken
+    int64_t taken_at;
+} reading_t;
+
+static reading_t s_readings[BATCH_CAPACITY];
+// Index of the oldest reading
+static int s_readings_head = 0;
+static int s_readings_len = 0;
+// Cleared until a batch is published: the first reading after boot is sent on its own
+static bool s_readings_sent = false;
+// Uptime in s before which no post is attempted, and the current wait after failed posts
+static int64_t s_post_retry_at = 0;
+static int s_post_backoff = 0;
+
+/* Store and forward
+ * Readings that could not be published are moved to a log in flash and replayed in order once the
+ * hub accepts posts again. At most one replay batch is sent per live publish so the backlog never
+ * holds up new readings. */
+static tlog_t s_tlog;
+static bool s_tlog_ready = false;
+
+/* Token refresh
+ * The refresh is a job of main_task like the status check, so the enrolment has the context and the
+ * secure element to itself. It enrols on a copy of the context, so the current credentials are kept
+ * if it fails. */
+static job_t s_refresh_job;
+static quarklink_context_t s_refresh_context;
+// Uptime in s at which the token should be replaced, 0 if it is only replaced once rejected
+static int64_t s_token_refresh_at = 0;
+// Cleared when the hub rejected the token, until a new one is swapped in
+static bool s_token_valid = true;
+
+/* Scheduling
+ * Status checks, firmware updates, publishes and token refreshes are timed jobs. main_task sleeps
+ * until a job timer sets its bit, so the CPU and radio are idle between real events. */
+#define STATUS_DUE_BIT BIT0
+#define FWUPDATE_DUE_BIT BIT1
+#define PUBLISH_DUE_BIT BIT2
+#define REFRESH_DUE_BIT BIT3
+static EventGroupHandle_t s_main_events;
+static job_t s_status_job;
+static job_t s_fwupdate_job;
+static job_t s_publish_job;
 
 #if (LED_COLOUR)
 // LED Strip object handle
@@ -57,6 +161,21 @@ static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_
         esp_wifi_connect();
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        if (s_fast_connect) {
+            if (++s_retry_num < WIFI_CACHE_JOIN_ATTEMPTS) {
+                ESP_LOGI(TAG, "Retry to connect to the cached AP (%d/%d)", s_retry_num, WIFI_CACHE_JOIN_ATTEMPTS);
+                esp_wifi_connect();
+                return;
+            }
+            /* The AP moved or changed channel: forget it and fall back to a full scan and DHCP */
+            ESP_LOGI(TAG, "Cached AP unavailable, scanning");
+            s_fast_connect = false;
+            s_retry_num = 0;
+            wifi_cache_forget(s_sta_netif, &s_wifi_config);
+            wifi_cache_set_config(&s_wifi_config);
+            esp_wifi_connect();
+            return;
+        }
         ESP_LOGI(TAG, "Connection to the AP failed");
         if (s_retry_num < 10) {
             esp_wifi_connect();
@@ -70,87 +189,198 @@ static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         ESP_LOGD(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        boot_mark("wifi connected");
+        wifi_cache_store(s_sta_netif, &s_wifi_config);
         s_retry_num = 0;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-    } 
+    }
+}
+
+bool isDatabaseDirect(quarklink_context_t *quarklink) {
+    return (strcmp(quarklink->token, "") != 0);
+}
+
+static int64_t uptime_s(void) {
+    return esp_timer_get_time() / 1000000;
 }
 
 /**
- * Local function to handle http events. Mostly needed to copy the response body
+ * Read a numeric claim out of a decoded JWT payload. Returns -1 if not present
  */
-static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
-    static int output_len = 0; // Stores number of bytes read
-    switch (evt->event_id) {
-        case HTTP_EVENT_ERROR:
-            ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
-            break;
-        case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
-            break;
-        case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
-            break;
-        case HTTP_EVENT_ON_HEADER:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
-            break;
-        case HTTP_EVENT_ON_DATA:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
-            if (!esp_http_client_is_chunked_response(evt->client)) {
-                if (evt->user_data) {
-                    memcpy(evt->user_data + output_len, evt->data, evt->data_len);
-                }
-                output_len += evt->data_len;
-            }
-            else {
-                ESP_LOGD(TAG, "it's chunked response");
-            }
-            break;
-        case HTTP_EVENT_ON_FINISH:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
-            // Insert end of string
-            ((char *)evt->user_data)[output_len] = '\0';
-            output_len = 0;
-            break;
-        case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
-            output_len = 0;
-            break;
-        case HTTP_EVENT_REDIRECT:
-            ESP_LOGD(TAG, "HTTP_EVENT_REDIRECT");
-            break;
+static int64_t token_claim(const char *payload, const char *claim) {
+    char key[16];
+    snprintf(key, sizeof(key), "\"%s\":", claim);
+    const char *pos = strstr(payload, key);
+    if (pos == NULL) {
+        return -1;
     }
-    return ESP_OK;
+    return strtoll(pos + strlen(key), NULL, 10);
 }
 
-bool isDatabaseDirect(quarklink_context_t *quarklink) {
-    return (strcmp(quarklink->token, "") != 0);
+/**
+ * Work out how long the token is valid for from its iat and exp claims, in s.
+ * The device has no wall clock, so the lifetime is measured against uptime instead.
+ * Returns -1 if the token is not a JWT or does not carry both claims.
+ */
+static int64_t token_lifetime(const char *token) {
+    static char encoded[QUARKLINK_MAX_TOKEN_LENGTH + 4];
+    static char payload[QUARKLINK_MAX_TOKEN_LENGTH];
+    const char *start = strchr(token, '.');
+    if (start == NULL) {
+        return -1;
+    }
+    start++;
+    const char *end = strchr(start, '.');
+    if (end == NULL) {
+        return -1;
+    }
+
+    /* base64url -> base64 with padding */
+    size_t len = 0;
+    for (const char *c = start; c < end && len < sizeof(encoded) - 4; c++) {
+        encoded[len++] = (*c == '-') ? '+' : (*c == '_') ? '/' : *c;
+    }
+    while (len % 4) {
+        encoded[len++] = '=';
+    }
+
+    size_t olen = 0;
+    if (mbedtls_base64_decode((unsigned char *)payload, sizeof(payload) - 1, &olen,
+                              (const unsigned char *)encoded, len) != 0) {
+        return -1;
+    }
+    payload[olen] = '\0';
+
+    int64_t iat = token_claim(payload, "iat");
+    int64_t exp = token_claim(payload, "exp");
+    if (iat < 0 || exp <= iat) {
+        return -1;
+    }
+    return exp - iat;
+}
+
+/**
+ * Arm the refresh timer for s_token_refresh_at
+ */
+static void token_schedule_refresh(void) {
+    int64_t remaining = s_token_refresh_at - uptime_s();
+    if (remaining > TOKEN_REFRESH_MAX_WAIT) {
+        remaining = TOKEN_REFRESH_MAX_WAIT;
+    }
+    job_start(&s_refresh_job, (remaining > 0) ? (uint32_t)remaining * 1000 : 0);
+}
+
+/**
+ * Record when the token currently in the context has to be refreshed.
+ */
+static void token_track(const quarklink_context_t *quarklink) {
+    /* No token to refresh outside Database Direct policies */
+    if (strcmp(quarklink->token, "") == 0) {
+        s_token_refresh_at = 0;
+        job_stop(&s_refresh_job);
+        return;
+    }
+    int64_t lifetime = token_lifetime(quarklink->token);
+    if (lifetime < 0) {
+        /* No expiry to go by: refresh at a fixed interval rather than wait for a rejection */
+        s_token_refresh_at = uptime_s() + TOKEN_REFRESH_DEFAULT;
+        s_token_valid = true;
+        token_schedule_refresh();
+        ESP_LOGI(TAG, "Token expiry unknown, refresh in %d s", TOKEN_REFRESH_DEFAULT);
+        return;
+    }
+    int64_t margin = (lifetime > 2 * TOKEN_REFRESH_MARGIN) ? TOKEN_REFRESH_MARGIN : lifetime / 2;
+    s_token_refresh_at = uptime_s() + lifetime - margin;
+    s_token_valid = true;
+    token_schedule_refresh();
+    ESP_LOGI(TAG, "Token valid for %" PRId64 " s, refresh in %" PRId64 " s", lifetime, lifetime - margin);
+}
+
+/**
+ * Refresh the token as soon as possible, e.g. because the hub rejected the current one
+ */
+static void token_request_refresh(void) {
+    job_start(&s_refresh_job, 0);
+}
+
+/**
+ * Obtain the next token before the current one expires, or once the hub rejected it.
+ */
+static void token_refresh(void) {
+    /* Long lived tokens take more than one timer wait */
+    if (s_token_valid && s_token_refresh_at - uptime_s() > TOKEN_REFRESH_JITTER) {
+        token_schedule_refresh();
+        return;
+    }
+    if (!isDatabaseDirect(&quarklink)) {
+        s_token_refresh_at = 0;
+        job_stop(&s_refresh_job);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Refreshing token");
+    memcpy(&s_refresh_context, &quarklink, sizeof(quarklink));
+    strcpy(s_refresh_context.deviceCert, "");
+    strcpy(s_refresh_context.token, "");
+    quarklink_return_t ql_ret = quarklink_enrol(&s_refresh_context);
+    if (ql_ret != QUARKLINK_SUCCESS) {
+        job_done(&s_refresh_job, false);
+        ESP_LOGW(TAG, "Token refresh failed (%d), retrying in %" PRIu32 " s", ql_ret,
+                 s_refresh_job.backoff_ms / 1000);
+        return;
+    }
+
+    job_done(&s_refresh_job, true);
+    memcpy(quarklink.token, s_refresh_context.token, sizeof(quarklink.token));
+    memcpy(quarklink.deviceCert, s_refresh_context.deviceCert, sizeof(quarklink.deviceCert));
+    quarklink.tempCert = s_refresh_context.tempCert;
+    ql_ret = quarklink_persistEnrolmentContext(&quarklink);
+    if (ql_ret != QUARKLINK_SUCCESS) {
+        ESP_LOGW(TAG, "Failed to store the Enrolment context");
+    }
+    token_track(&quarklink);
+    s_token_valid = true;
+    ESP_LOGI(TAG, "Token refreshed");
 }
 
+/**
+ * Start connecting to the AP without waiting, so the rest of the boot runs during association.
+ * The cached AP and DHCP lease of the last connection are used when there is one.
+ */
 void wifi_init_sta(void) {
     s_wifi_event_group = xEventGroupCreate();
 
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_sta_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
-                                                        &event_handler, NULL, &instance_any_id));
+                                                        &event_handler, NULL, &s_instance_any_id));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
-                                                        &event_handler, NULL, &instance_got_ip));
+                                                        &event_handler, NULL, &s_instance_got_ip));
 
-    wifi_config_t wifi_config;
     /* Load existing configuration and prompt user */
-    esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_get_config(WIFI_IF_STA, &s_wifi_config);
+
+    /* The cached AP only applies to this boot: it is kept out of the stored Wi-Fi configuration */
+    s_fast_connect = wifi_cache_apply(s_sta_netif, &s_wifi_config);
+    if (s_fast_connect) {
+        ESP_ERROR_CHECK(wifi_cache_set_config(&s_wifi_config));
+    }
 
     ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_LOGI(TAG, "wifi_init_sta finished.");
+    boot_mark("wifi started");
+    ESP_LOGD(TAG, "wifi_init_sta finished.");
+}
 
+/**
+ * Wait for the connection started by wifi_init_sta(), restarting if it cannot be established
+ */
+void wifi_wait_connected(void) {
     /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed
      * for the maximum number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see
      * above) */
@@ -160,10 +390,11 @@ void wifi_init_sta(void) {
     /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which
      * event actually happened. */
     if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "connected to ap SSID: %s", wifi_config.sta.ssid);
+        ESP_LOGI(TAG, "connected to ap SSID: %s%s", s_wifi_config.sta.ssid,
+                 s_fast_connect ? " (cached)" : "");
     }
     else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID: %s", wifi_config.sta.ssid);
+        ESP_LOGI(TAG, "Failed to connect to SSID: %s", s_wifi_config.sta.ssid);
         ESP_LOGI(TAG, "Reached maximum retry limit for connection to the AP");
         ESP_LOGI(TAG, "Restarting");
         vTaskDelay(3000 / portTICK_PERIOD_MS);
@@ -175,214 +406,836 @@ void wifi_init_sta(void) {
 
     /* The event will not be processed after unregister */
     ESP_ERROR_CHECK(
-        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, s_instance_got_ip));
     ESP_ERROR_CHECK(
-        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, s_instance_any_id));
     vEventGroupDelete(s_wifi_event_group);
 }
 
-int databaseDirectPost(const quarklink_context_t *quarklink, int post_count) {
-    static char rxBuffer[500];
+/* Database Direct connection
+ * A single TLS connection to the hub is kept open and reused by every post. It is only re-opened
+ * when the hub closes it, an I/O error occurs or the hub endpoint changes. */
+static struct {
+    esp_tls_t *tls;
+    char host[QUARKLINK_MAX_ENDPOINT_LENGTH];
+    uint16_t port;
+    // Number of TLS handshakes performed
+    uint32_t handshakes;
+    // Number of posts sent over an already open connection
+    uint32_t reused;
+} s_hub;
 
-    /* Configure the https client */
-    esp_http_client_config_t config = {
-        .host = quarklink->iotHubEndpoint,
-        .port = quarklink->iotHubPort,
-        .path = quarklink->uri,
-        .transport_type = HTTP_TRANSPORT_OVER_SSL,
-        .cert_pem = quarklink->iotHubRootCert,
-        .method = HTTP_METHOD_POST,
-        .event_handler = http_event_handler,
-        .user_data = rxBuffer,
-        .keep_alive_enable = true,
-        .buffer_size_tx = 2048,
+static void hub_close(void) {
+    if (s_hub.tls != NULL) {
+        esp_tls_conn_destroy(s_hub.tls);
+        s_hub.tls = NULL;
+    }
+}
+
+/**
+ * Return the open connection to the hub, connecting first if there is none.
+ * \param[out] reused true if the connection was already open
+ */
+static esp_tls_t *hub_connect(const quarklink_context_t *quarklink, bool *reused) {
+    const char *host = quarklink->iotHubEndpoint;
+    uint16_t port = quarklink->iotHubPort;
+
+    if (s_hub.tls != NULL && s_hub.port == port && strcmp(s_hub.host, host) == 0) {
+        s_hub.reused++;
+        *reused = true;
+        return s_hub.tls;
+    }
+    hub_close();
+    *reused = false;
+
+    esp_tls_client_session_t *session = tls_session_get(host, port);
+    esp_tls_cfg_t cfg = {
+        .cacert_buf = (const unsigned char *)quarklink->iotHubRootCert,
+        .cacert_bytes = strlen(quarklink->iotHubRootCert) + 1,
+        .timeout_ms = 10000,
+        .keep_alive_cfg = &(tls_keep_alive_cfg_t){
+            .keep_alive_enable = true,
+            .keep_alive_idle = 30,
+            .keep_alive_interval = 5,
+            .keep_alive_count = 3,
+        },
+        .client_session = session,
     };
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-
-    esp_http_client_set_header(client, "jwtTokenString", quarklink->token);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "Access-Control-Request-Headers", "*");
-
-    char body[200];
-    sprintf(body,
-            "{\"collection\":\"%s\",\"database\":\"%s\",\"dataSource\":\"%s\",\"document\":{\"count\":%d}}",
-            quarklink->deviceID, quarklink->database, quarklink->dataSource, post_count);
-    esp_http_client_set_post_field(client, body, strlen(body));
-    char url[QUARKLINK_MAX_ENDPOINT_LENGTH];
-    esp_http_client_get_url(client, url, sizeof(url));
-    ESP_LOGD(TAG, "Sending POST request to %s", url);
-    esp_err_t err;
-    err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        int64_t len = esp_http_client_get_content_length(client);
-        ESP_LOGD(TAG, "HTTP POST Status = %d, content length = %" PRIu64, status, len);
-        if (esp_http_client_is_complete_data_received(client)) {
-            ESP_LOGD(TAG, "Received response (%d): %s", strlen(rxBuffer), rxBuffer);
+    esp_tls_t *tls = esp_tls_init();
+    if (tls == NULL) {
+        return NULL;
+    }
+    int64_t start = esp_timer_get_time();
+    if (esp_tls_conn_new_sync(host, strlen(host), port, &cfg, tls) != 1) {
+        ESP_LOGE(TAG, "TLS connection to %s failed", host);
+        if (session != NULL) {
+            /* Start from a full handshake next time */
+            tls_session_forget(host, port);
+        }
+        esp_tls_conn_destroy(tls);
+        return NULL;
+    }
+    s_hub.handshakes++;
+    ESP_LOGI(TAG, "Connected to %s in %" PRId64 " ms (%s, handshakes=%" PRIu32 ", reused posts=%" PRIu32 ")",
+             host, (esp_timer_get_time() - start) / 1000, session ? "resuming" : "full handshake",
+             s_hub.handshakes, s_hub.reused);
+    tls_session_store(host, port, tls);
+
+    s_hub.tls = tls;
+    strlcpy(s_hub.host, host, sizeof(s_hub.host));
+    s_hub.port = port;
+    return tls;
+}
+
+/**
+ * Write the whole buffer to the connection
+ */
+static int tls_write_all(esp_tls_t *tls, const char *data, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        ssize_t ret = esp_tls_conn_write(tls, data + written, len - written);
+        if (ret < 0 && ret != ESP_TLS_ERR_SSL_WANT_READ && ret != ESP_TLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGE(TAG, "esp_tls_conn_write returned -0x%x", (int)-ret);
+            return -1;
+        }
+        if (ret > 0) {
+            written += ret;
+        }
+    }
+    return 0;
+}
+
+/* Response reader
+ * The response is parsed as it arrives through a small buffer, so headers of any length fit. The
+ * hub only answers once the request is sent, so nothing beyond the response is ever pending. */
+typedef struct {
+    esp_tls_t *tls;
+    char data[128];
+    size_t pos;
+    size_t len;
+    // At least one byte of the response arrived
+    bool started;
+} http_reader_t;
+
+/**
+ * Next byte of the response, -1 if the connection was closed or failed
+ */
+static int http_getc(http_reader_t *r) {
+    if (r->pos == r->len) {
+        ssize_t ret;
+        do {
+            ret = esp_tls_conn_read(r->tls, r->data, sizeof(r->data));
+        } while (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_WANT_WRITE);
+        if (ret <= 0) {
+            return -1;
+        }
+        r->pos = 0;
+        r->len = ret;
+        r->started = true;
+    }
+    return (unsigned char)r->data[r->pos++];
+}
+
+/**
+ * Read one CRLF terminated line, keeping its start in line and discarding what does not fit
+ * \return the length of the line as stored, -1 on error
+ */
+static int http_read_line(http_reader_t *r, char *line, size_t size) {
+    size_t len = 0;
+    int c;
+    while ((c = http_getc(r)) >= 0) {
+        if (c == '\n') {
+            if (len > 0 && line[len - 1] == '\r') {
+                len--;
+            }
+            line[len] = '\0';
+            return len;
+        }
+        if (len < size - 1) {
+            line[len++] = (char)c;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Read n bytes of body, appending them to buf while there is room
+ */
+static bool http_read_body(http_reader_t *r, size_t n, char *buf, size_t size, size_t *len) {
+    while (n-- > 0) {
+        int c = http_getc(r);
+        if (c < 0) {
+            return false;
+        }
+        if (*len < size - 1) {
+            buf[(*len)++] = (char)c;
+            buf[*len] = '\0';
+        }
+    }
+    return true;
+}
+
+/**
+ * Value of a header line if it is the given header, NULL otherwise
+ */
+static const char *http_header(const char *line, const char *name) {
+    size_t name_len = strlen(name);
+    if (strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+        return NULL;
+    }
+    const char *value = line + name_len + 1;
+    while (*value == ' ') {
+        value++;
+    }
+    return value;
+}
+
+/**
+ * Read one HTTP response, consuming exactly its bytes so the connection can carry the next request.
+ * The start of the body is kept in buf.
+ * \param[out] keep_open false if the hub will close the connection after this response or its end is unknown
+ * \param[out] started true if any byte of the response arrived, even when reading it failed
+ * \return the HTTP status, -1 on error
+ */
+static int http_read_response(esp_tls_t *tls, char *buf, size_t size, bool *keep_open, bool *started) {
+    http_reader_t r = { .tls = tls };
+    char line[128];
+    size_t len = 0;
+    int status = 0;
+    bool closing = false;
+    bool chunked = false;
+    bool has_length = false;
+    size_t expected = 0;
+
+    *keep_open = false;
+    buf[0] = '\0';
+
+    int ret;
+    do {
+        /* Interim 1xx responses end with their headers, the final response follows them */
+        ret = http_read_line(&r, line, sizeof(line));
+        *started = r.started;
+        if (ret < 0 || sscanf(line, "HTTP/%*s %d", &status) != 1) {
+            return -1;
+        }
+
+        /* Only the headers framing the body matter, the others are skipped whatever their length */
+        closing = chunked = has_length = false;
+        while ((ret = http_read_line(&r, line, sizeof(line))) > 0) {
+            const char *value;
+            if ((value = http_header(line, "Connection")) != NULL) {
+                closing = (strncasecmp(value, "close", 5) == 0);
+            }
+            else if ((value = http_header(line, "Content-Length")) != NULL) {
+                has_length = true;
+                expected = strtoul(value, NULL, 10);
+            }
+            else if ((value = http_header(line, "Transfer-Encoding")) != NULL) {
+                chunked = (strncasecmp(value, "chunked", 7) == 0);
+            }
+        }
+        if (ret < 0) {
+            return -1;
+        }
+    } while (status >= 100 && status < 200);
+
+    if (status == 204 || status == 304) {
+        /* Never a body, whatever the headers say */
+    }
+    else if (chunked) {
+        /* chunk-size [; extensions] CRLF data CRLF ... 0 CRLF [trailers] CRLF */
+        while (1) {
+            char *end;
+            if (http_read_line(&r, line, sizeof(line)) < 0) {
+                return -1;
+            }
+            size_t chunk = strtoul(line, &end, 16);
+            if (end == line) {
+                return -1;
+            }
+            if (chunk == 0) {
+                break;
+            }
+            if (!http_read_body(&r, chunk, buf, size, &len) || http_read_line(&r, line, sizeof(line)) != 0) {
+                return -1;
+            }
+        }
+        while ((ret = http_read_line(&r, line, sizeof(line))) > 0) {
+        }
+        if (ret < 0) {
+            return -1;
+        }
+    }
+    else if (has_length) {
+        if (!http_read_body(&r, expected, buf, size, &len)) {
+            return -1;
+        }
+    }
+    else {
+        /* No framing: the body only ends when the hub closes the connection, which it may not do
+         * before the read timeout. Keep what already arrived and close the connection instead. */
+        size_t n = r.len - r.pos;
+        if (n > size - 1) {
+            n = size - 1;
         }
+        memcpy(buf, r.data + r.pos, n);
+        buf[n] = '\0';
+        return status;
+    }
+
+    *keep_open = !closing;
+    return status;
+}
+
+/**
+ * Remove the oldest readings once the hub has accepted them
+ */
+static void readings_drop(int n) {
+    s_readings_head = (s_readings_head + n) % BATCH_CAPACITY;
+    s_readings_len -= n;
+    if (n > 0) {
+        s_readings_sent = true;
+    }
+}
+
+/**
+ * Move all the queued readings to the flash log, in order
+ */
+static void readings_spill(void) {
+    if (!s_tlog_ready || s_readings_len == 0) {
+        return;
+    }
+    int n = s_readings_len;
+    for (int i = 0; i < n; i++) {
+        if (tlog_append(&s_tlog, s_readings[(s_readings_head + i) % BATCH_CAPACITY].count) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to store a reading in flash");
+        }
+    }
+    readings_drop(n);
+    ESP_LOGI(TAG, "Stored %d reading(s) in flash, %" PRIu32 " waiting", n, tlog_pending(&s_tlog));
+}
+
+/**
+ * Queue a reading. Returns false if the ring is full and the flash log is not available.
+ */
+static bool readings_push(int value) {
+    if (s_readings_len == BATCH_CAPACITY) {
+        readings_spill();
+    }
+    if (s_readings_len == BATCH_CAPACITY) {
+        return false;
+    }
+    reading_t *reading = &s_readings[(s_readings_head + s_readings_len) % BATCH_CAPACITY];
+    reading->count = value;
+    reading->taken_at = uptime_s();
+    s_readings_len++;
+    return true;
+}
+
+/**
+ * Whether the queued readings should be published now
+ */
+static bool readings_due(void) {
+    if (s_readings_len == 0) {
+        return false;
+    }
+    return !s_readings_sent || (s_readings_len >= BATCH_FLUSH_SIZE) ||
+           (uptime_s() - s_readings[s_readings_head].taken_at >= BATCH_MAX_AGE);
+}
+
+/**
+ * Copy the queued readings, oldest first
+ */
+static int readings_peek(int32_t *values) {
+    for (int i = 0; i < s_readings_len; i++) {
+        values[i] = s_readings[(s_readings_head + i) % BATCH_CAPACITY].count;
+    }
+    return s_readings_len;
+}
+
+/**
+ * Write the request body for a batch of readings. With a NULL writer buffer this only measures it.
+ * \param[in] many use the insertMany "documents" form, otherwise only the first reading is sent
+ * \return the number of readings in the body
+ */
+static int readings_body(jw_t *w, const quarklink_context_t *quarklink, bool many, const int32_t *values,
+                         int count) {
+    int n = many ? count : 1;
+    jw_object_begin(w);
+    jw_key(w, "collection");
+    jw_string(w, quarklink->deviceID);
+    jw_key(w, "database");
+    jw_string(w, quarklink->database);
+    jw_key(w, "dataSource");
+    jw_string(w, quarklink->dataSource);
+    jw_key(w, many ? "documents" : "document");
+    if (many) {
+        jw_array_begin(w);
+    }
+    for (int i = 0; i < n; i++) {
+        jw_object_begin(w);
+        jw_key(w, "count");
+        jw_int(w, values[i]);
+        jw_object_end(w);
+    }
+    if (many) {
+        jw_array_end(w);
+    }
+    jw_object_end(w);
+    return n;
+}
+
+#if (TELEMETRY_CBOR)
+/* CBOR field names
+ * Field names are sent as small integer keys. The first body on each connection also carries the
+ * dictionary under key 0, mapping each key to its field name, and the hub keeps it for the rest of
+ * the connection. */
+enum {
+    FIELD_DICTIONARY = 0,
+    FIELD_COLLECTION,
+    FIELD_DATABASE,
+    FIELD_DATA_SOURCE,
+    FIELD_DOCUMENT,
+    FIELD_DOCUMENTS,
+    FIELD_COUNT,
+    FIELD_LAST = FIELD_COUNT
+};
+
+static const char *const FIELD_NAMES[FIELD_LAST + 1] = {
+    [FIELD_COLLECTION] = "collection",
+    [FIELD_DATABASE] = "database",
+    [FIELD_DATA_SOURCE] = "dataSource",
+    [FIELD_DOCUMENT] = "document",
+    [FIELD_DOCUMENTS] = "documents",
+    [FIELD_COUNT] = "count",
+};
+
+/**
+ * Write the CBOR equivalent of readings_body(), with the field dictionary first if requested.
+ * \return number of readings in the body
+ */
+static int readings_body_cbor(cw_t *w, const quarklink_context_t *quarklink, bool many, const int32_t *values,
+                              int count, bool dictionary) {
+    int n = many ? count : 1;
+    cw_map(w, dictionary ? 5 : 4);
+    if (dictionary) {
+        cw_uint(w, FIELD_DICTIONARY);
+        cw_map(w, FIELD_LAST);
+        for (int key = FIELD_DICTIONARY + 1; key <= FIELD_LAST; key++) {
+            cw_uint(w, key);
+            cw_text(w, FIELD_NAMES[key]);
+        }
+    }
+    cw_uint(w, FIELD_COLLECTION);
+    cw_text(w, quarklink->deviceID);
+    cw_uint(w, FIELD_DATABASE);
+    cw_text(w, quarklink->database);
+    cw_uint(w, FIELD_DATA_SOURCE);
+    cw_text(w, quarklink->dataSource);
+    cw_uint(w, many ? FIELD_DOCUMENTS : FIELD_DOCUMENT);
+    if (many) {
+        cw_array(w, n);
+    }
+    for (int i = 0; i < n; i++) {
+        cw_map(w, 1);
+        cw_uint(w, FIELD_COUNT);
+        cw_int(w, values[i]);
+    }
+    return n;
+}
+#endif
+
+/**
+ * Write the whole request for a batch of readings: headers, then the body straight after them.
+ * \param dictionary the body starts a new connection, so must carry the CBOR field dictionary
+ * \param[out] n number of readings in the body
+ * \return length of the request, -1 if it does not fit
+ */
+static int build_request(char *request, size_t size, const quarklink_context_t *quarklink, const char *path,
+                         bool many, const int32_t *values, int count, bool dictionary, int *n) {
+    size_t body_len;
+
+    /* Measure the body for Content-Length */
+    int64_t start = esp_timer_get_time();
+#if (TELEMETRY_CBOR)
+    cw_t w;
+    cw_init(&w, NULL, 0);
+    *n = readings_body_cbor(&w, quarklink, many, values, count, dictionary);
+    body_len = cw_length(&w);
+#else
+    jw_t w;
+    jw_init(&w, NULL, 0);
+    *n = readings_body(&w, quarklink, many, values, count);
+    body_len = jw_length(&w);
+#endif
+    int64_t encode_us = esp_timer_get_time() - start;
+
+    int len = snprintf(request, size,
+                       "POST %s HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "jwtTokenString: %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "Access-Control-Request-Headers: *\r\n"
+                       "Content-Length: %d\r\n"
+                       "\r\n",
+                       path, quarklink->iotHubEndpoint, quarklink->token,
+                       TELEMETRY_CBOR ? CBOR_CONTENT_TYPE : "application/json", (int)body_len);
+    if (len < 0 || len >= (int)size) {
+        ESP_LOGE(TAG, "Request headers too long");
+        return -1;
+    }
+
+#if (TELEMETRY_CBOR)
+    cw_init(&w, (uint8_t *)request + len, size - len);
+    readings_body_cbor(&w, quarklink, many, values, count, dictionary);
+    bool ok = cw_ok(&w);
+#else
+    jw_init(&w, request + len, size - len);
+    readings_body(&w, quarklink, many, values, count);
+    bool ok = jw_ok(&w);
+#endif
+    if (!ok) {
+        ESP_LOGE(TAG, "Request body too long (%d bytes)", (int)body_len);
+        return -1;
+    }
+
+#if (TELEMETRY_CBOR)
+    /* Report the size and encode time against the same body in JSON, both timed on the measuring pass */
+    jw_t json;
+    start = esp_timer_get_time();
+    jw_init(&json, NULL, 0);
+    readings_body(&json, quarklink, many, values, count);
+    int64_t json_us = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Body: %d bytes CBOR%s in %" PRId64 " us, %d bytes as JSON in %" PRId64 " us", (int)body_len,
+             dictionary ? " with dictionary" : "", encode_us, (int)jw_length(&json), json_us);
+#else
+    ESP_LOGI(TAG, "Body: %d bytes JSON in %" PRId64 " us", (int)body_len, encode_us);
+#endif
+    return len + (int)body_len;
+}
+
+/**
+ * Publish a batch of readings to the hub over the long-lived connection, resuming the previous TLS
+ * session whenever a new connection is needed.
+ * esp_http_client gives no access to the TLS session, so the request is written directly.
+ * \param[out] sent number of readings published, from the start of the batch
+ * \return ESP_OK once the hub accepted the readings, the HTTP status if it did not,
+ *         QUARKLINK_ERROR if the hub could not be reached
+ */
+int databaseDirectPost(const quarklink_context_t *quarklink, const int32_t *values, int count, int *sent) {
+    static char rxBuffer[500];
+    static char request[QUARKLINK_MAX_TOKEN_LENGTH + QUARKLINK_MAX_ENDPOINT_LENGTH + QUARKLINK_MAX_URI_LENGTH +
+                        256 + 2 * QUARKLINK_MAX_SHORT_DATA_LENGTH + QUARKLINK_MAX_DEVICE_ID_LENGTH +
+                        24 * BATCH_CAPACITY];
+    // Set once the hub answered 404 to insertMany: readings are then sent one per post
+    static bool s_insert_many_unknown = false;
+    char path[QUARKLINK_MAX_URI_LENGTH + 1];
+
+    *sent = 0;
+
+    /* The policy gives the insertOne action; its insertMany sibling takes the whole batch */
+    strlcpy(path, quarklink->uri, sizeof(path));
+    char *action = s_insert_many_unknown ? NULL : strstr(path, "insertOne");
+    bool many = (action != NULL);
+    if (many) {
+        strcpy(action, "insertMany");
+    }
+
+    ESP_LOGD(TAG, "Sending %d reading(s) to https://%s:%d%s", many ? count : 1, quarklink->iotHubEndpoint,
+             quarklink->iotHubPort, path);
+
+    /* An idle connection may have been closed by the hub: retry once on a new one */
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = false;
+        bool keep_open = false;
+        esp_tls_t *tls = hub_connect(quarklink, &reused);
+        if (tls == NULL) {
+            break;
+        }
+
+        /* A new connection is a new session for the hub, so the CBOR dictionary is sent again */
+        int n;
+        int len = build_request(request, sizeof(request), quarklink, path, many, values, count, !reused, &n);
+        if (len < 0) {
+            return QUARKLINK_ERROR;
+        }
+
+        int status = -1;
+        bool started = false;
+        bool written = (tls_write_all(tls, request, len) == 0);
+        if (written) {
+            status = http_read_response(tls, rxBuffer, sizeof(rxBuffer), &keep_open, &started);
+        }
+        if (!keep_open) {
+            hub_close();
+        }
+        if (status < 0) {
+            /* Posts are not idempotent: only send again if the hub cannot have taken the request,
+             * i.e. the idle connection was already closed when writing or before any answer */
+            if (reused && (!written || !started)) {
+                ESP_LOGD(TAG, "Kept-alive connection was closed, reconnecting");
+                continue;
+            }
+            break;
+        }
+
+        ESP_LOGD(TAG, "HTTP POST Status = %d (handshakes=%" PRIu32 ", reused posts=%" PRIu32 ")",
+                 status, s_hub.handshakes, s_hub.reused);
+        ESP_LOGD(TAG, "Received response: %s", rxBuffer);
         if (status == HttpStatus_Unauthorized) {
             ESP_LOGI(TAG, "Token Expired");
-            err = HttpStatus_Unauthorized;
+            return HttpStatus_Unauthorized;
         }
+        if (status < 200 || status >= 300) {
+            /* Not accepted: the readings stay queued for the next post */
+            ESP_LOGE(TAG, "Hub rejected the readings, HTTP status %d", status);
+            if (many && status == HttpStatus_NotFound) {
+                ESP_LOGW(TAG, "insertMany not available, falling back to insertOne");
+                s_insert_many_unknown = true;
+            }
+            return status;
+        }
+        *sent = n;
+        return ESP_OK;
+    }
+
+    ESP_LOGE(TAG, "HTTP POST request failed");
+    return QUARKLINK_ERROR;
+}
+
+/**
+ * Check the device status with QuarkLink and enrol when needed.
+ * \return false if the check or the enrolment failed
+ */
+static bool status_check(quarklink_return_t *ql_status) {
+    quarklink_return_t ql_ret;
+
+    /* get status */
+    ESP_LOGI(TAG, "Get status");
+    *ql_status = quarklink_status(&quarklink);
+    switch (*ql_status) {
+        case QUARKLINK_STATUS_ENROLLED:
+            if (strcmp(quarklink.iotHubEndpoint, "") == 0) {
+                ESP_LOGI(TAG, "No enrolment info saved. Re-enrolling");
+                *ql_status = QUARKLINK_STATUS_NOT_ENROLLED;
+            }
+            ESP_LOGI(TAG, "Enrolled");
+            break;
+        case QUARKLINK_STATUS_FWUPDATE_REQUIRED:
+            ESP_LOGI(TAG, "Firmware Update required");
+            break;
+        case QUARKLINK_STATUS_NOT_ENROLLED:
+            ESP_LOGI(TAG, "Not enrolled");
+            break;
+        case QUARKLINK_STATUS_CERTIFICATE_EXPIRED:
+            //Ignore this case as not relevant for DBD
+            break;
+        case QUARKLINK_STATUS_REVOKED:
+            #if (LED_COLOUR)
+                led_set_colour(led_strip, RED);
+            #endif
+            ESP_LOGI(TAG, "Device revoked");
+            break;
+        default:
+            ESP_LOGE(TAG, "Error during status request");
+            return false;
+    }
+
+    if (*ql_status == QUARKLINK_STATUS_NOT_ENROLLED ||
+        *ql_status == QUARKLINK_STATUS_REVOKED) {
+        /* enroll */
+        ESP_LOGI(TAG, "Enrol to %s", quarklink.endpoint);
+        ql_ret = quarklink_enrol(&quarklink);
+        switch (ql_ret) {
+            case QUARKLINK_SUCCESS:
+                ESP_LOGI(TAG, "Successfully enrolled!");
+                ql_ret = quarklink_persistEnrolmentContext(&quarklink);
+                if (ql_ret != QUARKLINK_SUCCESS) {
+                    ESP_LOGW(TAG, "Failed to store the Enrolment context");
+                }
+                token_track(&quarklink);
+                #if (LED_COLOUR)
+                    led_set_colour(led_strip, LED_COLOUR);
+                #endif
+                *ql_status = QUARKLINK_STATUS_ENROLLED;
+                break;
+            case QUARKLINK_DEVICE_DOES_NOT_EXIST:
+                ESP_LOGW(TAG, "Device does not exist");
+                break;
+            case QUARKLINK_DEVICE_REVOKED:
+                #if (LED_COLOUR)
+                    led_set_colour(led_strip, RED);
+                #endif
+                ESP_LOGW(TAG, "Device revoked");
+                break;
+            case QUARKLINK_CACERTS_ERROR:
+            default:
+                ESP_LOGE(TAG, "Error during enrol");
+                return false;
+            }
+    }
+    return true;
+}
+
+/**
+ * Download and install a firmware update.
+ * \return false if the update failed
+ */
+static bool firmware_update(void) {
+    /* firmware update */
+    ESP_LOGI(TAG, "Get firmware update");
+    quarklink_return_t ql_ret = quarklink_firmwareUpdate(&quarklink, NULL);
+    switch (ql_ret) {
+        case QUARKLINK_FWUPDATE_UPDATED:
+            ESP_LOGI(TAG, "Firmware updated. Rebooting...");
+            esp_restart();
+            break;
+        case QUARKLINK_FWUPDATE_NO_UPDATE:
+            ESP_LOGI(TAG, "No firmware update");
+            break;
+        case QUARKLINK_FWUPDATE_WRONG_SIGNATURE:
+            ESP_LOGI(TAG, "Wrong firmware signature");
+            return false;
+        case QUARKLINK_FWUPDATE_MISSING_SIGNATURE:
+            ESP_LOGI(TAG, "Missing required firmware signature");
+            return false;
+        case QUARKLINK_FWUPDATE_ERROR:
+        default:
+            ESP_LOGE(TAG, "Error while updating firmware");
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Take a reading and publish the queued ones when they are due.
+ * \return false if the hub could not be reached
+ */
+static bool publish_readings(void) {
+    /* Keep sampling while the token is refreshed, the readings go out with the next batch */
+    if (readings_push(count)) {
+        count++;
     }
     else {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
-        err = QUARKLINK_ERROR;
+        ESP_LOGW(TAG, "Telemetry buffer full, pausing readings until the hub accepts them");
+    }
+
+    if (!s_token_valid) {
+        ESP_LOGD(TAG, "Waiting for a refreshed token, skipping publish");
+        return true;
+    }
+    if (!readings_due()) {
+        ESP_LOGD(TAG, "%d reading(s) queued", s_readings_len);
+        return true;
+    }
+    if (uptime_s() < s_post_retry_at) {
+        ESP_LOGD(TAG, "Backing off, %d reading(s) queued", s_readings_len);
+        return true;
+    }
+
+    int32_t batch[BATCH_CAPACITY];
+    int ret_post = 0;
+    int sent = 0;
+    int n = readings_peek(batch);
+    ret_post = databaseDirectPost(&quarklink, batch, n, &sent);
+    if (ret_post == HttpStatus_Unauthorized) {
+        /* Keep the readings in flash, keep sampling and let the refresh job re-enrol */
+        readings_spill();
+        ESP_LOGI(TAG, "Requesting a new token");
+        s_token_valid = false;
+        token_request_refresh();
+        return false;
     }
-    esp_http_client_cleanup(client);
-    return err;
+    if (ret_post != 0) {
+        /* The token is still good: keep the readings and try again later, waiting longer after
+         * each failure so an unreachable hub is not hammered */
+        readings_spill();
+        s_post_backoff = (s_post_backoff == 0) ? POST_RETRY_MIN : MIN(2 * s_post_backoff, POST_RETRY_MAX);
+        s_post_retry_at = uptime_s() + s_post_backoff;
+        ESP_LOGW(TAG, "Post failed (%d), retrying in %d s", ret_post, s_post_backoff);
+        return false;
+    }
+    s_post_backoff = 0;
+    s_post_retry_at = 0;
+
+    readings_drop(sent);
+    ESP_LOGI(TAG, "Published %d reading(s), data=%d", sent, count);
+    boot_complete("first publish");
+
+    /* Replay one batch of the backlog */
+    n = s_tlog_ready ? tlog_peek(&s_tlog, batch, BATCH_CAPACITY) : 0;
+    if (n > 0) {
+        ret_post = databaseDirectPost(&quarklink, batch, n, &sent);
+        if (ret_post == 0) {
+            tlog_consume(&s_tlog, sent);
+            ESP_LOGI(TAG, "Replayed %d stored reading(s), %" PRIu32 " waiting", sent,
+                     tlog_pending(&s_tlog));
+        }
+    }
+
+    /* The first publish is out: let DHCP take over a reused lease */
+    wifi_cache_renew(s_sta_netif, &s_wifi_config);
+    #if (LED_COLOUR)
+        led_strip_clear(led_strip);
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+        led_set_colour(led_strip, LED_COLOUR);
+    #endif
+    return true;
 }
 
 void main_task(void *pvParameter) {
 
-    quarklink_return_t ql_ret;
     quarklink_return_t ql_status = QUARKLINK_ERROR;
-    uint32_t round = 0;
+
+    job_start(&s_status_job, 0);
 
     while (1) {
+        EventBits_t due = xEventGroupWaitBits(s_main_events,
+                                              STATUS_DUE_BIT | FWUPDATE_DUE_BIT | PUBLISH_DUE_BIT | REFRESH_DUE_BIT,
+                                              pdTRUE, pdFALSE, portMAX_DELAY);
 
-        // If it's time for a status check
-        if (round % STATUS_CHECK_INTERVAL == 0) {
-            /* get status */
-            ESP_LOGI(TAG, "Get status");
-            ql_status = quarklink_status(&quarklink);
-            switch (ql_status) {
-                case QUARKLINK_STATUS_ENROLLED:
-                    if (strcmp(quarklink.iotHubEndpoint, "") == 0) {
-                        ESP_LOGI(TAG, "No enrolment info saved. Re-enrolling");
-                        ql_status = QUARKLINK_STATUS_NOT_ENROLLED;
-                    }
-                    ESP_LOGI(TAG, "Enrolled");
-                    break;
-                case QUARKLINK_STATUS_FWUPDATE_REQUIRED:
-                    ESP_LOGI(TAG, "Firmware Update required");
-                    break;
-                case QUARKLINK_STATUS_NOT_ENROLLED:
-                    ESP_LOGI(TAG, "Not enrolled");
-                    break;
-                case QUARKLINK_STATUS_CERTIFICATE_EXPIRED:
-                    //Ignore this case as not relevant for DBD
-                    break;
-                case QUARKLINK_STATUS_REVOKED:
-                    #if (LED_COLOUR)
-                        led_set_colour(led_strip, RED);
-                    #endif
-                    ESP_LOGI(TAG, "Device revoked");
-                    break;
-                default:
-                    ESP_LOGE(TAG, "Error during status request");
-                    continue;
+        if (due & STATUS_DUE_BIT) {
+            bool ok = status_check(&ql_status);
+            job_done(&s_status_job, ok);
+            if (ok) {
+                boot_mark("status checked");
             }
 
-            if (ql_status == QUARKLINK_STATUS_NOT_ENROLLED ||
-                ql_status == QUARKLINK_STATUS_REVOKED) {
-                /* enroll */
-                ESP_LOGI(TAG, "Enrol to %s", quarklink.endpoint);
-                ql_ret = quarklink_enrol(&quarklink);
-                switch (ql_ret) {
-                    case QUARKLINK_SUCCESS:
-                        ESP_LOGI(TAG, "Successfully enrolled!");
-                        ql_ret = quarklink_persistEnrolmentContext(&quarklink);
-                        if (ql_ret != QUARKLINK_SUCCESS) {
-                            ESP_LOGW(TAG, "Failed to store the Enrolment context");
-                        }
-                        #if (LED_COLOUR)
-                            led_set_colour(led_strip, LED_COLOUR);
-                        #endif
-                        ql_status = QUARKLINK_STATUS_ENROLLED;
-                        break;
-                    case QUARKLINK_DEVICE_DOES_NOT_EXIST:
-                        ESP_LOGW(TAG, "Device does not exist");
-                        break;
-                    case QUARKLINK_DEVICE_REVOKED:
-                        #if (LED_COLOUR)
-                            led_set_colour(led_strip, RED);
-                        #endif
-                        ESP_LOGW(TAG, "Device revoked");
-                        break;
-                    case QUARKLINK_CACERTS_ERROR:
-                    default:
-                        ESP_LOGE(TAG, "Error during enrol");
-                        break;
-                    }
+            if (ql_status == QUARKLINK_STATUS_FWUPDATE_REQUIRED && !job_pending(&s_fwupdate_job)) {
+                job_start(&s_fwupdate_job, 0);
             }
-
-            if (ql_status == QUARKLINK_STATUS_FWUPDATE_REQUIRED) {
-                /* firmware update */
-                ESP_LOGI(TAG, "Get firmware update");
-                ql_ret = quarklink_firmwareUpdate(&quarklink, NULL);
-                switch (ql_ret) {
-                    case QUARKLINK_FWUPDATE_UPDATED:
-                        ESP_LOGI(TAG, "Firmware updated. Rebooting...");
-                        esp_restart();
-                        break;
-                    case QUARKLINK_FWUPDATE_NO_UPDATE:
-                        ESP_LOGI(TAG, "No firmware update");
-                        break;
-                    case QUARKLINK_FWUPDATE_WRONG_SIGNATURE:
-                        ESP_LOGI(TAG, "Wrong firmware signature");
-                        break;
-                    case QUARKLINK_FWUPDATE_MISSING_SIGNATURE:
-                        ESP_LOGI(TAG, "Missing required firmware signature");
-                        break;
-                    case QUARKLINK_FWUPDATE_ERROR:
-                    default:
-                        ESP_LOGE(TAG, "Error while updating firmware");
-                        break;
-                }
+            /* Readings are only taken while enrolled */
+            if (ql_status == QUARKLINK_STATUS_ENROLLED && !job_pending(&s_publish_job)) {
+                job_start(&s_publish_job, 0);
             }
         }
 
-        // If it's time to publish
-        if ((round % PUBLISH_INTERVAL == 0) && (ql_status == QUARKLINK_STATUS_ENROLLED)) {
-
-            if (isDatabaseDirect(&quarklink) == 1) {
-                int ret_post = 0;
-                ret_post = databaseDirectPost(&quarklink, count);
-                if (ret_post == 0) {
-                    count++;
-                    ESP_LOGI(TAG, "Published data=%d", count);
-                    #if (LED_COLOUR)
-                        led_strip_clear(led_strip);
-                        vTaskDelay(100 / portTICK_PERIOD_MS);
-                        led_set_colour(led_strip, LED_COLOUR);
-                    #endif
-                    round++;
-                }
-                else {
-                    strcpy(quarklink.deviceCert, "");
-                    strcpy(quarklink.token, "");
-                    ESP_LOGI(TAG, "Deleting Enrolment Context");
-                    quarklink_deleteEnrolmentContext(&quarklink);
-                    round = 0;
-                    ql_status = QUARKLINK_ERROR;
-                    ESP_LOGI(TAG, "ReEnrolling");
-                    ql_ret = quarklink_enrol(&quarklink);
-                    if (ql_ret == QUARKLINK_SUCCESS) {
-                        ESP_LOGI(TAG, "Successfully enrolled!");
-                    }
-                    ql_ret = quarklink_persistEnrolmentContext(&quarklink);
-                    if (ql_ret != QUARKLINK_SUCCESS) {
-                        ESP_LOGW(TAG, "Failed to store the Enrolment context");
-                    }
-                    #if (LED_COLOUR)
-                        led_set_colour(led_strip, LED_COLOUR);
-                    #endif
-                }
+        if (due & FWUPDATE_DUE_BIT) {
+            bool ok = firmware_update();
+            job_done(&s_fwupdate_job, ok);
+        }
+
+        if (due & PUBLISH_DUE_BIT) {
+            if (ql_status != QUARKLINK_STATUS_ENROLLED) {
+                job_stop(&s_publish_job);
             }
-            else {
+            else if (isDatabaseDirect(&quarklink) != 1) {
                 ESP_LOGW(TAG, "This example is only meant to work with Database Direct policies");
                 strcpy(quarklink.deviceCert, "");
                 strcpy(quarklink.token, "");
                 quarklink_deleteEnrolmentContext(&quarklink);
-                round = 0;
                 ql_status = QUARKLINK_ERROR;
+                job_stop(&s_publish_job);
+            }
+            else {
+                job_done(&s_publish_job, publish_readings());
             }
         }
 
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        round++;
+        if (due & REFRESH_DUE_BIT) {
+            token_refresh();
+        }
     }
 }
 
@@ -420,19 +1273,82 @@ void set_led(void) {
 }
 #endif
 
+/**
+ * Create the timed jobs, none of them started
+ */
+static void jobs_init(void) {
+    const job_config_t status = {
+        .period_ms = STATUS_CHECK_INTERVAL * 1000,
+        .jitter_ms = STATUS_CHECK_JITTER * 1000,
+        .backoff_min_ms = STATUS_RETRY_MIN * 1000,
+        .backoff_max_ms = STATUS_RETRY_MAX * 1000,
+    };
+    const job_config_t fwupdate = {
+        .backoff_min_ms = FWUPDATE_RETRY_MIN * 1000,
+        .backoff_max_ms = FWUPDATE_RETRY_MAX * 1000,
+    };
+    // Readings are taken at a steady rate, failed posts are retried with the next batch
+    const job_config_t publish = {
+        .period_ms = PUBLISH_INTERVAL * 1000,
+    };
+    const job_config_t refresh = {
+        .jitter_ms = TOKEN_REFRESH_JITTER * 1000,
+        .backoff_min_ms = TOKEN_REFRESH_RETRY * 1000,
+        .backoff_max_ms = TOKEN_REFRESH_RETRY_MAX * 1000,
+    };
+
+    s_main_events = xEventGroupCreate();
+    if (s_main_events == NULL ||
+        job_init(&s_status_job, "status", s_main_events, STATUS_DUE_BIT, &status) != ESP_OK ||
+        job_init(&s_fwupdate_job, "fwupdate", s_main_events, FWUPDATE_DUE_BIT, &fwupdate) != ESP_OK ||
+        job_init(&s_publish_job, "publish", s_main_events, PUBLISH_DUE_BIT, &publish) != ESP_OK ||
+        job_init(&s_refresh_job, "refresh", s_main_events, REFRESH_DUE_BIT, &refresh) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the job timers");
+        esp_restart();
+    }
+}
+
+/**
+ * \brief Let the idle task lower the CPU clock and enter light sleep while every task waits for a job
+ */
+static void power_init(void) {
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Power management not enabled (%s)", esp_err_to_name(err));
+    }
+#endif
+}
+
 void app_main(void) {
+    boot_mark("app_main");
     ESP_LOGI(TAG, "quarklink-database-direct-esp32");
+    power_init();
 
 #if (LED_COLOUR)
     set_led();                             // esp32-c3 RGB LED
     led_set_colour(led_strip, LED_COLOUR); // LED_RED or LED_GREEN or LED_BLUE
 #endif
 
+    jobs_init();
+
     /* quarklink init */
     ESP_LOGI(TAG, "Loading stored QuarkLink context");
     // Need to initialise a local quarklink_context_t in order to retrieve the stored one. Doesn't
     // matter what values it is given.
     quarklink_return_t ql_ret = quarklink_init(&quarklink, "", 1, "");
+    boot_mark("quarklink init");
+
+    /* Associate while the context is loaded and the device certificate is rebuilt */
+    wifi_init_sta();
+
     ql_ret = quarklink_loadStoredContext(&quarklink);
     if (ql_ret == QUARKLINK_CONTEXT_NO_ENROLMENT_INFO_STORED) {
         // Should get here the first time after provisioning as the device hasn't enrolled yet
@@ -447,8 +1363,26 @@ void app_main(void) {
 
     ESP_LOGI(TAG, "Successfully loaded QuarkLink details for: %s", quarklink.endpoint);
     ESP_LOGI(TAG, "Device ID: %s", quarklink.deviceID);
+    token_track(&quarklink);
+    boot_mark("context loaded");
 
-    wifi_init_sta();
+    esp_err_t err = tlog_open(&s_tlog);
+    if (err == ESP_OK) {
+        s_tlog_ready = true;
+        ESP_LOGI(TAG, "%" PRIu32 " stored reading(s) waiting to be published", tlog_pending(&s_tlog));
+    }
+    else {
+        ESP_LOGW(TAG, "Telemetry log unavailable (%s), readings are only kept in RAM", esp_err_to_name(err));
+    }
+
+    boot_mark("telemetry log opened");
+
+    if (tls_session_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to load the stored TLS sessions");
+    }
+    boot_mark("TLS sessions loaded");
+
+    wifi_wait_connected();
 
     xTaskCreate(&main_task, "main_task", 1024 * 8, NULL, 5, NULL);
 }
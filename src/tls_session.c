@@ -0,0 +1,225 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/ssl.h"
+#include "nvs.h"
+
+#include "tls_session.h"
+
+/* TLS session resumption cache
+ * A resumed handshake skips the certificate exchange, the ECDHE key agreement and the signature
+ * checks, all of which go through the secure element, and completes in a single round trip.
+ * Sessions are kept in RAM and mirrored to NVS so they also survive a reboot. A digest of the
+ * stored blob is kept with each entry so a resumed connection, whose session serialises to the
+ * same blob, does not rewrite flash. The cache is only used from the task that opens the
+ * connections, so it is not locked. */
+
+#define TLS_SESSION_NAMESPACE "tls_sessions"
+/* Serialised sessions carry the server certificate when CONFIG_MBEDTLS_SSL_KEEP_PEER_CERTIFICATE is set */
+#define TLS_SESSION_MAX_SIZE 3072
+
+typedef struct {
+    uint32_t id;
+    esp_tls_client_session_t *session;
+    bool stored;                 /* digest holds the SHA-256 of the blob in NVS */
+    unsigned char digest[32];
+} tls_session_entry_t;
+
+static const char *TAG = "tls_session";
+static tls_session_entry_t s_sessions[TLS_SESSION_CACHE_SIZE];
+static uint32_t s_next_victim = 0;
+
+/**
+ * FNV-1a of "host:port", also used to build the NVS key
+ */
+static uint32_t tls_session_id(const char *host, uint16_t port) {
+    uint32_t hash = 0x811C9DC5;
+    for (const char *c = host; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 0x01000193;
+    }
+    hash = (hash ^ (uint8_t)(port >> 8)) * 0x01000193;
+    hash = (hash ^ (uint8_t)port) * 0x01000193;
+    /* 0 marks a free entry */
+    return hash ? hash : 1;
+}
+
+static void tls_session_key(uint32_t id, char *key, size_t key_size) {
+    snprintf(key, key_size, "s%08" PRIx32, id);
+}
+
+static tls_session_entry_t *tls_session_find(uint32_t id) {
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+        if (s_sessions[i].id == id) {
+            return &s_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+static void tls_session_release(tls_session_entry_t *entry) {
+    if (entry->session != NULL) {
+        esp_tls_free_client_session(entry->session);
+    }
+    entry->session = NULL;
+    entry->id = 0;
+    entry->stored = false;
+}
+
+/**
+ * Take the entry of a server, reusing a free one or evicting round robin
+ */
+static tls_session_entry_t *tls_session_slot(uint32_t id) {
+    tls_session_entry_t *entry = tls_session_find(id);
+    if (entry == NULL) {
+        entry = tls_session_find(0);
+    }
+    if (entry == NULL) {
+        entry = &s_sessions[s_next_victim];
+        s_next_victim = (s_next_victim + 1) % TLS_SESSION_CACHE_SIZE;
+    }
+    tls_session_release(entry);
+    entry->id = id;
+    return entry;
+}
+
+/**
+ * Rebuild a session from its NVS blob, returning the digest of the blob
+ */
+static esp_tls_client_session_t *tls_session_load(nvs_handle_t nvs, const char *key, unsigned char *digest) {
+    static unsigned char blob[TLS_SESSION_MAX_SIZE];
+    size_t len = sizeof(blob);
+    if (nvs_get_blob(nvs, key, blob, &len) != ESP_OK) {
+        return NULL;
+    }
+
+    esp_tls_client_session_t *session = calloc(1, sizeof(esp_tls_client_session_t));
+    if (session == NULL) {
+        return NULL;
+    }
+    mbedtls_ssl_session_init(&session->saved_session);
+    int ret = mbedtls_ssl_session_load(&session->saved_session, blob, len);
+    mbedtls_sha256(blob, len, digest, 0);
+    mbedtls_platform_zeroize(blob, len);
+    if (ret != 0) {
+        /* Most likely saved by a build with a different mbedTLS configuration */
+        ESP_LOGD(TAG, "Discarding stored session %s (-0x%04x)", key, -ret);
+        esp_tls_free_client_session(session);
+        return NULL;
+    }
+    return session;
+}
+
+esp_err_t tls_session_init(void) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(TLS_SESSION_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        /* Nothing stored yet */
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_iterator_t it = NULL;
+    int loaded = 0;
+    err = nvs_entry_find(NVS_DEFAULT_PART_NAME, TLS_SESSION_NAMESPACE, NVS_TYPE_BLOB, &it);
+    while (err == ESP_OK && loaded < TLS_SESSION_CACHE_SIZE) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        uint32_t id = strtoul(&info.key[1], NULL, 16);
+        unsigned char digest[32];
+        esp_tls_client_session_t *session = tls_session_load(nvs, info.key, digest);
+        if (id != 0 && session != NULL) {
+            tls_session_entry_t *entry = tls_session_slot(id);
+            entry->session = session;
+            memcpy(entry->digest, digest, sizeof(digest));
+            entry->stored = true;
+            loaded++;
+        }
+        else if (session != NULL) {
+            esp_tls_free_client_session(session);
+        }
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    nvs_close(nvs);
+
+    ESP_LOGI(TAG, "Loaded %d stored TLS session(s)", loaded);
+    return ESP_OK;
+}
+
+esp_tls_client_session_t *tls_session_get(const char *host, uint16_t port) {
+    tls_session_entry_t *entry = tls_session_find(tls_session_id(host, port));
+    return (entry != NULL) ? entry->session : NULL;
+}
+
+void tls_session_store(const char *host, uint16_t port, esp_tls_t *tls) {
+    static unsigned char blob[TLS_SESSION_MAX_SIZE];
+    esp_tls_client_session_t *session = esp_tls_get_client_session(tls);
+    if (session == NULL) {
+        return;
+    }
+
+    uint32_t id = tls_session_id(host, port);
+    tls_session_entry_t *entry = tls_session_find(id);
+    bool stored = (entry != NULL) && entry->stored;
+    unsigned char stored_digest[32];
+    if (stored) {
+        memcpy(stored_digest, entry->digest, sizeof(stored_digest));
+    }
+    entry = tls_session_slot(id);
+    entry->session = session;
+
+    size_t len = 0;
+    int ret = mbedtls_ssl_session_save(&session->saved_session, blob, sizeof(blob), &len);
+    if (ret != 0) {
+        ESP_LOGD(TAG, "Session for %s not persisted (-0x%04x)", host, -ret);
+        return;
+    }
+
+    mbedtls_sha256(blob, len, entry->digest, 0);
+    if (stored && memcmp(stored_digest, entry->digest, sizeof(stored_digest)) == 0) {
+        /* Resumed with the session already in NVS */
+        entry->stored = true;
+        ESP_LOGD(TAG, "Session for %s unchanged, not rewritten", host);
+        mbedtls_platform_zeroize(blob, len);
+        return;
+    }
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    tls_session_key(id, key, sizeof(key));
+    nvs_handle_t nvs;
+    if (nvs_open(TLS_SESSION_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_set_blob(nvs, key, blob, len) != ESP_OK || nvs_commit(nvs) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to persist the session for %s", host);
+        }
+        else {
+            entry->stored = true;
+        }
+        nvs_close(nvs);
+    }
+    mbedtls_platform_zeroize(blob, len);
+}
+
+void tls_session_forget(const char *host, uint16_t port) {
+    uint32_t id = tls_session_id(host, port);
+    tls_session_entry_t *entry = tls_session_find(id);
+    if (entry == NULL) {
+        return;
+    }
+    tls_session_release(entry);
+
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    tls_session_key(id, key, sizeof(key));
+    nvs_handle_t nvs;
+    if (nvs_open(TLS_SESSION_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, key);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_tls.h"
+
+/* Number of servers whose TLS session is kept in RAM */
+#define TLS_SESSION_CACHE_SIZE 2
+
+/**
+ * \brief Load the TLS sessions persisted in NVS into the RAM cache.
+ * NVS must already be initialised (encrypted when CONFIG_NVS_ENCRYPTION is set).
+ */
+esp_err_t tls_session_init(void);
+
+/**
+ * \brief Get the session to resume for a server, NULL for a full handshake.
+ * The session stays owned by the cache; pass it in esp_tls_cfg_t.client_session.
+ */
+esp_tls_client_session_t *tls_session_get(const char *host, uint16_t port);
+
+/**
+ * \brief Save the session negotiated on a connection that just completed its handshake,
+ * in RAM and in NVS, so the next connection to the same server can resume it.
+ */
+void tls_session_store(const char *host, uint16_t port, esp_tls_t *tls);
+
+/**
+ * \brief Drop the session of a server, e.g. because the handshake using it failed
+ */
+void tls_session_forget(const char *host, uint16_t port);